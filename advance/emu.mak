@@ -47,6 +47,8 @@ ifeq ($(CONF_LIB_PTHREAD),yes)
 CFLAGS += -D_REENTRANT
 ADVANCECFLAGS += -DUSE_SMP
 ADVANCELIBS += -lpthread
+MAMECFLAGS += -DUSE_SMP
+EMUCHDMANLDFLAGS += -lpthread
 ADVANCEOBJS += $(OBJ)/advance/osd/thdouble.o
 else
 ADVANCEOBJS += $(OBJ)/advance/osd/thmono.o
@@ -280,6 +282,8 @@ CFLAGS += -D_REENTRANT
 ADVANCECFLAGS += -DUSE_SMP
 # pthread-win32 library without exceptions management
 ADVANCELIBS += -lpthread
+MAMECFLAGS += -DUSE_SMP
+EMUCHDMANLDFLAGS += -lpthread
 ADVANCEOBJS += $(OBJ)/advance/osd/thdouble.o
 else
 ADVANCEOBJS += $(OBJ)/advance/osd/thmono.o
@@ -131,6 +131,206 @@ static adv_filter_real filter_iir_extract(adv_filter* f, adv_filter_state* s)
 	return s->y_map[s->y_mac];
 }
 
+/**
+ * Max number of samples processed in a single step of the block functions.
+ */
+#define FILTER_BLOCK_MAX 256
+
+/**
+ * Process a block of samples of a single channel.
+ * The ring state is linearized in a local buffer to avoid the index
+ * wrapping in the inner loops, and it's stored back at the end.
+ * The computation is the same of filter_iir_insert().
+ */
+static void filter_iir_block_mono(adv_filter* f, adv_filter_state* s, const short* input, unsigned step, adv_filter_real* output, unsigned count, adv_filter_real factor)
+{
+	struct adv_filter_struct_iir* iir = &f->data.iir;
+	unsigned M = iir->M;
+	unsigned N = iir->N;
+	adv_filter_real x[FILTER_STATE_MAX + FILTER_BLOCK_MAX];
+	adv_filter_real y[FILTER_STATE_MAX + FILTER_BLOCK_MAX];
+	unsigned i, j, k;
+
+	while (count) {
+		unsigned run = count < FILTER_BLOCK_MAX ? count : FILTER_BLOCK_MAX;
+
+		/* load the last M values of x, skipping the oldest */
+		j = s->x_mac + 1;
+		if (j == M + 1)
+			j = 0;
+		for(k=0;k<M;++k) {
+			++j;
+			if (j == M + 1)
+				j = 0;
+			x[k] = s->x_map[j];
+		}
+
+		/* load the last N values of y, skipping the oldest */
+		j = s->y_mac + 1;
+		if (j == N + 1)
+			j = 0;
+		for(k=0;k<N;++k) {
+			++j;
+			if (j == N + 1)
+				j = 0;
+			y[k] = s->y_map[j];
+		}
+
+		for(i=0;i<run;++i) {
+			const adv_filter_real* xp = x + i;
+			const adv_filter_real* yp = y + i;
+			double v;
+
+			x[M + i] = input[0] / iir->gain;
+			input += step;
+
+			v = 0;
+			for(k=0;k<=M;++k)
+				v += iir->xcoeffs[k] * xp[k];
+			for(k=0;k<N;++k)
+				v += iir->ycoeffs[k] * yp[k];
+
+			/* see filter_iir_insert() */
+			v += 1E-12;
+			v -= 1E-12;
+
+			y[N + i] = v;
+
+			output[0] += factor * v;
+			output += step;
+		}
+
+		/* store the most recent values, the last one is at the end */
+		for(k=0;k<=M;++k)
+			s->x_map[k] = x[run - 1 + k];
+		s->x_mac = M;
+		for(k=0;k<=N;++k)
+			s->y_map[k] = y[run - 1 + k];
+		s->y_mac = N;
+
+		count -= run;
+	}
+}
+
+#if defined(__GNUC__) && (defined(__SSE2__) || defined(__ARM_NEON) || defined(__aarch64__))
+#define USE_FILTER_VECTOR
+#endif
+
+#ifdef USE_FILTER_VECTOR
+/**
+ * Vector of two samples, one for each stereo channel.
+ * Double precision is kept as the high order IIR filters in direct form
+ * are not stable in single precision at low cut frequencies.
+ */
+typedef double filter_v2 __attribute__((vector_size(16)));
+
+/**
+ * Process a block of stereo samples with both the channels in the same vector.
+ * Each lane computes exactly the same operations of filter_iir_block_mono().
+ */
+static void filter_iir_block_stereo(adv_filter* f, adv_filter_state* s0, adv_filter_state* s1, const short* input, adv_filter_real* output, unsigned count, adv_filter_real factor)
+{
+	struct adv_filter_struct_iir* iir = &f->data.iir;
+	unsigned M = iir->M;
+	unsigned N = iir->N;
+	filter_v2 x[FILTER_STATE_MAX + FILTER_BLOCK_MAX];
+	filter_v2 y[FILTER_STATE_MAX + FILTER_BLOCK_MAX];
+	filter_v2 xc[FILTER_POLE_MAX];
+	filter_v2 yc[FILTER_POLE_MAX];
+	filter_v2 gain = { iir->gain, iir->gain };
+	filter_v2 tiny = { 1E-12, 1E-12 };
+	unsigned i, j0, j1, k;
+
+	for(k=0;k<=M;++k) {
+		xc[k][0] = iir->xcoeffs[k];
+		xc[k][1] = iir->xcoeffs[k];
+	}
+	for(k=0;k<N;++k) {
+		yc[k][0] = iir->ycoeffs[k];
+		yc[k][1] = iir->ycoeffs[k];
+	}
+
+	/* both the states are always updated together, but they may */
+	/* have been reset at different times, so they are indexed separately */
+	while (count) {
+		unsigned run = count < FILTER_BLOCK_MAX ? count : FILTER_BLOCK_MAX;
+
+		j0 = s0->x_mac + 1;
+		if (j0 == M + 1)
+			j0 = 0;
+		j1 = s1->x_mac + 1;
+		if (j1 == M + 1)
+			j1 = 0;
+		for(k=0;k<M;++k) {
+			if (++j0 == M + 1)
+				j0 = 0;
+			if (++j1 == M + 1)
+				j1 = 0;
+			x[k][0] = s0->x_map[j0];
+			x[k][1] = s1->x_map[j1];
+		}
+
+		j0 = s0->y_mac + 1;
+		if (j0 == N + 1)
+			j0 = 0;
+		j1 = s1->y_mac + 1;
+		if (j1 == N + 1)
+			j1 = 0;
+		for(k=0;k<N;++k) {
+			if (++j0 == N + 1)
+				j0 = 0;
+			if (++j1 == N + 1)
+				j1 = 0;
+			y[k][0] = s0->y_map[j0];
+			y[k][1] = s1->y_map[j1];
+		}
+
+		for(i=0;i<run;++i) {
+			const filter_v2* xp = x + i;
+			const filter_v2* yp = y + i;
+			filter_v2 in;
+			filter_v2 v;
+
+			in[0] = input[0];
+			in[1] = input[1];
+			input += 2;
+
+			x[M + i] = in / gain;
+
+			v = xc[0] * xp[0];
+			for(k=1;k<=M;++k)
+				v += xc[k] * xp[k];
+			for(k=0;k<N;++k)
+				v += yc[k] * yp[k];
+
+			v += tiny;
+			v -= tiny;
+
+			y[N + i] = v;
+
+			output[0] += factor * v[0];
+			output[1] += factor * v[1];
+			output += 2;
+		}
+
+		for(k=0;k<=M;++k) {
+			s0->x_map[k] = x[run - 1 + k][0];
+			s1->x_map[k] = x[run - 1 + k][1];
+		}
+		s0->x_mac = M;
+		s1->x_mac = M;
+		for(k=0;k<=N;++k) {
+			s0->y_map[k] = y[run - 1 + k][0];
+			s1->y_map[k] = y[run - 1 + k][1];
+		}
+		s0->y_mac = N;
+		s1->y_mac = N;
+
+		count -= run;
+	}
+}
+#endif
+
 static void filter_init(struct adv_filter_struct_iir* iir)
 {
 	iir->spoles_mac = 0;
@@ -736,3 +936,38 @@ void adv_filter_lp_windowedsinc_set(adv_filter* f, double freq, unsigned order)
 	f->model = adv_filter_fir_windowedsinc;
 }
 
+/****************************************************************************/
+/* Block */
+
+static void filter_generic_block_mono(adv_filter* f, adv_filter_state* s, const short* input, unsigned step, adv_filter_real* output, unsigned count, adv_filter_real factor)
+{
+	unsigned i;
+
+	for(i=0;i<count;++i) {
+		adv_filter_insert(f, s, input[0]);
+		output[0] += factor * adv_filter_extract(f, s);
+		input += step;
+		output += step;
+	}
+}
+
+void adv_filter_block_mix(adv_filter* f, adv_filter_state* s, unsigned channel, const short* input, adv_filter_real* output, unsigned count, adv_filter_real factor)
+{
+	unsigned j;
+
+	if (f->model == adv_filter_fir_windowedsinc) {
+		for(j=0;j<channel;++j)
+			filter_generic_block_mono(f, s + j, input + j, channel, output + j, count, factor);
+		return;
+	}
+
+#ifdef USE_FILTER_VECTOR
+	if (channel == 2) {
+		filter_iir_block_stereo(f, s, s + 1, input, output, count, factor);
+		return;
+	}
+#endif
+
+	for(j=0;j<channel;++j)
+		filter_iir_block_mono(f, s + j, input + j, channel, output + j, count, factor);
+}
@@ -218,6 +218,21 @@ static inline adv_filter_real adv_filter_extract(adv_filter* f, adv_filter_state
 	return f->extract(f, s);
 }
 
+/**
+ * Filter a block of interleaved samples and mix the result.
+ * It's equivalent at calling adv_filter_insert() and adv_filter_extract()
+ * for each sample and each channel, but it's a lot faster.
+ * The filtered value multiplied by the factor is added at the output.
+ * \param f Filter definition.
+ * \param s Vector of filter states, one for each channel.
+ * \param channel Number of interleaved channels.
+ * \param input Input samples.
+ * \param output Output values. The filtered values are added at the existing ones.
+ * \param count Number of samples for each channel.
+ * \param factor Multiplication factor of the filtered values.
+ */
+void adv_filter_block_mix(adv_filter* f, adv_filter_state* s, unsigned channel, const short* input, adv_filter_real* output, unsigned count, adv_filter_real factor);
+
 /*@}*/
 
 #ifdef __cplusplus
@@ -35,6 +35,56 @@
 
 #include <linux/input.h>
 
+#ifdef USE_SMP
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+/**
+ * Max number of devices read by the input thread.
+ */
+#define EVENT_THREAD_DEVICE_MAX 32
+
+/**
+ * Size of the ring buffer of every device. It must be a power of 2.
+ */
+#define EVENT_THREAD_RING_SIZE 1024
+
+/**
+ * Event read by the input thread.
+ */
+struct event_thread_item {
+	int type;
+	int code;
+	int value;
+};
+
+/**
+ * Device read by the input thread.
+ */
+struct event_thread_device {
+	int f; /**< Device handle, -1 if the slot is free. */
+	struct event_thread_item ring[EVENT_THREAD_RING_SIZE]; /**< Events read and not yet processed. */
+	unsigned head; /**< Events inserted in the ring. Written only by the input thread. */
+	unsigned tail; /**< Events extracted from the ring. Written only by the reader. */
+	unsigned overflow; /**< Events dropped because the ring was full. */
+	unsigned char press_bitmask[KEY_MAX/8 + 1]; /**< Keys pressed in the current poll. */
+};
+
+struct event_thread_context {
+	adv_bool active_flag; /**< If the input thread is running. */
+#ifdef USE_SMP
+	pthread_t thread; /**< Input thread. */
+	int epoll_f; /**< Epoll handle of all the devices. */
+	int wake_f; /**< Eventfd handle used to stop the thread. */
+#endif
+	unsigned mac; /**< Number of devices in use. */
+	struct event_thread_device map[EVENT_THREAD_DEVICE_MAX];
+};
+
+static struct event_thread_context event_thread;
+
 static void event_key_log(int f)
 {
 	unsigned char key_bitmask[KEY_MAX/8 + 1];
@@ -1356,6 +1406,8 @@ err:
 
 void event_close(int f)
 {
+	event_thread_remove(f);
+
 	close(f);
 }
 
@@ -2177,10 +2229,362 @@ adv_bool event_is_keyboard(int f, unsigned char* evtype_bitmask)
 	return event_test_bit_feature(f, EV_KEY, evtype_bitmask, KEY_FEATURE);
 }
 
+/***************************************************************************/
+/* Input thread */
+
+/*
+ * The input thread waits on all the registered devices with epoll and
+ * moves the events in a lock free ring buffer for every device.
+ * The event_read() function gets them from
+ * the ring instead of the device, so the devices are drained as soon
+ * as the events arrive, and the reader can get them at any time without
+ * a system call.
+ */
+
+static struct event_thread_device* event_thread_find(int f)
+{
+	unsigned i;
+
+	if (!event_thread.mac)
+		return 0;
+
+	for(i=0;i<EVENT_THREAD_DEVICE_MAX;++i)
+		if (event_thread.map[i].f == f)
+			return &event_thread.map[i];
+
+	return 0;
+}
+
+#ifdef USE_SMP
+/**
+ * Move all the available events of a device in its ring.
+ * Called only by the input thread.
+ * \return 0 on success, -1 if the device is gone.
+ */
+static adv_error event_thread_fill(struct event_thread_device* dev)
+{
+	struct input_event buffer[64];
+	unsigned head = dev->head;
+	unsigned tail;
+	int size;
+	int i;
+
+	while (1) {
+		size = read(dev->f, buffer, sizeof(buffer));
+
+		if (size == -1 && errno == EAGAIN)
+			break;
+
+		if (size <= 0) {
+			log_std(("ERROR:event: invalid read size %d on the input thread, errno %d (%s)\n", size, errno, strerror(errno)));
+			return -1;
+		}
+
+		tail = __atomic_load_n(&dev->tail, __ATOMIC_ACQUIRE);
+
+		for(i=0;i<size/(int)sizeof(buffer[0]);++i) {
+			struct event_thread_item* item;
+
+			if (head - tail >= EVENT_THREAD_RING_SIZE) {
+				++dev->overflow;
+				continue;
+			}
+
+			item = &dev->ring[head & (EVENT_THREAD_RING_SIZE - 1)];
+			item->type = buffer[i].type;
+			item->code = buffer[i].code;
+			item->value = buffer[i].value;
+			++head;
+		}
+
+		/* publish the events to the reader */
+		__atomic_store_n(&dev->head, head, __ATOMIC_RELEASE);
+
+		if (size < (int)sizeof(buffer))
+			break;
+	}
+
+	return 0;
+}
+
+static void* event_thread_func(void* arg)
+{
+	struct epoll_event ready[EVENT_THREAD_DEVICE_MAX];
+	int count;
+	int i;
+
+	while (1) {
+		count = epoll_wait(event_thread.epoll_f, ready, EVENT_THREAD_DEVICE_MAX, -1);
+		if (count < 0) {
+			if (errno == EINTR)
+				continue;
+			log_std(("ERROR:event: epoll_wait() failed, errno %d (%s)\n", errno, strerror(errno)));
+			break;
+		}
+
+		for(i=0;i<count;++i) {
+			struct event_thread_device* dev;
+
+			/* stop request */
+			if (ready[i].data.u32 == EVENT_THREAD_DEVICE_MAX)
+				return 0;
+
+			dev = &event_thread.map[ready[i].data.u32];
+
+			if ((ready[i].events & (EPOLLERR | EPOLLHUP)) != 0 || event_thread_fill(dev) != 0) {
+				/* the device is gone, stop waiting on it */
+				log_std(("event: device %d removed from the input thread\n", dev->f));
+				epoll_ctl(event_thread.epoll_f, EPOLL_CTL_DEL, dev->f, 0);
+			}
+		}
+	}
+
+	return 0;
+}
+
+static adv_error event_thread_watch(unsigned i)
+{
+	struct epoll_event e;
+
+	memset(&e, 0, sizeof(e));
+	e.events = EPOLLIN;
+	e.data.u32 = i;
+
+	if (epoll_ctl(event_thread.epoll_f, EPOLL_CTL_ADD, i == EVENT_THREAD_DEVICE_MAX ? event_thread.wake_f : event_thread.map[i].f, &e) != 0) {
+		log_std(("ERROR:event: epoll_ctl(EPOLL_CTL_ADD) failed, errno %d (%s)\n", errno, strerror(errno)));
+		return -1;
+	}
+
+	return 0;
+}
+
+static adv_error event_thread_start(void)
+{
+	unsigned i;
+
+	event_thread.epoll_f = epoll_create(EVENT_THREAD_DEVICE_MAX + 1);
+	if (event_thread.epoll_f == -1) {
+		log_std(("ERROR:event: epoll_create() failed, errno %d (%s)\n", errno, strerror(errno)));
+		goto err;
+	}
+
+	event_thread.wake_f = eventfd(0, 0);
+	if (event_thread.wake_f == -1) {
+		log_std(("ERROR:event: eventfd() failed, errno %d (%s)\n", errno, strerror(errno)));
+		goto err_epoll;
+	}
+
+	if (event_thread_watch(EVENT_THREAD_DEVICE_MAX) != 0)
+		goto err_wake;
+
+	for(i=0;i<EVENT_THREAD_DEVICE_MAX;++i) {
+		if (event_thread.map[i].f != -1 && event_thread_watch(i) != 0)
+			goto err_wake;
+	}
+
+	if (pthread_create(&event_thread.thread, 0, event_thread_func, 0) != 0) {
+		log_std(("ERROR:event: error calling pthread_create()\n"));
+		goto err_wake;
+	}
+
+	event_thread.active_flag = 1;
+
+	log_std(("event: input thread started with %d devices\n", event_thread.mac));
+
+	return 0;
+
+err_wake:
+	close(event_thread.wake_f);
+err_epoll:
+	close(event_thread.epoll_f);
+err:
+	return -1;
+}
+
+/**
+ * Stop using the input thread for all the devices.
+ * Called when the thread cannot be started, after it all the
+ * devices are read directly by event_read().
+ */
+static void event_thread_clear(void)
+{
+	unsigned i;
+
+	for(i=0;i<EVENT_THREAD_DEVICE_MAX;++i)
+		event_thread.map[i].f = -1;
+	event_thread.mac = 0;
+
+	log_std(("WARNING:event: input thread not available, reading the devices directly\n"));
+}
+
+static void event_thread_stop(void)
+{
+	unsigned long long one = 1;
+
+	if (!event_thread.active_flag)
+		return;
+
+	if (write(event_thread.wake_f, &one, sizeof(one)) != sizeof(one)) {
+		log_std(("ERROR:event: error waking the input thread\n"));
+	}
+
+	if (pthread_join(event_thread.thread, 0) != 0) {
+		log_std(("ERROR:event: error calling pthread_join()\n"));
+	}
+
+	close(event_thread.wake_f);
+	close(event_thread.epoll_f);
+
+	event_thread.active_flag = 0;
+
+	log_std(("event: input thread stopped\n"));
+}
+#endif
+
+/**
+ * Read the device with the input thread.
+ * After this call the event_read() function returns the events
+ * collected by the thread. If the thread is not available, the
+ * device is read directly as before.
+ * \param f Device handle returned by event_open().
+ */
+adv_error event_thread_add(int f)
+{
+#ifdef USE_SMP
+	struct event_thread_device* dev;
+	unsigned i;
+
+	if (event_thread_find(f) != 0)
+		return 0;
+
+	if (!event_thread.mac) {
+		for(i=0;i<EVENT_THREAD_DEVICE_MAX;++i)
+			event_thread.map[i].f = -1;
+	}
+
+	for(i=0;i<EVENT_THREAD_DEVICE_MAX;++i)
+		if (event_thread.map[i].f == -1)
+			break;
+	if (i == EVENT_THREAD_DEVICE_MAX) {
+		log_std(("WARNING:event: too many devices for the input thread\n"));
+		return -1;
+	}
+
+	dev = &event_thread.map[i];
+	dev->head = 0;
+	dev->tail = 0;
+	dev->overflow = 0;
+	memset(dev->press_bitmask, 0, sizeof(dev->press_bitmask));
+
+	/* set the handle only after the initialization */
+	/* the running thread starts to read it only after the epoll registration */
+	dev->f = f;
+	++event_thread.mac;
+
+	if (event_thread.active_flag) {
+		if (event_thread_watch(i) != 0)
+			goto err;
+	} else {
+		if (event_thread_start() != 0)
+			goto err_start;
+	}
+
+	log_std(("event: device %d read by the input thread\n", f));
+
+	return 0;
+
+err_start:
+	event_thread_clear();
+	return -1;
+err:
+	dev->f = -1;
+	--event_thread.mac;
+	return -1;
+#else
+	return -1;
+#endif
+}
+
+/**
+ * Stop reading the device with the input thread.
+ * It's called automatically by event_close().
+ */
+void event_thread_remove(int f)
+{
+#ifdef USE_SMP
+	struct event_thread_device* dev = event_thread_find(f);
+
+	if (!dev)
+		return;
+
+	/* the thread may be using the device, stop it */
+	/* it's restarted by the next event_read() of the remaining devices */
+	event_thread_stop();
+
+	if (dev->overflow != 0)
+		log_std(("WARNING:event: input thread ring overflow of %d events on device %d\n", dev->overflow, f));
+
+	dev->f = -1;
+	--event_thread.mac;
+#endif
+}
+
+/**
+ * Get an event from the ring of the input thread.
+ * A key release following a key press read in the same poll is left
+ * in the ring for the next poll, to not lose the very short presses.
+ */
+static adv_error event_thread_read(struct event_thread_device* dev, int* type, int* code, int* value)
+{
+	unsigned tail = dev->tail;
+	unsigned head = __atomic_load_n(&dev->head, __ATOMIC_ACQUIRE);
+	struct event_thread_item* item;
+
+	if (tail == head)
+		goto end;
+
+	item = &dev->ring[tail & (EVENT_THREAD_RING_SIZE - 1)];
+
+	if (item->type == EV_KEY && item->code >= 0 && item->code < KEY_MAX) {
+		if (item->value == 0 && event_test_bit(item->code, dev->press_bitmask))
+			goto end;
+		if (item->value == 1)
+			dev->press_bitmask[item->code / 8] |= 1 << (item->code % 8);
+	}
+
+	log_debug(("event: thread type %d, code %d, value %d\n", item->type, item->code, item->value));
+
+	*type = item->type;
+	*code = item->code;
+	*value = item->value;
+
+	/* release the space to the input thread */
+	__atomic_store_n(&dev->tail, tail + 1, __ATOMIC_RELEASE);
+
+	return 0;
+
+end:
+	/* the poll is complete */
+	memset(dev->press_bitmask, 0, sizeof(dev->press_bitmask));
+	return -1;
+}
+
 adv_error event_read(int f, int* type, int* code, int* value)
 {
 	int size;
 	struct input_event e;
+	struct event_thread_device* dev;
+
+	dev = event_thread_find(f);
+	if (dev) {
+#ifdef USE_SMP
+		/* restart the thread stopped by event_thread_remove() */
+		if (!event_thread.active_flag && event_thread_start() != 0)
+			event_thread_clear();
+		else
+#endif
+			return event_thread_read(dev, type, code, value);
+	}
 
 	size = read(f, &e, sizeof(e));
 
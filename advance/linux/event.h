@@ -39,6 +39,9 @@ void event_log(int f, unsigned char* evtype_bitmask);
 adv_error event_read(int f, int* type, int* code, int* value);
 adv_error event_write(int f, int type, int code, int value);
 
+adv_error event_thread_add(int f);
+void event_thread_remove(int f);
+
 adv_bool event_is_mouse(int f, unsigned char* evtype_bitmask);
 adv_bool event_is_joystick(int f, unsigned char* evtype_bitmask);
 adv_bool event_is_keyboard(int f, unsigned char* evtype_bitmask);
@@ -581,6 +581,9 @@ adv_error joystickb_event_init(int joystickb_id)
 		item->version = map[i].version;
 		item->bus = map[i].bus;
 
+		/* read the events as soon as they arrive */
+		event_thread_add(f);
+
 		++event_state.mac;
 	}
 
@@ -819,6 +819,9 @@ adv_error keyb_event_init(int keyb_id, adv_bool disable_special)
 		item->version = map[i].version;
 		item->bus = map[i].bus;
 
+		/* read the events as soon as they arrive */
+		event_thread_add(f);
+
 		++event_state.mac;
 	}
 
@@ -249,6 +249,9 @@ adv_error mouseb_event_init(int mouseb_id)
 		item->version = map[i].version;
 		item->bus = map[i].bus;
 
+		/* read the events as soon as they arrive */
+		event_thread_add(f);
+
 		++event_state.mac;
 	}
 
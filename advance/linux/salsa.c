@@ -41,15 +41,26 @@
 
 #include <alsa/asoundlib.h>
 
+#ifdef USE_SMP
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 /**
  * Base for the volume adjustment.
  */
 #define ALSA_VOLUME_BASE 32768
 
+/**
+ * Period time in seconds used with the feeder thread.
+ */
+#define ALSA_THREAD_PERIOD_TIME 0.005
+
 struct alsa_option_struct {
 	adv_bool initialized; /**< Options initialized. */
 	char device_buffer[256]; /**< Output card device. */
 	char mixer_buffer[256]; /**< Mixer card device. */
+	adv_bool thread_flag; /**< Use the feeder thread. */
 };
 
 static struct alsa_option_struct alsa_option;
@@ -62,6 +73,18 @@ struct soundb_alsa_context {
 	int volume; /**< Volume adjustement. ALSA_VOLUME_BASE == full volume. */
 	snd_pcm_uframes_t buffer_size; /**< ALSA buffer size in frames. */
 	snd_pcm_uframes_t period_size; /**< ALSA period size in frames. */
+#ifdef USE_SMP
+	adv_bool thread_flag; /**< If the feeder thread is running. */
+	pthread_t thread; /**< Feeder thread. */
+	int thread_stop; /**< Request to stop the feeder thread. */
+	adv_sample* ring_map; /**< Ring buffer of samples between the producer and the feeder thread. */
+	unsigned ring_size; /**< Size of the ring buffer in frames. It's a power of 2. */
+	unsigned ring_head; /**< Frames inserted in the ring. Written only by the producer. */
+	unsigned ring_tail; /**< Frames extracted from the ring. Written only by the feeder. */
+	unsigned hw_buffered; /**< Frames buffered in the device. Written only by the feeder. */
+	unsigned ring_overflow; /**< Frames dropped because the ring was full. */
+	unsigned hw_underrun; /**< Number of underruns of the device. */
+#endif
 };
 
 static struct soundb_alsa_context alsa_state;
@@ -112,6 +135,215 @@ static void alsa_log(snd_pcm_hw_params_t* hw_params, snd_pcm_sw_params_t* sw_par
 		log_std(("sound:alsa: hw buffer_size %d\n", (unsigned)buffer_size));
 }
 
+static void alsa_write(const adv_sample* sample_map, unsigned sample_count)
+{
+	int r;
+
+	/* calling write with a 0 size result in wrong output */
+	while (sample_count) {
+		if (alsa_state.volume == ALSA_VOLUME_BASE) {
+			/* write directly */
+			r = snd_pcm_writei(alsa_state.handle, sample_map, sample_count);
+		} else {
+			/* adjust the volume and write */
+			const unsigned buf_size = 2048;
+			adv_sample buf_map[buf_size];
+			unsigned run;
+			unsigned i;
+
+			run = sample_count * alsa_state.channel;
+			if (run > buf_size)
+				run = buf_size;
+
+			for(i=0;i<run;++i)
+				buf_map[i] = (int)sample_map[i] * alsa_state.volume / ALSA_VOLUME_BASE;
+
+			r = snd_pcm_writei(alsa_state.handle, buf_map, run / alsa_state.channel);
+		}
+
+		log_debug(("sound:alsa: snd_pcm_writei() -> %d\n", r));
+
+		if (r < 0) {
+			if (r == -EAGAIN) {
+				/* audio buffer full, it should never happen */
+				log_std(("WARNING:sound:alsa: snd_pcm_writei() failed: internal buffer full\n"));
+				/* retry */
+				continue;
+			}
+
+			if (r == -EPIPE)
+				log_std(("ERROR:sound:alsa: snd_pcm_writei() failed: %s. Increase the latency with -sound_latency.\n", snd_strerror(r)));
+			else
+				log_std(("ERROR:sound:alsa: snd_pcm_writei() failed: %s (%d)\n", snd_strerror(r), r));
+
+			if (r < 0) {
+				r = snd_pcm_prepare(alsa_state.handle);
+				if (r < 0)
+					log_std(("ERROR:sound:alsa: snd_pcm_prepare() failed: %s\n", snd_strerror(r)));
+			}
+
+			if (r < 0) {
+				break;
+			}
+		} else {
+			sample_count -= r;
+			sample_map += r * alsa_state.channel;
+		}
+	}
+}
+
+#ifdef USE_SMP
+/**
+ * Insert samples in the ring buffer.
+ * Called only by the producer. It never blocks, if the ring is full
+ * the exceeding samples are dropped.
+ */
+static void alsa_ring_put(const adv_sample* sample_map, unsigned sample_count)
+{
+	unsigned head = alsa_state.ring_head;
+	unsigned tail = __atomic_load_n(&alsa_state.ring_tail, __ATOMIC_ACQUIRE);
+	unsigned avail = alsa_state.ring_size - (head - tail);
+
+	if (sample_count > avail) {
+		log_std(("WARNING:sound:alsa: ring buffer full, dropped %d samples\n", sample_count - avail));
+		alsa_state.ring_overflow += sample_count - avail;
+		sample_count = avail;
+	}
+
+	while (sample_count) {
+		unsigned pos = head & (alsa_state.ring_size - 1);
+		unsigned run = alsa_state.ring_size - pos;
+		if (run > sample_count)
+			run = sample_count;
+
+		memcpy(alsa_state.ring_map + pos * alsa_state.channel, sample_map, run * alsa_state.sample_length);
+
+		head += run;
+		sample_map += run * alsa_state.channel;
+		sample_count -= run;
+	}
+
+	/* publish the samples to the feeder */
+	__atomic_store_n(&alsa_state.ring_head, head, __ATOMIC_RELEASE);
+}
+
+/**
+ * Feeder thread.
+ * It moves the samples from the ring buffer to the device in period
+ * sized chunks, waiting for the device to have space for them.
+ */
+static void* alsa_thread(void* arg)
+{
+	struct sched_param param;
+	unsigned period_us;
+	int r;
+
+	param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+	r = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+	if (r != 0)
+		log_std(("WARNING:sound:alsa: no real-time priority for the feeder thread, error %d\n", r));
+
+	period_us = alsa_state.period_size * 1000000ULL / alsa_state.rate;
+
+	while (!__atomic_load_n(&alsa_state.thread_stop, __ATOMIC_ACQUIRE)) {
+		unsigned tail = alsa_state.ring_tail;
+		unsigned head = __atomic_load_n(&alsa_state.ring_head, __ATOMIC_ACQUIRE);
+		unsigned fill = head - tail;
+		snd_pcm_sframes_t avail;
+		unsigned pos;
+		unsigned run;
+
+		avail = snd_pcm_avail(alsa_state.handle);
+		if (avail < 0) {
+			if (avail == -EPIPE)
+				++alsa_state.hw_underrun;
+			log_debug(("sound:alsa: snd_pcm_avail() failed: %s\n", snd_strerror(avail)));
+			r = snd_pcm_prepare(alsa_state.handle);
+			if (r < 0) {
+				log_std(("ERROR:sound:alsa: snd_pcm_prepare() failed: %s\n", snd_strerror(r)));
+				usleep(period_us);
+			}
+			continue;
+		}
+
+		if (avail > alsa_state.buffer_size)
+			avail = alsa_state.buffer_size;
+		__atomic_store_n(&alsa_state.hw_buffered, alsa_state.buffer_size - avail, __ATOMIC_RELEASE);
+
+		if (fill == 0) {
+			/* wait for the producer */
+			usleep(period_us / 4);
+			continue;
+		}
+
+		if (avail < alsa_state.period_size) {
+			/* wait for the device */
+			snd_pcm_wait(alsa_state.handle, period_us / 1000 + 1);
+			continue;
+		}
+
+		/* write at most a period, in a contiguous chunk */
+		pos = tail & (alsa_state.ring_size - 1);
+		run = alsa_state.ring_size - pos;
+		if (run > fill)
+			run = fill;
+		if (run > alsa_state.period_size)
+			run = alsa_state.period_size;
+
+		alsa_write(alsa_state.ring_map + pos * alsa_state.channel, run);
+
+		/* release the space to the producer */
+		__atomic_store_n(&alsa_state.ring_tail, tail + run, __ATOMIC_RELEASE);
+	}
+
+	return 0;
+}
+
+static adv_error alsa_thread_start(double buffer_time)
+{
+	unsigned size;
+
+	size = 1;
+	while (size < alsa_state.rate * buffer_time || size < alsa_state.buffer_size)
+		size *= 2;
+
+	alsa_state.ring_map = malloc(size * alsa_state.sample_length);
+	if (!alsa_state.ring_map)
+		return -1;
+
+	alsa_state.ring_size = size;
+	alsa_state.ring_head = 0;
+	alsa_state.ring_tail = 0;
+	alsa_state.hw_buffered = 0;
+	alsa_state.ring_overflow = 0;
+	alsa_state.hw_underrun = 0;
+	alsa_state.thread_stop = 0;
+
+	if (pthread_create(&alsa_state.thread, 0, alsa_thread, 0) != 0) {
+		log_std(("ERROR:sound:alsa: error calling pthread_create()\n"));
+		free(alsa_state.ring_map);
+		return -1;
+	}
+
+	log_std(("sound:alsa: feeder thread started with a ring of %d samples\n", size));
+
+	return 0;
+}
+
+static void alsa_thread_stop(void)
+{
+	__atomic_store_n(&alsa_state.thread_stop, 1, __ATOMIC_RELEASE);
+
+	if (pthread_join(alsa_state.thread, 0) != 0) {
+		log_std(("ERROR:sound:alsa: error calling pthread_join()\n"));
+	}
+
+	log_std(("sound:alsa: feeder thread stopped, overflow %d samples, underrun %d times\n", alsa_state.ring_overflow, alsa_state.hw_underrun));
+
+	free(alsa_state.ring_map);
+}
+#endif
+
 adv_error soundb_alsa_init(int sound_id, unsigned* rate, adv_bool stereo_flag, double buffer_time)
 {
 	int r;
@@ -187,6 +419,17 @@ adv_error soundb_alsa_init(int sound_id, unsigned* rate, adv_bool stereo_flag, d
 	buffer_size = alsa_state.rate * buffer_time;
 	period_size = buffer_size / 4;
 
+#ifdef USE_SMP
+	/* with the feeder thread use small periods, as the latency */
+	/* is controlled by the ring buffer and not by the device */
+	alsa_state.thread_flag = alsa_option.thread_flag;
+	if (alsa_state.thread_flag) {
+		period_size = alsa_state.rate * ALSA_THREAD_PERIOD_TIME;
+		if (period_size < 32)
+			period_size = 32;
+	}
+#endif
+
 	log_std(("sound:alsa: request period_size of %d samples\n", (unsigned)period_size));
 
 	r = snd_pcm_hw_params_set_period_size_near(alsa_state.handle, hw_params, &period_size, 0);
@@ -260,6 +503,15 @@ adv_error soundb_alsa_init(int sound_id, unsigned* rate, adv_bool stereo_flag, d
 
 	alsa_log(hw_params, sw_params);
 
+#ifdef USE_SMP
+	if (alsa_state.thread_flag) {
+		if (alsa_thread_start(buffer_time) != 0) {
+			log_std(("ERROR:sound:alsa: Couldn't start the feeder thread\n"));
+			alsa_state.thread_flag = 0;
+		}
+	}
+#endif
+
 	*rate = alsa_state.rate;
 
 	return 0;
@@ -275,6 +527,11 @@ void soundb_alsa_done(void)
 {
 	log_std(("sound:alsa: soundb_alsa_done()\n"));
 
+#ifdef USE_SMP
+	if (alsa_state.thread_flag)
+		alsa_thread_stop();
+#endif
+
 	snd_pcm_drop(alsa_state.handle);
 	snd_pcm_close(alsa_state.handle);
 }
@@ -289,6 +546,19 @@ unsigned soundb_alsa_buffered(void)
 	int r;
 	snd_pcm_sframes_t avail;
 
+#ifdef USE_SMP
+	if (alsa_state.thread_flag) {
+		/* samples in the ring plus the ones in the device, as measured by the feeder */
+		unsigned head = alsa_state.ring_head;
+		unsigned tail = __atomic_load_n(&alsa_state.ring_tail, __ATOMIC_ACQUIRE);
+		unsigned hw = __atomic_load_n(&alsa_state.hw_buffered, __ATOMIC_ACQUIRE);
+
+		log_debug(("sound:alsa: ring = %d, device = %d\n", head - tail, hw));
+
+		return head - tail + hw;
+	}
+#endif
+
 	r = snd_pcm_avail(alsa_state.handle);
 	if (r < 0) {
 		if (r == -EPIPE) {
@@ -422,61 +692,16 @@ void soundb_alsa_volume(double volume)
 
 void soundb_alsa_play(const adv_sample* sample_map, unsigned sample_count)
 {
-	int r;
-
 	log_debug(("sound:alsa: soundb_alsa_play(count:%d)\n", sample_count));
 
-	/* calling write with a 0 size result in wrong output */
-	while (sample_count) {
-		if (alsa_state.volume == ALSA_VOLUME_BASE) {
-			/* write directly */
-			r = snd_pcm_writei(alsa_state.handle, sample_map, sample_count);
-		} else {
-			/* adjust the volume and write */
-			const unsigned buf_size = 2048;
-			adv_sample buf_map[buf_size];
-			unsigned run;
-			unsigned i;
-
-			run = sample_count * alsa_state.channel;
-			if (run > buf_size)
-				run = buf_size;
-
-			for(i=0;i<run;++i)
-				buf_map[i] = (int)sample_map[i] * alsa_state.volume / ALSA_VOLUME_BASE;
-
-			r = snd_pcm_writei(alsa_state.handle, buf_map, run / alsa_state.channel);
-		}
-
-		log_debug(("sound:alsa: snd_pcm_writei() -> %d\n", r));
-
-		if (r < 0) {
-			if (r == -EAGAIN) {
-				/* audio buffer full, it should never happen */
-				log_std(("WARNING:sound:alsa: snd_pcm_writei() failed: internal buffer full\n"));
-				/* retry */
-				continue;
-			}
-
-			if (r == -EPIPE)
-				log_std(("ERROR:sound:alsa: snd_pcm_writei() failed: %s. Increase the latency with -sound_latency.\n", snd_strerror(r)));
-			else
-				log_std(("ERROR:sound:alsa: snd_pcm_writei() failed: %s (%d)\n", snd_strerror(r), r));
-
-			if (r < 0) {
-				r = snd_pcm_prepare(alsa_state.handle);
-				if (r < 0)
-					log_std(("ERROR:sound:alsa: snd_pcm_prepare() failed: %s\n", snd_strerror(r)));
-			}
-
-			if (r < 0) {
-				break;
-			}
-		} else {
-			sample_count -= r;
-			sample_map += r * alsa_state.channel;
-		}
+#ifdef USE_SMP
+	if (alsa_state.thread_flag) {
+		alsa_ring_put(sample_map, sample_count);
+		return;
 	}
+#endif
+
+	alsa_write(sample_map, sample_count);
 }
 
 adv_error soundb_alsa_start(double silence_time)
@@ -518,6 +743,11 @@ adv_error soundb_alsa_load(adv_conf* context)
 {
 	sncpy(alsa_option.device_buffer, sizeof(alsa_option.device_buffer), conf_string_get_default(context, "device_alsa_device"));
 	sncpy(alsa_option.mixer_buffer, sizeof(alsa_option.mixer_buffer), conf_string_get_default(context, "device_alsa_mixer"));
+#ifdef USE_SMP
+	alsa_option.thread_flag = conf_bool_get_default(context, "device_alsa_thread");
+#else
+	alsa_option.thread_flag = 0;
+#endif
 
 	alsa_option.initialized = 1;
 
@@ -528,12 +758,20 @@ void soundb_alsa_reg(adv_conf* context)
 {
 	conf_string_register_default(context, "device_alsa_device", "default");
 	conf_string_register_default(context, "device_alsa_mixer", "channel");
+#ifdef USE_SMP
+	conf_bool_register_default(context, "device_alsa_thread", 1);
+#endif
 }
 
 void soundb_alsa_default(void)
 {
 	sncpy(alsa_option.device_buffer, sizeof(alsa_option.device_buffer), "default");
 	sncpy(alsa_option.mixer_buffer, sizeof(alsa_option.mixer_buffer), "channel");
+#ifdef USE_SMP
+	alsa_option.thread_flag = 1;
+#else
+	alsa_option.thread_flag = 0;
+#endif
 
 	alsa_option.initialized = 1;
 }
@@ -229,6 +229,10 @@ static void help(void)
 	target_out("%sremove         remove all the default option from the configuration file\n", slash);
 	target_out("%slog            create a log of operations\n", slash);
 	target_out("%slistxml        output the rom XML file\n", slash);
+#ifndef MESS
+	target_out("%scpubench [CPU] run the CPU cores benchmarks\n", slash);
+	target_out("%sverifyroms [GAME] verify the romsets\n", slash);
+#endif
 	target_out("%srecord FILE    record an .inp file\n", slash);
 	target_out("%splayback FILE  play an .inp file\n", slash);
 	target_out("%sversion        print the version\n", slash);
@@ -609,6 +613,8 @@ int os_main(int argc, char* argv[])
 	int i;
 	struct mame_option option;
 	int opt_xml;
+	int opt_cpubench;
+	int opt_verifyroms;
 	int opt_log;
 	int opt_logsync;
 	int opt_default;
@@ -626,6 +632,8 @@ int os_main(int argc, char* argv[])
 	const char* control;
 
 	opt_xml = 0;
+	opt_cpubench = 0;
+	opt_verifyroms = 0;
 	opt_log = 0;
 	opt_logsync = 0;
 	opt_gamename = 0;
@@ -702,6 +710,12 @@ int os_main(int argc, char* argv[])
 			option.debug_flag = 1;
 		} else if (target_option_compare(argv[i], "listxml")) {
 			opt_xml = 1;
+#ifndef MESS
+		} else if (target_option_compare(argv[i], "cpubench")) {
+			opt_cpubench = 1;
+		} else if (target_option_compare(argv[i], "verifyroms")) {
+			opt_verifyroms = 1;
+#endif
 		} else if (target_option_compare(argv[i], "record") && i+1<argc && argv[i+1][0] != '-') {
 			if (strchr(argv[i+1], '.') == 0)
 				snprintf(option.record_file_buffer, sizeof(option.record_file_buffer), "%s.inp", argv[i+1]);
@@ -809,6 +823,24 @@ int os_main(int argc, char* argv[])
 		goto done_os;
 	}
 
+#ifndef MESS
+	if (opt_cpubench) {
+		/* the optional game name is the CPU to benchmark */
+		if (mame_cpu_benchmark(stdout, opt_gamename) != 0)
+			goto err_os;
+		goto done_os;
+	}
+
+	if (opt_verifyroms) {
+		/* the optional game name is the only romset to verify */
+		if (advance_fileio_config_load(&context->fileio, context->cfg, &option) != 0)
+			goto err_os;
+		if (mame_verify_roms(stdout, opt_gamename) != 0)
+			goto err_os;
+		goto done_os;
+	}
+#endif
+
 	if (opt_default) {
 		conf_setdefault_all_if_missing(context->cfg, "");
 		if (conf_save(context->cfg, 1, 0, error_callback, 0) != 0) {
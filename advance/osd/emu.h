@@ -319,6 +319,17 @@ struct advance_ui_config_context {
 	adv_color_rgb ui_color[UI_COLOR_MAX]; /**< Colors. */
 };
 
+/** Max number of user interface layers. */
+#define UI_LAYER_MAX 8
+
+/** User interface element to put directly on the screen. */
+struct ui_layer {
+	adv_bitmap* flat; /**< Image of the element. */
+	int x; /**< Screen position. */
+	int y; /**< Screen position. */
+	adv_color_def def; /**< Color definition of the screen. */
+};
+
 struct advance_ui_state_context {
 	adv_bool ui_extra_flag; /**< Extra frame to be drawn to clear the off game border. */
 	adv_bool ui_message_flag; /**< User interface message display flag. */
@@ -354,6 +365,10 @@ struct advance_ui_state_context {
 	adv_color_def buffer_def; /**< Color definition of the internal bitmap buffer. */
 
 	struct ui_color_set color_map; /**< Current color mapping. */
+
+	adv_bool ui_layer_flag; /**< If the elements are saved as layers instead of drawn. */
+	struct ui_layer ui_layer_map[UI_LAYER_MAX]; /**< Layers to put on the screen. */
+	unsigned ui_layer_mac; /**< Number of layers. */
 };
 
 struct advance_ui_context {
@@ -377,6 +392,10 @@ void advance_ui_menu_dft_insert(struct ui_menu* menu, double* m, unsigned n, dou
 
 void advance_ui_buffer_update(struct advance_ui_context* context, void* ptr, unsigned dx, unsigned dy, unsigned dw, adv_color_def color_def, adv_color_rgb* palette_map, unsigned palette_max);
 void advance_ui_direct_update(struct advance_ui_context* context, void* ptr, unsigned dx, unsigned dy, unsigned dw, adv_color_def color_def, adv_color_rgb* palette_map, unsigned palette_max);
+unsigned advance_ui_layer_update(struct advance_ui_context* context, unsigned dx, unsigned dy, adv_color_def color_def, adv_color_rgb* palette_map, unsigned palette_max);
+void advance_ui_layer_get(struct advance_ui_context* context, unsigned i, int* x, int* y, unsigned* dx, unsigned* dy);
+void advance_ui_layer_put(struct advance_ui_context* context, unsigned i, adv_bitmap* dst, int x, int y);
+void advance_ui_layer_free(struct advance_ui_context* context);
 adv_error advance_ui_init(struct advance_ui_context* context, adv_conf* cfg_context);
 adv_error advance_ui_config_load(struct advance_ui_context* context, adv_conf* cfg_context, struct mame_option* option);
 void advance_ui_done(struct advance_ui_context* context);
@@ -419,6 +438,9 @@ struct advance_record_state_context {
 	unsigned video_freq_step; /**< Frequency base value. */
 	unsigned video_freq_base; /**< Frequency step value. */
 	adv_bool video_stopped_flag; /**< If the video recording is stopped. */
+	adv_bool video_changed_flag; /**< If the image changed after the last frame written. */
+	off_t video_fram_offset; /**< File offset of the last frame chunk written, or 0 if none. */
+	unsigned video_fram_tick; /**< Delay of the last frame chunk written. */
 
 	char sound_file_buffer[FILE_MAXPATH]; /**< Sound file */
 	FILE* sound_f; /**< Sound handle */
@@ -439,7 +461,7 @@ void advance_record_done(struct advance_record_context* context);
 adv_error advance_record_config_load(struct advance_record_context* context, adv_conf* cfg_context);
 
 void advance_record_sound_update(struct advance_record_context* context, const short* sample_buffer, unsigned sample_count);
-void advance_record_video_update(struct advance_record_context* context, const void* video_buffer, unsigned video_width, unsigned video_height, unsigned video_bytes_per_pixel, unsigned video_bytes_per_scanline, adv_color_def color_def, adv_color_rgb* palette_map, unsigned palette_max, unsigned orientation);
+void advance_record_video_update(struct advance_record_context* context, const void* video_buffer, unsigned video_width, unsigned video_height, unsigned video_bytes_per_pixel, unsigned video_bytes_per_scanline, adv_color_def color_def, adv_color_rgb* palette_map, unsigned palette_max, unsigned orientation, adv_bool unchanged);
 void advance_record_snapshot_update(struct advance_record_context* context, const void* video_buffer, unsigned video_width, unsigned video_height, unsigned video_bytes_per_pixel, unsigned video_bytes_per_scanline, adv_color_def color_def, adv_color_rgb* palette_map, unsigned palette_max, unsigned orientation);
 
 adv_bool advance_record_sound_is_active(struct advance_record_context* context);
@@ -451,22 +473,25 @@ adv_error advance_record_png_write(adv_fz* f, const void* video_buffer, unsigned
 /***************************************************************************/
 /* Estimate */
 
+/** Time model of a part of the frame. */
+struct advance_estimate_part {
+	double full; /**< Average time for a full frame. */
+	double skip; /**< Average time for a skip frame. */
+	double full_predict; /**< Predicted time for the next full frame. */
+	double skip_predict; /**< Predicted time for the next skip frame. */
+	double full_last; /**< Time of the latest full frame. */
+	adv_bool flag; /**< If the begin time is set. */
+	double begin; /**< Begin time. */
+};
+
 struct advance_estimate_context {
-	double estimate_mame_full; /**< Estimate time for a MAME full frame */
-	double estimate_mame_skip; /**< Estimate time for a MAME skip frame */
-	double estimate_osd_full; /**< Estimate time for a OSD full frame */
-	double estimate_osd_skip; /**< Estimate time for a OSD skip frame */
-	double estimate_common_full;
-	double estimate_common_skip;
+	struct advance_estimate_part mame; /**< MAME emulation. */
+	struct advance_estimate_part osd; /**< OSD video update. */
+	struct advance_estimate_part sound; /**< OSD sound update. */
+	struct advance_estimate_part common; /**< Data exchange with the video thread. */
 	double estimate_frame; /**< Estimate time for a MAME+OSD frame */
-	adv_bool estimate_mame_flag; /**< If last time at point 1 is set */
-	adv_bool estimate_osd_flag; /**< If last time at point 2 is set */
-	adv_bool estimate_frame_flag; /**< If last time at point 3 is set */
-	adv_bool estimate_common_flag;
-	double estimate_mame_last; /**< Last time at point 1 */
-	double estimate_osd_last; /**< Last time at point 2 */
-	double estimate_frame_last; /**< Last time at point 3 */
-	double estimate_common_last;
+	adv_bool estimate_frame_flag; /**< If the last frame time is set */
+	double estimate_frame_last; /**< Last frame time */
 };
 
 void advance_estimate_init(struct advance_estimate_context* context, double step);
@@ -475,6 +500,8 @@ void advance_estimate_mame_begin(struct advance_estimate_context* context);
 void advance_estimate_mame_end(struct advance_estimate_context* context, adv_bool skip_flag);
 void advance_estimate_osd_begin(struct advance_estimate_context* context);
 void advance_estimate_osd_end(struct advance_estimate_context* context, adv_bool skip_flag);
+void advance_estimate_sound_begin(struct advance_estimate_context* context);
+void advance_estimate_sound_end(struct advance_estimate_context* context, adv_bool skip_flag);
 void advance_estimate_frame(struct advance_estimate_context* context);
 void advance_estimate_common_begin(struct advance_estimate_context* context);
 void advance_estimate_common_end(struct advance_estimate_context* context, adv_bool skip_flag);
@@ -500,6 +527,23 @@ void advance_estimate_common_end(struct advance_estimate_context* context, adv_b
  */
 #define SOUND_POWER_DB_MAX 120
 
+/**
+ * Number of taps of the internal resampler.
+ * The SIMD implementation assumes 16 taps.
+ */
+#define SOUND_RESAMPLE_TAPS 16
+
+/**
+ * Number of phases of the internal resampler as power of 2.
+ */
+#define SOUND_RESAMPLE_PHASE_BIT 8
+#define SOUND_RESAMPLE_PHASE_MAX (1 << SOUND_RESAMPLE_PHASE_BIT)
+
+/**
+ * Bits of fractional precision of the resampler coefficients.
+ */
+#define SOUND_RESAMPLE_COEFF_BIT 14
+
 struct advance_sound_config_context {
 	double latency_time; /**< Requested minimum latency in seconds */
 	int mode; /**< Channel mode. */
@@ -554,6 +598,10 @@ struct advance_sound_state_context {
 	double equalizer_mid_factor;
 	double equalizer_high_factor;
 
+	adv_bool resample_flag; /**< If the internal resampler is in use. */
+	short resample_history[2][SOUND_RESAMPLE_TAPS]; /**< Last input samples of each channel. */
+	short resample_coeff[SOUND_RESAMPLE_PHASE_MAX][SOUND_RESAMPLE_TAPS]; /**< Polyphase filter coefficients. */
+
 	/* Menu state */
 	adv_bool menu_sub_flag; /**< If the sub menu is active. */
 	int menu_sub_selected; /**< Index of the selected sub menu voice. */
@@ -672,12 +720,19 @@ struct advance_video_config_context {
 	unsigned game_orientation; /**< Game orientation mask. Mask of ORIENTATION_*. */
 	int combine; /**< Combine effect. Mask of COMBINE_*. */
 	int combine_max; /**< Maximum combine effect. Always starting with COMBINE_XBR and then decreasing at runtime. */
+	unsigned combine_budget; /**< Max share of the frame time for the automatic combine effect [percent]. 0 for no limit. */
+	adv_bool combine_cache_flag; /**< If combine_max was loaded from the saved value of the game. */
+	unsigned combine_cache_size_x; /**< Video mode size of the saved combine_max. */
+	unsigned combine_cache_size_y; /**< Video mode size of the saved combine_max. */
 	int rgb_effect; /**< Special additional effect. Mask of EFFECT_*. */
 	int interlace_effect; /**< Special additional interlace effect. Mask of EFFECT_*. */
 	double turbo_speed_factor; /**< Speed of the turbo function. Multiplicative factor. */
 	double fps_speed_factor; /**< Additional speed factor over the standard value. Multiplicative factor. */
 	double fps_fixed; /**< Fixed fps. If ==0 use the original fps. */
 	int fastest_time; /**< Time for turbo at the startup [seconds]. */
+	adv_bool delay_auto_flag; /**< Automatic frame delay. */
+	double delay_time; /**< Fixed frame delay after the syncronization [seconds]. 0 for none. */
+	adv_bool runahead_auto_flag; /**< Automatic run-ahead, the measured lag is saved. */
 	int measure_time; /**< Time for the speed measure [seconds]. */
 	adv_bool restore_flag; /**< Reset the video mode at the exit [boolean]. */
 	unsigned magnify_factor; /**< Magnify factor requested [0=auto,1,2,3,4]. */
@@ -713,6 +768,9 @@ struct advance_video_config_context {
 #define AUDIOVIDEO_MEASURE_MAX 17
 
 #define PIPELINE_MEASURE_MAX 13
+
+/** Number of measures of the emulation time used by the frame delay. */
+#define DELAY_MEASURE_MAX 128
 #define PIPELINE_BLIT_MAX 2 /**< Number of pipelines to create. 0 for buffered, 1 for direct write. */
 
 /** State for the video part. */
@@ -779,6 +837,17 @@ struct advance_video_state_context {
 	adv_bool sync_throttle_flag; /**< Throttle mode flag. */
 	unsigned sync_skip_counter; /**< Number of frames skipped. */
 
+	/* Frame delay */
+	double delay_map[DELAY_MEASURE_MAX]; /**< Circular buffer of the most recent emulation times after the delay. */
+	unsigned delay_mac; /**< Current position in the ::delay_map buffer. */
+	unsigned delay_count; /**< Number of valid measures in the ::delay_map buffer. */
+	double delay_time; /**< Current delay after the syncronization [seconds]. */
+	double delay_last; /**< Time of the end of the latest delay. */
+	unsigned delay_hold_counter; /**< Number of frames to wait before increasing the delay after a miss. */
+
+	/* Run-ahead */
+	adv_bool runahead_saved_flag; /**< If the measured lag of the game was already saved. */
+
 	/* Frameskip */
 	adv_bool skip_warming_up_flag; /**< Initializing flag. */
 	adv_bool skip_flag; /**< Skip the next frame flag. */
@@ -788,8 +857,12 @@ struct advance_video_state_context {
 	unsigned skip_level_skip; /**< Number of frames to skip in the cycle. */
 	unsigned skip_level_sum; /**< Total number of frame in the cycle. */
 	adv_bool skip_level_disable_flag; /**< If skipping was disabled for some reasons. */
+	unsigned skip_level_stable; /**< Number of frames since the latest change of the automatic cycle. */
+	double skip_time_predict; /**< Predicted time of the next full frame. */
+	double skip_time_last; /**< Time of the latest full frame. */
 	unsigned skip_level_combine_counter; /**< Counter of slow frame before decreasing the combine effect. */
 	unsigned skip_level_combine_total; /**< Total counter of slow frame before decreasing the combine effect. */
+	adv_bool combine_budget_flag; /**< If a pipeline measure is completed and it must be checked with the time budget. */
 
 	int latency_diff; /**< Current sound latency error in samples. */
 
@@ -852,6 +925,22 @@ struct advance_video_state_context {
 	struct video_pipeline_struct buffer_pipeline_video; /**< Put pipeline to buffer. */
 	adv_color_def buffer_def; /**< Put pipeline to buffer color format. */
 
+	/* Unchanged frame detection */
+	unsigned char* last_ptr; /**< Copy of the game image last put on the screen, or 0. */
+	unsigned last_row_size; /**< Size in bytes of one row of the copy. */
+	unsigned last_row_count; /**< Number of rows of the copy. */
+	int last_visible_pos_x; /**< Visible position of the copy. */
+	int last_visible_pos_y; /**< Visible position of the copy. */
+	unsigned last_counter; /**< Number of video pages already containing the copy. */
+
+	/* User interface layers */
+	unsigned layer_clear_counter; /**< Number of video pages where to clear the area of the ui. */
+	int layer_clear_x0; /**< Area of the ui to clear. */
+	int layer_clear_y0; /**< Area of the ui to clear. */
+	int layer_clear_x1; /**< Area of the ui to clear. */
+	int layer_clear_y1; /**< Area of the ui to clear. */
+	adv_bitmap* layer_area; /**< Copy of the screen under the ui, allocated for the whole screen. */
+
 	int combine; /**< One of the COMBINE_ effect. */
 	int rgb_effect; /**< One of the EFFECT_ effect. */
 	int interlace_effect; /**< One of the EFFECT_INTERLACE_ effect. */
@@ -942,6 +1031,8 @@ void advance_video_reconfigure(struct advance_video_context* context, struct adv
 
 void advance_video_skip(struct advance_video_context* context, struct advance_estimate_context* estimate_context, struct advance_record_context* record_context);
 void advance_video_sync(struct advance_video_context* context, struct advance_sound_context* sound_context, struct advance_estimate_context* estimate_context, adv_bool skip_flag);
+adv_bool advance_video_delay_is_active(struct advance_video_context* context);
+void advance_video_delay(struct advance_video_context* context);
 void advance_video_frame(struct advance_video_context* context, struct advance_record_context* record_context, struct advance_ui_context* ui_context, const struct osd_bitmap* game, const struct osd_bitmap* debug, const osd_rgb_t* debug_palette, unsigned debug_palette_size, adv_bool skip_flag);
 void advance_sound_frame(struct advance_sound_context* context, struct advance_record_context* record_context, struct advance_video_context* video_context, struct advance_safequit_context* safequit_context, const short* sample_buffer, unsigned sample_count, unsigned sample_recount, adv_bool normal_speed);
 
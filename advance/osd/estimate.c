@@ -37,86 +37,102 @@ static inline double estimate_merge(double estimator, double v)
 	return 0.95 * estimator + 0.05 * v;
 }
 
-void advance_estimate_init(struct advance_estimate_context* context, double step)
+/**
+ * Update a prediction of the time of the next frame.
+ * The increments are followed quickly to react at the load spikes,
+ * the decrements slowly to not trust a single fast frame.
+ */
+static inline double estimate_predict(double predictor, double v)
 {
-	context->estimate_mame_flag = 0;
-	context->estimate_osd_flag = 0;
-	context->estimate_frame_flag = 0;
-	context->estimate_common_flag = 0;
+	if (v > predictor)
+		return 0.5 * predictor + 0.5 * v;
+	else
+		return 0.9 * predictor + 0.1 * v;
+}
 
-	context->estimate_frame = step;
-	context->estimate_mame_skip = 0.01 * step;
-	context->estimate_mame_full = 0.7 * step;
-	context->estimate_osd_skip = 0.01 * step;
-	context->estimate_osd_full = 0.1 * step;
-	context->estimate_common_skip = 0.001 * step;
-	context->estimate_common_full = 0.001 * step;
+static void estimate_part_init(struct advance_estimate_part* part, double full, double skip)
+{
+	part->flag = 0;
+	part->full = full;
+	part->skip = skip;
+	part->full_predict = full;
+	part->skip_predict = skip;
+	part->full_last = full;
 }
 
-void advance_estimate_mame_end(struct advance_estimate_context* context, adv_bool skip_flag)
+static void estimate_part_begin(struct advance_estimate_part* part)
+{
+	part->flag = 1;
+	part->begin = advance_timer();
+}
+
+static void estimate_part_end(struct advance_estimate_part* part, adv_bool skip_flag)
 {
 	double current = advance_timer();
 
-	if (context->estimate_mame_flag) {
+	if (part->flag) {
 		double previous;
-		previous = current - context->estimate_mame_last;
-		if (skip_flag)
-			context->estimate_mame_skip = estimate_merge(context->estimate_mame_skip, previous);
-		else
-			context->estimate_mame_full = estimate_merge(context->estimate_mame_full, previous);
+		previous = current - part->begin;
+		if (skip_flag) {
+			part->skip = estimate_merge(part->skip, previous);
+			part->skip_predict = estimate_predict(part->skip_predict, previous);
+		} else {
+			part->full = estimate_merge(part->full, previous);
+			part->full_predict = estimate_predict(part->full_predict, previous);
+			part->full_last = previous;
+		}
 	}
 }
 
-void advance_estimate_osd_begin(struct advance_estimate_context* context)
+void advance_estimate_init(struct advance_estimate_context* context, double step)
 {
-	double current = advance_timer();
+	context->estimate_frame_flag = 0;
+	context->estimate_frame = step;
 
-	context->estimate_osd_flag = 1;
-	context->estimate_osd_last = current;
+	estimate_part_init(&context->mame, 0.7 * step, 0.01 * step);
+	estimate_part_init(&context->osd, 0.1 * step, 0.01 * step);
+	estimate_part_init(&context->sound, 0.01 * step, 0.01 * step);
+	estimate_part_init(&context->common, 0.001 * step, 0.001 * step);
 }
 
-void advance_estimate_osd_end(struct advance_estimate_context* context, adv_bool skip_flag)
+void advance_estimate_mame_begin(struct advance_estimate_context* context)
 {
-	double current = advance_timer();
+	estimate_part_begin(&context->mame);
+}
 
-	if (context->estimate_osd_flag) {
-		double previous;
-		previous = current - context->estimate_osd_last;
-		if (skip_flag)
-			context->estimate_osd_skip = estimate_merge(context->estimate_osd_skip, previous);
-		else
-			context->estimate_osd_full = estimate_merge(context->estimate_osd_full, previous);
-	}
+void advance_estimate_mame_end(struct advance_estimate_context* context, adv_bool skip_flag)
+{
+	estimate_part_end(&context->mame, skip_flag);
 }
 
-void advance_estimate_common_begin(struct advance_estimate_context* context)
+void advance_estimate_osd_begin(struct advance_estimate_context* context)
 {
-	double current = advance_timer();
+	estimate_part_begin(&context->osd);
+}
 
-	context->estimate_common_flag = 1;
-	context->estimate_common_last = current;
+void advance_estimate_osd_end(struct advance_estimate_context* context, adv_bool skip_flag)
+{
+	estimate_part_end(&context->osd, skip_flag);
 }
 
-void advance_estimate_common_end(struct advance_estimate_context* context, adv_bool skip_flag)
+void advance_estimate_sound_begin(struct advance_estimate_context* context)
 {
-	double current = advance_timer();
+	estimate_part_begin(&context->sound);
+}
 
-	if (context->estimate_common_flag) {
-		double previous;
-		previous = current - context->estimate_common_last;
-		if (skip_flag)
-			context->estimate_common_skip = estimate_merge(context->estimate_common_skip, previous);
-		else
-			context->estimate_common_full = estimate_merge(context->estimate_common_full, previous);
-	}
+void advance_estimate_sound_end(struct advance_estimate_context* context, adv_bool skip_flag)
+{
+	estimate_part_end(&context->sound, skip_flag);
 }
 
-void advance_estimate_mame_begin(struct advance_estimate_context* context)
+void advance_estimate_common_begin(struct advance_estimate_context* context)
 {
-	double current = advance_timer();
+	estimate_part_begin(&context->common);
+}
 
-	context->estimate_mame_flag = 1;
-	context->estimate_mame_last = current;
+void advance_estimate_common_end(struct advance_estimate_context* context, adv_bool skip_flag)
+{
+	estimate_part_end(&context->common, skip_flag);
 }
 
 void advance_estimate_frame(struct advance_estimate_context* context)
@@ -132,6 +148,3 @@ void advance_estimate_frame(struct advance_estimate_context* context)
 	context->estimate_frame_flag = 1;
 	context->estimate_frame_last = current;
 }
-
-
-
@@ -38,6 +38,10 @@
 
 #include <zlib.h>
 
+#if HAVE_SYS_MMAN_H
+#include <sys/mman.h> /* for mmap */
+#endif
+
 /***************************************************************************/
 /* Declaration */
 
@@ -88,9 +92,14 @@ static struct fileio_item FILEIO_CONFIG[] = {
 	{ FILETYPE_HISTORY, 0, 0, FILEIO_MODE_FILE, 0, 0 }, /* used for history.dat, mameinfo.dat */
 	{ FILETYPE_CHEAT, 0, 0, FILEIO_MODE_FILE, 0, 0 }, /* used for cheat.dat */
 	{ FILETYPE_LANGUAGE, 0, 0, FILEIO_MODE_FILE, 0, 0 }, /* used for language file */
+#ifndef MESS
+	{ FILETYPE_HASHCACHE, 0, 0, FILEIO_MODE_FILE, 0, 0 }, /* used for romhash.dat */
+#else
+	{ FILETYPE_HASH, "dir_hash", "hash", FILEIO_MODE_MULTI, 0, 0 }, /* used for the *.hsi hash files */
+	{ FILETYPE_HASHINDEX, 0, 0, FILEIO_MODE_FILE, 0, 0 }, /* used for the *.hsx hash indexes */
+#endif
 	/* FILETYPE_CTRLR */
 	/* FILETYPE_INI */
-	/* FILETYPE_HASH, */
 	{ FILETYPE_end, 0, 0, 0, 0 }
 };
 
@@ -105,6 +114,306 @@ struct fileio_item* fileio_find(int type) {
 	return i;
 }
 
+/***************************************************************************/
+/* Directory cache */
+
+/*
+ * At the game start MAME searches every file in all the directories of
+ * the path, and again for the parent and the bios sets. Most of these
+ * checks fail, and each one costs a system call.
+ * The content of the directories is instead read only once, and kept in
+ * memory to answer the checks, also the negative ones.
+ * A directory is read again if its modification time changes, checked
+ * at most once every second, or if it's modified by the emulator.
+ */
+
+/*
+ * The names are compared exactly, but a name found with a different
+ * case is always checked on the file system. So, the result is correct
+ * also on file systems that ignore the case.
+ * On DOS and Windows the files are also reachable with their short
+ * 8.3 names, not reported in the directory content, and the cache
+ * is not used.
+ */
+#if !defined(__MSDOS__) && !defined(__WIN32__)
+#define USE_DIRCACHE
+#endif
+
+#ifdef USE_DIRCACHE
+
+#define DIRCACHE_BUCKET_MAX 256 /**< Number of buckets of the directory hash table. */
+
+/** Entry of a cached directory. */
+struct dircache_entry {
+	char* name; /**< Name of the entry. */
+	unsigned hash; /**< Hash of the name in lower case. */
+	int type; /**< PATH_IS_FILE, PATH_IS_DIRECTORY or -1 if unknown. */
+	struct dircache_entry* next; /**< Next entry with the same hash bucket. */
+};
+
+/** Cached directory. */
+struct dircache_dir {
+	char* dir; /**< Path of the directory. */
+	unsigned hash; /**< Hash of the path. */
+	adv_bool read_flag; /**< If the content is read. */
+	adv_bool exists_flag; /**< If the directory exists. */
+	adv_bool racy_flag; /**< If the directory was modified in the same second of the read. */
+	time_t mtime; /**< Modification time of the directory. */
+	target_clock_t check; /**< Time of the last modification check. */
+	unsigned entry_mac; /**< Number of entries. */
+	struct dircache_entry* entry_map; /**< Vector of entries. */
+	unsigned bucket_mask; /**< Number of buckets - 1. */
+	struct dircache_entry** bucket_map; /**< Hash table of entries. */
+	struct dircache_dir* next; /**< Next directory with the same hash bucket. */
+};
+
+static struct dircache_dir* DIRCACHE[DIRCACHE_BUCKET_MAX];
+
+static unsigned dircache_hash(const char* s)
+{
+	unsigned h = 2166136261U;
+
+	while (*s) {
+		h ^= (unsigned char)tolower((unsigned char)*s);
+		h *= 16777619U;
+		++s;
+	}
+
+	return h;
+}
+
+static void dircache_clear(struct dircache_dir* d)
+{
+	unsigned i;
+
+	for(i=0;i<d->entry_mac;++i)
+		free(d->entry_map[i].name);
+	free(d->entry_map);
+	free(d->bucket_map);
+
+	d->read_flag = 0;
+	d->entry_mac = 0;
+	d->entry_map = 0;
+	d->bucket_mask = 0;
+	d->bucket_map = 0;
+}
+
+/**
+ * Read the content of a directory.
+ */
+static void dircache_read(struct dircache_dir* d)
+{
+	struct stat st;
+	DIR* h;
+	struct dirent* ent;
+	unsigned entry_max;
+	unsigned i;
+
+	d->read_flag = 1;
+	d->exists_flag = 0;
+	d->racy_flag = 0;
+	d->mtime = 0;
+	d->check = target_clock();
+
+	/* get the time before reading, a change during the read is detected later */
+	if (stat(d->dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+		log_std(("osd: dircache %s -> missing\n", d->dir));
+		return;
+	}
+
+	h = opendir(d->dir);
+	if (!h) {
+		/* the content is unknown, the file system is always checked */
+		log_std(("osd: dircache %s -> not readable, %s\n", d->dir, strerror(errno)));
+		d->read_flag = 0;
+		return;
+	}
+
+	d->exists_flag = 1;
+	d->mtime = st.st_mtime;
+	d->racy_flag = st.st_mtime >= time(0) - 1;
+
+	entry_max = 0;
+	while ((ent = readdir(h)) != 0) {
+		struct dircache_entry* e;
+
+		if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+			continue;
+
+		if (d->entry_mac == entry_max) {
+			entry_max = entry_max ? 2 * entry_max : 64;
+			d->entry_map = realloc(d->entry_map, entry_max * sizeof(struct dircache_entry));
+		}
+
+		e = &d->entry_map[d->entry_mac++];
+		e->name = strdup(ent->d_name);
+		e->hash = dircache_hash(e->name);
+		e->type = -1;
+#ifdef DT_DIR
+		/* symbolic links and other types are checked on the file system */
+		if (ent->d_type == DT_REG)
+			e->type = PATH_IS_FILE;
+		else if (ent->d_type == DT_DIR)
+			e->type = PATH_IS_DIRECTORY;
+#endif
+	}
+
+	closedir(h);
+
+	/* at least twice the number of entries */
+	d->bucket_mask = 15;
+	while (d->bucket_mask < 2 * d->entry_mac)
+		d->bucket_mask = 2 * d->bucket_mask + 1;
+
+	d->bucket_map = calloc(d->bucket_mask + 1, sizeof(struct dircache_entry*));
+	for(i=0;i<d->entry_mac;++i) {
+		struct dircache_entry* e = &d->entry_map[i];
+		unsigned b = e->hash & d->bucket_mask;
+		e->next = d->bucket_map[b];
+		d->bucket_map[b] = e;
+	}
+
+	log_std(("osd: dircache %s -> %u entries\n", d->dir, d->entry_mac));
+}
+
+/**
+ * Get a directory from the cache, reading it if required.
+ */
+static struct dircache_dir* dircache_get(const char* dir)
+{
+	unsigned hash = dircache_hash(dir);
+	struct dircache_dir* d;
+
+	for(d=DIRCACHE[hash % DIRCACHE_BUCKET_MAX];d!=0;d=d->next) {
+		if (d->hash == hash && strcmp(d->dir, dir) == 0)
+			break;
+	}
+
+	if (!d) {
+		d = calloc(1, sizeof(struct dircache_dir));
+		d->dir = strdup(dir);
+		d->hash = hash;
+		d->next = DIRCACHE[hash % DIRCACHE_BUCKET_MAX];
+		DIRCACHE[hash % DIRCACHE_BUCKET_MAX] = d;
+	} else if (d->read_flag && target_clock() - d->check > TARGET_CLOCKS_PER_SEC) {
+		struct stat st;
+		adv_bool exists_flag;
+
+		/* check for external changes */
+		exists_flag = stat(d->dir, &st) == 0 && S_ISDIR(st.st_mode);
+
+		if (exists_flag != d->exists_flag
+			|| (exists_flag && (st.st_mtime != d->mtime || d->racy_flag))
+		) {
+			log_std(("osd: dircache %s -> changed\n", d->dir));
+			dircache_clear(d);
+		} else {
+			d->check = target_clock();
+		}
+	}
+
+	if (!d->read_flag)
+		dircache_read(d);
+
+	return d;
+}
+
+/**
+ * Get the type of a file from the cache.
+ * \return PATH_IS_FILE, PATH_IS_DIRECTORY, PATH_NOT_FOUND, or -1 if the file system must be checked.
+ */
+static int dircache_type(const char* path)
+{
+	char dir_buffer[FILE_MAXPATH];
+	const char* name;
+	struct dircache_dir* d;
+	struct dircache_entry* e;
+	unsigned hash;
+
+	name = strrchr(path, '/');
+	if (!name || name == path)
+		return -1;
+
+	if (name - path >= sizeof(dir_buffer))
+		return -1;
+	memcpy(dir_buffer, path, name - path);
+	dir_buffer[name - path] = 0;
+
+	++name;
+	if (name[0] == 0 || strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+		return -1;
+
+	d = dircache_get(dir_buffer);
+	if (!d->read_flag)
+		return -1;
+	if (!d->exists_flag)
+		return PATH_NOT_FOUND;
+
+	hash = dircache_hash(name);
+	for(e=d->bucket_map[hash & d->bucket_mask];e!=0;e=e->next) {
+		if (e->hash == hash && strcasecmp(e->name, name) == 0) {
+			/* with a different case the file system decides */
+			if (strcmp(e->name, name) != 0)
+				return -1;
+			return e->type;
+		}
+	}
+
+	return PATH_NOT_FOUND;
+}
+
+/**
+ * Forget the content of all the directories containing a path.
+ * Called when the emulator creates a file or a directory.
+ */
+static void dircache_invalidate(const char* path)
+{
+	unsigned i;
+
+	for(i=0;i<DIRCACHE_BUCKET_MAX;++i) {
+		struct dircache_dir* d;
+		for(d=DIRCACHE[i];d!=0;d=d->next) {
+			size_t len = strlen(d->dir);
+			if (d->read_flag && strncmp(d->dir, path, len) == 0 && (path[len] == '/' || path[len] == 0))
+				dircache_clear(d);
+		}
+	}
+}
+
+static void dircache_done(void)
+{
+	unsigned i;
+
+	for(i=0;i<DIRCACHE_BUCKET_MAX;++i) {
+		struct dircache_dir* d = DIRCACHE[i];
+		while (d) {
+			struct dircache_dir* next = d->next;
+			dircache_clear(d);
+			free(d->dir);
+			free(d);
+			d = next;
+		}
+		DIRCACHE[i] = 0;
+	}
+}
+
+#else
+
+static int dircache_type(const char* path)
+{
+	return -1;
+}
+
+static void dircache_invalidate(const char* path)
+{
+}
+
+static void dircache_done(void)
+{
+}
+
+#endif
+
 /***************************************************************************/
 /* OSD interface */
 
@@ -141,6 +450,18 @@ int osd_get_path_info(int pathtype, int pathindex, const char* filename)
 
 	log_std(("osd: osd_get_path_info() try %s\n", path_buffer));
 
+	switch (dircache_type(path_buffer)) {
+	case PATH_NOT_FOUND :
+		log_std(("osd: osd_get_path_info() -> failed, cached\n"));
+		return PATH_NOT_FOUND;
+	case PATH_IS_DIRECTORY :
+		log_std(("osd: osd_get_path_info() -> directory, cached\n"));
+		return PATH_IS_DIRECTORY;
+	case PATH_IS_FILE :
+		log_std(("osd: osd_get_path_info() -> file, cached\n"));
+		return PATH_IS_FILE;
+	}
+
 	if (stat(path_buffer, &st) != 0) {
 		log_std(("osd: osd_get_path_info() -> failed\n"));
 		return PATH_NOT_FOUND;
@@ -158,20 +479,46 @@ int osd_get_path_info(int pathtype, int pathindex, const char* filename)
 	return PATH_NOT_FOUND;
 }
 
-static int partialequal(const char* zipfile, const char* file)
+int osd_get_file_stamp(int pathtype, int pathindex, const char* filename, char* path, int path_size, UINT64* size, UINT64* mtime)
 {
-	const char* s1 = file;
-	/* start comparison after last / */
-	const char* s2 = strrchr(zipfile, '/');
-	if (s2)
-		++s2;
-	else
-		s2 = zipfile;
-	while (*s1 && toupper(*s1)==toupper(*s2)) {
-		++s1;
-		++s2;
+	struct fileio_item* i;
+	char path_buffer[FILE_MAXPATH];
+	struct stat st;
+
+	i = fileio_find(pathtype);
+	if (!i) {
+		log_std(("WARNING:fileio: file type %d unknown\n", pathtype));
+		return -1;
+	}
+
+	sncpy(path_buffer, sizeof(path_buffer), file_abs(i->dir_map[pathindex], filename));
+
+	if (dircache_type(path_buffer) == PATH_NOT_FOUND) {
+		log_debug(("osd: osd_get_file_stamp(%s) -> failed, cached\n", path_buffer));
+		return -1;
+	}
+
+	if (stat(path_buffer, &st) != 0 || !S_ISREG(st.st_mode)) {
+		log_debug(("osd: osd_get_file_stamp(%s) -> failed\n", path_buffer));
+		return -1;
+	}
+
+	/* the path of the file independently of the current directory and of the links */
+#if !defined(__MSDOS__) && !defined(__WIN32__)
+	{
+		char real_buffer[PATH_MAX];
+		if (realpath(path_buffer, real_buffer) != 0)
+			sncpy(path_buffer, sizeof(path_buffer), real_buffer);
 	}
-	return !*s1 && !*s2;
+#endif
+	sncpy(path, path_size, path_buffer);
+
+	*size = st.st_size;
+	*mtime = st.st_mtime;
+
+	log_debug(("osd: osd_get_file_stamp(%s) -> size:%d, mtime:%d\n", path_buffer, (int)*size, (int)*mtime));
+
+	return 0;
 }
 
 static void osd_errno_to_filerr(osd_file_error *error)
@@ -225,12 +572,16 @@ osd_file* osd_fopen(int pathtype, int pathindex, const char* filename, const cha
 
 	sncpy(path_buffer, sizeof(path_buffer), file_abs(i->dir_map[pathindex], filename));
 
-	split = strchr(path_buffer, '=');
+	/* the zip name is the part of the file name before the '=' */
+	split = 0;
+	if (strchr(filename, '=') != 0)
+		split = strrchr(path_buffer, '=');
 	if (split != 0) {
 		char zip_file_buffer[FILE_MAXPATH];
+		char zip_name_buffer[FILE_MAXPATH];
 		char file_buffer[FILE_MAXPATH];
-		adv_zip* zip;
-		adv_zipent* ent;
+		zip_entry ent;
+		int r;
 
 		*split = 0;
 		snprintf(zip_file_buffer, sizeof(zip_file_buffer), "%s.zip", path_buffer);
@@ -238,36 +589,42 @@ osd_file* osd_fopen(int pathtype, int pathindex, const char* filename, const cha
 
 		log_std(("osd: osd_fopen() try %s %s\n", zip_file_buffer, file_buffer));
 
+		if (dircache_type(zip_file_buffer) == PATH_NOT_FOUND) {
+			*error = FILEERR_NOT_FOUND;
+			log_std(("osd: osd_fopen() -> failed, zip %s missing\n", zip_file_buffer));
+			return 0;
+		}
+
 		if (access(zip_file_buffer, R_OK)!=0) {
 			osd_errno_to_filerr(error);
 			log_std(("osd: osd_fopen() -> failed, zip %s not readable\n", zip_file_buffer));
 			return 0;
 		}
 
-		zip = zip_open(zip_file_buffer);
-		if (!zip) {
+		/* search the file in the zip index of the MAME core */
+		sncpy(zip_name_buffer, sizeof(zip_name_buffer), filename);
+		*strrchr(zip_name_buffer, '=') = 0;
+		sncat(zip_name_buffer, sizeof(zip_name_buffer), ".zip");
+
+		r = find_zipped_file(pathtype, pathindex, zip_name_buffer, file_buffer, &ent);
+		if (r < 0) {
 			osd_errno_to_filerr(error);
 			log_std(("osd: osd_fopen() -> failed, zip %s not openable\n", zip_file_buffer));
 			return 0;
 		}
 
 		h = 0;
-		while ((ent = zip_read(zip))!=0) {
-			if (partialequal(ent->name, file_buffer)) {
-				if (ent->compression_method == 0) {
-					h = fzopenzipuncompressed(zip_file_buffer, ent->offset_lcl_hdr_frm_frst_disk, ent->uncompressed_size);
-					if (h == 0)
-						osd_errno_to_filerr(error);
-				} else if (ent->compression_method == 8) {
-					h = fzopenzipcompressed(zip_file_buffer, ent->offset_lcl_hdr_frm_frst_disk, ent->compressed_size, ent->uncompressed_size);
-					if (h == 0)
-						osd_errno_to_filerr(error);
-				}
-				break;
+		if (r == 0) {
+			if (ent.compression_method == 0) {
+				h = fzopenzipuncompressed(zip_file_buffer, ent.offset_lcl_hdr_frm_frst_disk, ent.uncompressed_size);
+				if (h == 0)
+					osd_errno_to_filerr(error);
+			} else if (ent.compression_method == 8) {
+				h = fzopenzipcompressed(zip_file_buffer, ent.offset_lcl_hdr_frm_frst_disk, ent.compressed_size, ent.uncompressed_size);
+				if (h == 0)
+					osd_errno_to_filerr(error);
 			}
 		}
-
-		zip_close(zip);
 	} else {
 		log_std(("osd: osd_fopen() try file %s\n", path_buffer));
 
@@ -299,6 +656,11 @@ osd_file* osd_fopen(int pathtype, int pathindex, const char* filename, const cha
 					}
 				}
 			}
+		} else if (mode[0] == 'r' && strchr(mode, '+') == 0 && dircache_type(path_buffer) == PATH_NOT_FOUND) {
+			/* the file doesn't exist */
+			h = 0;
+			*error = FILEERR_NOT_FOUND;
+			log_std(("osd: fzopen() failed, missing\n"));
 		} else {
 			/* open a regular file */
 			h = fzopen(path_buffer, mode);
@@ -309,6 +671,10 @@ osd_file* osd_fopen(int pathtype, int pathindex, const char* filename, const cha
 				log_std(("osd: fzopen() failed, %s\n", strerror(errno)));
 			}
 		}
+
+		/* a file may be created */
+		if (mode[0] != 'r' || strchr(mode, '+') != 0)
+			dircache_invalidate(path_buffer);
 	}
 
 	log_std(("osd: osd_fopen() -> return %p\n", h));
@@ -400,6 +766,70 @@ UINT32 osd_fwrite(osd_file* file, const void* buffer, UINT32 length)
 	return r;
 }
 
+/**
+ * Largest map read in advance.
+ */
+#define FMAP_WILLNEED_MAX (16*1024*1024)
+
+void* osd_fmap(osd_file* file, UINT64 offset, UINT32 length)
+{
+#if HAVE_MMAP && HAVE_SYS_MMAN_H
+	adv_fz* h = (adv_fz*)file;
+	long page;
+	off_t base;
+	unsigned char* ptr;
+	struct stat st;
+
+	/* only real files can be mapped */
+	if (h->type != fz_file || length == 0) {
+		log_std(("osd: osd_fmap(%p, offset:%d, length:%d) -> not supported\n", file, (int)offset, (int)length));
+		return 0;
+	}
+
+	/* the pages after the end of the file raise SIGBUS when read, */
+	/* so a truncated file is left to the read path to report the error */
+	if (fstat(fileno(h->f), &st) != 0 || offset + length > (UINT64)st.st_size) {
+		log_std(("osd: osd_fmap(%p, offset:%d, length:%d) -> beyond the end of the file\n", file, (int)offset, (int)length));
+		return 0;
+	}
+
+	/* the map must start at a page boundary */
+	page = sysconf(_SC_PAGESIZE);
+	base = offset & ~(UINT64)(page - 1);
+
+	ptr = mmap(0, length + (offset - base), PROT_READ, MAP_PRIVATE, fileno(h->f), base);
+	if (ptr == MAP_FAILED) {
+		log_std(("osd: osd_fmap(%p, offset:%d, length:%d) -> failed, %s\n", file, (int)offset, (int)length, strerror(errno)));
+		return 0;
+	}
+
+#ifdef MADV_WILLNEED
+	/* small maps are going to be read entirely, the large ones */
+	/* like the hard disk images are read on demand */
+	if (length <= FMAP_WILLNEED_MAX)
+		madvise(ptr, length + (offset - base), MADV_WILLNEED);
+#endif
+
+	log_std(("osd: osd_fmap(%p, offset:%d, length:%d) -> %p\n", file, (int)offset, (int)length, ptr + (offset - base)));
+
+	return ptr + (offset - base);
+#else
+	return 0;
+#endif
+}
+
+void osd_funmap(void* ptr, UINT32 length)
+{
+#if HAVE_MMAP && HAVE_SYS_MMAN_H
+	long page = sysconf(_SC_PAGESIZE);
+	unsigned char* base = (unsigned char*)((uintptr_t)ptr & ~(uintptr_t)(page - 1));
+
+	log_std(("osd: osd_funmap(%p, length:%d)\n", ptr, (int)length));
+
+	munmap(base, length + ((unsigned char*)ptr - base));
+#endif
+}
+
 int osd_create_directory(int pathtype, int pathindex, const char *dirname)
 {
 	struct fileio_item* i;
@@ -417,6 +847,8 @@ int osd_create_directory(int pathtype, int pathindex, const char *dirname)
 
 	log_std(("osd: osd_create_directory() -> %s\n", path_buffer));
 
+	dircache_invalidate(path_buffer);
+
 	if (file_dir_make(path_buffer) != 0) {
 		log_std(("ERROR:fileio: mkdir(%s) failed\n", path_buffer));
 		return -1;
@@ -751,6 +1183,7 @@ void advance_fileio_done(struct advance_fileio_context* context)
 	if (context->state.diff_handle) {
 		fzclose(context->state.diff_handle);
 	}
+	dircache_done();
 }
 
 static void dir_create(const char* dir)
@@ -461,6 +461,12 @@ void advance_video_invalidate_screen(struct advance_video_context* context)
 		video_clear(update_x_get(), update_y_get(), video_size_x(), video_size_y(), color);
 		update_stop(update_x_get(), update_y_get(), video_size_x(), video_size_y(), 0);
 	}
+
+	/* the game image must be put again in all the pages */
+	context->state.last_counter = 0;
+
+	/* nothing remains of the ui */
+	context->state.layer_clear_counter = 0;
 }
 
 /**
@@ -493,6 +499,11 @@ static void video_done_pipeline(struct advance_video_context* context)
 		free(context->state.buffer_ptr_alloc);
 		context->state.buffer_ptr_alloc = 0;
 	}
+
+	/* forget the last game image */
+	free(context->state.last_ptr);
+	context->state.last_ptr = 0;
+	context->state.last_counter = 0;
 }
 
 /**
@@ -532,6 +543,10 @@ static adv_error vidmode_init(struct advance_video_context* context, adv_mode* m
 	/* initialize the blit pipeline */
 	context->state.blit_pipeline_flag = 0;
 	context->state.buffer_ptr_alloc = 0;
+	context->state.last_ptr = 0;
+	context->state.last_counter = 0;
+	context->state.layer_clear_counter = 0;
+	context->state.layer_area = 0;
 
 	/* initialize the update system */
 	update_init(context->config.triplebuf_flag != 0 ? 3 : 1);
@@ -563,6 +578,9 @@ static void vidmode_done(struct advance_video_context* context, adv_bool restore
 
 	video_done_pipeline(context);
 
+	adv_bitmap_free(context->state.layer_area);
+	context->state.layer_area = 0;
+
 	update_done();
 
 	context->state.mode_flag = 0;
@@ -1970,6 +1988,120 @@ static void video_recompute_pipeline(struct advance_video_context* context, cons
 	context->state.pipeline_measure_i = 0;
 	context->state.pipeline_measure_j = 0;
 	context->state.blit_pipeline_index = 0;
+	context->state.combine_budget_flag = 0;
+}
+
+/**
+ * Clear a screen area, excluding the part covered by the game image.
+ * \param x, y Position of the screen page.
+ * \param game_x, game_y Position of the game image.
+ */
+static void video_frame_layer_clear(struct advance_video_context* context, unsigned x, unsigned y, int game_x, int game_y)
+{
+	int gx0 = game_x;
+	int gy0 = game_y;
+	int gx1 = game_x + context->state.mode_visible_size_x;
+	int gy1 = game_y + context->state.mode_visible_size_y;
+	int rx0 = context->state.layer_clear_x0;
+	int ry0 = context->state.layer_clear_y0;
+	int rx1 = context->state.layer_clear_x1;
+	int ry1 = context->state.layer_clear_y1;
+	int my0, my1;
+	adv_pixel color;
+
+	/* on palettized modes it always return 0 */
+	color = video_pixel_get(0, 0, 0);
+
+	/* over the game */
+	if (ry0 < gy0)
+		video_clear(x + rx0, y + ry0, rx1 - rx0, MIN(ry1, gy0) - ry0, color);
+
+	/* under the game */
+	if (ry1 > gy1)
+		video_clear(x + rx0, y + MAX(ry0, gy1), rx1 - rx0, ry1 - MAX(ry0, gy1), color);
+
+	/* at the left and right of the game */
+	my0 = MAX(ry0, gy0);
+	my1 = MIN(ry1, gy1);
+	if (my0 < my1) {
+		if (rx0 < gx0)
+			video_clear(x + rx0, y + my0, MIN(rx1, gx0) - rx0, my1 - my0, color);
+		if (rx1 > gx1)
+			video_clear(x + MAX(rx0, gx1), y + my0, rx1 - MAX(rx0, gx1), my1 - my0, color);
+	}
+}
+
+/**
+ * Draw the user interface directly on the screen.
+ * Every element of the interface is put over the game image already
+ * drawn, reading back and updating only the screen area it covers.
+ * \param x, y Position of the screen page.
+ */
+static void video_frame_layer(struct advance_video_context* context, struct advance_ui_context* ui_context, unsigned x, unsigned y)
+{
+	unsigned bytes_per_pixel = video_bytes_per_pixel();
+	unsigned count;
+	unsigned i;
+
+	count = advance_ui_layer_update(ui_context, video_size_x(), video_size_y(), context->state.buffer_def, context->state.palette_map, context->state.palette_total);
+
+	/* the copy of the screen is kept for all the frames in the same video mode */
+	if (count != 0 && !context->state.layer_area) {
+		context->state.layer_area = adv_bitmap_alloc(video_size_x(), video_size_y(), bytes_per_pixel);
+		if (!context->state.layer_area)
+			return;
+	}
+
+	for(i=0;i<count;++i) {
+		int layer_x, layer_y;
+		unsigned layer_dx, layer_dy;
+		int x0, y0, x1, y1;
+		unsigned size;
+		adv_bitmap area;
+		int j;
+
+		advance_ui_layer_get(ui_context, i, &layer_x, &layer_y, &layer_dx, &layer_dy);
+
+		/* clip at the screen */
+		x0 = MAX(layer_x, 0);
+		y0 = MAX(layer_y, 0);
+		x1 = MIN(layer_x + (int)layer_dx, (int)video_size_x());
+		y1 = MIN(layer_y + (int)layer_dy, (int)video_size_y());
+		if (x0 >= x1 || y0 >= y1)
+			continue;
+
+		size = (x1 - x0) * bytes_per_pixel;
+
+		/* use the part of the copy of the size of the layer */
+		area = *context->state.layer_area;
+		area.size_x = x1 - x0;
+		area.size_y = y1 - y0;
+
+		/* read the game image under the layer */
+		for(j=y0;j<y1;++j)
+			memcpy(adv_bitmap_line(&area, j - y0), video_write_line(y + j) + video_offset(x + x0), size);
+
+		advance_ui_layer_put(ui_context, i, &area, x0, y0);
+
+		for(j=y0;j<y1;++j)
+			memcpy(video_write_line(y + j) + video_offset(x + x0), adv_bitmap_line(&area, j - y0), size);
+
+		/* remember the area to clear when the interface is removed */
+		if (context->state.layer_clear_counter == 0) {
+			context->state.layer_clear_x0 = x0;
+			context->state.layer_clear_y0 = y0;
+			context->state.layer_clear_x1 = x1;
+			context->state.layer_clear_y1 = y1;
+		} else {
+			context->state.layer_clear_x0 = MIN(context->state.layer_clear_x0, x0);
+			context->state.layer_clear_y0 = MIN(context->state.layer_clear_y0, y0);
+			context->state.layer_clear_x1 = MAX(context->state.layer_clear_x1, x1);
+			context->state.layer_clear_y1 = MAX(context->state.layer_clear_y1, y1);
+		}
+
+		/* clear it in all the video pages */
+		context->state.layer_clear_counter = update_page_max_get();
+	}
 }
 
 static void video_frame_put(struct advance_video_context* context, struct advance_ui_context* ui_context, const struct osd_bitmap* bitmap, unsigned x, unsigned y)
@@ -1978,6 +2110,7 @@ static void video_frame_put(struct advance_video_context* context, struct advanc
 	unsigned dst_x, dst_y;
 	unsigned pixel;
 	adv_bool ui_buffer_active;
+	adv_bool ui_layer_flag;
 	target_clock_t start;
 	target_clock_t stop;
 	adv_bool buffer_flag;
@@ -2015,10 +2148,25 @@ static void video_frame_put(struct advance_video_context* context, struct advanc
 
 	/* use buffered or direct write to screen ? */
 	buffer_flag = 0;
+	ui_layer_flag = 0;
 
 	/* if ui active use the buffer */
 	if (ui_buffer_active) {
-		buffer_flag = 1;
+		/* if the screen has the same orientation and format of the buffer */
+		/* the ui is put directly on the screen after the game image, */
+		/* but only if the page isn't visible while it's written */
+		if (context->config.user_orientation == 0
+			&& context->state.buffer_def == video_color_def()
+			&& update_page_max_get() > 1)
+			ui_layer_flag = 1;
+		else
+			buffer_flag = 1;
+	}
+
+	/* remove the ui drawn out of the game area in the previous frames */
+	if (!buffer_flag && context->state.layer_clear_counter != 0) {
+		video_frame_layer_clear(context, x, y, dst_x, dst_y);
+		--context->state.layer_clear_counter;
 	}
 
 	start = target_clock();
@@ -2148,6 +2296,9 @@ static void video_frame_put(struct advance_video_context* context, struct advanc
 
 					/* end the measure process */
 					context->state.pipeline_measure_flag = 0;
+
+					/* check the effect with the time budget */
+					context->state.combine_budget_flag = 1;
 				}
 			}
 
@@ -2165,6 +2316,10 @@ static void video_frame_put(struct advance_video_context* context, struct advanc
 		if (context->state.pipeline_timing_max < stop)
 			context->state.pipeline_timing_max = stop;
 	}
+
+	if (ui_layer_flag) {
+		video_frame_layer(context, ui_context, x, y);
+	}
 }
 
 static void video_frame_screen(struct advance_video_context* context, struct advance_ui_context* ui_context, const struct osd_bitmap *bitmap)
@@ -2253,12 +2408,99 @@ static void video_frame_palette(struct advance_video_context* context)
 	}
 }
 
+/**
+ * Compare the game image with the copy of the last one put on the screen.
+ * The copy is updated row by row, writing only the rows that differ.
+ * \return !=0 if the image is identical at the last one
+ */
+static adv_bool video_frame_compare(struct advance_video_context* context, const struct osd_bitmap *bitmap)
+{
+	unsigned pos_x = context->state.game_used_pos_x;
+	unsigned pos_y = context->state.game_used_pos_y;
+	unsigned size_x = context->state.game_used_size_x;
+	unsigned size_y = context->state.game_used_size_y;
+	unsigned row_size;
+	unsigned char* src;
+	unsigned char* dst;
+	adv_bool equal;
+	unsigned i;
+
+	/* restore the original orientation */
+	if ((context->config.blit_orientation & OSD_ORIENTATION_SWAP_XY) != 0) {
+		SWAP(unsigned, pos_x, pos_y);
+		SWAP(unsigned, size_x, size_y);
+	}
+
+	row_size = size_x * context->state.game_bytes_per_pixel;
+	src = (unsigned char*)bitmap->ptr + pos_x * context->state.game_bytes_per_pixel + pos_y * bitmap->bytes_per_scanline;
+
+	if (!context->state.last_ptr
+		|| context->state.last_row_size != row_size
+		|| context->state.last_row_count != size_y
+	) {
+		free(context->state.last_ptr);
+		context->state.last_ptr = malloc(row_size * size_y);
+		context->state.last_row_size = row_size;
+		context->state.last_row_count = size_y;
+		equal = 0;
+		if (!context->state.last_ptr)
+			return 0;
+	} else {
+		equal = 1;
+	}
+
+	/* the visible position may change without any change of the image */
+	if (context->state.last_visible_pos_x != context->state.game_visible_pos_x
+		|| context->state.last_visible_pos_y != context->state.game_visible_pos_y
+	) {
+		context->state.last_visible_pos_x = context->state.game_visible_pos_x;
+		context->state.last_visible_pos_y = context->state.game_visible_pos_y;
+		equal = 0;
+	}
+
+	dst = context->state.last_ptr;
+	for(i=0;i<size_y;++i) {
+		if (!equal || memcmp(dst, src, row_size) != 0) {
+			memcpy(dst, src, row_size);
+			equal = 0;
+		}
+		src += bitmap->bytes_per_scanline;
+		dst += row_size;
+	}
+
+	return equal;
+}
+
 static void video_frame_game(struct advance_video_context* context, struct advance_record_context* record_context, struct advance_ui_context* ui_context, const struct osd_bitmap *bitmap, adv_bool skip_flag)
 {
 	/* bitmap */
 	if (!skip_flag) {
-		video_frame_palette(context);
-		video_frame_screen(context, ui_context, bitmap);
+		adv_bool unchanged;
+		adv_bool ui_active;
+
+		ui_active = advance_ui_direct_active(ui_context) || advance_ui_buffer_active(ui_context);
+
+		/* the pipeline must be ready to know the used area */
+		video_recompute_pipeline(context, bitmap);
+
+		/* the comparison is always done to keep the copy updated */
+		unchanged = video_frame_compare(context, bitmap)
+			&& !context->state.palette_dirty_flag
+			&& !context->state.pipeline_measure_flag
+			&& !ui_active;
+
+		if (!unchanged)
+			context->state.last_counter = 0;
+
+		/* skip the put if all the video pages already contain the image */
+		if (context->state.last_counter < update_page_max_get()) {
+			video_frame_palette(context);
+			video_frame_screen(context, ui_context, bitmap);
+
+			/* with the ui the screen doesn't contain only the game image */
+			if (!ui_active)
+				++context->state.last_counter;
+		}
 
 		if (advance_record_video_is_active(record_context)
 			&& !context->state.pause_flag) {
@@ -2280,9 +2522,9 @@ static void video_frame_game(struct advance_video_context* context, struct advan
 			offset = pos_x * dp + pos_y * dw;
 
 			if (context->state.game_rgb_flag) {
-				advance_record_video_update(record_context, (unsigned char*)bitmap->ptr + offset, size_x, size_y, dp, dw, context->state.game_color_def, 0, 0, context->config.game_orientation);
+				advance_record_video_update(record_context, (unsigned char*)bitmap->ptr + offset, size_x, size_y, dp, dw, context->state.game_color_def, 0, 0, context->config.game_orientation, unchanged);
 			} else {
-				advance_record_video_update(record_context, (unsigned char*)bitmap->ptr + offset, size_x, size_y, dp, dw, context->state.game_color_def, context->state.palette_map, context->state.palette_total, context->config.game_orientation);
+				advance_record_video_update(record_context, (unsigned char*)bitmap->ptr + offset, size_x, size_y, dp, dw, context->state.game_color_def, context->state.palette_map, context->state.palette_total, context->config.game_orientation, unchanged);
 			}
 		}
 
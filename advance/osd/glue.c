@@ -519,6 +519,98 @@ void mame_print_xml(FILE* out)
 	print_mame_xml(out, drivers);
 }
 
+#ifndef MESS
+/**
+ * Run the benchmarks of the CPU cores.
+ * \param out Where to print the results.
+ * \param cpu Name of the CPU to benchmark, or 0 for all.
+ * \return 0 on success.
+ */
+int mame_cpu_benchmark(FILE* out, const char* cpu)
+{
+	return cpu_benchmark(out, cpu);
+}
+
+static FILE* verify_out;
+
+static void CLIB_DECL verify_printf(const char* fmt, ...)
+{
+	va_list arg;
+	va_start(arg, fmt);
+	vfprintf(verify_out, fmt, arg);
+	va_end(arg);
+}
+
+/**
+ * Verify the romsets.
+ * The checksums of the unzipped files are saved in the hash cache,
+ * and the unchanged files are not read again at the next run.
+ * \param out Where to print the results.
+ * \param game Name of the game to verify, or 0 for all.
+ * \return 0 if all the verified romsets are correct.
+ */
+int mame_verify_roms(FILE* out, const char* game)
+{
+	unsigned i;
+	unsigned correct = 0;
+	unsigned incorrect = 0;
+	unsigned notfound = 0;
+
+	verify_out = out;
+
+	for(i=0;drivers[i];++i) {
+		const game_driver* clone_of;
+		int res;
+
+		if (game && strcmp(drivers[i]->name, game) != 0)
+			continue;
+
+		res = audit_verify_roms(i, verify_printf);
+
+		if (res == NOTFOUND || res == CLONE_NOTFOUND) {
+			++notfound;
+			continue;
+		}
+
+		fprintf(out, "romset %s ", drivers[i]->name);
+		clone_of = driver_get_clone(drivers[i]);
+		if (clone_of)
+			fprintf(out, "[%s] ", clone_of->name);
+
+		switch (res) {
+		case INCORRECT :
+			fprintf(out, "is bad\n");
+			++incorrect;
+			break;
+		case BEST_AVAILABLE :
+			fprintf(out, "is best available\n");
+			++correct;
+			break;
+		case MISSING_OPTIONAL :
+			fprintf(out, "is missing optional roms\n");
+			++correct;
+			break;
+		default :
+			fprintf(out, "is good\n");
+			++correct;
+			break;
+		}
+	}
+
+	/* save the hash cache and release the zip index */
+	fileio_exit();
+
+	if (game && correct + incorrect + notfound == 0) {
+		target_err("Unknown game '%s'.\n", game);
+		return -1;
+	}
+
+	fprintf(out, "%u romsets found, %u were OK.\n", correct + incorrect, correct);
+
+	return incorrect != 0 ? -1 : 0;
+}
+#endif
+
 /**
  * Check if a game use a vector display.
  */
@@ -646,6 +738,9 @@ int mame_game_run(struct advance_context* context, const struct mame_option* adv
 	else
 		options.savegame = 0; /* no savegame file to load */
 	options.auto_save = 0; /* 1 to automatically save/restore at startup/quitting time */
+#ifndef MESS
+	options.runahead = advance->runahead;
+#endif
 	options.debug_width = advance->debug_width;
 	options.debug_height = advance->debug_height;
 	options.debug_depth = 8;
@@ -2028,6 +2123,30 @@ unsigned mame_ui_frames_per_second(void)
 	return Machine->drv->frames_per_second;
 }
 
+/**
+ * Get the run-ahead state of the last frame.
+ * \param frames Frames emulated ahead.
+ * \param time Time used to emulate them in seconds.
+ * \return Lag of the game in frames, or -1 if not yet measured.
+ */
+int mame_ui_runahead(unsigned* frames, double* time)
+{
+#ifndef MESS
+	const performance_info* perf = mame_get_performance_info();
+
+	*frames = perf->runahead_frames;
+	*time = perf->runahead_time;
+
+	return perf->runahead_lag;
+#else
+	/* not available in MESS */
+	*frames = 0;
+	*time = 0;
+
+	return -1;
+#endif
+}
+
 /**
  * Check if a MAME port is active.
  * A port is active if the associated key sequence is pressed.
@@ -2897,6 +3016,8 @@ adv_error mame_init(struct advance_context* context)
 
 	conf_string_register_default(context->cfg, "misc_bios", "default");
 
+	conf_string_register_default(context->cfg, "misc_runahead", "none");
+
 #ifdef MESS
 	mess_init(context->cfg);
 #endif
@@ -2949,6 +3070,22 @@ adv_error mame_config_load(adv_conf* cfg_context, struct mame_option* option)
 
 	sncpy(option->bios_buffer, sizeof(option->bios_buffer), conf_string_get_default(cfg_context, "misc_bios"));
 
+	{
+		const char* r = conf_string_get_default(cfg_context, "misc_runahead");
+		if (strcmp(r, "none") == 0) {
+			option->runahead = 0;
+		} else if (strcmp(r, "auto") == 0) {
+			option->runahead = -1;
+		} else {
+			char* e;
+			option->runahead = strtol(r, &e, 10);
+			if (*e || option->runahead < 1 || option->runahead > 4) {
+				target_err("Invalid argument '%s' for option 'misc_runahead'.\n", r);
+				return -1;
+			}
+		}
+	}
+
 	/* convert the dir separator char to ';'. */
 	/* the cheat system use always this char in all the operating system */
 	for(s=option->cheat_file_buffer;*s;++s)
@@ -58,6 +58,7 @@ struct mame_option {
 	const mame_game* game;
 
 	adv_bool cheat_flag;
+	int runahead; /**< Frames to run ahead, 0 none, -1 auto. */
 
 	double gamma;
 	double brightness;
@@ -128,6 +129,8 @@ const char* mame_game_manufacturer(const mame_game* game);
 unsigned mame_game_players(const mame_game* game);
 const char* mame_game_control(const mame_game* game);
 void mame_print_xml(FILE* out);
+int mame_cpu_benchmark(FILE* out, const char* cpu);
+int mame_verify_roms(FILE* out, const char* game);
 adv_bool mame_is_game_vector(const mame_game* game);
 adv_bool mame_is_game_relative(const char* relative, const mame_game* game);
 const struct mame_game* mame_playback_look(const char* file);
@@ -249,6 +252,7 @@ void mame_ui_refresh(void);
 void mame_ui_gamma_factor_set(double gamma);
 unsigned char mame_ui_cpu_read(unsigned cpu, unsigned addr);
 unsigned mame_ui_frames_per_second(void);
+int mame_ui_runahead(unsigned* frames, double* time);
 void mame_ui_input_map(unsigned* pdigital_mac, struct mame_digital_map_entry* digital_map, unsigned digital_max);
 
 /***************************************************************************/
@@ -42,6 +42,7 @@
 #include "../../srcmess/osdepend.h"
 #include "../../srcmess/ui_text.h"
 #include "../../srcmess/profiler.h"
+#include "../../srcmess/unzip.h"
 
 #else
 
@@ -52,6 +53,9 @@
 #include "../../src/osdepend.h"
 #include "../../src/ui_text.h"
 #include "../../src/profiler.h"
+#include "../../src/unzip.h"
+#include "../../src/cpubench.h"
+#include "../../src/audit.h"
 
 #endif
 
@@ -134,26 +134,30 @@ struct symbol {
 };
 
 /* Evaluate a constant */
-static struct script_value* script_constant_get(union script_arg_extra argextra)
+static void script_constant_get(struct script_value* result, union script_arg_extra argextra)
 {
-	return script_value_alloc_num(argextra.value);
+	script_value_set_num(result, argextra.value);
 }
 
 /* Evaluate a text variable */
-static struct script_value* script_text_get(union script_arg_extra argextra)
+static void script_text_get(struct script_value* result, union script_arg_extra argextra)
 {
 	switch (argextra.value) {
 	case 0 :
-		return script_value_alloc_text(STATE.info_desc_buffer);
+		script_value_set_text(result, STATE.info_desc_buffer);
+		return;
 	case 1 :
-		return script_value_alloc_text(STATE.info_manufacturer_buffer);
+		script_value_set_text(result, STATE.info_manufacturer_buffer);
+		return;
 	case 2 :
-		return script_value_alloc_text(STATE.info_year_buffer);
+		script_value_set_text(result, STATE.info_year_buffer);
+		return;
 	case 3 :
-		return script_value_alloc_text(STATE.info_throttle_buffer);
+		script_value_set_text(result, STATE.info_throttle_buffer);
+		return;
 	}
 
-	return script_value_alloc_num(0);
+	script_value_set_num(result, 0);
 }
 
 /* Check a symbol */
@@ -216,7 +220,7 @@ script_exp_op1s_evaluator* script_symbol_check(const char* sym, union script_arg
 	return 0;
 }
 
-static struct script_value* script_function1_get(union script_arg_extra argextra)
+static void script_function1_get(struct script_value* result, union script_arg_extra argextra)
 {
 	int r;
 
@@ -229,12 +233,12 @@ static struct script_value* script_function1_get(union script_arg_extra argextra
 		break;
 	}
 
-	return script_value_alloc_num(r);
+	script_value_set_num(result, r);
 }
 
-static struct script_value* script_function2_get(struct script_value* varg0, union script_arg_extra argextra)
+static void script_function2_get(struct script_value* result, const struct script_value* varg0, union script_arg_extra argextra)
 {
-	int arg0 = script_value_free_num(varg0);
+	int arg0 = script_value_get_num(varg0);
 	int r;
 
 	switch (argextra.value) {
@@ -258,10 +262,10 @@ static struct script_value* script_function2_get(struct script_value* varg0, uni
 		break;
 	}
 
-	return script_value_alloc_num(r);
+	script_value_set_num(result, r);
 }
 
-static struct script_value* script_function2t_get(struct script_value* varg0, union script_arg_extra argextra)
+static void script_function2t_get(struct script_value* result, const struct script_value* varg0, union script_arg_extra argextra)
 {
 	int r;
 
@@ -303,15 +307,13 @@ static struct script_value* script_function2t_get(struct script_value* varg0, un
 		break;
 	}
 
-	script_value_free(varg0);
-
-	return script_value_alloc_num(r);
+	script_value_set_num(result, r);
 }
 
-static struct script_value* script_function3_get(struct script_value* varg0, struct script_value* varg1, union script_arg_extra argextra)
+static void script_function3_get(struct script_value* result, const struct script_value* varg0, const struct script_value* varg1, union script_arg_extra argextra)
 {
-	int arg0 = script_value_free_num(varg0);
-	int arg1 = script_value_free_num(varg1);
+	int arg0 = script_value_get_num(varg0);
+	int arg1 = script_value_get_num(varg1);
 	int r;
 
 	switch (argextra.value) {
@@ -344,12 +346,12 @@ static struct script_value* script_function3_get(struct script_value* varg0, str
 		break;
 	}
 
-	return script_value_alloc_num(r);
+	script_value_set_num(result, r);
 }
 
-static struct script_value* script_function3t_get(struct script_value* varg0, struct script_value* varg1, union script_arg_extra argextra)
+static void script_function3t_get(struct script_value* result, const struct script_value* varg0, const struct script_value* varg1, union script_arg_extra argextra)
 {
-	int arg0 = script_value_free_num(varg0);
+	int arg0 = script_value_get_num(varg0);
 	int r;
 
 	switch (argextra.value) {
@@ -372,9 +374,7 @@ static struct script_value* script_function3t_get(struct script_value* varg0, st
 		break;
 	}
 
-	script_value_free(varg1);
-
-	return script_value_alloc_num(r);
+	script_value_set_num(result, r);
 }
 
 script_exp_op1f_evaluator* script_function1_check(const char* sym, union script_arg_extra* argextra)
@@ -261,6 +261,9 @@ static adv_error video_start(struct advance_record_context* context, const char*
 	context->state.video_frequency = frequency;
 	context->state.video_sample_counter = 0;
 	context->state.video_stopped_flag = 0;
+	context->state.video_changed_flag = 0;
+	context->state.video_fram_offset = 0;
+	context->state.video_fram_tick = 0;
 
 	sncpy(context->state.video_file_buffer, sizeof(context->state.video_file_buffer), file);
 
@@ -299,12 +302,38 @@ static adv_error video_start(struct advance_record_context* context, const char*
 	return 0;
 }
 
+/**
+ * Extend the duration of the last frame written.
+ * The delay of the last FRAM chunk is rewritten in place, avoiding to
+ * compress and store again the same image.
+ */
+static adv_error video_extend(struct advance_record_context* context)
+{
+	off_t pos;
+
+	pos = fztell(context->state.video_f);
+	if (pos < 0)
+		return -1;
+
+	if (fzseek(context->state.video_f, context->state.video_fram_offset, SEEK_SET) != 0)
+		return -1;
+
+	context->state.video_fram_tick += context->state.video_freq_step;
+
+	if (adv_mng_write_fram(context->state.video_fram_tick, context->state.video_f, 0) != 0)
+		return -1;
+
+	if (fzseek(context->state.video_f, pos, SEEK_SET) != 0)
+		return -1;
+
+	return 0;
+}
+
 /**
  * Insert some data in the video recording. Automatically save if full.
- * \param map samples buffer
- * \param mac number of 16 bit samples mono or stereo in little endian format
+ * \param unchanged if the image is equal at the previous one
  */
-static adv_error video_update(struct advance_record_context* context, const void* video_buffer, unsigned video_width, unsigned video_height, unsigned video_bytes_per_pixel, unsigned video_bytes_per_scanline, adv_color_def color_def, adv_color_rgb* palette_map, unsigned palette_max, unsigned orientation)
+static adv_error video_update(struct advance_record_context* context, const void* video_buffer, unsigned video_width, unsigned video_height, unsigned video_bytes_per_pixel, unsigned video_bytes_per_scanline, adv_color_def color_def, adv_color_rgb* palette_map, unsigned palette_max, unsigned orientation, adv_bool unchanged)
 {
 	const uint8* pix_ptr;
 	unsigned pix_width;
@@ -326,11 +355,25 @@ static adv_error video_update(struct advance_record_context* context, const void
 
 	context->state.video_sample_counter += 1;
 
+	if (!unchanged)
+		context->state.video_changed_flag = 1;
+
 	/* skip frames */
 	if (context->state.video_sample_counter % context->config.video_interlace != 0) {
 		return 0;
 	}
 
+	/* if the image is the same of the last frame written, only extend its duration */
+	if (!context->state.video_changed_flag && context->state.video_fram_offset != 0) {
+		if (video_extend(context) != 0) {
+			log_std(("ERROR: extending image frame in file %s\n", context->state.video_file_buffer));
+			goto err;
+		}
+		return 0;
+	}
+
+	context->state.video_changed_flag = 0;
+
 	pix_ptr = video_buffer;
 	pix_width = video_width;
 	pix_height = video_height;
@@ -339,7 +382,10 @@ static adv_error video_update(struct advance_record_context* context, const void
 
 	png_orientation(&pix_ptr, &pix_width, &pix_height, &pix_pixel_pitch, &pix_scanline_pitch, orientation);
 
-	if (adv_mng_write_fram(context->state.video_freq_step, context->state.video_f, 0) != 0) {
+	context->state.video_fram_offset = fztell(context->state.video_f);
+	context->state.video_fram_tick = context->state.video_freq_step;
+
+	if (adv_mng_write_fram(context->state.video_fram_tick, context->state.video_f, 0) != 0) {
 		log_std(("ERROR: writing image frame in file %s\n", context->state.video_file_buffer));
 		goto err;
 	}
@@ -640,13 +686,13 @@ void advance_record_sound_update(struct advance_record_context* context, const s
 #endif
 }
 
-void advance_record_video_update(struct advance_record_context* context, const void* video_buffer, unsigned video_width, unsigned video_height, unsigned video_bytes_per_pixel, unsigned video_bytes_per_scanline, adv_color_def color_def, adv_color_rgb* palette_map, unsigned palette_max, unsigned orientation)
+void advance_record_video_update(struct advance_record_context* context, const void* video_buffer, unsigned video_width, unsigned video_height, unsigned video_bytes_per_pixel, unsigned video_bytes_per_scanline, adv_color_def color_def, adv_color_rgb* palette_map, unsigned palette_max, unsigned orientation, adv_bool unchanged)
 {
 #ifdef USE_SMP
 	pthread_mutex_lock(&context->state.access_mutex);
 #endif
 
-	video_update(context, video_buffer, video_width, video_height, video_bytes_per_pixel, video_bytes_per_scanline, color_def, palette_map, palette_max, orientation);
+	video_update(context, video_buffer, video_width, video_height, video_bytes_per_pixel, video_bytes_per_scanline, color_def, palette_map, palette_max, orientation, unchanged);
 
 #ifdef USE_SMP
 	pthread_mutex_unlock(&context->state.access_mutex);
@@ -232,127 +232,316 @@ struct script_exp* script_exp_make_op3fee(int type, const char* arg0, struct scr
 	return exp;
 }
 
-struct script_value* script_value_alloc(int type)
-{
-	struct script_value* p = malloc(sizeof(struct script_value));
-	p->type = type;
-	return p;
-}
+/***************************************************************************/
+/* Code */
 
-void script_value_free(struct script_value* p)
+static int script_code_emit(struct script_code* code, unsigned char op, unsigned dst, unsigned a, unsigned b)
 {
-	switch (p->type) {
-	case SCRIPT_VALUE_NUM :
-		break;
-	case SCRIPT_VALUE_TEXT :
-		free(p->value.text);
-		break;
+	struct script_op* p;
+
+	if (dst >= SCRIPT_CODE_REGISTER_MAX || a >= SCRIPT_CODE_REGISTER_MAX || b >= SCRIPT_CODE_REGISTER_MAX) {
+		script_error("Expression too complex");
+		return -1;
 	}
-	free(p);
-}
 
-struct script_value* script_value_alloc_num(int v)
-{
-	struct script_value* p = script_value_alloc(SCRIPT_VALUE_NUM);
-	p->value.num = v;
-	return p;
-}
+	if (code->op_mac == code->op_max) {
+		unsigned op_max = code->op_max ? code->op_max * 2 : 16;
+		struct script_op* op_map = realloc(code->op_map, op_max * sizeof(struct script_op));
+		if (!op_map) {
+			script_error("Low memory");
+			return -1;
+		}
+		code->op_map = op_map;
+		code->op_max = op_max;
+	}
 
-struct script_value* script_value_alloc_text(const char* v)
-{
-	struct script_value* p = script_value_alloc(SCRIPT_VALUE_TEXT);
-	p->value.text = strdup(v);
-	return p;
-}
+	p = &code->op_map[code->op_mac++];
+	memset(p, 0, sizeof(struct script_op));
+	p->code = op;
+	p->dst = dst;
+	p->a = a;
+	p->b = b;
 
-int script_value_free_num(struct script_value* p)
-{
-	int v;
-	if (p->type == SCRIPT_VALUE_NUM) {
-		v = p->value.num;
-	} else {
-		v = 0;
-	}
-	script_value_free(p);
-	return v;
+	return 0;
 }
 
-static struct script_value* script_value_add(struct script_value* a, struct script_value* b)
+static inline struct script_op* script_code_last(struct script_code* code)
 {
-	if (a->type == SCRIPT_VALUE_TEXT && b->type == SCRIPT_VALUE_TEXT) {
-		struct script_value* p = script_value_alloc(SCRIPT_VALUE_TEXT);
-		unsigned la = strlen(a->value.text);
-		unsigned lb = strlen(b->value.text);
-		char* s = malloc(la + lb);
-
-		memcpy(s, a->value.text, la);
-		memcpy(s + la, b->value.text, lb);
-		s[la + lb] = 0;
-
-		p->value.text = s;
-
-		return p;
-	} else {
-		return script_value_alloc_num(script_value_free_num(a) + script_value_free_num(b));
-	}
+	return &code->op_map[code->op_mac - 1];
 }
 
-struct script_value* script_evaluate(const struct script_exp* exp)
+/* Compile the expression storing the result in the dst register */
+static int script_code_compile_exp(struct script_code* code, const struct script_exp* exp, unsigned dst)
 {
+	unsigned char op;
+	unsigned jump;
+
 	switch (exp->type) {
 		case SCRIPT_EXP_VALUE :
-			return script_value_alloc_num(exp->data.op1v.arg0);
-		case SCRIPT_EXP_VARIABLE :
-			return exp->data.op1s.eval(exp->data.op1s.argextra);
+			if (script_code_emit(code, SCRIPT_OP_NUM, dst, 0, 0) != 0)
+				return -1;
+			script_code_last(code)->arg.num = exp->data.op1v.arg0;
+			return 0;
 		case SCRIPT_EXP_TEXT :
-			return script_value_alloc_text(exp->data.op1t.arg0);
+			if (script_code_emit(code, SCRIPT_OP_TEXT, dst, 0, 0) != 0)
+				return -1;
+			script_code_last(code)->arg.text = strdup(exp->data.op1t.arg0);
+			if (!script_code_last(code)->arg.text) {
+				script_error("Low memory");
+				return -1;
+			}
+			return 0;
+		case SCRIPT_EXP_VARIABLE :
+			if (script_code_emit(code, SCRIPT_OP_VARIABLE, dst, 0, 0) != 0)
+				return -1;
+			script_code_last(code)->arg.eval0 = exp->data.op1s.eval;
+			script_code_last(code)->argextra = exp->data.op1s.argextra;
+			return 0;
 		case SCRIPT_EXP_F0 :
-			return exp->data.op1f.eval(exp->data.op1f.argextra);
+			if (script_code_emit(code, SCRIPT_OP_F0, dst, 0, 0) != 0)
+				return -1;
+			script_code_last(code)->arg.eval0 = exp->data.op1f.eval;
+			script_code_last(code)->argextra = exp->data.op1f.argextra;
+			return 0;
 		case SCRIPT_EXP_F1 :
-			return exp->data.op2fe.eval(script_evaluate(exp->data.op2fe.arg1), exp->data.op2fe.argextra);
+			if (script_code_compile_exp(code, exp->data.op2fe.arg1, dst) != 0)
+				return -1;
+			if (script_code_emit(code, SCRIPT_OP_F1, dst, dst, 0) != 0)
+				return -1;
+			script_code_last(code)->arg.eval1 = exp->data.op2fe.eval;
+			script_code_last(code)->argextra = exp->data.op2fe.argextra;
+			return 0;
 		case SCRIPT_EXP_F2 :
-			return exp->data.op3fee.eval(script_evaluate(exp->data.op3fee.arg1), script_evaluate(exp->data.op3fee.arg2), exp->data.op3fee.argextra);
+			if (script_code_compile_exp(code, exp->data.op3fee.arg1, dst) != 0)
+				return -1;
+			if (script_code_compile_exp(code, exp->data.op3fee.arg2, dst + 1) != 0)
+				return -1;
+			if (script_code_emit(code, SCRIPT_OP_F2, dst, dst, dst + 1) != 0)
+				return -1;
+			script_code_last(code)->arg.eval2 = exp->data.op3fee.eval;
+			script_code_last(code)->argextra = exp->data.op3fee.argextra;
+			return 0;
 		case SCRIPT_EXP_EXPRESSION :
-			return script_evaluate(exp->data.op1e.arg0);
+			return script_code_compile_exp(code, exp->data.op1e.arg0, dst);
 		case SCRIPT_EXP_NOT :
-			return script_value_alloc_num(~script_value_free_num(script_evaluate(exp->data.op1e.arg0)));
 		case SCRIPT_EXP_LNOT :
-			return script_value_alloc_num(!script_value_free_num(script_evaluate(exp->data.op1e.arg0)));
-		case SCRIPT_EXP_ADD :
-			return script_value_add(script_evaluate(exp->data.op2ee.arg0), script_evaluate(exp->data.op2ee.arg1));
-		case SCRIPT_EXP_SUB :
-			return script_value_alloc_num(script_value_free_num(script_evaluate(exp->data.op2ee.arg0)) - script_value_free_num(script_evaluate(exp->data.op2ee.arg1)));
-		case SCRIPT_EXP_AND :
-			return script_value_alloc_num(script_value_free_num(script_evaluate(exp->data.op2ee.arg0)) & script_value_free_num(script_evaluate(exp->data.op2ee.arg1)));
-		case SCRIPT_EXP_OR :
-			return script_value_alloc_num(script_value_free_num(script_evaluate(exp->data.op2ee.arg0)) | script_value_free_num(script_evaluate(exp->data.op2ee.arg1)));
-		case SCRIPT_EXP_XOR :
-			return script_value_alloc_num(script_value_free_num(script_evaluate(exp->data.op2ee.arg0)) ^ script_value_free_num(script_evaluate(exp->data.op2ee.arg1)));
-		case SCRIPT_EXP_L :
-			return script_value_alloc_num(script_value_free_num(script_evaluate(exp->data.op2ee.arg0)) < script_value_free_num(script_evaluate(exp->data.op2ee.arg1)));
-		case SCRIPT_EXP_G :
-			return script_value_alloc_num(script_value_free_num(script_evaluate(exp->data.op2ee.arg0)) > script_value_free_num(script_evaluate(exp->data.op2ee.arg1)));
-		case SCRIPT_EXP_E :
-			return script_value_alloc_num(script_value_free_num(script_evaluate(exp->data.op2ee.arg0)) == script_value_free_num(script_evaluate(exp->data.op2ee.arg1)));
-		case SCRIPT_EXP_LE :
-			return script_value_alloc_num(script_value_free_num(script_evaluate(exp->data.op2ee.arg0)) <= script_value_free_num(script_evaluate(exp->data.op2ee.arg1)));
-		case SCRIPT_EXP_GE :
-			return script_value_alloc_num(script_value_free_num(script_evaluate(exp->data.op2ee.arg0)) >= script_value_free_num(script_evaluate(exp->data.op2ee.arg1)));
-		case SCRIPT_EXP_SL :
-			return script_value_alloc_num(script_value_free_num(script_evaluate(exp->data.op2ee.arg0)) << script_value_free_num(script_evaluate(exp->data.op2ee.arg1)));
-		case SCRIPT_EXP_SR :
-			return script_value_alloc_num(script_value_free_num(script_evaluate(exp->data.op2ee.arg0)) >> script_value_free_num(script_evaluate(exp->data.op2ee.arg1)));
+			if (script_code_compile_exp(code, exp->data.op1e.arg0, dst) != 0)
+				return -1;
+			op = exp->type == SCRIPT_EXP_NOT ? SCRIPT_OP_NOT : SCRIPT_OP_LNOT;
+			return script_code_emit(code, op, dst, dst, 0);
 		case SCRIPT_EXP_LOR :
-			return script_value_alloc_num(script_value_free_num(script_evaluate(exp->data.op2ee.arg0)) || script_value_free_num(script_evaluate(exp->data.op2ee.arg1)));
 		case SCRIPT_EXP_LAND :
-			return script_value_alloc_num(script_value_free_num(script_evaluate(exp->data.op2ee.arg0)) && script_value_free_num(script_evaluate(exp->data.op2ee.arg1)));
+			/* the second operand is evaluated only if required */
+			if (script_code_compile_exp(code, exp->data.op2ee.arg0, dst) != 0)
+				return -1;
+			op = exp->type == SCRIPT_EXP_LOR ? SCRIPT_OP_JUMPTRUE : SCRIPT_OP_JUMPFALSE;
+			if (script_code_emit(code, op, dst, dst, 0) != 0)
+				return -1;
+			jump = code->op_mac - 1;
+			if (script_code_compile_exp(code, exp->data.op2ee.arg1, dst) != 0)
+				return -1;
+			if (script_code_emit(code, SCRIPT_OP_BOOL, dst, dst, 0) != 0)
+				return -1;
+			code->op_map[jump].arg.num = code->op_mac;
+			return 0;
+		case SCRIPT_EXP_ADD : op = SCRIPT_OP_ADD; break;
+		case SCRIPT_EXP_SUB : op = SCRIPT_OP_SUB; break;
+		case SCRIPT_EXP_AND : op = SCRIPT_OP_AND; break;
+		case SCRIPT_EXP_OR : op = SCRIPT_OP_OR; break;
+		case SCRIPT_EXP_XOR : op = SCRIPT_OP_XOR; break;
+		case SCRIPT_EXP_L : op = SCRIPT_OP_L; break;
+		case SCRIPT_EXP_G : op = SCRIPT_OP_G; break;
+		case SCRIPT_EXP_E : op = SCRIPT_OP_E; break;
+		case SCRIPT_EXP_LE : op = SCRIPT_OP_LE; break;
+		case SCRIPT_EXP_GE : op = SCRIPT_OP_GE; break;
+		case SCRIPT_EXP_SL : op = SCRIPT_OP_SL; break;
+		case SCRIPT_EXP_SR : op = SCRIPT_OP_SR; break;
 		default:
 			assert(0);
+			return -1;
+	}
+
+	/* binary operators */
+	if (script_code_compile_exp(code, exp->data.op2ee.arg0, dst) != 0)
+		return -1;
+	if (script_code_compile_exp(code, exp->data.op2ee.arg1, dst + 1) != 0)
+		return -1;
+	return script_code_emit(code, op, dst, dst, dst + 1);
+}
+
+struct script_code* script_code_compile(const struct script_exp* exp)
+{
+	struct script_code* code = malloc(sizeof(struct script_code));
+	if (!code) {
+		script_error("Low memory");
+		return 0;
+	}
+
+	code->op_map = 0;
+	code->op_mac = 0;
+	code->op_max = 0;
+
+	if (script_code_compile_exp(code, exp, 0) != 0) {
+		script_code_free(code);
+		return 0;
+	}
+
+	return code;
+}
+
+void script_code_free(struct script_code* code)
+{
+	unsigned i;
+
+	if (!code)
+		return;
+
+	for(i=0;i<code->op_mac;++i) {
+		if (code->op_map[i].code == SCRIPT_OP_TEXT)
+			free(code->op_map[i].arg.text);
 	}
 
-	return script_value_alloc_num(0);
+	free(code->op_map);
+	free(code);
 }
 
+static struct script_value SCRIPT_REGISTER[SCRIPT_CODE_REGISTER_MAX];
+static char SCRIPT_TEXT[SCRIPT_CODE_TEXT_MAX];
+
+/* Concatenate two texts in the text buffer, truncating if it's full */
+static const char* script_code_concat(unsigned* text_pos, const char* a, const char* b)
+{
+	char* begin = SCRIPT_TEXT + *text_pos;
+	char* end = SCRIPT_TEXT + SCRIPT_CODE_TEXT_MAX - 1;
+	char* d = begin;
+
+	if (d > end)
+		return "";
+
+	while (*a && d < end)
+		*d++ = *a++;
+	while (*b && d < end)
+		*d++ = *b++;
+	*d++ = 0;
+
+	*text_pos = d - SCRIPT_TEXT;
+
+	return begin;
+}
+
+void script_code_run(const struct script_code* code, struct script_value* result)
+{
+	struct script_value* r = SCRIPT_REGISTER;
+	const struct script_op* op = code->op_map;
+	const struct script_op* end = code->op_map + code->op_mac;
+	unsigned text_pos = 0;
+
+	while (op != end) {
+		struct script_value* d = &r[op->dst];
+		const struct script_value* a = &r[op->a];
+		const struct script_value* b = &r[op->b];
+
+		switch (op->code) {
+		case SCRIPT_OP_NUM :
+			script_value_set_num(d, op->arg.num);
+			break;
+		case SCRIPT_OP_TEXT :
+			script_value_set_text(d, op->arg.text);
+			break;
+		case SCRIPT_OP_VARIABLE :
+		case SCRIPT_OP_F0 :
+			op->arg.eval0(d, op->argextra);
+			break;
+		case SCRIPT_OP_F1 :
+			op->arg.eval1(d, a, op->argextra);
+			break;
+		case SCRIPT_OP_F2 :
+			op->arg.eval2(d, a, b, op->argextra);
+			break;
+		case SCRIPT_OP_NOT :
+			script_value_set_num(d, ~script_value_get_num(a));
+			break;
+		case SCRIPT_OP_LNOT :
+			script_value_set_num(d, !script_value_get_num(a));
+			break;
+		case SCRIPT_OP_BOOL :
+			script_value_set_num(d, script_value_get_num(a) != 0);
+			break;
+		case SCRIPT_OP_ADD :
+			if (a->type == SCRIPT_VALUE_TEXT && b->type == SCRIPT_VALUE_TEXT)
+				script_value_set_text(d, script_code_concat(&text_pos, a->value.text, b->value.text));
+			else
+				script_value_set_num(d, script_value_get_num(a) + script_value_get_num(b));
+			break;
+		case SCRIPT_OP_SUB :
+			script_value_set_num(d, script_value_get_num(a) - script_value_get_num(b));
+			break;
+		case SCRIPT_OP_AND :
+			script_value_set_num(d, script_value_get_num(a) & script_value_get_num(b));
+			break;
+		case SCRIPT_OP_OR :
+			script_value_set_num(d, script_value_get_num(a) | script_value_get_num(b));
+			break;
+		case SCRIPT_OP_XOR :
+			script_value_set_num(d, script_value_get_num(a) ^ script_value_get_num(b));
+			break;
+		case SCRIPT_OP_L :
+			script_value_set_num(d, script_value_get_num(a) < script_value_get_num(b));
+			break;
+		case SCRIPT_OP_G :
+			script_value_set_num(d, script_value_get_num(a) > script_value_get_num(b));
+			break;
+		case SCRIPT_OP_E :
+			script_value_set_num(d, script_value_get_num(a) == script_value_get_num(b));
+			break;
+		case SCRIPT_OP_LE :
+			script_value_set_num(d, script_value_get_num(a) <= script_value_get_num(b));
+			break;
+		case SCRIPT_OP_GE :
+			script_value_set_num(d, script_value_get_num(a) >= script_value_get_num(b));
+			break;
+		case SCRIPT_OP_SL :
+			script_value_set_num(d, script_value_get_num(a) << script_value_get_num(b));
+			break;
+		case SCRIPT_OP_SR :
+			script_value_set_num(d, script_value_get_num(a) >> script_value_get_num(b));
+			break;
+		case SCRIPT_OP_JUMPTRUE :
+			if (script_value_get_num(a)) {
+				script_value_set_num(d, 1);
+				op = code->op_map + op->arg.num;
+				continue;
+			}
+			break;
+		case SCRIPT_OP_JUMPFALSE :
+			if (!script_value_get_num(a)) {
+				script_value_set_num(d, 0);
+				op = code->op_map + op->arg.num;
+				continue;
+			}
+			break;
+		default:
+			assert(0);
+		}
+
+		++op;
+	}
+
+	*result = r[0];
+}
+
+int script_code_run_num(const struct script_code* code)
+{
+	struct script_value value;
+
+	script_code_run(code, &value);
+
+	return script_value_get_num(&value);
+}
+
+/***************************************************************************/
+/* Command */
+
 struct script_cmd* script_cmd_alloc(void)
 {
 	struct script_cmd* cmd = malloc(sizeof(struct script_cmd));
@@ -370,17 +559,17 @@ void script_free(struct script_cmd* script)
 				script_free(script->data.op1c.arg0);
 				break;
 			case SCRIPT_CMD_TYPE_1E :
-				script_exp_free(script->data.op1e.arg0);
+				script_code_free(script->data.op1e.arg0);
 				break;
 			case SCRIPT_CMD_TYPE_1ED :
-				script_exp_free(script->data.op1ed.arg0);
+				script_code_free(script->data.op1ed.arg0);
 				break;
 			case SCRIPT_CMD_TYPE_2EC :
-				script_exp_free(script->data.op2ec.arg0);
+				script_code_free(script->data.op2ec.arg0);
 				script_free(script->data.op2ec.arg1);
 				break;
 			case SCRIPT_CMD_TYPE_2ECD :
-				script_exp_free(script->data.op2ecd.arg0);
+				script_code_free(script->data.op2ecd.arg0);
 				script_free(script->data.op2ecd.arg1);
 				break;
 		}
@@ -422,24 +611,46 @@ struct script_cmd* script_cmd_make_op2cc(struct script_cmd* arg0, struct script_
 	return arg0;
 }
 
+/* Compile the expression of a command, and free it */
+static struct script_code* script_cmd_compile(struct script_exp* exp)
+{
+	struct script_code* code = script_code_compile(exp);
+	script_exp_free(exp);
+	return code;
+}
+
 struct script_cmd* script_cmd_make_op2se(const char* arg0, struct script_exp* arg1)
 {
+	struct script_code* code;
+
 	if (strcmp(arg0, "wait")==0) {
-		struct script_cmd* cmd = script_cmd_alloc();
+		struct script_cmd* cmd;
+		code = script_cmd_compile(arg1);
+		if (!code)
+			return 0;
+		cmd = script_cmd_alloc();
 		cmd->type = SCRIPT_CMD_WAIT;
-		cmd->data.op1e.arg0 = arg1;
+		cmd->data.op1e.arg0 = code;
 		return cmd;
 	} else if (strcmp(arg0, "delay")==0) {
-		struct script_cmd* cmd = script_cmd_alloc();
+		struct script_cmd* cmd;
+		code = script_cmd_compile(arg1);
+		if (!code)
+			return 0;
+		cmd = script_cmd_alloc();
 		cmd->type = SCRIPT_CMD_DELAY;
-		cmd->data.op1ed.arg0 = arg1;
+		cmd->data.op1ed.arg0 = code;
 		cmd->data.op1ed.value_set = 0;
 		cmd->data.op1ed.value = 0;
 		return cmd;
 	} else if (strcmp(arg0, "evaluate")==0) {
-		struct script_cmd* cmd = script_cmd_alloc();
+		struct script_cmd* cmd;
+		code = script_cmd_compile(arg1);
+		if (!code)
+			return 0;
+		cmd = script_cmd_alloc();
 		cmd->type = SCRIPT_CMD_EVALUATE;
-		cmd->data.op1e.arg0 = arg1;
+		cmd->data.op1e.arg0 = code;
 		return cmd;
 	} else {
 		char buffer[128];
@@ -456,24 +667,38 @@ struct script_cmd* script_cmd_make_op1c(struct script_cmd* arg0)
 
 struct script_cmd* script_cmd_make_op3sec(const char* arg0, struct script_exp* arg1, struct script_cmd* arg2)
 {
+	struct script_code* code;
+
 	if (strcmp(arg0, "while")==0) {
-		struct script_cmd* cmd = script_cmd_alloc();
+		struct script_cmd* cmd;
+		code = script_cmd_compile(arg1);
+		if (!code)
+			return 0;
+		cmd = script_cmd_alloc();
 		cmd->type = SCRIPT_CMD_WHILE;
-		cmd->data.op2ec.arg0 = arg1;
+		cmd->data.op2ec.arg0 = code;
 		cmd->data.op2ec.arg1 = arg2;
 		return cmd;
 	} else if (strcmp(arg0, "repeat")==0) {
-		struct script_cmd* cmd = script_cmd_alloc();
+		struct script_cmd* cmd;
+		code = script_cmd_compile(arg1);
+		if (!code)
+			return 0;
+		cmd = script_cmd_alloc();
 		cmd->type = SCRIPT_CMD_REPEAT;
-		cmd->data.op2ecd.arg0 = arg1;
+		cmd->data.op2ecd.arg0 = code;
 		cmd->data.op2ecd.arg1 = arg2;
 		cmd->data.op2ecd.value_set = 0;
 		cmd->data.op2ecd.value = 0;
 		return cmd;
 	} else if (strcmp(arg0, "if")==0) {
-		struct script_cmd* cmd = script_cmd_alloc();
+		struct script_cmd* cmd;
+		code = script_cmd_compile(arg1);
+		if (!code)
+			return 0;
+		cmd = script_cmd_alloc();
 		cmd->type = SCRIPT_CMD_IF;
-		cmd->data.op2ec.arg0 = arg1;
+		cmd->data.op2ec.arg0 = code;
 		cmd->data.op2ec.arg1 = arg2;
 		return cmd;
 	} else {
@@ -529,16 +754,15 @@ void script_run_next(struct script_state* state)
 void script_run_exp(struct script_state* state)
 {
 	struct script_cmd* cursor = script_run_cursor_get(state);
-	struct script_value* value = script_evaluate(cursor->data.op1e.arg0);
-	script_value_free(value);
+	struct script_value value;
+	script_code_run(cursor->data.op1e.arg0, &value);
 	script_run_next(state);
 }
 
 void script_run_wait(struct script_state* state)
 {
 	struct script_cmd* cursor = script_run_cursor_get(state);
-	struct script_value* value = script_evaluate(cursor->data.op1e.arg0);
-	int condition = script_value_free_num(value);
+	int condition = script_code_run_num(cursor->data.op1e.arg0);
 	if (condition) {
 		script_run_next(state);
 	} else {
@@ -553,7 +777,7 @@ void script_run_delay(struct script_state* state)
 	struct script_cmd* cursor = script_run_cursor_get(state);
 	if (!cursor->data.op1ed.value_set) {
 		cursor->data.op1ed.value_set = 1;
-		cursor->data.op1ed.value = script_value_free_num(script_evaluate(cursor->data.op1ed.arg0));
+		cursor->data.op1ed.value = script_code_run_num(cursor->data.op1ed.arg0);
 	}
 
 	if (state->time_to_play < cursor->data.op1ed.value * unit) {
@@ -571,7 +795,7 @@ void script_run_repeat(struct script_state* state)
 	struct script_cmd* cursor = script_run_cursor_get(state);
 	if (!cursor->data.op2ecd.value_set) {
 		cursor->data.op2ecd.value_set = 1;
-		cursor->data.op2ecd.value = script_value_free_num(script_evaluate(cursor->data.op2ecd.arg0));
+		cursor->data.op2ecd.value = script_code_run_num(cursor->data.op2ecd.arg0);
 	}
 	if (cursor->data.op2ecd.value) {
 		--cursor->data.op2ecd.value;
@@ -598,8 +822,7 @@ void script_run_inner(struct script_state* state)
 void script_run_if(struct script_state* state)
 {
 	struct script_cmd* cursor = script_run_cursor_get(state);
-	struct script_value* value = script_evaluate(cursor->data.op2ec.arg0);
-	int condition = script_value_free_num(value);
+	int condition = script_code_run_num(cursor->data.op2ec.arg0);
 	if (condition) {
 		script_run_cursor_set(state, cursor->next); /* set the next, also if is 0 */
 		script_run_cursor_push(state, cursor->data.op2ec.arg1);
@@ -611,8 +834,7 @@ void script_run_if(struct script_state* state)
 void script_run_while(struct script_state* state)
 {
 	struct script_cmd* cursor = script_run_cursor_get(state);
-	struct script_value* value = script_evaluate(cursor->data.op2ec.arg0);
-	int condition = script_value_free_num(value);
+	int condition = script_code_run_num(cursor->data.op2ec.arg0);
 	if (condition) {
 		script_run_cursor_push(state, cursor->data.op2ec.arg1);
 	} else {
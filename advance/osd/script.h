@@ -38,7 +38,7 @@
 #define SCRIPT_VALUE_TEXT 0x01
 
 union script_value_arg {
-	char* text;
+	const char* text; /**< Text not owned by the value. */
 	int num;
 };
 
@@ -47,10 +47,23 @@ struct script_value {
 	union script_value_arg value;
 };
 
-void script_value_free(struct script_value* p);
-int script_value_free_num(struct script_value* p);
-struct script_value* script_value_alloc_num(int v);
-struct script_value* script_value_alloc_text(const char* v);
+static inline void script_value_set_num(struct script_value* p, int v)
+{
+	p->type = SCRIPT_VALUE_NUM;
+	p->value.num = v;
+}
+
+static inline void script_value_set_text(struct script_value* p, const char* v)
+{
+	p->type = SCRIPT_VALUE_TEXT;
+	p->value.text = v;
+}
+
+/* Get the numerical value, a text is 0 */
+static inline int script_value_get_num(const struct script_value* p)
+{
+	return p->type == SCRIPT_VALUE_NUM ? p->value.num : 0;
+}
 
 /***************************************************************************/
 /* Expression */
@@ -75,7 +88,7 @@ struct script_exp_op1v {
 	int arg0; /* value */
 };
 
-typedef struct script_value* (script_exp_op1s_evaluator)(union script_arg_extra argextra);
+typedef void (script_exp_op1s_evaluator)(struct script_value* result, union script_arg_extra argextra);
 
 struct script_exp_op1s {
 	union script_arg_extra argextra; /* extra value for the evaluator */
@@ -86,14 +99,14 @@ struct script_exp_op1t {
 	char* arg0; /* text */
 };
 
-typedef struct script_value* (script_exp_op1f_evaluator)(union script_arg_extra argextra);
+typedef void (script_exp_op1f_evaluator)(struct script_value* result, union script_arg_extra argextra);
 
 struct script_exp_op1f {
 	union script_arg_extra argextra; /* extra value for the evaluator */
 	script_exp_op1f_evaluator* eval; /* evaluator */
 };
 
-typedef struct script_value* (script_exp_op2fe_evaluator)(struct script_value* arg1, union script_arg_extra argextra);
+typedef void (script_exp_op2fe_evaluator)(struct script_value* result, const struct script_value* arg1, union script_arg_extra argextra);
 
 struct script_exp_op2fe {
 	struct script_exp* arg1; /* expression */
@@ -101,7 +114,7 @@ struct script_exp_op2fe {
 	script_exp_op2fe_evaluator* eval; /* evaluator */
 };
 
-typedef struct script_value* (script_exp_op3fee_evaluator)(struct script_value* arg1, struct script_value* arg2, union script_arg_extra argextra);
+typedef void (script_exp_op3fee_evaluator)(struct script_value* result, const struct script_value* arg1, const struct script_value* arg2, union script_arg_extra argextra);
 
 struct script_exp_op3fee {
 	struct script_exp* arg1; /* expression */
@@ -167,8 +180,6 @@ struct script_exp {
 	union script_exp_data data;
 };
 
-struct script_value* script_evaluate(const struct script_exp* exp);
-
 /* Symbol callback */
 script_exp_op1s_evaluator* script_symbol_check(const char* sym, union script_arg_extra* argextra);
 script_exp_op1f_evaluator* script_function1_check(const char* sym, union script_arg_extra* argextra);
@@ -186,6 +197,78 @@ struct script_exp* script_exp_make_op2ee(int type, struct script_exp* arg0, stru
 struct script_exp* script_exp_make_op1f(int type, const char* arg0);
 struct script_exp* script_exp_make_op2fe(int type, const char* arg0, struct script_exp* arg1);
 struct script_exp* script_exp_make_op3fee(int type, const char* arg0, struct script_exp* arg1, struct script_exp* arg2);
+void script_exp_free(struct script_exp* exp);
+
+/***************************************************************************/
+/* Code */
+
+/*
+ * The expressions are compiled in a sequence of operations working on
+ * a fixed set of registers. The result of each subexpression is stored
+ * in the register of its depth in the expression, and the result of
+ * the whole expression is in the register 0.
+ * The evaluation doesn't allocate memory. The texts computed are stored
+ * in a fixed buffer, valid until the next evaluation.
+ */
+
+/* Max number of registers */
+#define SCRIPT_CODE_REGISTER_MAX 32
+
+/* Size of the buffer for the computed texts */
+#define SCRIPT_CODE_TEXT_MAX 1024
+
+/* Code operations */
+#define SCRIPT_OP_NUM 0x00 /* dst = num */
+#define SCRIPT_OP_TEXT 0x01 /* dst = text */
+#define SCRIPT_OP_VARIABLE 0x02 /* dst = eval0() */
+#define SCRIPT_OP_F0 0x03 /* dst = eval0() */
+#define SCRIPT_OP_F1 0x04 /* dst = eval1(a) */
+#define SCRIPT_OP_F2 0x05 /* dst = eval2(a, b) */
+#define SCRIPT_OP_NOT 0x06 /* dst = ~a */
+#define SCRIPT_OP_LNOT 0x07 /* dst = !a */
+#define SCRIPT_OP_BOOL 0x08 /* dst = a != 0 */
+#define SCRIPT_OP_ADD 0x09 /* dst = a + b, numbers or texts */
+#define SCRIPT_OP_SUB 0x0a
+#define SCRIPT_OP_AND 0x0b
+#define SCRIPT_OP_OR 0x0c
+#define SCRIPT_OP_XOR 0x0d
+#define SCRIPT_OP_L 0x0e
+#define SCRIPT_OP_G 0x0f
+#define SCRIPT_OP_E 0x10
+#define SCRIPT_OP_LE 0x11
+#define SCRIPT_OP_GE 0x12
+#define SCRIPT_OP_SL 0x13
+#define SCRIPT_OP_SR 0x14
+#define SCRIPT_OP_JUMPTRUE 0x15 /* if (a) { dst = 1; jump num } */
+#define SCRIPT_OP_JUMPFALSE 0x16 /* if (!a) { dst = 0; jump num } */
+
+union script_op_arg {
+	int num; /**< Value, or jump target. */
+	char* text; /**< Text owned by the operation. */
+	script_exp_op1s_evaluator* eval0;
+	script_exp_op2fe_evaluator* eval1;
+	script_exp_op3fee_evaluator* eval2;
+};
+
+struct script_op {
+	unsigned char code; /**< Operation. */
+	unsigned char dst; /**< Destination register. */
+	unsigned char a; /**< First operand register. */
+	unsigned char b; /**< Second operand register. */
+	union script_arg_extra argextra; /**< Extra value for the evaluators. */
+	union script_op_arg arg;
+};
+
+struct script_code {
+	struct script_op* op_map;
+	unsigned op_mac;
+	unsigned op_max;
+};
+
+struct script_code* script_code_compile(const struct script_exp* exp);
+void script_code_free(struct script_code* code);
+void script_code_run(const struct script_code* code, struct script_value* result);
+int script_code_run_num(const struct script_code* code);
 
 /***************************************************************************/
 /* Commands */
@@ -215,11 +298,11 @@ static inline int script_cmd_type_get(unsigned type)
 
 /* Commands data */
 struct script_cmd_op1e {
-	struct script_exp* arg0;
+	struct script_code* arg0;
 };
 
 struct script_cmd_op1ed {
-	struct script_exp* arg0;
+	struct script_code* arg0;
 	int value;
 	int value_set;
 };
@@ -229,12 +312,12 @@ struct script_cmd_op1c {
 };
 
 struct script_cmd_op2ec {
-	struct script_exp* arg0;
+	struct script_code* arg0;
 	struct script_cmd* arg1;
 };
 
 struct script_cmd_op2ecd {
-	struct script_exp* arg0;
+	struct script_code* arg0;
 	struct script_cmd* arg1;
 	int value;
 	int value_set;
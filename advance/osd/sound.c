@@ -36,6 +36,12 @@
 
 #include <math.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 static struct game_adjust_struct {
 	const char* name;
 	int gain;
@@ -338,151 +344,248 @@ static void sound_adjust(struct advance_sound_context* context, unsigned channel
 	}
 }
 
+/**
+ * Number of samples equalized in a single step.
+ */
+#define SOUND_EQUALIZER_BLOCK 256
+
 static void sound_equalizer(struct advance_sound_context* context, unsigned channel, const short* input_sample, short* output_sample, unsigned sample_count)
 {
-	unsigned i, j;
-	int mult;
+	adv_filter_real mix[SOUND_EQUALIZER_BLOCK * 2];
 
-	for(j=0;j<channel;++j) {
-		unsigned off = j;
-		for(i=0;i<sample_count;++i) {
-			double v, vl, vm, vh, vr;
-			int vi;
+	assert(channel <= 2);
 
-			v = input_sample[off];
+	while (sample_count) {
+		unsigned run = sample_count < SOUND_EQUALIZER_BLOCK ? sample_count : SOUND_EQUALIZER_BLOCK;
+		unsigned count = run * channel;
+		unsigned i;
 
-			vr = 0;
+		for(i=0;i<count;++i)
+			mix[i] = 0;
 
-			if (context->config.equalizer_low > -40) {
-				adv_filter_insert(&context->state.equalizer_low, &context->state.equalizer_low_state[j], v);
-				vr += context->state.equalizer_low_factor * adv_filter_extract(&context->state.equalizer_low, &context->state.equalizer_low_state[j]);
-			}
-
-			if (context->config.equalizer_mid > -40) {
-				adv_filter_insert(&context->state.equalizer_mid, &context->state.equalizer_mid_state[j], v);
-				vr += context->state.equalizer_mid_factor * adv_filter_extract(&context->state.equalizer_mid, &context->state.equalizer_mid_state[j]);
-			}
-
-			if (context->config.equalizer_high > -40) {
-				adv_filter_insert(&context->state.equalizer_high, &context->state.equalizer_high_state[j], v);
-				vr += context->state.equalizer_high_factor * adv_filter_extract(&context->state.equalizer_high, &context->state.equalizer_high_state[j]);
-			}
+		/* filter and mix all the bands */
+		if (context->config.equalizer_low > -40)
+			adv_filter_block_mix(&context->state.equalizer_low, context->state.equalizer_low_state, channel, input_sample, mix, run, context->state.equalizer_low_factor);
+		if (context->config.equalizer_mid > -40)
+			adv_filter_block_mix(&context->state.equalizer_mid, context->state.equalizer_mid_state, channel, input_sample, mix, run, context->state.equalizer_mid_factor);
+		if (context->config.equalizer_high > -40)
+			adv_filter_block_mix(&context->state.equalizer_high, context->state.equalizer_high_state, channel, input_sample, mix, run, context->state.equalizer_high_factor);
 
+		/* convert and clamp */
+		for(i=0;i<count;++i) {
 			/* lrint is potentially faster than a cast to int */
-			vi = lrint(vr);
+			long v = lrint(mix[i]);
 
-			if (vi > 32767) {
+			if (v > 32767) {
 				++context->state.overflow;
-				vi = 32767;
+				v = 32767;
 			}
-			if (vi < -32768) {
+			if (v < -32768) {
 				++context->state.overflow;
-				vi = -32768;
+				v = -32768;
 			}
 
-			output_sample[off] = vi;
-			off += channel;
+			output_sample[i] = v;
 		}
+
+		input_sample += count;
+		output_sample += count;
+		sample_count -= run;
 	}
 }
 
 /* Resample */
+
+#if SOUND_RESAMPLE_TAPS != 16
+#error The resampler requires 16 taps
+#endif
+
+/**
+ * Fixed point precision of the position in the input samples.
+ */
+#define SOUND_RESAMPLE_POS_BIT 16
+
+/**
+ * Compute the windowed sinc coefficients of the polyphase resampler.
+ * Each phase interpolates the input at a fractional position between
+ * the two central taps. The phase 0 is an exact copy of the input.
+ */
+static void sound_resample_init(struct advance_sound_context* context)
+{
+	unsigned p, t;
+	double half = SOUND_RESAMPLE_TAPS / 2;
+
+	for(p=0;p<SOUND_RESAMPLE_PHASE_MAX;++p) {
+		double frac = (double)p / SOUND_RESAMPLE_PHASE_MAX;
+		double c[SOUND_RESAMPLE_TAPS];
+		double sum;
+		int isum;
+
+		sum = 0;
+		for(t=0;t<SOUND_RESAMPLE_TAPS;++t) {
+			double d = t - (half - 1) - frac;
+			double w;
+
+			/* sample value */
+			if (d == 0)
+				c[t] = 1;
+			else
+				c[t] = sin(M_PI*d) / (M_PI*d);
+
+			/* Blackman window */
+			w = 0.42 + 0.5 * cos(M_PI*d/half) + 0.08 * cos(2*M_PI*d/half);
+
+			c[t] *= w;
+			sum += c[t];
+		}
+
+		/* adjust the gain to be exact 1.0 also after the rounding */
+		isum = 0;
+		for(t=0;t<SOUND_RESAMPLE_TAPS;++t) {
+			int v = floor(c[t] / sum * (1 << SOUND_RESAMPLE_COEFF_BIT) + 0.5);
+			context->state.resample_coeff[p][t] = v;
+			isum += v;
+		}
+		context->state.resample_coeff[p][SOUND_RESAMPLE_TAPS/2 - 1] += (1 << SOUND_RESAMPLE_COEFF_BIT) - isum;
+	}
+}
+
+static void sound_resample_reset(struct advance_sound_context* context)
+{
+	unsigned i, j;
+
+	context->state.resample_flag = 0;
+	for(j=0;j<2;++j)
+		for(i=0;i<SOUND_RESAMPLE_TAPS;++i)
+			context->state.resample_history[j][i] = 0;
+}
+
+/**
+ * Compute the filtered value of 16 samples.
+ * \param x Input samples.
+ * \param c Filter coefficients.
+ * \return Filtered value with SOUND_RESAMPLE_COEFF_BIT of fractional precision.
+ */
+static inline int sound_resample_dot(const short* x, const short* c)
+{
+#if defined(__SSE2__)
+	__m128i a, b;
+
+	a = _mm_madd_epi16(_mm_loadu_si128((const __m128i*)x), _mm_loadu_si128((const __m128i*)c));
+	b = _mm_madd_epi16(_mm_loadu_si128((const __m128i*)(x + 8)), _mm_loadu_si128((const __m128i*)(c + 8)));
+	a = _mm_add_epi32(a, b);
+	a = _mm_add_epi32(a, _mm_shuffle_epi32(a, _MM_SHUFFLE(1, 0, 3, 2)));
+	a = _mm_add_epi32(a, _mm_shuffle_epi32(a, _MM_SHUFFLE(2, 3, 0, 1)));
+
+	return _mm_cvtsi128_si32(a);
+#elif defined(__ARM_NEON)
+	int32x4_t a;
+	int32x2_t b;
+
+	a = vmull_s16(vld1_s16(x), vld1_s16(c));
+	a = vmlal_s16(a, vld1_s16(x + 4), vld1_s16(c + 4));
+	a = vmlal_s16(a, vld1_s16(x + 8), vld1_s16(c + 8));
+	a = vmlal_s16(a, vld1_s16(x + 12), vld1_s16(c + 12));
+	b = vadd_s32(vget_low_s32(a), vget_high_s32(a));
+	b = vpadd_s32(b, b);
+
+	return vget_lane_s32(b, 0);
+#else
+	int v = 0;
+	unsigned i;
+
+	for(i=0;i<16;++i)
+		v += x[i] * c[i];
+
+	return v;
+#endif
+}
+
+/**
+ * Resample with a polyphase windowed sinc filter.
+ * The input samples are always consumed completely, and the last
+ * ones are kept as history for the next call. This allows to change
+ * the ratio at every call without any discontinuity.
+ */
 static void sound_scale(struct advance_sound_context* context, unsigned channel, const short* input_sample, short* output_sample, unsigned sample_count, unsigned sample_recount)
 {
-	adv_slice slice;
-
-	slice_set(&slice, sample_count, sample_recount);
-
-	if (channel == 1) {
-		if (sample_count < sample_recount) {
-			/* expansion */
-			int count = slice.count;
-			int error = slice.error;
-			while (count) {
-				unsigned run = slice.whole;
-				if ((error += slice.up) > 0) {
-					++run;
-					error -= slice.down;
-				}
+	short* buffer;
+	unsigned whole;
+	unsigned up;
+	unsigned i, j;
 
-				while (run) {
-					output_sample[0] = input_sample[0];
-					output_sample += 1;
-					--run;
-				}
-				input_sample += 1;
+	assert(sample_count < (1U << (32 - SOUND_RESAMPLE_POS_BIT)));
+	assert(channel <= 2);
 
-				--count;
-			}
-		} else {
-			/* reduction */
-			int count = slice.count;
-			int error = slice.error;
-			while (count) {
-				unsigned run = slice.whole;
-				if ((error += slice.up) > 0) {
-					++run;
-					error -= slice.down;
-				}
+	/* step from one output sample to the next in input samples */
+	whole = (sample_count << SOUND_RESAMPLE_POS_BIT) / sample_recount;
+	up = (sample_count << SOUND_RESAMPLE_POS_BIT) % sample_recount;
 
-				output_sample[0] = input_sample[0];
-				output_sample += 1;
-				input_sample += run;
+	buffer = (short*)malloc((SOUND_RESAMPLE_TAPS + sample_count) * sizeof(short));
 
-				--count;
-			}
-		}
-	} else if (channel == 2) {
-		if (sample_count < sample_recount) {
-			/* expansion */
-			int count = slice.count;
-			int error = slice.error;
-			while (count) {
-				unsigned run = slice.whole;
-				if ((error += slice.up) > 0) {
-					++run;
-					error -= slice.down;
-				}
+	for(j=0;j<channel;++j) {
+		short* history = context->state.resample_history[j];
+		unsigned pos;
+		unsigned error;
 
-				while (run) {
-					output_sample[0] = input_sample[0];
-					output_sample[1] = input_sample[1];
-					output_sample += 2;
-					--run;
-				}
-				input_sample += 2;
+		/* history followed by the deinterleaved input */
+		for(i=0;i<SOUND_RESAMPLE_TAPS;++i)
+			buffer[i] = history[i];
+		for(i=0;i<sample_count;++i)
+			buffer[SOUND_RESAMPLE_TAPS + i] = input_sample[i*channel + j];
+
+		pos = 0;
+		error = 0;
+		for(i=0;i<sample_recount;++i) {
+			unsigned ipos = pos >> SOUND_RESAMPLE_POS_BIT;
+			unsigned phase = (pos >> (SOUND_RESAMPLE_POS_BIT - SOUND_RESAMPLE_PHASE_BIT)) & (SOUND_RESAMPLE_PHASE_MAX - 1);
+			int v;
+
+			v = sound_resample_dot(buffer + ipos, context->state.resample_coeff[phase]);
 
-				--count;
+			/* round */
+			v = (v + (1 << (SOUND_RESAMPLE_COEFF_BIT - 1))) >> SOUND_RESAMPLE_COEFF_BIT;
+
+			if (v > 32767) {
+				++context->state.overflow;
+				v = 32767;
+			}
+			if (v < -32768) {
+				++context->state.overflow;
+				v = -32768;
 			}
-		} else {
-			/* reduction */
-			int count = slice.count;
-			int error = slice.error;
-			while (count) {
-				unsigned run = slice.whole;
-				if ((error += slice.up) > 0) {
-					++run;
-					error -= slice.down;
-				}
 
-				output_sample[0] = input_sample[0];
-				output_sample[1] = input_sample[1];
-				output_sample += 2;
-				input_sample += 2*run;
+			output_sample[i*channel + j] = v;
 
-				--count;
+			pos += whole;
+			error += up;
+			if (error >= sample_recount) {
+				error -= sample_recount;
+				++pos;
 			}
 		}
+
+		/* at the end all the input is exactly consumed */
+		assert(pos == sample_count << SOUND_RESAMPLE_POS_BIT);
+
+		for(i=0;i<SOUND_RESAMPLE_TAPS;++i)
+			history[i] = buffer[sample_count + i];
 	}
+
+	free(buffer);
 }
 
 static void sound_play_recount(struct advance_sound_context* context, const short* sample_buffer, unsigned sample_count, unsigned sample_recount)
 {
 	unsigned output_channel = context->state.output_mode != SOUND_MODE_MONO ? 2 : 1;
 
-	if (sample_count != sample_recount) {
+	/* after the first resampling, continue to use the resampler to */
+	/* keep the same delay and avoid discontinuities */
+	if (sample_count != sample_recount || context->state.resample_flag) {
 		short* sample_re = (short*)malloc(sample_recount * context->state.output_bytes_per_sample);
 
+		context->state.resample_flag = 1;
+
 		sound_scale(context, output_channel, sample_buffer, sample_re, sample_count, sample_recount);
 
 		soundb_play(sample_re, sample_recount);
@@ -905,6 +1008,8 @@ static adv_error sound_mode_update(struct advance_sound_context* context)
 		}
 
 		soundb_start(0);
+
+		sound_resample_reset(context);
 	}
 
 	/* set the new output mode */
@@ -1152,6 +1257,9 @@ int osd2_sound_init(unsigned* sample_rate, int stereo_flag)
 
 	context->state.overflow = 0;
 
+	sound_resample_init(context);
+	sound_resample_reset(context);
+
 	soundb_start(context->config.latency_time);
 
 	sound_normalize_update(context);
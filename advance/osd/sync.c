@@ -39,6 +39,21 @@
 /** Max frameskip factor */
 #define SYNC_MAX 4
 
+/** Number of frames of the automatic frameskip cycle. */
+#define SYNC_PATTERN_MAX 12
+
+/** Extra time required to the prediction before displaying more frames. */
+#define SYNC_HYSTERESIS 0.05
+
+/** Fraction of the frame time always left free by the automatic frame delay. */
+#define DELAY_MARGIN 0.1
+
+/** Number of frames without increasing the automatic frame delay after a miss. */
+#define DELAY_HOLD 300
+
+/** Minimum number of measures before using the automatic frame delay. */
+#define DELAY_MEASURE_MIN 32
+
 /**
  * Update the skip state.
  * Recompute the skip counters from the config.frameskip_factor variable.
@@ -174,26 +189,30 @@ void advance_video_update_sync(struct advance_video_context* context)
 	}
 }
 
-static void video_time(struct advance_video_context* context, struct advance_estimate_context* estimate_context, double* full, double* skip)
+static double video_time_merge(struct advance_video_context* context, double mame, double osd, double sound, double common)
 {
+	double time;
+
 	if (context->config.smp_flag) {
 		/* if SMP is active the time estimation take care of it, */
 		/* the times are not added, but the max value is used */
-		*full = estimate_context->estimate_mame_full;
-		if (*full < estimate_context->estimate_osd_full)
-			*full = estimate_context->estimate_osd_full;
-		*skip = estimate_context->estimate_mame_skip;
-		if (*skip < estimate_context->estimate_osd_skip)
-			*skip = estimate_context->estimate_osd_skip;
+		time = mame;
+		if (time < osd + sound)
+			time = osd + sound;
 	} else {
 		/* standard time estimation */
-		*full = estimate_context->estimate_mame_full + estimate_context->estimate_osd_full;
-		*skip = estimate_context->estimate_mame_skip + estimate_context->estimate_osd_skip;
+		time = mame + osd + sound;
 	}
 
 	/* common time */
-	*full += estimate_context->estimate_common_full;
-	*skip += estimate_context->estimate_common_skip;
+	return time + common;
+}
+
+static void video_time(struct advance_video_context* context, struct advance_estimate_context* estimate_context, double* full, double* skip)
+{
+	/* use the predicted time of the next frame */
+	*full = video_time_merge(context, estimate_context->mame.full_predict, estimate_context->osd.full_predict, estimate_context->sound.full_predict, estimate_context->common.full_predict);
+	*skip = video_time_merge(context, estimate_context->mame.skip_predict, estimate_context->osd.skip_predict, estimate_context->sound.skip_predict, estimate_context->common.skip_predict);
 
 	/* correct errors, it may happen that skip is not measured and it contains an old value */
 	if (*full < *skip)
@@ -203,35 +222,70 @@ static void video_time(struct advance_video_context* context, struct advance_est
 /* Define to optimize for full CPU usage (reduce the wait time) instead of full speed */
 /* #define USE_FULLCPU */
 
+/**
+ * Number of frames to display in the automatic cycle.
+ * \param full Time of a full frame.
+ * \param skip Time of a skip frame.
+ * \param step Time available for one frame.
+ */
+static unsigned video_skip_pattern(double full, double skip, double step)
+{
+	double v;
+	unsigned level;
+
+	if (full < step)
+		return SYNC_PATTERN_MAX;
+
+	/* fraction of frames to display to use exactly the available time */
+	v = (step - skip) / (full - skip);
+
+#ifdef USE_FULLCPU
+	/* The use of ceil() instead of floor() generates a frame rate lower than 100% */
+	/* but it ensures to use all the CPU time */
+	level = ceil(v * SYNC_PATTERN_MAX);
+#else
+	level = floor(v * SYNC_PATTERN_MAX);
+#endif
+
+	/* max skip limit */
+	if (level < SYNC_PATTERN_MAX / SYNC_MAX)
+		level = SYNC_PATTERN_MAX / SYNC_MAX;
+	if (level > SYNC_PATTERN_MAX - 1)
+		level = SYNC_PATTERN_MAX - 1;
+
+	return level;
+}
+
 static void video_skip_recompute(struct advance_video_context* context, struct advance_estimate_context* estimate_context)
 {
 	/* frame time */
 	double step = context->state.skip_step;
 
-	/* time required to compute and draw a complete frame */
+	/* predicted time required to compute and draw a complete frame */
 	double full;
 
-	/* time required to compute a frame without displaying it */
+	/* predicted time required to compute a frame without displaying it */
 	double skip;
 
+	/* number of frames displayed in the current and in the new cycle */
+	unsigned current;
+	unsigned level;
+
 	video_time(context, estimate_context, &full, &skip);
 
-	log_debug(("advance:skip: step %g [sec]\n", step));
-	log_debug(("advance:skip: frame full %g [sec], frame skip %g [sec]\n", estimate_context->estimate_mame_full + estimate_context->estimate_osd_full, estimate_context->estimate_mame_skip + estimate_context->estimate_osd_skip));
-	log_debug(("advance:skip: mame_full %g [sec], mame_skip %g [sec], osd_full %g [sec], osd_skip %g [sec]\n", estimate_context->estimate_mame_full, estimate_context->estimate_mame_skip, estimate_context->estimate_osd_full, estimate_context->estimate_osd_skip));
-	log_debug(("advance:skip: common_full %g [sec], common_skip %g [sec]\n", estimate_context->estimate_common_full, estimate_context->estimate_common_skip));
-	log_debug(("advance:skip: full %g [sec], skip %g [sec]\n", full, skip));
+	context->state.skip_time_predict = full;
+	context->state.skip_time_last = video_time_merge(context, estimate_context->mame.full_last, estimate_context->osd.full_last, estimate_context->sound.full_last, estimate_context->common.full_last);
 
-	context->state.skip_level_disable_flag = 0;
+	log_debug(("advance:skip: step %g [sec]\n", step));
+	log_debug(("advance:skip: mame_full %g [sec], mame_skip %g [sec], osd_full %g [sec], osd_skip %g [sec], sound_full %g [sec], sound_skip %g [sec]\n", estimate_context->mame.full_predict, estimate_context->mame.skip_predict, estimate_context->osd.full_predict, estimate_context->osd.skip_predict, estimate_context->sound.full_predict, estimate_context->sound.skip_predict));
+	log_debug(("advance:skip: common_full %g [sec], common_skip %g [sec]\n", estimate_context->common.full_predict, estimate_context->common.skip_predict));
+	log_debug(("advance:skip: full %g [sec], skip %g [sec], last full %g [sec]\n", full, skip, context->state.skip_time_last));
 
 	assert(skip <= full);
 
-	if (full < step) {
-		/* full frame rate */
-		context->state.skip_level_full = SYNC_MAX;
-		context->state.skip_level_skip = 0;
-	} else if (skip >= step /* (this check is implicit on the next one) */
-		|| skip * SYNC_MAX + full >= step * (SYNC_MAX+1)
+	if (full >= step
+		&& (skip >= step /* (this check is implicit on the next one) */
+		|| skip * SYNC_MAX + full >= step * (SYNC_MAX+1))
 	) {
 		/* if the maximum skip plus one isn't enought use a special management */
 		/* (the plus one is to avoid to continously activate and deactivate skipping) */
@@ -239,6 +293,7 @@ static void video_skip_recompute(struct advance_video_context* context, struct a
 			/* null frame rate */
 			context->state.skip_level_full = 1;
 			context->state.skip_level_skip = SYNC_MAX - 1;
+			context->state.skip_level_disable_flag = 0;
 		} else {
 			/* mid frame rate, there isn't reason to skip, the correct speed is impossible */
 			/* the full frame rate isn't used to continue measuring the skip time */
@@ -246,59 +301,48 @@ static void video_skip_recompute(struct advance_video_context* context, struct a
 			context->state.skip_level_skip = 1;
 			context->state.skip_level_disable_flag = 1; /* signal the special condition */
 		}
+		context->state.skip_level_stable = 0;
+		return;
+	}
+
+	/* number of frames currently displayed in a cycle */
+	if (context->state.skip_level_disable_flag) {
+		/* exit immediately from the special condition */
+		current = 0;
+	} else if (context->state.skip_level_skip == 0) {
+		current = SYNC_PATTERN_MAX;
 	} else {
-		double full_lose_time = full - step; /* time lost drawing a full frame */
-		double skip_gain_time = step - skip; /* time recovered drawing a skip frame */
+		current = SYNC_PATTERN_MAX * context->state.skip_level_full / (context->state.skip_level_full + context->state.skip_level_skip);
+	}
 
-		assert(full_lose_time > 0);
-		assert(skip_gain_time > 0);
+	level = video_skip_pattern(full, skip, step);
 
-		if (skip_gain_time >= full_lose_time) {
-			/* compute the number of full frame witch can be draw */
-			/* for any skip frame */
-			double v = skip_gain_time / full_lose_time;
+	if (level > current && current != 0) {
+		/* display more frames only if there is some spare time, */
+		/* and after at least a complete cycle from the latest change */
+		level = video_skip_pattern(full * (1 + SYNC_HYSTERESIS), skip * (1 + SYNC_HYSTERESIS), step);
+		if (level <= current || context->state.skip_level_stable < SYNC_PATTERN_MAX)
+			level = current;
+	}
 
-			/* limit value before converting to int to prevent overflow */
-			if (v > SYNC_MAX)
-				v = SYNC_MAX;
+	if (level != current) {
+		/* skip more frames immediately, before getting late */
+		context->state.skip_level_stable = 0;
+		context->state.skip_level_disable_flag = 0;
 
-#ifdef USE_FULLCPU
-			/* The use of ceil() instead of floor() generates a frame rate lower than 100% */
-			/* but it ensures to use all the CPU time */
-			context->state.skip_level_full = ceil(v);
-#else
-			context->state.skip_level_full = floor(v);
-#endif
-			context->state.skip_level_skip = 1;
-
-			/* max skip limit */
-			if (context->state.skip_level_full >= SYNC_MAX)
-				context->state.skip_level_full = SYNC_MAX - 1;
+		if (level == SYNC_PATTERN_MAX) {
+			/* full frame rate */
+			context->state.skip_level_full = SYNC_MAX;
+			context->state.skip_level_skip = 0;
 		} else {
-			/* compute the number of skip frames required to */
-			/* recover the extra time of a full frame */
-			double v = full_lose_time / skip_gain_time;
-
-			/* limit value before converting to int to prevent overflow */
-			if (v > SYNC_MAX)
-				v = SYNC_MAX;
-
-			context->state.skip_level_full = 1;
-#ifdef USE_FULLCPU
-			/* The use of floor() instead of ceil() generates a frame rate lower than 100% */
-			/* but it ensures to use all the CPU time */
-			context->state.skip_level_skip = floor(v);
-#else
-			context->state.skip_level_skip = ceil(v);
-#endif
-
-			/* max skip limit */
-			if (context->state.skip_level_skip >= SYNC_MAX)
-				context->state.skip_level_skip = SYNC_MAX - 1;
+			context->state.skip_level_full = level;
+			context->state.skip_level_skip = SYNC_PATTERN_MAX - level;
 		}
-	}
 
-	log_debug(("advance:skip: cycle %d/%d\n", context->state.skip_level_full, context->state.skip_level_skip));
+		log_debug(("advance:skip: cycle %d/%d\n", context->state.skip_level_full, context->state.skip_level_skip));
+	} else {
+		++context->state.skip_level_stable;
+	}
 }
 
 static double video_frame_wait(double current, double expected)
@@ -314,6 +358,171 @@ static double video_frame_wait(double current, double expected)
 	return current;
 }
 
+/***************************************************************************/
+/* Frame delay */
+
+/**
+ * Check if the frame delay is used.
+ * The delay is used only if all the frames are displayed at the correct speed,
+ * and if the video update is done in the same thread.
+ * It isn't used if the vsync is done later with the page flip, because the
+ * time of the sync isn't known when the delay starts.
+ */
+adv_bool advance_video_delay_is_active(struct advance_video_context* context)
+{
+	return (context->config.delay_auto_flag || context->config.delay_time > 0)
+		&& context->state.sync_throttle_flag
+		&& !context->state.fastest_flag
+		&& !context->state.turbo_flag
+		&& !context->state.measure_flag
+		&& context->state.skip_level_skip == 0
+		&& !context->config.smp_flag
+		&& !(context->state.vsync_flag
+			&& (video_flags() & MODE_FLAGS_RETRACE_WAIT_SYNC) == 0
+			&& (video_flags() & (MODE_FLAGS_RETRACE_SCROLL_SYNC | MODE_FLAGS_RETRACE_WRITE_SYNC)) != 0);
+}
+
+/**
+ * Time between two syncronization points.
+ */
+static double video_frame_period(struct advance_video_context* context)
+{
+	if ((video_flags() & MODE_FLAGS_RETRACE_WAIT_SYNC) != 0
+		&& context->state.vsync_flag)
+		return 1.0 / context->state.mode_vclock;
+	else
+		return context->state.skip_step;
+}
+
+static int double_compare(const void* void_a, const void* void_b)
+{
+	double a = *(const double*)void_a;
+	double b = *(const double*)void_b;
+	if (a < b)
+		return -1;
+	if (a > b)
+		return 1;
+	return 0;
+}
+
+static void video_frame_delay_reset(struct advance_video_context* context)
+{
+	context->state.delay_mac = 0;
+	context->state.delay_count = 0;
+	context->state.delay_time = 0;
+	context->state.delay_last = 0;
+	context->state.delay_hold_counter = 0;
+}
+
+/**
+ * Recompute the automatic frame delay.
+ * The delay is the frame time not used by the 99th percentile of the
+ * emulation time measured after the delay, minus a safety margin.
+ * It's reduced immediately, but increased slowly.
+ */
+static void video_frame_delay_recompute(struct advance_video_context* context)
+{
+	double map[DELAY_MEASURE_MAX];
+	double period;
+	double worst;
+	double target;
+	unsigned count;
+
+	count = context->state.delay_count;
+	if (count < DELAY_MEASURE_MIN)
+		return;
+
+	memcpy(map, context->state.delay_map, count * sizeof(map[0]));
+	qsort(map, count, sizeof(map[0]), double_compare);
+
+	worst = map[count * 99 / 100];
+	period = video_frame_period(context);
+
+	target = period * (1 - DELAY_MARGIN) - worst;
+	if (target < 0)
+		target = 0;
+
+	if (target < context->state.delay_time) {
+		context->state.delay_time = target;
+	} else if (!context->state.delay_hold_counter) {
+		/* increase at most of 1/32 of frame at every recomputation */
+		if (target > context->state.delay_time + period / 32)
+			target = context->state.delay_time + period / 32;
+		context->state.delay_time = target;
+	}
+
+	log_debug(("advance:delay: p99 %g [sec], delay %g [sec]\n", worst, context->state.delay_time));
+}
+
+/**
+ * Store the emulation time of the latest frame.
+ * \param current Time of the syncronization request.
+ */
+static void video_frame_delay_measure(struct advance_video_context* context, double current)
+{
+	if (!advance_video_delay_is_active(context)
+		|| context->state.delay_last <= context->state.sync_last
+	) {
+		return;
+	}
+
+	context->state.delay_map[context->state.delay_mac] = current - context->state.delay_last;
+	++context->state.delay_mac;
+	if (context->state.delay_mac == DELAY_MEASURE_MAX)
+		context->state.delay_mac = 0;
+	if (context->state.delay_count < DELAY_MEASURE_MAX)
+		++context->state.delay_count;
+
+	if (context->state.delay_hold_counter)
+		--context->state.delay_hold_counter;
+
+	if (context->config.delay_auto_flag && context->state.delay_mac % 16 == 0)
+		video_frame_delay_recompute(context);
+}
+
+/**
+ * Back off the automatic frame delay after a missed syncronization.
+ */
+static void video_frame_delay_miss(struct advance_video_context* context)
+{
+	if (!context->config.delay_auto_flag
+		|| context->state.delay_time == 0
+		|| context->state.delay_last <= context->state.sync_last)
+		return;
+
+	context->state.delay_time /= 2;
+	context->state.delay_hold_counter = DELAY_HOLD;
+
+	log_std(("advance:delay: missed sync, delay reduced to %g [sec]\n", context->state.delay_time));
+}
+
+/**
+ * Wait the frame delay after the syncronization.
+ * It delays the start of the emulation of the next frame to
+ * read the input as late as possible.
+ */
+void advance_video_delay(struct advance_video_context* context)
+{
+	double current;
+	double expected;
+	double delay;
+
+	if (context->config.delay_auto_flag)
+		delay = context->state.delay_time;
+	else
+		delay = context->config.delay_time;
+
+	/* never wait more than the frame */
+	if (delay > video_frame_period(context) * (1 - DELAY_MARGIN))
+		delay = video_frame_period(context) * (1 - DELAY_MARGIN);
+
+	current = advance_timer();
+
+	expected = context->state.sync_last + delay;
+
+	context->state.delay_last = video_frame_wait(current, expected);
+}
+
 static void video_frame_sync(struct advance_video_context* context)
 {
 	double current;
@@ -332,14 +541,18 @@ static void video_frame_sync(struct advance_video_context* context)
 		context->state.sync_last = current;
 		context->state.sync_skip_counter = 0;
 
+		video_frame_delay_reset(context);
+
 		context->state.sync_warming_up_flag = 0;
 
 		log_debug(("advance:sync: throttle warming up\n"));
 	} else {
+		video_frame_delay_measure(context, current);
+
 		/* the vsync is used only if all the frames are displayed */
 		if ((video_flags() & MODE_FLAGS_RETRACE_WAIT_SYNC) != 0
 			&& context->state.vsync_flag
-			&& context->state.skip_level_full == SYNC_MAX
+			&& context->state.skip_level_skip == 0
 		) {
 			double limit;
 			double error;
@@ -367,6 +580,7 @@ static void video_frame_sync(struct advance_video_context* context)
 
 			if (error < -limit) {
 				log_std(("ERROR:advance:sync: wait %g too long. frame %g, reference %g (error %g)\n", current - begin, current - context->state.sync_last, 1.0 / context->state.mode_vclock, -error));
+				video_frame_delay_miss(context);
 			} else if (error > limit) {
 				log_std(("WARNING:advance:sync: wait %g too short. frame %g, reference %g (error %g)\n", current - begin, current - context->state.sync_last, 1.0 / context->state.mode_vclock, error));
 			}
@@ -378,7 +592,7 @@ static void video_frame_sync(struct advance_video_context* context)
 			context->state.sync_pivot = 0;
 		} else if ((video_flags() & (MODE_FLAGS_RETRACE_SCROLL_SYNC | MODE_FLAGS_RETRACE_WRITE_SYNC)) != 0
 			&& context->state.vsync_flag
-			&& context->state.skip_level_full == SYNC_MAX
+			&& context->state.skip_level_skip == 0
 		) {
 			/*
 			 * We do nothing here, as we are going to vsync later when updating.
@@ -401,6 +615,9 @@ static void video_frame_sync(struct advance_video_context* context)
 
 			current = video_frame_wait(current, expected);
 
+			if (current - expected > 0.06 * context->state.skip_step)
+				video_frame_delay_miss(context);
+
 			/* save the time of the latest sync */
 			context->state.sync_last = current;
 
@@ -467,6 +684,7 @@ static void video_frame_skip(struct advance_video_context* context, struct advan
 	if (context->state.skip_warming_up_flag) {
 		context->state.skip_flag = 0;
 		context->state.skip_level_counter = 0;
+		context->state.skip_level_stable = 0;
 
 		if (context->state.measure_flag) {
 			context->state.skip_step = 1.0 / context->state.game_fps;
@@ -490,20 +708,24 @@ static void video_frame_skip(struct advance_video_context* context, struct advan
 
 		log_debug(("advance:skip: throttle warming up\n"));
 	} else {
+		unsigned sum;
+
+		/* recompute the frameskip at every frame from the predicted time */
+		if (!context->state.fastest_flag
+			&& !context->state.measure_flag
+			&& (context->state.turbo_flag || context->config.frameskip_auto_flag)) {
+			video_skip_recompute(context, estimate_context);
+		}
+
 		/* compute if the next (not the current one) frame must be skipped */
-		context->state.skip_flag = context->state.skip_level_counter >= context->state.skip_level_full;
-
-		++context->state.skip_level_counter;
-		if (context->state.skip_level_counter >= context->state.skip_level_full + context->state.skip_level_skip) {
-			/* restart the full/skip sequence */
-			context->state.skip_level_counter = 0;
-
-			/* recompute the frameskip */
-			if (!context->state.fastest_flag
-				&& !context->state.measure_flag
-				&& (context->state.turbo_flag || context->config.frameskip_auto_flag)) {
-				video_skip_recompute(context, estimate_context);
-			}
+		/* spreading the skipped frames evenly in the cycle */
+		sum = context->state.skip_level_full + context->state.skip_level_skip;
+		context->state.skip_level_counter += context->state.skip_level_full;
+		if (context->state.skip_level_counter >= sum) {
+			context->state.skip_level_counter = (context->state.skip_level_counter - sum) % sum;
+			context->state.skip_flag = 0;
+		} else {
+			context->state.skip_flag = 1;
 		}
 
 		log_debug(("advance:skip: skip %d, frame %d/%d/%d\n", context->state.skip_flag, context->state.skip_level_counter, context->state.skip_level_full, context->state.skip_level_skip));
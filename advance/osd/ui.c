@@ -46,6 +46,71 @@ static inline adv_bool ui_alpha(adv_color_def color_def)
 	return color_def_type_get(color_def) == adv_color_type_rgb;
 }
 
+/**
+ * Allocate the bitmap of an user interface element.
+ * When rendering the layers, the bitmap of the same layer of the previous
+ * frame is reused if it has the same size.
+ */
+static adv_bitmap* ui_flat_alloc(struct advance_ui_context* context, unsigned size_x, unsigned size_y, adv_color_def def)
+{
+	unsigned bytes_per_pixel;
+
+	if (ui_alpha(def))
+		bytes_per_pixel = color_def_bytes_per_pixel_get(context->state.buffer_def);
+	else
+		bytes_per_pixel = color_def_bytes_per_pixel_get(def);
+
+	if (context->state.ui_layer_flag && context->state.ui_layer_mac < UI_LAYER_MAX) {
+		struct ui_layer* layer = &context->state.ui_layer_map[context->state.ui_layer_mac];
+
+		if (layer->flat
+			&& layer->flat->size_x == size_x
+			&& layer->flat->size_y == size_y
+			&& layer->flat->bytes_per_pixel == bytes_per_pixel)
+			return layer->flat;
+
+		adv_bitmap_free(layer->flat);
+		layer->flat = adv_bitmap_alloc(size_x, size_y, bytes_per_pixel);
+
+		return layer->flat;
+	}
+
+	return adv_bitmap_alloc(size_x, size_y, bytes_per_pixel);
+}
+
+/**
+ * Put an user interface element on the destination bitmap.
+ * When rendering the layers, the element is instead saved to be put later
+ * directly on the screen, and its bitmap is kept for the next frame.
+ * Otherwise the flat bitmap is freed.
+ */
+static void ui_flat_put(struct advance_ui_context* context, adv_bitmap* dst, int pos_x, int pos_y, adv_bitmap* flat, adv_color_def def)
+{
+	if (context->state.ui_layer_flag) {
+		struct ui_layer* layer;
+
+		if (context->state.ui_layer_mac == UI_LAYER_MAX) {
+			log_std(("ERROR:emu:ui: too many layers\n"));
+			adv_bitmap_free(flat);
+			return;
+		}
+
+		/* the bitmap is already in the layer, allocated by ui_flat_alloc() */
+		layer = &context->state.ui_layer_map[context->state.ui_layer_mac++];
+		layer->x = pos_x;
+		layer->y = pos_y;
+		layer->def = def;
+		return;
+	}
+
+	if (ui_alpha(def))
+		adv_bitmap_put_alpha(dst, pos_x, pos_y, def, flat, 0, 0, flat->size_x, flat->size_y, context->state.buffer_def);
+	else
+		adv_bitmap_put(dst, pos_x, pos_y, flat, 0, 0, flat->size_x, flat->size_y);
+
+	adv_bitmap_free(flat);
+}
+
 static void ui_text_center(struct advance_ui_context* context, adv_bitmap* dst, int x, int y, const char* begin, const char* end, struct ui_color cf, struct ui_color cb, adv_pixel* map, adv_color_def def)
 {
 	int size_x;
@@ -265,10 +330,7 @@ static void ui_menu(struct advance_ui_context* context, adv_bitmap* dst, struct
 	pos_x = dst->size_x / 2 - size_x / 2;
 	pos_y = dst->size_y / 2 - size_y / 2;
 
-	if (ui_alpha(def))
-		flat = adv_bitmap_alloc(size_x, size_y, color_def_bytes_per_pixel_get(context->state.buffer_def));
-	else
-		flat = adv_bitmap_alloc(size_x, size_y, color_def_bytes_per_pixel_get(def));
+	flat = ui_flat_alloc(context, size_x, size_y, def);
 
 	/* put */
 	adv_bitmap_box(flat, 0, 0, size_x, size_y, 1, entry_f.f);
@@ -338,12 +400,7 @@ static void ui_menu(struct advance_ui_context* context, adv_bitmap* dst, struct
 		y += height;
 	}
 
-	if (ui_alpha(def))
-		adv_bitmap_put_alpha(dst, pos_x, pos_y, def, flat, 0, 0, flat->size_x, flat->size_y, context->state.buffer_def);
-	else
-		adv_bitmap_put(dst, pos_x, pos_y, flat, 0, 0, flat->size_x, flat->size_y);
-
-	adv_bitmap_free(flat);
+	ui_flat_put(context, dst, pos_x, pos_y, flat, def);
 }
 
 static adv_bool ui_recognize_title(const char* begin, const char* end)
@@ -461,10 +518,7 @@ static void ui_scroll(struct advance_ui_context* context, adv_bitmap* dst, char*
 	pos_x = dst->size_x / 2 - size_x / 2;
 	pos_y = dst->size_y / 2 - size_y / 2;
 
-	if (ui_alpha(def))
-		flat = adv_bitmap_alloc(size_x, size_y, color_def_bytes_per_pixel_get(context->state.buffer_def));
-	else
-		flat = adv_bitmap_alloc(size_x, size_y, color_def_bytes_per_pixel_get(def));
+	flat = ui_flat_alloc(context, size_x, size_y, def);
 
 	/* put */
 	adv_bitmap_box(flat, 0, 0, size_x, size_y, 1, text_f.f);
@@ -507,12 +561,7 @@ static void ui_scroll(struct advance_ui_context* context, adv_bitmap* dst, char*
 		++n;
 	}
 
-	if (ui_alpha(def))
-		adv_bitmap_put_alpha(dst, pos_x, pos_y, def, flat, 0, 0, flat->size_x, flat->size_y, context->state.buffer_def);
-	else
-		adv_bitmap_put(dst, pos_x, pos_y, flat, 0, 0, flat->size_x, flat->size_y);
-
-	adv_bitmap_free(flat);
+	ui_flat_put(context, dst, pos_x, pos_y, flat, def);
 }
 
 static void ui_messagebox_center(struct advance_ui_context* context, adv_bitmap* dst, int x, int y, const char* begin, const char* end, struct ui_color cf, struct ui_color cb, adv_pixel* map, adv_color_def def)
@@ -533,10 +582,7 @@ static void ui_messagebox_center(struct advance_ui_context* context, adv_bitmap*
 	pos_x = x - size_x / 2;
 	pos_y = y - size_y / 2;
 
-	if (ui_alpha(def))
-		flat = adv_bitmap_alloc(size_x, size_y, color_def_bytes_per_pixel_get(context->state.buffer_def));
-	else
-		flat = adv_bitmap_alloc(size_x, size_y, color_def_bytes_per_pixel_get(def));
+	flat = ui_flat_alloc(context, size_x, size_y, def);
 
 	adv_bitmap_box(flat, 0, 0, size_x, size_y, 1, cf.f);
 	adv_bitmap_clear(flat, 1, 1, size_x - 2, size_y - 2, cb.b);
@@ -546,12 +592,7 @@ static void ui_messagebox_center(struct advance_ui_context* context, adv_bitmap*
 	else
 		adv_font_put_string(context->state.ui_font, flat, border_x, border_y, begin, end, cf.p, cb.p);
 
-	if (ui_alpha(def))
-		adv_bitmap_put_alpha(dst, pos_x, pos_y, def, flat, 0, 0, flat->size_x, flat->size_y, context->state.buffer_def);
-	else
-		adv_bitmap_put(dst, pos_x, pos_y, flat, 0, 0, flat->size_x, flat->size_y);
-
-	adv_bitmap_free(flat);
+	ui_flat_put(context, dst, pos_x, pos_y, flat, def);
 }
 
 /**************************************************************************/
@@ -832,10 +873,7 @@ static void ui_help_update(struct advance_ui_context* context, adv_bitmap* dst,
 	pos_x = dst->size_x / 2 - size_x / 2;
 	pos_y = dst->size_y / 8;
 
-	if (ui_alpha(def))
-		flat = adv_bitmap_alloc(size_x, size_y, color_def_bytes_per_pixel_get(context->state.buffer_def));
-	else
-		flat = adv_bitmap_alloc(size_x, size_y, color_def_bytes_per_pixel_get(def));
+	flat = ui_flat_alloc(context, size_x, size_y, def);
 
 	pb = 0; /* black on RGB format */
 
@@ -910,12 +948,7 @@ static void ui_help_update(struct advance_ui_context* context, adv_bitmap* dst,
 		}
 	}
 
-	if (ui_alpha(def))
-		adv_bitmap_put_alpha(dst, pos_x, pos_y, def, flat, 0, 0, flat->size_x, flat->size_y, context->state.buffer_def);
-	else
-		adv_bitmap_put(dst, pos_x, pos_y, flat, 0, 0, flat->size_x, flat->size_y);
-
-	adv_bitmap_free(flat);
+	ui_flat_put(context, dst, pos_x, pos_y, flat, def);
 
 	if (msg_buffer[0])
 		ui_messagebox_center(context, dst, dst->size_x / 2, pos_y + size_y + adv_font_sizey(context->state.ui_font) * 2, msg_buffer, msg_buffer + strlen(msg_buffer), color->ui_f, color->ui_b, color->ui_alpha, color->def);
@@ -1185,15 +1218,8 @@ static void ui_setup_color(struct advance_ui_context* context, struct ui_color_s
 	color->def = color_def;
 }
 
-void advance_ui_buffer_update(struct advance_ui_context* context, void* ptr, unsigned dx, unsigned dy, unsigned dw, adv_color_def color_def, adv_color_rgb* palette_map, unsigned palette_max)
+static void ui_buffer_draw(struct advance_ui_context* context, adv_bitmap* dst, struct ui_color_set* color)
 {
-	adv_bitmap* dst;
-	struct ui_color_set* color = &context->state.color_map;
-
-	ui_setup_color(context, color, color_def, palette_map, palette_max);
-
-	dst = adv_bitmap_import_rgb(dx, dy, color_def_bytes_per_pixel_get(color_def), 0, 0, ptr, dw);
-
 	context->state.ui_extra_flag = 0;
 
 	if (context->state.ui_help_flag) {
@@ -1216,10 +1242,98 @@ void advance_ui_buffer_update(struct advance_ui_context* context, void* ptr, uns
 		ui_scroll_update(context, dst, color);
 		context->state.ui_extra_flag = 1;
 	}
+}
+
+void advance_ui_buffer_update(struct advance_ui_context* context, void* ptr, unsigned dx, unsigned dy, unsigned dw, adv_color_def color_def, adv_color_rgb* palette_map, unsigned palette_max)
+{
+	adv_bitmap* dst;
+	struct ui_color_set* color = &context->state.color_map;
+
+	ui_setup_color(context, color, color_def, palette_map, palette_max);
+
+	dst = adv_bitmap_import_rgb(dx, dy, color_def_bytes_per_pixel_get(color_def), 0, 0, ptr, dw);
+
+	ui_buffer_draw(context, dst, color);
 
 	adv_bitmap_free(dst);
 }
 
+/**
+ * Render the user interface as a set of layers.
+ * Instead of drawing on a buffer containing the game image, every element
+ * of the interface is kept in its own small bitmap, to be put directly
+ * on the screen with advance_ui_layer_put() after the game image.
+ * \param dx, dy Size of the screen.
+ * \param color_def Color format of the screen.
+ * \return Number of layers.
+ */
+unsigned advance_ui_layer_update(struct advance_ui_context* context, unsigned dx, unsigned dy, adv_color_def color_def, adv_color_rgb* palette_map, unsigned palette_max)
+{
+	adv_bitmap dst;
+	struct ui_color_set* color = &context->state.color_map;
+
+	/* the bitmaps of the previous frame are reused */
+	context->state.ui_layer_mac = 0;
+
+	ui_setup_color(context, color, color_def, palette_map, palette_max);
+
+	/* the bitmap is used only for its size, nothing is drawn on it */
+	memset(&dst, 0, sizeof(dst));
+	dst.size_x = dx;
+	dst.size_y = dy;
+	dst.bytes_per_pixel = color_def_bytes_per_pixel_get(color_def);
+
+	context->state.ui_layer_flag = 1;
+	ui_buffer_draw(context, &dst, color);
+	context->state.ui_layer_flag = 0;
+
+	return context->state.ui_layer_mac;
+}
+
+/**
+ * Get the screen area of a layer.
+ */
+void advance_ui_layer_get(struct advance_ui_context* context, unsigned i, int* x, int* y, unsigned* dx, unsigned* dy)
+{
+	struct ui_layer* layer = &context->state.ui_layer_map[i];
+
+	*x = layer->x;
+	*y = layer->y;
+	*dx = layer->flat->size_x;
+	*dy = layer->flat->size_y;
+}
+
+/**
+ * Put a layer on a copy of a screen area.
+ * \param dst Copy of the screen area.
+ * \param x, y Screen position of the copy.
+ */
+void advance_ui_layer_put(struct advance_ui_context* context, unsigned i, adv_bitmap* dst, int x, int y)
+{
+	struct ui_layer* layer = &context->state.ui_layer_map[i];
+	adv_bitmap* flat = layer->flat;
+
+	if (ui_alpha(layer->def))
+		adv_bitmap_put_alpha(dst, layer->x - x, layer->y - y, layer->def, flat, 0, 0, flat->size_x, flat->size_y, context->state.buffer_def);
+	else
+		adv_bitmap_put(dst, layer->x - x, layer->y - y, flat, 0, 0, flat->size_x, flat->size_y);
+}
+
+/**
+ * Free all the layers and their bitmaps.
+ */
+void advance_ui_layer_free(struct advance_ui_context* context)
+{
+	unsigned i;
+
+	for(i=0;i<UI_LAYER_MAX;++i) {
+		adv_bitmap_free(context->state.ui_layer_map[i].flat);
+		context->state.ui_layer_map[i].flat = 0;
+	}
+
+	context->state.ui_layer_mac = 0;
+}
+
 void advance_ui_direct_update(struct advance_ui_context* context, void* ptr, unsigned dx, unsigned dy, unsigned dw, adv_color_def color_def, adv_color_rgb* palette_map, unsigned palette_max)
 {
 	adv_bitmap* dst;
@@ -1249,7 +1363,13 @@ void advance_ui_direct_update(struct advance_ui_context* context, void* ptr, uns
 
 adv_error advance_ui_init(struct advance_ui_context* context, adv_conf* cfg_context)
 {
+	unsigned i;
+
 	context->state.ui_extra_flag = 0;
+	context->state.ui_layer_flag = 0;
+	context->state.ui_layer_mac = 0;
+	for(i=0;i<UI_LAYER_MAX;++i)
+		context->state.ui_layer_map[i].flat = 0;
 	context->state.ui_message_flag = 0;
 	context->state.ui_help_flag = 0;
 	context->state.ui_menu_map = 0;
@@ -1568,6 +1688,8 @@ adv_error advance_ui_inner_init(struct advance_ui_context* context, adv_conf* cf
 
 void advance_ui_inner_done(struct advance_ui_context* context)
 {
+	advance_ui_layer_free(context);
+
 	adv_font_free(context->state.ui_font);
 	context->state.ui_font = 0;
 	adv_font_free(context->state.ui_font_oriented);
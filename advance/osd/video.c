@@ -201,6 +201,131 @@ static void video_command_pan(struct advance_video_context* context, unsigned in
 	}
 }
 
+/**
+ * Name of the effects used with the automatic selection.
+ */
+static const char* video_combine_name(int combine)
+{
+	switch (combine) {
+	case COMBINE_XBR : return "xbr";
+	case COMBINE_SCALEK : return "scalek";
+	case COMBINE_SCALEX : return "scalex";
+	default: return "none";
+	}
+}
+
+/**
+ * Effect to use when the specified one is too slow.
+ */
+static int video_combine_decrease(int combine)
+{
+	switch (combine) {
+	case COMBINE_XBR : return COMBINE_SCALEK;
+	case COMBINE_SCALEK : return COMBINE_SCALEX;
+	default: return COMBINE_NONE;
+	}
+}
+
+/**
+ * Default maximum effect for the automatic selection.
+ */
+static int video_combine_max_default(struct advance_video_context* context)
+{
+	/* if the effect is measured, start always from the best */
+	if (context->config.combine_budget != 0)
+		return COMBINE_XBR;
+
+	/* on Intel assume a fast machine */
+#if defined(__i386__) || defined(__x86_64__)
+	return COMBINE_XBR;
+#else
+	return COMBINE_SCALEK;
+#endif
+}
+
+static void video_reconfigure_combine(struct advance_video_context* context, int combine_max, adv_bool cache_flag)
+{
+	struct advance_video_config_context config = context->config;
+
+	config.combine_max = combine_max;
+	config.combine_cache_flag = cache_flag;
+
+	/* reconfigure */
+	advance_video_reconfigure(context, &config);
+
+	/* restart counting */
+	context->state.skip_level_combine_counter = 0;
+	context->state.skip_level_combine_total = 0;
+}
+
+/**
+ * Check the automatic effect with the time budget.
+ * Called after every measure of the blit pipeline. If the blit of
+ * the effect takes more than the allowed share of the frame time
+ * a simpler effect is selected, and measured again.
+ * The accepted effect is saved for the game and the video mode size.
+ */
+static void video_command_budget(struct advance_video_context* context, adv_conf* cfg_context)
+{
+	double frame;
+	double pipeline;
+	char buffer[64];
+
+	if (!context->state.combine_budget_flag)
+		return;
+
+	context->state.combine_budget_flag = 0;
+
+	if (context->config.combine != COMBINE_AUTO
+		|| context->config.combine_budget == 0
+		|| context->state.combine != context->config.combine_max /* the effect doesn't depend on combine_max */
+	)
+		return;
+
+	/* if the saved effect is for another video mode, restart from the best one */
+	if (context->config.combine_cache_flag
+		&& (context->config.combine_cache_size_x != context->state.mode_visible_size_x
+			|| context->config.combine_cache_size_y != context->state.mode_visible_size_y)
+	) {
+		log_std(("advance:skip: ignore saved combine %s for %ux%u\n", video_combine_name(context->config.combine_max), context->config.combine_cache_size_x, context->config.combine_cache_size_y));
+		video_reconfigure_combine(context, video_combine_max_default(context), 0);
+		return;
+	}
+
+	if (context->state.vsync_flag) {
+		frame = 1.0 / context->state.mode_vclock;
+	} else {
+		frame = 1.0 / context->state.game_fps;
+	}
+
+	pipeline = context->state.pipeline_measure_result[context->state.blit_pipeline_index] / TARGET_CLOCKS_PER_SEC;
+
+	log_std(("advance:skip: combine %s pipeline:%g frame:%g budget:%u%%\n", video_combine_name(context->config.combine_max), pipeline, frame, context->config.combine_budget));
+
+	if (context->config.combine_max != COMBINE_NONE
+		&& pipeline > frame * context->config.combine_budget / 100
+	) {
+		int combine_max = video_combine_decrease(context->config.combine_max);
+
+		log_std(("advance:skip: decrease combine from %s to %s for the budget\n", video_combine_name(context->config.combine_max), video_combine_name(combine_max)));
+
+		video_reconfigure_combine(context, combine_max, 0);
+		return;
+	}
+
+	/* save the effect only if changed */
+	if (context->config.combine_cache_flag)
+		return;
+
+	context->config.combine_cache_flag = 1;
+	context->config.combine_cache_size_x = context->state.mode_visible_size_x;
+	context->config.combine_cache_size_y = context->state.mode_visible_size_y;
+
+	snprintf(buffer, sizeof(buffer), "%ux%u %s", context->config.combine_cache_size_x, context->config.combine_cache_size_y, video_combine_name(context->config.combine_max));
+
+	conf_string_set(cfg_context, context->config.section_name_buffer, "display_effectcache", buffer);
+}
+
 static void video_command_combine(struct advance_video_context* context, struct advance_ui_context* ui_context, adv_bool skip_flag)
 {
 	adv_bool decrease = 0;
@@ -239,7 +364,7 @@ static void video_command_combine(struct advance_video_context* context, struct
 			frame = 1.0 / context->state.game_fps;
 		}
 
-		pipeline = adv_measure_mean(0.00001, 0.5, context->state.pipeline_timing_map, PIPELINE_MEASURE_MAX);
+		pipeline = adv_measure_mean(0.00001, 0.5, context->state.pipeline_timing_map, PIPELINE_MEASURE_MAX) / TARGET_CLOCKS_PER_SEC;
 		update = context->state.update_timing_min / TARGET_CLOCKS_PER_SEC;
 
 		if (pipeline + update > frame) {
@@ -266,40 +391,17 @@ static void video_command_combine(struct advance_video_context* context, struct
 		}
 	}
 
-	if (decrease) {
-		unsigned combine_max = context->config.combine_max;
-
-		/* use a simpler video video effect */
-		if (context->config.combine == COMBINE_AUTO) {
-			switch (combine_max) {
-			case COMBINE_SCALEX :
-				combine_max = COMBINE_NONE;
-				log_std(("advance:skip: decrease combine from scalex to none\n"));
-				break;
-			case COMBINE_SCALEK :
-				combine_max = COMBINE_SCALEX;
-				log_std(("advance:skip: decrease combine from scalek to scalex\n"));
-				break;
-			case COMBINE_XBR :
-				combine_max = COMBINE_SCALEK;
-				log_std(("advance:skip: decrease combine from xbr to scalek\n"));
-				break;
-			}
-		}
-
-		/* if something changed */
-		if (context->config.combine_max != combine_max) {
-			struct advance_video_config_context config = context->config;
-
-			config.combine_max = combine_max;
+	/* use a simpler video video effect */
+	if (decrease
+		&& context->config.combine == COMBINE_AUTO
+		&& context->config.combine_max != COMBINE_NONE
+	) {
+		int combine_max = video_combine_decrease(context->config.combine_max);
 
-			/* reconfigure */
-			advance_video_reconfigure(context, &config);
+		log_std(("advance:skip: decrease combine from %s to %s\n", video_combine_name(context->config.combine_max), video_combine_name(combine_max)));
 
-			/* restart counting */
-			context->state.skip_level_combine_counter = 0;
-			context->state.skip_level_combine_total = 0;
-		}
+		/* the new effect is saved after the next measure */
+		video_reconfigure_combine(context, combine_max, 0);
 	}
 }
 
@@ -441,6 +543,26 @@ static void video_command(struct advance_video_context* context, struct advance_
 		}
 	}
 
+	if (context->config.runahead_auto_flag && !context->state.runahead_saved_flag) {
+		unsigned frames;
+		double time;
+		int lag = mame_ui_runahead(&frames, &time);
+
+		/* save the measured lag, the next run starts directly with it */
+		if (lag >= 0) {
+			context->state.runahead_saved_flag = 1;
+			if (lag > 0) {
+				char buffer[32];
+				snprintf(buffer, sizeof(buffer), "%d", lag);
+				conf_string_set(cfg_context, context->config.section_name_buffer, "misc_runahead", buffer);
+				advance_global_message(&CONTEXT.global, "Run-ahead of %d frames saved", lag);
+			} else {
+				conf_string_set(cfg_context, context->config.section_name_buffer, "misc_runahead", "none");
+				advance_global_message(&CONTEXT.global, "Run-ahead not required");
+			}
+		}
+	}
+
 	advance_ui_direct_fast(ui_context, context->state.fastest_flag || context->state.turbo_flag);
 
 	advance_ui_direct_slow(ui_context, context->state.skip_level_disable_flag);
@@ -485,7 +607,30 @@ static void video_command(struct advance_video_context* context, struct advance_
 		if (l>=11 && isspace(buffer[l-11]))
 			buffer[l-11] = ADV_FONT_FIXSPACE;
 
-		advance_ui_direct_text(ui_context, buffer);
+		{
+			char text[256];
+			unsigned runahead_frames;
+			double runahead_time;
+
+			sncpy(text, sizeof(text), buffer);
+
+			/* predicted and measured time of the latest displayed frame */
+			if (context->state.sync_throttle_flag
+				&& !context->state.fastest_flag
+				&& (context->state.turbo_flag || context->config.frameskip_auto_flag)) {
+				l = strlen(text);
+				snprintf(text + l, sizeof(text) - l, " %4.1f/%4.1fms", context->state.skip_time_predict * 1000, context->state.skip_time_last * 1000);
+			}
+
+			/* frames emulated ahead and their time */
+			mame_ui_runahead(&runahead_frames, &runahead_time);
+			if (runahead_frames != 0) {
+				l = strlen(text);
+				snprintf(text + l, sizeof(text) - l, " ra %u/%4.1fms", runahead_frames, runahead_time * 1000);
+			}
+
+			advance_ui_direct_text(ui_context, text);
+		}
 
 		hardware_script_info(0, 0, 0, buffer);
 	} else {
@@ -504,6 +649,8 @@ static void video_command(struct advance_video_context* context, struct advance_
 	video_command_pan(context, input);
 
 	video_command_combine(context, ui_context, skip_flag);
+
+	video_command_budget(context, cfg_context);
 }
 
 /***************************************************************************/
@@ -560,11 +707,15 @@ static void video_frame_update_now(struct advance_video_context* context, struct
 	/* update the video for the new frame */
 	advance_video_frame(context, record_context, ui_context, game, debug, debug_palette, debug_palette_size, skip_flag);
 
+	/* estimate the time */
+	advance_estimate_osd_end(estimate_context, skip_flag);
+	advance_estimate_sound_begin(estimate_context);
+
 	/* update the audio buffer for the new frame */
 	advance_sound_frame(sound_context, record_context, context, safequit_context, sample_buffer, sample_count, sample_recount, context->config.rawsound_flag || video_is_normal_speed(context));
 
 	/* estimate the time */
-	advance_estimate_osd_end(estimate_context, skip_flag);
+	advance_estimate_sound_end(estimate_context, skip_flag);
 
 	/* stop updating, this may include a vsync and it's out of the time estimation */
 	video_frame_stop(context);
@@ -1165,6 +1316,9 @@ static int int_compare(const void* void_a, const void* void_b)
 /** Number of frames on which distribute the latency error. */
 #define AUDIOVIDEO_DISTRIBUTE_COUNT 4
 
+/** Maximum rate change for small latency errors with the internal resampler, as divisor of the number of samples. */
+#define AUDIOVIDEO_RATE_DIVISOR 64
+
 int osd2_frame(const struct osd_bitmap* game, const struct osd_bitmap* debug, const osd_rgb_t* debug_palette, unsigned debug_palette_size, unsigned led, unsigned input, const short* sample_buffer, unsigned sample_count, unsigned knocker)
 {
 	struct advance_video_context* context = &CONTEXT.video;
@@ -1178,6 +1332,9 @@ int osd2_frame(const struct osd_bitmap* game, const struct osd_bitmap* debug, co
 	/* effective number of sound samples to output */
 	int sample_recount;
 
+	/* if the frame delay is active */
+	adv_bool delay_flag;
+
 	unsigned i;
 	int sample_limit;
 	int latency_limit;
@@ -1213,7 +1370,18 @@ int osd2_frame(const struct osd_bitmap* game, const struct osd_bitmap* debug, co
 		latency_median = median_map[AUDIOVIDEO_MEASURE_MAX/2];
 
 		/* if playing at normal speed */
-		if (latency_median >= -latency_limit && latency_median <= latency_limit) {
+		if (context->config.internalresample_flag && latency_median >= -latency_limit && latency_median <= latency_limit) {
+			/* the internal resampler changes the rate without artifacts, */
+			/* so the error is corrected continuously, limiting only the */
+			/* maximum rate change to keep the pitch stable */
+			int rate_limit = sample_count / AUDIOVIDEO_RATE_DIVISOR + 1;
+
+			latency_diff = latency_median / AUDIOVIDEO_DISTRIBUTE_COUNT;
+			if (latency_diff > rate_limit)
+				latency_diff = rate_limit;
+			if (latency_diff < -rate_limit)
+				latency_diff = -rate_limit;
+		} else if (latency_median >= -latency_limit && latency_median <= latency_limit) {
 			/* if the error is small (in the latency_limit), use a small correction */
 			latency_diff = latency_median / (latency_limit / AUDIOVIDEO_NEAR_STEP_COUNT);
 		} else if (latency_median > latency_limit) {
@@ -1271,7 +1439,11 @@ int osd2_frame(const struct osd_bitmap* game, const struct osd_bitmap* debug, co
 	/* update the global info */
 	video_command(&CONTEXT.video, &CONTEXT.estimate, &CONTEXT.safequit, &CONTEXT.ui, CONTEXT.cfg, led, input, skip_flag, knocker);
 	advance_video_skip(&CONTEXT.video, &CONTEXT.estimate, &CONTEXT.record);
-	advance_input_update(&CONTEXT.input, &CONTEXT.safequit, CONTEXT.video.state.pause_flag);
+
+	/* with the frame delay the input is read after the delay */
+	delay_flag = advance_video_delay_is_active(&CONTEXT.video);
+	if (!delay_flag)
+		advance_input_update(&CONTEXT.input, &CONTEXT.safequit, CONTEXT.video.state.pause_flag);
 
 	/* estimate the time */
 	advance_estimate_frame(&CONTEXT.estimate);
@@ -1283,6 +1455,12 @@ int osd2_frame(const struct osd_bitmap* game, const struct osd_bitmap* debug, co
 	/* update the local info */
 	video_frame_update(&CONTEXT.video, &CONTEXT.sound, &CONTEXT.estimate, &CONTEXT.record, &CONTEXT.ui, &CONTEXT.safequit, game, debug, debug_palette, debug_palette_size, led, input, sample_buffer, sample_count, sample_recount, skip_flag);
 
+	if (delay_flag) {
+		/* delay the emulation of the next frame, and read the input just before it */
+		advance_video_delay(&CONTEXT.video);
+		advance_input_update(&CONTEXT.input, &CONTEXT.safequit, CONTEXT.video.state.pause_flag);
+	}
+
 	/* estimate the time */
 	advance_estimate_mame_begin(&CONTEXT.estimate);
 
@@ -1424,6 +1602,8 @@ adv_error advance_video_init(struct advance_video_context* context, adv_conf* cf
 	conf_bool_register_default(cfg_context, "display_flipx", 0);
 	conf_bool_register_default(cfg_context, "display_flipy", 0);
 	conf_int_register_enum_default(cfg_context, "display_resizeeffect", conf_enum(OPTION_RESIZEEFFECT), COMBINE_AUTO);
+	conf_int_register_limit_default(cfg_context, "display_effectbudget", 0, 100, 50);
+	conf_string_register_default(cfg_context, "display_effectcache", "none");
 	conf_int_register_enum_default(cfg_context, "display_rgbeffect", conf_enum(OPTION_RGBEFFECT), EFFECT_NONE);
 	conf_int_register_enum_default(cfg_context, "display_interlaceeffect", conf_enum(OPTION_INTERLACEEFFECT), EFFECT_NONE);
 	conf_string_register_default(cfg_context, "sync_fps", "auto");
@@ -1432,6 +1612,7 @@ adv_error advance_video_init(struct advance_video_context* context, adv_conf* cf
 	conf_bool_register_default(cfg_context, "debug_crash", 0);
 	conf_bool_register_default(cfg_context, "debug_rawsound", 0);
 	conf_string_register_default(cfg_context, "sync_startuptime", "auto");
+	conf_string_register_default(cfg_context, "sync_framedelay", "none");
 	conf_int_register_limit_default(cfg_context, "misc_timetorun", 0, 3600, 0);
 	conf_string_register_default(cfg_context, "display_mode", "auto");
 	conf_int_register_enum_default(cfg_context, "display_color", conf_enum(OPTION_INDEX), 0);
@@ -1600,12 +1781,28 @@ adv_error advance_video_config_load(struct advance_video_context* context, adv_c
 	log_std(("emu:video: orientation ui   %04x\n", option->ui_orientation));
 
 	context->config.combine = conf_int_get_default(cfg_context, "display_resizeeffect");
-	/* on Intel assume a fast machine */
-#if defined(__i386__) || defined(__x86_64__)
-	context->config.combine_max = COMBINE_XBR;
-#else
-	context->config.combine_max = COMBINE_SCALEK;
-#endif
+	context->config.combine_budget = conf_int_get_default(cfg_context, "display_effectbudget");
+	context->config.combine_max = video_combine_max_default(context);
+	context->config.combine_cache_flag = 0;
+	context->config.combine_cache_size_x = 0;
+	context->config.combine_cache_size_y = 0;
+	if (context->config.combine_budget != 0) {
+		unsigned size_x, size_y;
+		char name[16];
+
+		/* effect already selected for this game */
+		s = conf_string_get_default(cfg_context, "display_effectcache");
+		if (sscanf(s, "%ux%u %15s", &size_x, &size_y, name) == 3) {
+			int combine_max = COMBINE_XBR;
+			while (combine_max != COMBINE_NONE && strcmp(name, video_combine_name(combine_max)) != 0)
+				combine_max = video_combine_decrease(combine_max);
+			context->config.combine_max = combine_max;
+			context->config.combine_cache_flag = 1;
+			context->config.combine_cache_size_x = size_x;
+			context->config.combine_cache_size_y = size_y;
+			log_std(("emu:video: saved combine %s for %ux%u\n", video_combine_name(combine_max), size_x, size_y));
+		}
+	}
 	context->config.rgb_effect = conf_int_get_default(cfg_context, "display_rgbeffect");
 	context->config.interlace_effect = conf_int_get_default(cfg_context, "display_interlaceeffect");
 	context->config.turbo_speed_factor = conf_float_get_default(cfg_context, "sync_turbospeed");
@@ -1642,6 +1839,25 @@ adv_error advance_video_config_load(struct advance_video_context* context, adv_c
 		}
 	}
 	context->config.fastest_time = d;
+
+	s = conf_string_get_default(cfg_context, "sync_framedelay");
+	if (strcmp(s, "none") == 0) {
+		context->config.delay_auto_flag = 0;
+		context->config.delay_time = 0;
+	} else if (strcmp(s, "auto") == 0) {
+		context->config.delay_auto_flag = 1;
+		context->config.delay_time = 0;
+	} else {
+		char* e;
+		d = strtod(s, &e);
+		if (*e != 0 || d < 0 || d > 0.1) {
+			target_err("Invalid argument '%s' for option 'sync_framedelay'.\n", s);
+			return -1;
+		}
+		context->config.delay_auto_flag = 0;
+		context->config.delay_time = d;
+	}
+
 	context->config.measure_time = conf_int_get_default(cfg_context, "misc_timetorun");
 	context->config.crash_flag = conf_bool_get_default(cfg_context, "debug_crash");
 	context->config.rawsound_flag = conf_bool_get_default(cfg_context, "debug_rawsound");
@@ -1760,6 +1976,9 @@ adv_error advance_video_inner_init(struct advance_video_context* context, struct
 
 	advance_video_mode_preinit(context, option);
 
+	context->config.runahead_auto_flag = option->runahead < 0;
+	context->state.runahead_saved_flag = 0;
+
 	return 0;
 }
 
@@ -22,10 +22,21 @@
 #define SAMPLES_PER_BLOCK		0x40000
 #define CASSETTE_FLAG_DIRTY		0x10000
 
+/* maximum number of blocks expanded from a legacy waveform kept in memory */
+#define LEGACY_RESIDENT_BLOCKS	8
+
+/* the block is expanded from the legacy waveform and can be discarded */
+#define BLOCK_FLAG_LEGACY		0x01
+
+/* size of the reads of the image converted by the legacy code */
+#define LEGACY_READ_SIZE		0x10000
+
 struct sample_block
 {
 	INT32 *block;
 	size_t sample_count;
+	int flags;
+	UINT64 stamp;
 };
 
 struct _cassette_image
@@ -41,6 +52,13 @@ struct _cassette_image
 	struct sample_block *blocks;
 	size_t block_count;
 	size_t sample_count;
+
+	/* legacy waveform, expanded to blocks on the first access */
+	INT16 *legacy_samples;
+	size_t legacy_sample_count;
+	size_t legacy_block_count;
+	size_t resident_count;
+	UINT64 stamp;
 };
 
 
@@ -302,6 +320,8 @@ void cassette_close(cassette_image *cassette)
 {
 	if ((cassette->flags & CASSETTE_FLAG_DIRTY) && (cassette->flags & CASSETTE_FLAG_SAVEONEXIT))
 		cassette_save(cassette);
+	if (cassette->legacy_samples)
+		free(cassette->legacy_samples);
 	pool_exit(&cassette->pool);
 	free(cassette);
 }
@@ -394,8 +414,72 @@ static casserr_t compute_manipulation_ranges(cassette_image *cassette, int chann
 
 
 
-static casserr_t lookup_sample(cassette_image *cassette, int channel, size_t sample, int allocate, INT32 **ptr)
+static void discard_legacy_block(cassette_image *cassette)
 {
+	size_t i;
+	struct sample_block *block;
+	struct sample_block *oldest = NULL;
+
+	/* find the least recently used block that can be expanded again */
+	for (i = 0; i < cassette->legacy_block_count; i++)
+	{
+		block = &cassette->blocks[i];
+		if (block->block && (block->flags & BLOCK_FLAG_LEGACY))
+		{
+			if (!oldest || block->stamp < oldest->stamp)
+				oldest = block;
+		}
+	}
+
+	if (oldest)
+	{
+		pool_freeptr(&cassette->pool, oldest->block);
+		oldest->block = NULL;
+		oldest->sample_count = 0;
+		oldest->flags &= ~BLOCK_FLAG_LEGACY;
+		cassette->resident_count--;
+	}
+}
+
+
+
+static casserr_t expand_legacy_block(cassette_image *cassette, size_t sample_block)
+{
+	struct sample_block *block;
+	const INT16 *source;
+	INT32 *new_block;
+	size_t first;
+	size_t count;
+	size_t i;
+
+	if (cassette->resident_count >= LEGACY_RESIDENT_BLOCKS)
+		discard_legacy_block(cassette);
+
+	new_block = pool_malloc(&cassette->pool, SAMPLES_PER_BLOCK * sizeof(new_block[0]));
+	if (!new_block)
+		return CASSETTE_ERROR_OUTOFMEMORY;
+
+	/* the legacy waveform has always a single channel */
+	first = sample_block * SAMPLES_PER_BLOCK;
+	count = MIN(SAMPLES_PER_BLOCK, cassette->legacy_sample_count - first);
+	source = cassette->legacy_samples + first;
+	for (i = 0; i < count; i++)
+		new_block[i] = extrapolate16(source[i]);
+	memset(&new_block[count], 0, (SAMPLES_PER_BLOCK - count) * sizeof(new_block[0]));
+
+	block = &cassette->blocks[sample_block];
+	block->block = new_block;
+	block->sample_count = SAMPLES_PER_BLOCK;
+	block->flags |= BLOCK_FLAG_LEGACY;
+	cassette->resident_count++;
+	return CASSETTE_ERROR_SUCCESS;
+}
+
+
+
+static casserr_t lookup_sample(cassette_image *cassette, int channel, size_t sample, int allocate, int write, INT32 **ptr)
+{
+	casserr_t err;
 	size_t sample_block;
 	size_t sample_index;
 	size_t sample_size;
@@ -427,7 +511,23 @@ static casserr_t lookup_sample(cassette_image *cassette, int channel, size_t sam
 		cassette->block_count = new_block_count;
 	}
 
+	/* is this block still to be expanded from the legacy waveform? */
+	if (!cassette->blocks[sample_block].block && sample_block < cassette->legacy_block_count)
+	{
+		err = expand_legacy_block(cassette, sample_block);
+		if (err)
+			return err;
+	}
+
 	block = &cassette->blocks[sample_block];
+	block->stamp = ++cassette->stamp;
+
+	/* a modified block cannot be expanded again, so keep it */
+	if (write && (block->flags & BLOCK_FLAG_LEGACY))
+	{
+		block->flags &= ~BLOCK_FLAG_LEGACY;
+		cassette->resident_count--;
+	}
 
 	/* is this sample access off the current block? */
 	if (sample_index >= block->sample_count)
@@ -486,7 +586,7 @@ casserr_t cassette_get_samples(cassette_image *cassette, int channel,
 			/* find the sample that we are putting */
 			d = map_double(ranges.sample_last + 1 - ranges.sample_first, 0, sample_count, sample_index) + ranges.sample_first;
 			cassette_sample_index = (size_t) d;
-			err = lookup_sample(cassette, channel, cassette_sample_index, TRUE, (INT32 **) &source_ptr);
+			err = lookup_sample(cassette, channel, cassette_sample_index, TRUE, FALSE, (INT32 **) &source_ptr);
 			if (err)
 				return err;
 
@@ -588,7 +688,7 @@ casserr_t cassette_put_samples(cassette_image *cassette, int channel,
 		for (channel = ranges.channel_first; channel <= ranges.channel_last; channel++)
 		{
 			/* find the sample that we are putting */
-			err = lookup_sample(cassette, channel, sample_index, TRUE, &dest_ptr);
+			err = lookup_sample(cassette, channel, sample_index, TRUE, TRUE, &dest_ptr);
 			if (err)
 				return err;
 			*dest_ptr = dest_value;
@@ -914,6 +1014,8 @@ casserr_t cassette_legacy_construct(cassette_image *cassette,
 	int pos = 0;
 	UINT64 offset = 0;
 	UINT64 size;
+	size_t read_size;
+	size_t read_pos;
 	struct CassetteLegacyWaveFiller args;
 
 	/* sanity check the args */
@@ -932,8 +1034,12 @@ casserr_t cassette_legacy_construct(cassette_image *cassette,
 	if (args.sample_frequency == 0)
 		args.sample_frequency = 11025;
 
-	/* allocate a buffer for the binary data */
-	chunk = malloc(args.chunk_size);
+	/* allocate a buffer for the binary data, reading many chunks at once */
+	read_size = args.chunk_size;
+	if (read_size > 0 && read_size < LEGACY_READ_SIZE)
+		read_size = (LEGACY_READ_SIZE / read_size) * read_size;
+	read_pos = read_size;
+	chunk = malloc(read_size);
 	if (!chunk)
 	{
 		err = CASSETTE_ERROR_OUTOFMEMORY;
@@ -991,10 +1097,15 @@ casserr_t cassette_legacy_construct(cassette_image *cassette,
 	/* convert the file data to samples */
 	while((pos < sample_count) && (offset < size))
 	{
-		cassette_image_read(cassette, chunk, offset, args.chunk_size);
-		offset += args.chunk_size;
+		if (read_pos >= read_size)
+		{
+			cassette_image_read(cassette, chunk, offset, read_size);
+			read_pos = 0;
+		}
 
-		length = args.fill_wave(samples + pos, sample_count - pos, chunk);
+		length = args.fill_wave(samples + pos, sample_count - pos, (UINT8 *) chunk + read_pos);
+		read_pos += args.chunk_size;
+		offset += args.chunk_size;
 		if (length < 0)
 		{
 			err = CASSETTE_ERROR_INVALIDIMAGE;
@@ -1018,10 +1129,37 @@ casserr_t cassette_legacy_construct(cassette_image *cassette,
 	}
 
 	/* specify the wave */
-	err = cassette_put_samples(cassette, 0, 0.0, ((double) pos) / args.sample_frequency,
-		pos, 2, samples, CASSETTE_WAVEFORM_16BIT);
-	if (err)
-		goto done;
+	if (cassette->channels == 1 && cassette->sample_frequency == args.sample_frequency
+		&& !cassette->legacy_samples && cassette->block_count == 0)
+	{
+		/* keep the 16 bit waveform, the blocks are expanded only when accessed */
+		/* with a different frequency the samples are resampled by cassette_put_samples() */
+		cassette->legacy_block_count = (pos + SAMPLES_PER_BLOCK - 1) / SAMPLES_PER_BLOCK;
+		if (cassette->legacy_block_count)
+		{
+			cassette->blocks = pool_malloc(&cassette->pool, cassette->legacy_block_count * sizeof(cassette->blocks[0]));
+			if (!cassette->blocks)
+			{
+				cassette->legacy_block_count = 0;
+				err = CASSETTE_ERROR_OUTOFMEMORY;
+				goto done;
+			}
+			memset(cassette->blocks, 0, cassette->legacy_block_count * sizeof(cassette->blocks[0]));
+			cassette->block_count = cassette->legacy_block_count;
+		}
+		cassette->legacy_samples = samples;
+		cassette->legacy_sample_count = pos;
+		cassette->sample_count = pos;
+		cassette->flags |= CASSETTE_FLAG_DIRTY;
+		samples = NULL;
+	}
+	else
+	{
+		err = cassette_put_samples(cassette, 0, 0.0, ((double) pos) / args.sample_frequency,
+			pos, 2, samples, CASSETTE_WAVEFORM_16BIT);
+		if (err)
+			goto done;
+	}
 
 	/* success! */
 	err = CASSETTE_ERROR_SUCCESS;
@@ -6,6 +6,8 @@
 
 *********************************************************************/
 
+#include <zlib.h>
+
 #include "hashfile.h"
 #include "pool.h"
 #include "expat.h"
@@ -27,6 +29,52 @@ struct _hash_file
 	int preloaded_hash_count;
 
 	void (*error_proc)(const char *message);
+
+	const char *sysname;
+	int index_checked;
+	UINT8 *index;
+	const struct hashindex_header *index_header;
+	const UINT32 *index_buckets;
+	const struct hashindex_record *index_records;
+	const char *index_strings;
+};
+
+
+
+/* The hash index is a compiled copy of the hash file, stored in a *.hsx
+ * file and rebuilt when the size or the crc32 of the hash file change.
+ * It's made by the header, the bucket heads, the records and the strings.
+ * Each record is chained in the bucket of its key, that is the first 32
+ * bits of the crc32, or of the sha1 or md5 if the crc32 is missing.
+ * A record without checksums never matches, and it isn't chained.
+ */
+#define HASHINDEX_MAGIC			"MESSHSX1"
+#define HASHINDEX_BYTEORDER		0x01020304
+#define HASHINDEX_NONE			0xFFFFFFFF
+
+struct hashindex_header
+{
+	char magic[8];
+	UINT32 byteorder;
+	UINT32 source_size;
+	UINT32 source_crc;
+	UINT32 functions[IO_COUNT];
+	UINT32 bucket_count;
+	UINT32 record_count;
+	UINT32 string_size;
+};
+
+struct hashindex_record
+{
+	UINT32 key;
+	UINT32 key_function;
+	UINT32 next;
+	UINT32 hash;
+	UINT32 longname;
+	UINT32 manufacturer;
+	UINT32 year;
+	UINT32 playable;
+	UINT32 extrainfo;
 };
 
 
@@ -364,6 +412,10 @@ hash_file *hashfile_open(const char *sysname, int is_preload,
 	pool_init(&hashfile->pool);
 	hashfile->error_proc = error_proc;
 
+	hashfile->sysname = pool_strdup(&hashfile->pool, sysname);
+	if (!hashfile->sysname)
+		goto error;
+
 	/* open a file */
 	hashfile->file = mame_fopen(sysname, sysname, FILETYPE_HASH, 0);
 	if (!hashfile->file)
@@ -384,6 +436,8 @@ error:
 
 void hashfile_close(hash_file *hashfile)
 {
+	if (hashfile->index)
+		free(hashfile->index);
 	pool_exit(&hashfile->pool);
 	if (hashfile->file)
 		mame_fclose(hashfile->file);
@@ -417,6 +471,389 @@ static void singular_use_proc(hash_file *hashfile, void *param, struct hash_info
 
 
 
+/* ----------------------------------------------------------------------- */
+
+static UINT32 hashindex_key(const char *hash, unsigned int function)
+{
+	unsigned char checksum[20];
+
+	if (!hash_data_extract_binary_checksum(hash, function, checksum))
+		return 0;
+
+	return (checksum[0] << 24) | (checksum[1] << 16) | (checksum[2] << 8) | checksum[3];
+}
+
+
+
+static unsigned int hashindex_key_function(const char *hash)
+{
+	if (hash_data_has_checksum(hash, HASH_CRC))
+		return HASH_CRC;
+	if (hash_data_has_checksum(hash, HASH_SHA1))
+		return HASH_SHA1;
+	if (hash_data_has_checksum(hash, HASH_MD5))
+		return HASH_MD5;
+	return 0;
+}
+
+
+
+static int hashindex_source(hash_file *hashfile, UINT32 *size, UINT32 *crc)
+{
+	UINT8 buf[16384];
+	UINT64 file_size;
+	UINT32 len;
+
+	file_size = mame_fsize(hashfile->file);
+	if (file_size > 0x7FFFFFFF)
+		return -1;
+
+	*size = (UINT32) file_size;
+	*crc = crc32(0, NULL, 0);
+
+	mame_fseek(hashfile->file, 0, SEEK_SET);
+	while ((len = mame_fread(hashfile->file, buf, sizeof(buf))) > 0)
+		*crc = crc32(*crc, buf, len);
+
+	return 0;
+}
+
+
+
+static int hashindex_set(hash_file *hashfile, UINT8 *index, UINT32 index_size,
+	UINT32 source_size, UINT32 source_crc)
+{
+	const struct hashindex_header *header = (const struct hashindex_header *) index;
+	const UINT32 *buckets;
+	const struct hashindex_record *records;
+	const char *strings;
+	UINT32 i;
+
+	/* check the header */
+	if (index_size < sizeof(*header)
+		|| memcmp(header->magic, HASHINDEX_MAGIC, sizeof(header->magic)) != 0
+		|| header->byteorder != HASHINDEX_BYTEORDER
+		|| header->source_size != source_size
+		|| header->source_crc != source_crc
+		|| header->bucket_count == 0
+		|| (header->bucket_count & (header->bucket_count - 1)) != 0
+		|| header->bucket_count > index_size / sizeof(UINT32)
+		|| header->record_count > index_size / sizeof(struct hashindex_record)
+		|| header->string_size == 0
+		|| sizeof(*header) + header->bucket_count * sizeof(UINT32)
+			+ header->record_count * sizeof(struct hashindex_record)
+			+ header->string_size != index_size)
+		return -1;
+
+	buckets = (const UINT32 *) (header + 1);
+	records = (const struct hashindex_record *) (buckets + header->bucket_count);
+	strings = (const char *) (records + header->record_count);
+
+	/* check all the references, the lookups then don't need to */
+	if (strings[header->string_size - 1] != 0)
+		return -1;
+	for (i = 0; i < header->bucket_count; i++)
+	{
+		if (buckets[i] != HASHINDEX_NONE && buckets[i] >= header->record_count)
+			return -1;
+	}
+	for (i = 0; i < header->record_count; i++)
+	{
+		const struct hashindex_record *record = &records[i];
+		if ((record->next != HASHINDEX_NONE && record->next >= header->record_count)
+			|| record->hash >= header->string_size
+			|| strlen(strings + record->hash) >= HASH_BUF_SIZE
+			|| (record->longname != HASHINDEX_NONE && record->longname >= header->string_size)
+			|| (record->manufacturer != HASHINDEX_NONE && record->manufacturer >= header->string_size)
+			|| (record->year != HASHINDEX_NONE && record->year >= header->string_size)
+			|| (record->playable != HASHINDEX_NONE && record->playable >= header->string_size)
+			|| (record->extrainfo != HASHINDEX_NONE && record->extrainfo >= header->string_size))
+			return -1;
+	}
+
+	for (i = 0; i < IO_COUNT; i++)
+		hashfile->functions[i] |= header->functions[i];
+
+	hashfile->index = index;
+	hashfile->index_header = header;
+	hashfile->index_buckets = buckets;
+	hashfile->index_records = records;
+	hashfile->index_strings = strings;
+	return 0;
+}
+
+
+
+static int hashindex_load(hash_file *hashfile, UINT32 source_size, UINT32 source_crc)
+{
+	mame_file *file;
+	UINT8 *index;
+	UINT64 size;
+
+	file = mame_fopen(hashfile->sysname, hashfile->sysname, FILETYPE_HASHINDEX, 0);
+	if (!file)
+		return -1;
+
+	size = mame_fsize(file);
+	if (size < sizeof(struct hashindex_header) || size > 0x7FFFFFFF)
+	{
+		mame_fclose(file);
+		return -1;
+	}
+
+	index = malloc((size_t) size);
+	if (!index)
+	{
+		mame_fclose(file);
+		return -1;
+	}
+
+	if (mame_fread(file, index, (UINT32) size) != (UINT32) size
+		|| hashindex_set(hashfile, index, (UINT32) size, source_size, source_crc) != 0)
+	{
+		free(index);
+		mame_fclose(file);
+		return -1;
+	}
+
+	mame_fclose(file);
+	return 0;
+}
+
+
+
+struct hashindex_build
+{
+	struct hash_info **entries;
+	UINT32 entry_count;
+	UINT32 string_size;
+};
+
+
+
+static UINT32 hashindex_string_size(const char *s)
+{
+	return s ? strlen(s) + 1 : 0;
+}
+
+
+
+static void hashindex_use_proc(hash_file *hashfile, void *param, struct hash_info *hi)
+{
+	struct hashindex_build *build = (struct hashindex_build *) param;
+	struct hash_info **new_entries;
+
+	new_entries = realloc(build->entries, (build->entry_count + 1) * sizeof(struct hash_info *));
+	if (!new_entries)
+		return;
+
+	build->entries = new_entries;
+	build->entries[build->entry_count++] = hi;
+	build->string_size += hashindex_string_size(hi->hash)
+		+ hashindex_string_size(hi->longname)
+		+ hashindex_string_size(hi->manufacturer)
+		+ hashindex_string_size(hi->year)
+		+ hashindex_string_size(hi->playable)
+		+ hashindex_string_size(hi->extrainfo);
+}
+
+
+
+static UINT32 hashindex_put_string(char *strings, UINT32 *pos, const char *s)
+{
+	UINT32 offset;
+
+	if (!s)
+		return HASHINDEX_NONE;
+
+	offset = *pos;
+	strcpy(strings + offset, s);
+	*pos += strlen(s) + 1;
+	return offset;
+}
+
+
+
+static int hashindex_build(hash_file *hashfile, UINT32 source_size, UINT32 source_crc)
+{
+	struct hashindex_build build;
+	struct hashindex_header *header;
+	UINT32 *buckets;
+	struct hashindex_record *records;
+	char *strings;
+	UINT8 *index = NULL;
+	UINT32 index_size;
+	UINT32 bucket_count;
+	UINT32 string_pos;
+	UINT32 i;
+	mame_file *file;
+	int err = -1;
+
+	/* parse the whole hash file */
+	memset(&build, 0, sizeof(build));
+	hashfile_parse(hashfile, NULL, hashindex_use_proc, hashfile->error_proc, &build);
+
+	bucket_count = 1;
+	while (bucket_count < build.entry_count)
+		bucket_count *= 2;
+
+	index_size = sizeof(*header) + bucket_count * sizeof(UINT32)
+		+ build.entry_count * sizeof(struct hashindex_record) + build.string_size + 1;
+
+	index = malloc(index_size);
+	if (!index)
+		goto done;
+	memset(index, 0, index_size);
+
+	header = (struct hashindex_header *) index;
+	buckets = (UINT32 *) (header + 1);
+	records = (struct hashindex_record *) (buckets + bucket_count);
+	strings = (char *) (records + build.entry_count);
+
+	memcpy(header->magic, HASHINDEX_MAGIC, sizeof(header->magic));
+	header->byteorder = HASHINDEX_BYTEORDER;
+	header->source_size = source_size;
+	header->source_crc = source_crc;
+	for (i = 0; i < IO_COUNT; i++)
+		header->functions[i] = hashfile->functions[i];
+	header->bucket_count = bucket_count;
+	header->record_count = build.entry_count;
+	header->string_size = build.string_size + 1;
+
+	for (i = 0; i < bucket_count; i++)
+		buckets[i] = HASHINDEX_NONE;
+
+	/* the first string is empty, so the string table is never empty */
+	string_pos = 1;
+
+	/* the chains are built backward, so they are in the file order */
+	for (i = build.entry_count; i-- > 0; )
+	{
+		const struct hash_info *hi = build.entries[i];
+		struct hashindex_record *record = &records[i];
+		UINT32 *head;
+
+		record->key_function = hashindex_key_function(hi->hash);
+		record->key = record->key_function ? hashindex_key(hi->hash, record->key_function) : 0;
+		record->hash = hashindex_put_string(strings, &string_pos, hi->hash);
+		record->longname = hashindex_put_string(strings, &string_pos, hi->longname);
+		record->manufacturer = hashindex_put_string(strings, &string_pos, hi->manufacturer);
+		record->year = hashindex_put_string(strings, &string_pos, hi->year);
+		record->playable = hashindex_put_string(strings, &string_pos, hi->playable);
+		record->extrainfo = hashindex_put_string(strings, &string_pos, hi->extrainfo);
+
+		if (record->key_function)
+		{
+			head = &buckets[record->key & (bucket_count - 1)];
+			record->next = *head;
+			*head = i;
+		}
+		else
+		{
+			record->next = HASHINDEX_NONE;
+		}
+	}
+
+	/* save it, if it fails it's used only for this session */
+	file = mame_fopen(hashfile->sysname, hashfile->sysname, FILETYPE_HASHINDEX, 1);
+	if (file)
+	{
+		mame_fwrite(file, index, index_size);
+		mame_fclose(file);
+	}
+
+	err = hashindex_set(hashfile, index, index_size, source_size, source_crc);
+	if (!err)
+		index = NULL;
+
+done:
+	if (index)
+		free(index);
+	if (build.entries)
+		free(build.entries);
+	return err;
+}
+
+
+
+static void hashindex_open(hash_file *hashfile)
+{
+	UINT32 source_size;
+	UINT32 source_crc;
+
+	if (hashindex_source(hashfile, &source_size, &source_crc) != 0)
+		return;
+
+	if (hashindex_load(hashfile, source_size, source_crc) == 0)
+		return;
+
+	hashindex_build(hashfile, source_size, source_crc);
+}
+
+
+
+static const char *hashindex_string(hash_file *hashfile, UINT32 offset)
+{
+	return offset != HASHINDEX_NONE ? hashfile->index_strings + offset : NULL;
+}
+
+
+
+static const struct hash_info *hashindex_lookup(hash_file *hashfile, const char *hash)
+{
+	static const unsigned int key_functions[] = { HASH_CRC, HASH_SHA1, HASH_MD5 };
+	const struct hashindex_header *header = hashfile->index_header;
+	const struct hashindex_record *record;
+	struct hash_info *hi;
+	UINT32 found = HASHINDEX_NONE;
+	UINT32 key;
+	UINT32 i, j;
+
+	/* the last matching record of the file wins, as in hashfile_parse() */
+	for (j = 0; j < sizeof(key_functions) / sizeof(key_functions[0]); j++)
+	{
+		if (!hash_data_has_checksum(hash, key_functions[j]))
+			continue;
+		key = hashindex_key(hash, key_functions[j]);
+
+		for (i = hashfile->index_buckets[key & (header->bucket_count - 1)]; i != HASHINDEX_NONE; i = record->next)
+		{
+			const char *record_hash;
+
+			record = &hashfile->index_records[i];
+			if (found != HASHINDEX_NONE && i <= found)
+				continue;
+			if (record->key_function != key_functions[j] || record->key != key)
+				continue;
+
+			record_hash = hashfile->index_strings + record->hash;
+			if (hash_data_is_equal(record_hash, hash, hash_data_used_functions(record_hash)) == 1)
+				found = i;
+		}
+	}
+
+	if (found == HASHINDEX_NONE)
+		return NULL;
+
+	hi = pool_malloc(&hashfile->pool, sizeof(struct hash_info));
+	if (!hi)
+		return NULL;
+	memset(hi, 0, sizeof(*hi));
+
+	record = &hashfile->index_records[found];
+	strcpy(hi->hash, hashfile->index_strings + record->hash);
+	hi->longname = hashindex_string(hashfile, record->longname);
+	hi->manufacturer = hashindex_string(hashfile, record->manufacturer);
+	hi->year = hashindex_string(hashfile, record->year);
+	hi->playable = hashindex_string(hashfile, record->playable);
+	hi->extrainfo = hashindex_string(hashfile, record->extrainfo);
+	return hi;
+}
+
+
+
+/* ----------------------------------------------------------------------- */
+
 const struct hash_info *hashfile_lookup(hash_file *hashfile, const char *hash)
 {
 	struct hashlookup_params param;
@@ -431,6 +868,15 @@ const struct hash_info *hashfile_lookup(hash_file *hashfile, const char *hash)
 			return hashfile->preloaded_hashes[i];
 	}
 
+	/* use the compiled index, if the file isn't preloaded */
+	if (!hashfile->preloaded_hashes && !hashfile->index_checked)
+	{
+		hashfile->index_checked = TRUE;
+		hashindex_open(hashfile);
+	}
+	if (hashfile->index)
+		return hashindex_lookup(hashfile, hash);
+
 	hashfile_parse(hashfile, singular_selector_proc, singular_use_proc,
 		hashfile->error_proc, (void *) &param);
 	return param.hi;
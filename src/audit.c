@@ -16,8 +16,16 @@
 #include "harddisk.h"
 #include "sound/samples.h"
 
+/* max amount of file data kept in memory waiting to be hashed */
+#define AUDIT_BATCH_SIZE	0x2000000
+
 static audit_record *audit_records = NULL;
 
+/* files opened for each audit record, and their ROM entries */
+static mame_file *audit_files[AUD_MAX_ROMS];
+static const rom_entry *audit_entries[AUD_MAX_ROMS];
+static int audit_file_count;
+
 static const game_driver *chd_gamedrv;
 
 /*-------------------------------------------------
@@ -101,6 +109,111 @@ static chd_interface audit_chd_interface =
 };
 
 
+/*-------------------------------------------------
+    audit_complete_task - hash a share of the
+    opened files
+-------------------------------------------------*/
+
+static void audit_complete_task(void *param, int task_num, int task_count)
+{
+	int i;
+
+	(void)param;
+
+	for (i = task_num; i < audit_file_count; i += task_count)
+		if (audit_files[i])
+			mame_fcomplete(audit_files[i]);
+}
+
+
+/*-------------------------------------------------
+    audit_complete - hash all the files opened
+    so far, in parallel
+-------------------------------------------------*/
+
+static void audit_complete(void)
+{
+	osd_parallelize(audit_complete_task, NULL, audit_file_count);
+}
+
+
+/*-------------------------------------------------
+    audit_rom_status - compute the status of a ROM
+    audit record from its opened file
+-------------------------------------------------*/
+
+static void audit_rom_status(audit_record *aud, const rom_entry *rom, mame_file *file, const game_driver *clone_of)
+{
+	const game_driver *drv;
+
+	if (file)
+	{
+		hash_data_copy(aud->hash, mame_fhash(file));
+		aud->length = mame_fsize(file);
+		mame_fclose(file);
+	}
+
+	if (!file)
+	{
+		if (hash_data_has_info(aud->exphash, HASH_INFO_NO_DUMP))
+		{
+			/* not found but it's not good anyway */
+			aud->status = AUD_NOT_AVAILABLE;
+		}
+		else if (ROM_ISOPTIONAL(rom))
+		{
+			/* optional ROM not found */
+			aud->status = AUD_OPTIONAL_ROM_NOT_FOUND;
+		}
+		else
+		{
+			/* not found */
+			aud->status = AUD_ROM_NOT_FOUND;
+
+			drv = clone_of;
+
+			/* If missing ROM is also present in a parent set, indicate that */
+			while (drv)
+			{
+				if (audit_is_rom_used (drv, aud->exphash))
+				{
+					if (drv->flags & NOT_A_DRIVER)
+					{
+						aud->status = AUD_ROM_NOT_FOUND_BIOS;
+						break;
+					}
+					else
+						aud->status = AUD_ROM_NOT_FOUND_PARENT;
+				}
+
+				// Walk up the inheritance list. If this ROM is a clone of a set which
+				// contains a BIOS that is missing, we can correctly mark it as
+				// such.
+				drv = driver_get_clone(drv);
+			}
+		}
+	}
+	/* all cases below assume the ROM was at least found */
+	else if (aud->explength != aud->length)
+		aud->status = AUD_LENGTH_MISMATCH;
+	else if (hash_data_has_info(aud->exphash, HASH_INFO_NO_DUMP))
+			aud->status = AUD_ROM_NEED_DUMP; /* new case - found but not known to be dumped */
+	else if (!hash_data_is_equal(aud->exphash, aud->hash, 0))
+	{
+		/* non-matching hash */
+			aud->status = AUD_BAD_CHECKSUM;
+	}
+	else
+	{
+		/* matching hash */
+		if (hash_data_has_info(aud->exphash, HASH_INFO_BAD_DUMP))
+			aud->status = AUD_ROM_NEED_REDUMP;
+		else
+		aud->status = AUD_ROM_GOOD;
+	}
+}
+
+
 /* returns 1 if rom is defined in this set */
 int audit_is_rom_used (const game_driver *gamedrv, const char* hash)
 {
@@ -179,6 +292,9 @@ int audit_roms (int game, audit_record **audit)
 	int count = 0;
 	audit_record *aud;
 	int	err;
+	int i;
+	mame_file *file;
+	UINT64 pending = 0;
 
 	if (!audit_records)
 	{
@@ -199,6 +315,8 @@ int audit_roms (int game, audit_record **audit)
 
 	if (!gamedrv->rom) return -1;
 
+	audit_file_count = 0;
+
 	/* check for existence of romset */
 	if (!mame_faccess (gamedrv->name, FILETYPE_ROM))
 	{
@@ -227,76 +345,33 @@ int audit_roms (int game, audit_record **audit)
 
 				count++;
 
-				/* obtain hash checksums and length of ROM file */
+				/* open the ROM file; the checksums of the unzipped files are
+                   computed later, all together and in parallel */
 				drv = gamedrv;
 				do
 				{
-					err = mame_fchecksum(drv->name, name, &aud->length, aud->hash);
+					file = mame_fopen_checksum_deferred(drv->name, name, aud->hash);
 					drv = driver_get_clone(drv);
-				} while (err && drv);
+				} while (!file && drv);
 
 				/* spin through ROM_CONTINUEs, totaling length */
 				for (chunk = rom_first_chunk(rom); chunk; chunk = rom_next_chunk(chunk))
 					aud->explength += ROM_GETLENGTH(chunk);
 
-				if (err)
+				audit_files[aud - audit_records] = file;
+				audit_entries[aud - audit_records] = rom;
+				audit_file_count = aud - audit_records + 1;
+
+				/* limit the data waiting to be hashed */
+				if (file)
 				{
-					if (hash_data_has_info(aud->exphash, HASH_INFO_NO_DUMP))
-					{
-						/* not found but it's not good anyway */
-						aud->status = AUD_NOT_AVAILABLE;
-					}
-					else if (ROM_ISOPTIONAL(rom))
-					{
-						/* optional ROM not found */
-						aud->status = AUD_OPTIONAL_ROM_NOT_FOUND;
-					}
-					else
+					pending += mame_fsize(file);
+					if (pending >= AUDIT_BATCH_SIZE)
 					{
-						/* not found */
-						aud->status = AUD_ROM_NOT_FOUND;
-
-						drv = clone_of;
-
-						/* If missing ROM is also present in a parent set, indicate that */
-						while (drv)
-						{
-							if (audit_is_rom_used (drv, aud->exphash))
-							{
-								if (drv->flags & NOT_A_DRIVER)
-								{
-									aud->status = AUD_ROM_NOT_FOUND_BIOS;
-									break;
-								}
-								else
-									aud->status = AUD_ROM_NOT_FOUND_PARENT;
-							}
-
-							// Walk up the inheritance list. If this ROM is a clone of a set which
-							// contains a BIOS that is missing, we can correctly mark it as
-							// such.
-							drv = driver_get_clone(drv);
-						}
+						audit_complete();
+						pending = 0;
 					}
 				}
-				/* all cases below assume the ROM was at least found */
-				else if (aud->explength != aud->length)
-					aud->status = AUD_LENGTH_MISMATCH;
-				else if (hash_data_has_info(aud->exphash, HASH_INFO_NO_DUMP))
-						aud->status = AUD_ROM_NEED_DUMP; /* new case - found but not known to be dumped */
-				else if (!hash_data_is_equal(aud->exphash, aud->hash, 0))
-				{
-					/* non-matching hash */
-						aud->status = AUD_BAD_CHECKSUM;
-				}
-				else
-				{
-					/* matching hash */
-					if (hash_data_has_info(aud->exphash, HASH_INFO_BAD_DUMP))
-						aud->status = AUD_ROM_NEED_REDUMP;
-					else
-					aud->status = AUD_ROM_GOOD;
-				}
 
 				aud++;
 			}
@@ -306,6 +381,10 @@ int audit_roms (int game, audit_record **audit)
 				void *source;
 				chd_header header;
 
+				audit_files[aud - audit_records] = NULL;
+				audit_entries[aud - audit_records] = NULL;
+				audit_file_count = aud - audit_records + 1;
+
 				name = ROM_GETNAME(rom);
 				strcpy (aud->rom, name);
 				aud->explength = 0;
@@ -364,6 +443,13 @@ int audit_roms (int game, audit_record **audit)
 			}
 		}
 
+	/* hash the remaining files and compute the ROM status */
+	audit_complete();
+	for (i = 0; i < audit_file_count; i++)
+		if (audit_entries[i])
+			audit_rom_status(&audit_records[i], audit_entries[i], audit_files[i], clone_of);
+	audit_file_count = 0;
+
         #ifdef MESS
         if (!count)
                 return -1;
@@ -12,6 +12,9 @@
 #include "sha1.h"
 #include <zlib.h>
 #include <time.h>
+#ifdef USE_SMP
+#include <pthread.h>
+#endif
 
 
 
@@ -56,6 +59,14 @@
 
 #define NO_MATCH					(~0)
 
+#define MAX_COMPRESS_THREADS		16			/* max number of compression threads */
+#define COMPRESS_SLOTS_PER_THREAD	4			/* hunks queued for every compression thread */
+
+#define SLOT_EMPTY					0			/* slot not in use */
+#define SLOT_READY					1			/* slot read and waiting for compression */
+#define SLOT_BUSY					2			/* slot being compressed */
+#define SLOT_DONE					3			/* slot compressed and waiting to be written */
+
 
 
 /*************************************
@@ -124,6 +135,10 @@ struct _chd_file
 	UINT8 *					compressed;		/* pointer to buffer for compressed data */
 	void *					codecdata;		/* opaque pointer to codec data */
 
+	UINT8 *					mapped;			/* file mapped in memory, or NULL */
+	UINT32					mappedbytes;	/* size of the mapped file */
+	UINT8 *					verified;		/* bitmap of the mapped hunks with a verified CRC */
+
 	crcmap_entry *			crcmap;			/* CRC map entries */
 	crcmap_entry *			crcfree;		/* free list CRC entries */
 	crcmap_entry **			crctable;		/* table of CRC entries */
@@ -151,6 +166,56 @@ struct _zlib_codec_data
 typedef struct _zlib_codec_data zlib_codec_data;
 
 
+struct _compress_source
+{
+	chd_interface_file *	file;			/* source file */
+	UINT64					offset;			/* offset within the file of the next sector */
+	UINT32					secsize;		/* bytes read for every sector */
+	UINT32					secstride;		/* bytes used by every sector in the hunk */
+	UINT32					secperhunk;		/* sectors in every hunk */
+};
+typedef struct _compress_source compress_source;
+
+
+#ifdef USE_SMP
+struct _compress_slot
+{
+	UINT8 *					data;			/* raw data of the hunk */
+	UINT8 *					compressed;		/* compressed data of the hunk */
+	map_entry				entry;			/* map entry computed by the worker */
+	int						err;			/* error reported by the worker */
+	int						state;			/* state of the slot */
+};
+typedef struct _compress_slot compress_slot;
+
+
+struct _compress_worker
+{
+	struct _compress_pool *	pool;			/* pool owning the worker */
+	zlib_codec_data *		codec;			/* private compressor */
+	pthread_t				thread;			/* thread of the worker */
+};
+typedef struct _compress_worker compress_worker;
+
+
+struct _compress_pool
+{
+	chd_file *				chd;			/* CHD being compressed */
+	pthread_mutex_t			mutex;			/* access control */
+	pthread_cond_t			readycond;		/* signaled when a slot is ready */
+	pthread_cond_t			donecond;		/* signaled when a slot is done */
+	compress_worker			worker[MAX_COMPRESS_THREADS];
+	int						workers;		/* number of running workers */
+	compress_slot *			slot;			/* ring of slots */
+	UINT32					slots;			/* number of slots */
+	UINT8 *					buffer;			/* memory of all the slots */
+	UINT32					nextwork;		/* sequence number of the next slot to compress */
+	int						quit;			/* nonzero to stop the workers */
+};
+typedef struct _compress_pool compress_pool;
+#endif
+
+
 
 /*************************************
  *
@@ -161,6 +226,7 @@ typedef struct _zlib_codec_data zlib_codec_data;
 static chd_interface cur_interface;
 static chd_file *first_file;
 static int last_error;
+static int compress_threads = 1;
 
 static const UINT8 nullmd5[CHD_MD5_BYTES] = { 0 };
 static const UINT8 nullsha1[CHD_SHA1_BYTES] = { 0 };
@@ -176,7 +242,15 @@ static const UINT8 nullsha1[CHD_SHA1_BYTES] = { 0 };
 static int validate_header(const chd_header *header);
 static int read_hunk_into_memory(chd_file *chd, UINT32 hunknum, UINT8 *dest);
 static int read_hunk_into_cache(chd_file *chd, UINT32 hunknum);
+static const UINT8 *map_hunk(chd_file *chd, UINT32 hunknum);
+static void map_file(chd_file *chd);
+static void unmap_file(chd_file *chd);
 static int write_hunk_from_memory(chd_file *chd, UINT32 hunknum, const UINT8 *src);
+static void init_hunk_entry(chd_file *chd, const UINT8 *src, map_entry *newentry);
+static int match_hunk(chd_file *chd, UINT32 hunknum, const UINT8 *src, map_entry *newentry);
+static int compress_hunk(chd_file *chd, zlib_codec_data *codec, const UINT8 *src, UINT8 *dest, map_entry *newentry);
+static int write_hunk_entry(chd_file *chd, UINT32 hunknum, map_entry *newentry, const UINT8 *src, const UINT8 *compressed);
+static int compress_hunks(chd_exfile *chdex, compress_source *source, UINT32 hunkcount, void (*progress)(const char *, ...));
 static int read_header(chd_interface_file *file, chd_header *header);
 static int write_header(chd_interface_file *file, const chd_header *header);
 static int read_hunk_map(chd_file *chd);
@@ -187,6 +261,8 @@ static int find_metadata_entry(chd_file *chd, UINT32 metatag, UINT32 metaindex,
 
 static int init_codec(chd_file *chd);
 static void free_codec(chd_file *chd);
+static zlib_codec_data *init_compressor(void);
+static void free_compressor(zlib_codec_data *data);
 
 static chd_interface_file *multi_open(const char *filename, const char *mode);
 static void multi_close(chd_interface_file *file);
@@ -310,6 +386,23 @@ void chd_save_interface(chd_interface *interface_save)
 
 
 
+/*************************************
+ *
+ *  Compression threads setup
+ *
+ *************************************/
+
+void chd_set_compress_threads(int threads)
+{
+	if (threads < 1)
+		threads = 1;
+	if (threads > MAX_COMPRESS_THREADS)
+		threads = MAX_COMPRESS_THREADS;
+	compress_threads = threads;
+}
+
+
+
 /*************************************
  *
  *  Create a new data file
@@ -566,6 +659,10 @@ chd_file *chd_open(const char *filename, int writeable, chd_file *parent)
 	if (err != CHDERR_NONE)
 		SET_ERROR_AND_CLEANUP(err);
 
+	/* map read-only files in memory, if the interface allows it */
+	if (!writeable)
+		map_file(&chd);
+
 	/* allocate and init the hunk cache */
 	chd.cache = malloc(chd.header.hunkbytes);
 	chd.compare = malloc(chd.header.hunkbytes);
@@ -609,6 +706,8 @@ cleanup:
 		free(chd.cache);
 	if (chd.map)
 		free(chd.map);
+	if (chd.mapped)
+		unmap_file(&chd);
 	if (chd.file)
 		multi_close(chd.file);
 	return NULL;
@@ -652,6 +751,10 @@ void chd_close(chd_file *chd)
 	if (chd->crcmap)
 		free(chd->crcmap);
 
+	/* unmap the file */
+	if (chd->mapped)
+		unmap_file(chd);
+
 	/* close the file */
 	if (chd->file)
 		multi_close(chd->file);
@@ -879,6 +982,17 @@ UINT32 chd_read(chd_file *chd, UINT32 hunknum, UINT32 hunkcount, void *buffer)
 	if (hunknum > chd->maxhunk)
 		chd->maxhunk = hunknum;
 
+	/* if the hunk is mapped, also in the parent, copy it directly */
+	if (chd->cachehunk != hunknum)
+	{
+		const UINT8 *data = map_hunk(chd, hunknum);
+		if (data)
+		{
+			memcpy(buffer, data, chd->header.hunkbytes);
+			return 1;
+		}
+	}
+
 	/* if the hunk is not cached, load and decompress it */
 	if (chd->cachehunk != hunknum)
 	{
@@ -897,6 +1011,27 @@ cleanup:
 
 
 
+/*************************************
+ *
+ *  Direct access to a mapped hunk
+ *
+ *************************************/
+
+const void *chd_map_hunk(chd_file *chd, UINT32 hunknum)
+{
+	/* punt if NULL or invalid */
+	if (!chd || chd->cookie != COOKIE_VALUE || hunknum >= chd->header.totalhunks)
+		return NULL;
+
+	/* track the max */
+	if (hunknum > chd->maxhunk)
+		chd->maxhunk = hunknum;
+
+	return map_hunk(chd, hunknum);
+}
+
+
+
 /*************************************
  *
  *  Writing to a data file
@@ -1051,12 +1186,11 @@ cleanup:
 
 int chd_compress(chd_file *chd, const char *rawfile, UINT32 offset, void (*progress)(const char *, ...))
 {
-	chd_interface_file *sourcefile = NULL;
-	UINT64 sourceoffset = 0;
-	struct MD5Context md5;
-	struct sha1_ctx sha;
-	clock_t lastupdate;
-	int err, hunknum;
+	compress_source source;
+	chd_exfile *chdex;
+	int err;
+
+	source.file = NULL;
 
 	/* punt if no interface */
 	if (!cur_interface.open)
@@ -1067,105 +1201,364 @@ int chd_compress(chd_file *chd, const char *rawfile, UINT32 offset, void (*progr
 		SET_ERROR_AND_CLEANUP(CHDERR_INVALID_PARAMETER);
 
 	/* open the raw file */
-	sourcefile = multi_open(rawfile, "rb");
-	if (!sourcefile)
+	source.file = multi_open(rawfile, "rb");
+	if (!source.file)
 		SET_ERROR_AND_CLEANUP(CHDERR_FILE_NOT_FOUND);
 
-	/* mark the CHD writeable and write the updated header */
-	chd->header.flags |= CHDFLAGS_IS_WRITEABLE;
-	err = write_header(chd->file, &chd->header);
+	/* the raw file is read one whole hunk at a time */
+	source.offset = offset;
+	source.secsize = chd->header.hunkbytes;
+	source.secstride = chd->header.hunkbytes;
+	source.secperhunk = 1;
+
+	/* mark the CHD writeable and init the CRC maps and the MD5/SHA1 computations */
+	chdex = chd_start_compress_ex(chd);
+	if (!chdex)
+		goto cleanup;
+
+	/* loop over source hunks until we run out */
+	err = compress_hunks(chdex, &source, chd->header.totalhunks, progress);
 	if (err != CHDERR_NONE)
+	{
+		free(chdex);
 		SET_ERROR_AND_CLEANUP(err);
+	}
 
-	/* create CRC maps for the new CHD and the parent */
-	init_crcmap(chd, 0);
-	if (chd->parent)
-		init_crcmap(chd->parent, 1);
+	/* close the file */
+	multi_close(source.file);
 
-	/* init the MD5/SHA1 computations */
-	MD5Init(&md5);
-	sha1_init(&sha);
+	/* compute the final MD5/SHA1 values and re-write the header */
+	err = chd_end_compress_ex(chdex, progress);
+	if (err != CHDERR_NONE)
+		last_error = err;
+	return err;
 
-	/* loop over source hunks until we run out */
-	lastupdate = 0;
-	for (hunknum = 0; hunknum < chd->header.totalhunks; hunknum++)
+cleanup:
+	if (source.file)
+		multi_close(source.file);
+	return last_error;
+}
+
+/*************************************
+ *
+ *  Hunk compression loop
+ *
+ *************************************/
+
+static void read_source_hunk(chd_file *chd, compress_source *source, UINT8 *dest)
+{
+	UINT32 filled = 0;
+	UINT32 i;
+
+	/* read each sector, padding it out to the sector stride */
+	for (i = 0; i < source->secperhunk; i++)
 	{
-		clock_t curtime = clock();
-		UINT32 bytestochecksum;
-		UINT32 bytesread;
+		UINT32 bytesread = multi_read(source->file, source->offset, source->secsize, &dest[filled]);
+		/*
+           NOTE: because we pad CD tracks to a hunk boundry, there is a possibility
+           that we will run off the end of the sourcefile and bytesread will be zero.
+           the padding below takes care of it.
+        */
+		if (bytesread < source->secstride)
+			memset(&dest[filled + bytesread], 0, source->secstride - bytesread);
+		source->offset += source->secsize;
+		filled += source->secstride;
+	}
 
-		/* read the data */
-		bytesread = multi_read(sourcefile, sourceoffset + offset, chd->header.hunkbytes, chd->cache);
-		if (bytesread < chd->header.hunkbytes)
-			memset(&chd->cache[bytesread], 0, chd->header.hunkbytes - bytesread);
+	/* zero the rest of the hunk */
+	if (filled < chd->header.hunkbytes)
+		memset(&dest[filled], 0, chd->header.hunkbytes - filled);
+}
 
-		/* progress */
-		if (curtime - lastupdate > CLOCKS_PER_SEC / 2)
+
+static void update_source_checksum(chd_exfile *chdex, const UINT8 *data)
+{
+	chd_file *chd = chdex->chd;
+	UINT32 bytestochecksum;
+
+	/* update the MD5/SHA1 */
+	bytestochecksum = chd->header.hunkbytes;
+	if (chdex->sourceoffset + chd->header.hunkbytes > chd->header.logicalbytes)
+	{
+		if (chdex->sourceoffset >= chd->header.logicalbytes)
+			bytestochecksum = 0;
+		else
+			bytestochecksum = chd->header.logicalbytes - chdex->sourceoffset;
+	}
+	if (bytestochecksum)
+	{
+		MD5Update(&chdex->md5, data, bytestochecksum);
+		sha1_update(&chdex->sha, bytestochecksum, data);
+	}
+
+	/* prepare for the next hunk */
+	chdex->sourceoffset += chd->header.hunkbytes;
+}
+
+
+static void update_compress_progress(chd_file *chd, UINT32 hunknum, clock_t *lastupdate, void (*progress)(const char *, ...))
+{
+	clock_t curtime = clock();
+
+	if (curtime - *lastupdate > CLOCKS_PER_SEC / 2)
+	{
+		UINT64 sourcepos = (UINT64)hunknum * chd->header.hunkbytes;
+		if (progress && sourcepos)
+			(*progress)("Compressing hunk %d/%d... (ratio=%d%%)  \r", hunknum, chd->header.totalhunks, 100 - multi_length(chd->file) * 100 / sourcepos);
+		*lastupdate = curtime;
+	}
+}
+
+
+static void update_crcmap(chd_file *chd, UINT32 hunknum)
+{
+	/* hunks referencing other hunks never need to be matched */
+	if ((chd->map[hunknum].flags & MAP_ENTRY_FLAG_TYPE_MASK) != MAP_ENTRY_TYPE_SELF_HUNK &&
+		(chd->map[hunknum].flags & MAP_ENTRY_FLAG_TYPE_MASK) != MAP_ENTRY_TYPE_PARENT_HUNK)
+		add_to_crcmap(chd, hunknum);
+}
+
+
+#ifdef USE_SMP
+
+/*
+    The threaded compression uses a ring of slots. The calling thread reads
+    the source hunks in order and queues them in the free slots, the workers
+    compute the CRC and compress them with their own codec, and the calling
+    thread writes them back in order, looking for matching hunks only then,
+    so the resulting file is the same of the single threaded compression.
+*/
+
+static void *compress_worker_thread(void *param)
+{
+	compress_worker *worker = param;
+	compress_pool *pool = worker->pool;
+	chd_file *chd = pool->chd;
+
+	pthread_mutex_lock(&pool->mutex);
+	while (!pool->quit)
+	{
+		compress_slot *slot = &pool->slot[pool->nextwork % pool->slots];
+
+		/* wait for the next hunk in order */
+		if (slot->state != SLOT_READY)
 		{
-			UINT64 sourcepos = (UINT64)hunknum * chd->header.hunkbytes;
-			if (progress && sourcepos)
-				(*progress)("Compressing hunk %d/%d... (ratio=%d%%)  \r", hunknum, chd->header.totalhunks, 100 - multi_length(chd->file) * 100 / sourcepos);
-			lastupdate = curtime;
+			pthread_cond_wait(&pool->readycond, &pool->mutex);
+			continue;
 		}
+		slot->state = SLOT_BUSY;
+		pool->nextwork++;
+		pthread_mutex_unlock(&pool->mutex);
+
+		/* compress it, unless it's a mini hunk */
+		init_hunk_entry(chd, slot->data, &slot->entry);
+		slot->err = CHDERR_NONE;
+		if ((slot->entry.flags & MAP_ENTRY_FLAG_TYPE_MASK) != MAP_ENTRY_TYPE_MINI)
+			slot->err = compress_hunk(chd, worker->codec, slot->data, slot->compressed, &slot->entry);
+
+		pthread_mutex_lock(&pool->mutex);
+		slot->state = SLOT_DONE;
+		pthread_cond_signal(&pool->donecond);
+	}
+	pthread_mutex_unlock(&pool->mutex);
 
-		/* update the MD5/SHA1 */
-		bytestochecksum = chd->header.hunkbytes;
-		if (sourceoffset + chd->header.hunkbytes > chd->header.logicalbytes)
+	return NULL;
+}
+
+
+static void free_compress_pool(compress_pool *pool)
+{
+	int i;
+
+	/* stop the workers */
+	pthread_mutex_lock(&pool->mutex);
+	pool->quit = 1;
+	pthread_cond_broadcast(&pool->readycond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (i = 0; i < pool->workers; i++)
+	{
+		pthread_join(pool->worker[i].thread, NULL);
+		free_compressor(pool->worker[i].codec);
+	}
+
+	pthread_cond_destroy(&pool->donecond);
+	pthread_cond_destroy(&pool->readycond);
+	pthread_mutex_destroy(&pool->mutex);
+
+	if (pool->buffer)
+		free(pool->buffer);
+	if (pool->slot)
+		free(pool->slot);
+	free(pool);
+}
+
+
+static compress_pool *init_compress_pool(chd_file *chd, int threads)
+{
+	compress_pool *pool;
+	UINT32 i;
+
+	pool = malloc(sizeof(compress_pool));
+	if (!pool)
+		return NULL;
+	memset(pool, 0, sizeof(*pool));
+	pool->chd = chd;
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->readycond, NULL);
+	pthread_cond_init(&pool->donecond, NULL);
+
+	/* allocate the slots, with room for the raw and the compressed data */
+	pool->slots = threads * COMPRESS_SLOTS_PER_THREAD;
+	pool->slot = malloc(pool->slots * sizeof(pool->slot[0]));
+	pool->buffer = malloc((size_t)pool->slots * 2 * chd->header.hunkbytes);
+	if (!pool->slot || !pool->buffer)
+	{
+		free_compress_pool(pool);
+		return NULL;
+	}
+	for (i = 0; i < pool->slots; i++)
+	{
+		memset(&pool->slot[i], 0, sizeof(pool->slot[i]));
+		pool->slot[i].data = pool->buffer + (size_t)i * 2 * chd->header.hunkbytes;
+		pool->slot[i].compressed = pool->slot[i].data + chd->header.hunkbytes;
+	}
+
+	/* start the workers, each one with its own compressor */
+	while (pool->workers < threads)
+	{
+		compress_worker *worker = &pool->worker[pool->workers];
+
+		worker->pool = pool;
+		worker->codec = init_compressor();
+		if (!worker->codec)
+			break;
+		if (pthread_create(&worker->thread, NULL, compress_worker_thread, worker) != 0)
 		{
-			if (sourceoffset >= chd->header.logicalbytes)
-				bytestochecksum = 0;
-			else
-				bytestochecksum = chd->header.logicalbytes - sourceoffset;
+			free_compressor(worker->codec);
+			break;
 		}
-		if (bytestochecksum)
+		pool->workers++;
+	}
+
+	/* if nothing started, compress without threads */
+	if (pool->workers == 0)
+	{
+		free_compress_pool(pool);
+		return NULL;
+	}
+
+	return pool;
+}
+
+
+static int compress_hunks_threaded(compress_pool *pool, chd_exfile *chdex, compress_source *source, UINT32 hunkcount, void (*progress)(const char *, ...))
+{
+	chd_file *chd = chdex->chd;
+	clock_t lastupdate = 0;
+	UINT32 readnum = 0;
+	UINT32 writenum = 0;
+	int err;
+
+	while (writenum < hunkcount)
+	{
+		compress_slot *slot;
+
+		/* read ahead as many hunks as there are free slots */
+		while (readnum < hunkcount && readnum - writenum < pool->slots)
 		{
-			MD5Update(&md5, chd->cache, bytestochecksum);
-			sha1_update(&sha, bytestochecksum, chd->cache);
+			slot = &pool->slot[readnum % pool->slots];
+			read_source_hunk(chd, source, slot->data);
+			update_source_checksum(chdex, slot->data);
+
+			pthread_mutex_lock(&pool->mutex);
+			slot->state = SLOT_READY;
+			pthread_cond_signal(&pool->readycond);
+			pthread_mutex_unlock(&pool->mutex);
+			readnum++;
 		}
 
-		/* write out the hunk */
-		err = write_hunk_from_memory(chd, hunknum, chd->cache);
+		/* wait for the oldest hunk */
+		slot = &pool->slot[writenum % pool->slots];
+		pthread_mutex_lock(&pool->mutex);
+		while (slot->state != SLOT_DONE)
+			pthread_cond_wait(&pool->donecond, &pool->mutex);
+		pthread_mutex_unlock(&pool->mutex);
+
+		/* progress */
+		update_compress_progress(chd, chdex->hunknum + writenum, &lastupdate, progress);
+
+		/* write out the hunk, or a reference to a matching one */
+		err = slot->err;
 		if (err != CHDERR_NONE)
-			SET_ERROR_AND_CLEANUP(err);
+			return err;
+		match_hunk(chd, chdex->hunknum + writenum, slot->data, &slot->entry);
+		err = write_hunk_entry(chd, chdex->hunknum + writenum, &slot->entry, slot->data, slot->compressed);
+		if (err != CHDERR_NONE)
+			return err;
 
 		/* update our CRC map */
-		if ((chd->map[hunknum].flags & MAP_ENTRY_FLAG_TYPE_MASK) != MAP_ENTRY_TYPE_SELF_HUNK &&
-			(chd->map[hunknum].flags & MAP_ENTRY_FLAG_TYPE_MASK) != MAP_ENTRY_TYPE_PARENT_HUNK)
-			add_to_crcmap(chd, hunknum);
+		update_crcmap(chd, chdex->hunknum + writenum);
 
-		/* prepare for the next hunk */
-		sourceoffset += chd->header.hunkbytes;
+		writenum++;
 	}
 
-	/* compute the final MD5/SHA1 values */
-	MD5Final(chd->header.md5, &md5);
-	sha1_final(&sha);
-	sha1_digest(&sha, SHA1_DIGEST_SIZE, chd->header.sha1);
+	return CHDERR_NONE;
+}
 
-	/* turn off the writeable flag and re-write the header */
-	chd->header.flags &= ~CHDFLAGS_IS_WRITEABLE;
-	err = write_header(chd->file, &chd->header);
-	if (err != CHDERR_NONE)
-		SET_ERROR_AND_CLEANUP(err);
+#endif
 
-	/* final progress update */
-	if (progress)
+
+static int compress_hunks(chd_exfile *chdex, compress_source *source, UINT32 hunkcount, void (*progress)(const char *, ...))
+{
+	chd_file *chd = chdex->chd;
+	clock_t lastupdate = 0;
+	UINT32 hunk;
+	int err;
+
+#ifdef USE_SMP
+	/* use the compression threads, if there is something to compress */
+	if (compress_threads > 1 && chd->header.compression != CHDCOMPRESSION_NONE)
 	{
-		UINT64 sourcepos = (UINT64)hunknum * chd->header.hunkbytes;
-		if (sourcepos)
-			(*progress)("Compression complete ... final ratio = %d%%            \n", 100 - multi_length(chd->file) * 100 / sourcepos);
+		compress_pool *pool = init_compress_pool(chd, compress_threads);
+		if (pool)
+		{
+			err = compress_hunks_threaded(pool, chdex, source, hunkcount, progress);
+			free_compress_pool(pool);
+			if (err != CHDERR_NONE)
+				return err;
+			chdex->hunknum += hunkcount;
+			return CHDERR_NONE;
+		}
 	}
+#endif
 
-	/* close the file */
-	multi_close(sourcefile);
-	return CHDERR_NONE;
+	for (hunk = 0; hunk < hunkcount; hunk++)
+	{
+		/* read the data */
+		read_source_hunk(chd, source, chd->cache);
 
-cleanup:
-	if (sourcefile)
-		multi_close(sourcefile);
-	return last_error;
+		/* progress */
+		update_compress_progress(chd, chdex->hunknum + hunk, &lastupdate, progress);
+
+		/* update the MD5/SHA1 */
+		update_source_checksum(chdex, chd->cache);
+
+		/* write out the hunk */
+		err = write_hunk_from_memory(chd, chdex->hunknum + hunk, chd->cache);
+		if (err != CHDERR_NONE)
+			return err;
+
+		/* update our CRC map */
+		update_crcmap(chd, chdex->hunknum + hunk);
+	}
+
+	chdex->hunknum += hunkcount;
+	return CHDERR_NONE;
 }
 
+
+
 /*************************************
  *
  *  All-in-one file verifier
@@ -1324,6 +1717,7 @@ static int validate_header(const chd_header *header)
 static int read_hunk_into_memory(chd_file *chd, UINT32 hunknum, UINT8 *dest)
 {
 	map_entry *entry = &chd->map[hunknum];
+	const UINT8 *src;
 	UINT32 bytes;
 	int err;
 
@@ -1333,10 +1727,16 @@ static int read_hunk_into_memory(chd_file *chd, UINT32 hunknum, UINT8 *dest)
 		/* compressed data */
 		case MAP_ENTRY_TYPE_COMPRESSED:
 
-			/* read it into the decompression buffer */
-			bytes = multi_read(chd->file, entry->offset, entry->length, chd->compressed);
-			if (bytes != entry->length)
-				return CHDERR_READ_ERROR;
+			/* decompress it from the mapped file, or read it into the decompression buffer */
+			if (chd->mapped && entry->offset + entry->length <= chd->mappedbytes)
+				src = chd->mapped + entry->offset;
+			else
+			{
+				bytes = multi_read(chd->file, entry->offset, entry->length, chd->compressed);
+				if (bytes != entry->length)
+					return CHDERR_READ_ERROR;
+				src = chd->compressed;
+			}
 
 			/* now decompress based on the compression method */
 			switch (chd->header.compression)
@@ -1347,7 +1747,7 @@ static int read_hunk_into_memory(chd_file *chd, UINT32 hunknum, UINT8 *dest)
 					zlib_codec_data *codec = chd->codecdata;
 
 					/* reset the decompressor */
-					codec->inflater.next_in = chd->compressed;
+					codec->inflater.next_in = (Bytef *)src;
 					codec->inflater.avail_in = entry->length;
 					codec->inflater.total_in = 0;
 					codec->inflater.next_out = dest;
@@ -1368,6 +1768,11 @@ static int read_hunk_into_memory(chd_file *chd, UINT32 hunknum, UINT8 *dest)
 
 		/* uncompressed data */
 		case MAP_ENTRY_TYPE_UNCOMPRESSED:
+			if (chd->mapped && entry->offset + chd->header.hunkbytes <= chd->mappedbytes)
+			{
+				memcpy(dest, chd->mapped + entry->offset, chd->header.hunkbytes);
+				break;
+			}
 			bytes = multi_read(chd->file, entry->offset, chd->header.hunkbytes, dest);
 			if (bytes != chd->header.hunkbytes)
 				return CHDERR_READ_ERROR;
@@ -1422,6 +1827,93 @@ static int read_hunk_into_cache(chd_file *chd, UINT32 hunknum)
 
 
 
+/*************************************
+ *
+ *  Mapped hunk access
+ *
+ *************************************/
+
+static const UINT8 *map_hunk(chd_file *chd, UINT32 hunknum)
+{
+	map_entry *entry = &chd->map[hunknum];
+	const UINT8 *data;
+
+	/* switch off the entry type */
+	switch (entry->flags & MAP_ENTRY_FLAG_TYPE_MASK)
+	{
+		/* uncompressed data, only if this file is mapped */
+		/* the references are followed also from an unmapped diff */
+		case MAP_ENTRY_TYPE_UNCOMPRESSED:
+			if (!chd->mapped || entry->offset + chd->header.hunkbytes > chd->mappedbytes)
+				return NULL;
+			data = chd->mapped + entry->offset;
+
+			/* validate the CRC the first time, errors are reported by chd_read() */
+			if (!(chd->verified[hunknum / 8] & (1 << (hunknum % 8))))
+			{
+				if (!(entry->flags & MAP_ENTRY_FLAG_NO_CRC) && entry->crc != crc32(0, data, chd->header.hunkbytes))
+					return NULL;
+				chd->verified[hunknum / 8] |= 1 << (hunknum % 8);
+			}
+			return data;
+
+		/* self-referenced data */
+		case MAP_ENTRY_TYPE_SELF_HUNK:
+			if (entry->offset >= chd->header.totalhunks || entry->offset == hunknum)
+				return NULL;
+			return map_hunk(chd, entry->offset);
+
+		/* parent-referenced data */
+		case MAP_ENTRY_TYPE_PARENT_HUNK:
+			if (!chd->parent || entry->offset >= chd->parent->header.totalhunks)
+				return NULL;
+			return map_hunk(chd->parent, entry->offset);
+	}
+
+	/* everything else must be decompressed */
+	return NULL;
+}
+
+
+static void map_file(chd_file *chd)
+{
+	UINT64 length;
+
+	if (!cur_interface.map || !cur_interface.unmap)
+		return;
+
+	/* the whole file must fit in the map */
+	length = multi_length(chd->file);
+	if (length == 0 || length > 0xffffffff)
+		return;
+
+	chd->verified = malloc((chd->header.totalhunks + 7) / 8);
+	if (!chd->verified)
+		return;
+	memset(chd->verified, 0, (chd->header.totalhunks + 7) / 8);
+
+	chd->mapped = (*cur_interface.map)(chd->file, 0, length);
+	if (!chd->mapped)
+	{
+		free(chd->verified);
+		chd->verified = NULL;
+		return;
+	}
+	chd->mappedbytes = length;
+}
+
+
+static void unmap_file(chd_file *chd)
+{
+	(*cur_interface.unmap)(chd->file, chd->mapped, chd->mappedbytes);
+	free(chd->verified);
+	chd->mapped = NULL;
+	chd->mappedbytes = 0;
+	chd->verified = NULL;
+}
+
+
+
 /*************************************
  *
  *  Hunk write/compress
@@ -1430,14 +1922,38 @@ static int read_hunk_into_cache(chd_file *chd, UINT32 hunknum)
 
 static int write_hunk_from_memory(chd_file *chd, UINT32 hunknum, const UINT8 *src)
 {
-	map_entry *entry = &chd->map[hunknum];
 	map_entry newentry;
-	UINT8 fileentry[MAP_ENTRY_SIZE];
-	const void *data = src;
-	UINT32 bytes, match;
 
 	/* first compute the CRC */
-	newentry.crc = crc32(0, &src[0], chd->header.hunkbytes);
+	init_hunk_entry(chd, src, &newentry);
+
+	/* compress the data only if we can't reference another hunk */
+	if (!match_hunk(chd, hunknum, src, &newentry))
+	{
+		int err = compress_hunk(chd, chd->codecdata, src, chd->compressed, &newentry);
+		if (err != CHDERR_NONE)
+			return err;
+	}
+
+	return write_hunk_entry(chd, hunknum, &newentry, src, chd->compressed);
+}
+
+
+/*
+    The steps below are split so that the CRC and the compression, which
+    only look at the hunk data, can run in the compression threads, while
+    the matching and the writing, which look at the file, stay in order.
+*/
+
+static void init_hunk_entry(chd_file *chd, const UINT8 *src, map_entry *newentry)
+{
+	UINT32 bytes;
+
+	/* first compute the CRC */
+	newentry->crc = crc32(0, &src[0], chd->header.hunkbytes);
+	newentry->offset = 0;
+	newentry->length = 0;
+	newentry->flags = MAP_ENTRY_TYPE_INVALID;
 
 	/* some extra stuff for zlib+ compression */
 	if (chd->header.compression == CHDCOMPRESSION_ZLIB_PLUS)
@@ -1450,40 +1966,57 @@ static int write_hunk_from_memory(chd_file *chd, UINT32 hunknum, const UINT8 *sr
 		/* if so, we don't need to write any data */
 		if (bytes == chd->header.hunkbytes)
 		{
-			newentry.offset = get_bigendian_uint64(&src[0]);
-			newentry.length = 0;
-			newentry.flags = MAP_ENTRY_TYPE_MINI;
-			goto write_entry;
+			newentry->offset = get_bigendian_uint64(&src[0]);
+			newentry->flags = MAP_ENTRY_TYPE_MINI;
 		}
+	}
+}
 
-		/* otherwise, see if we can find a match in the current file */
-		match = find_matching_hunk(chd, hunknum, newentry.crc, &src[0]);
-		if (match != NO_MATCH)
-		{
-			newentry.offset = match;
-			newentry.length = 0;
-			newentry.flags = MAP_ENTRY_TYPE_SELF_HUNK;
-			goto write_entry;
-		}
 
-		/* if we have a parent, see if we can find a match in there */
-		if (chd->header.flags & CHDFLAGS_HAS_PARENT)
+static int match_hunk(chd_file *chd, UINT32 hunknum, const UINT8 *src, map_entry *newentry)
+{
+	UINT32 match;
+
+	/* mini hunks don't need any data */
+	if ((newentry->flags & MAP_ENTRY_FLAG_TYPE_MASK) == MAP_ENTRY_TYPE_MINI)
+		return 1;
+
+	/* only zlib+ compression references other hunks */
+	if (chd->header.compression != CHDCOMPRESSION_ZLIB_PLUS)
+		return 0;
+
+	/* see if we can find a match in the current file */
+	match = find_matching_hunk(chd, hunknum, newentry->crc, &src[0]);
+	if (match != NO_MATCH)
+	{
+		newentry->offset = match;
+		newentry->length = 0;
+		newentry->flags = MAP_ENTRY_TYPE_SELF_HUNK;
+		return 1;
+	}
+
+	/* if we have a parent, see if we can find a match in there */
+	if (chd->header.flags & CHDFLAGS_HAS_PARENT)
+	{
+		match = find_matching_hunk(chd->parent, ~0, newentry->crc, &src[0]);
+		if (match != NO_MATCH)
 		{
-			match = find_matching_hunk(chd->parent, ~0, newentry.crc, &src[0]);
-			if (match != NO_MATCH)
-			{
-				newentry.offset = match;
-				newentry.length = 0;
-				newentry.flags = MAP_ENTRY_TYPE_PARENT_HUNK;
-				goto write_entry;
-			}
+			newentry->offset = match;
+			newentry->length = 0;
+			newentry->flags = MAP_ENTRY_TYPE_PARENT_HUNK;
+			return 1;
 		}
 	}
 
-	/* if we get here, we need to compress the data */
+	return 0;
+}
+
+
+static int compress_hunk(chd_file *chd, zlib_codec_data *codec, const UINT8 *src, UINT8 *dest, map_entry *newentry)
+{
 	/* first, fill in an uncompressed entry */
-	newentry.length = chd->header.hunkbytes;
-	newentry.flags = MAP_ENTRY_TYPE_UNCOMPRESSED;
+	newentry->length = chd->header.hunkbytes;
+	newentry->flags = MAP_ENTRY_TYPE_UNCOMPRESSED;
 
 	/* now try compressing the data */
 	switch (chd->header.compression)
@@ -1491,14 +2024,13 @@ static int write_hunk_from_memory(chd_file *chd, UINT32 hunknum, const UINT8 *sr
 		case CHDCOMPRESSION_ZLIB:
 		case CHDCOMPRESSION_ZLIB_PLUS:
 		{
-			zlib_codec_data *codec = chd->codecdata;
 			int err;
 
 			/* reset the decompressor */
 			codec->deflater.next_in = (void *)src;
 			codec->deflater.avail_in = chd->header.hunkbytes;
 			codec->deflater.total_in = 0;
-			codec->deflater.next_out = chd->compressed;
+			codec->deflater.next_out = dest;
 			codec->deflater.avail_out = chd->header.hunkbytes;
 			codec->deflater.total_out = 0;
 			err = deflateReset(&codec->deflater);
@@ -1509,29 +2041,44 @@ static int write_hunk_from_memory(chd_file *chd, UINT32 hunknum, const UINT8 *sr
 			err = deflate(&codec->deflater, Z_FINISH);
 
 			/* if we didn't run out of space, override the raw data with compressed */
-			if (err == Z_STREAM_END && codec->deflater.total_out < newentry.length)
+			if (err == Z_STREAM_END && codec->deflater.total_out < newentry->length)
 			{
-				data = chd->compressed;
-				newentry.length = codec->deflater.total_out;
-				newentry.flags = MAP_ENTRY_TYPE_COMPRESSED;
+				newentry->length = codec->deflater.total_out;
+				newentry->flags = MAP_ENTRY_TYPE_COMPRESSED;
 			}
 			break;
 		}
 	}
 
-	/* if the data doesn't fit into the previous entry, make a new one at the eof */
-	newentry.offset = entry->offset;
-	if (newentry.offset == 0 || newentry.length > entry->length)
-		newentry.offset = multi_length(chd->file);
+	return CHDERR_NONE;
+}
 
-	/* write the data */
-	bytes = multi_write(chd->file, newentry.offset, newentry.length, data);
-	if (bytes != newentry.length)
-		return CHDERR_WRITE_ERROR;
+
+static int write_hunk_entry(chd_file *chd, UINT32 hunknum, map_entry *newentry, const UINT8 *src, const UINT8 *compressed)
+{
+	map_entry *entry = &chd->map[hunknum];
+	UINT8 fileentry[MAP_ENTRY_SIZE];
+	UINT32 bytes;
+
+	/* write the data, if any */
+	if ((newentry->flags & MAP_ENTRY_FLAG_TYPE_MASK) == MAP_ENTRY_TYPE_UNCOMPRESSED ||
+		(newentry->flags & MAP_ENTRY_FLAG_TYPE_MASK) == MAP_ENTRY_TYPE_COMPRESSED)
+	{
+		const void *data = ((newentry->flags & MAP_ENTRY_FLAG_TYPE_MASK) == MAP_ENTRY_TYPE_COMPRESSED) ? compressed : src;
+
+		/* if the data doesn't fit into the previous entry, make a new one at the eof */
+		newentry->offset = entry->offset;
+		if (newentry->offset == 0 || newentry->length > entry->length)
+			newentry->offset = multi_length(chd->file);
+
+		/* write the data */
+		bytes = multi_write(chd->file, newentry->offset, newentry->length, data);
+		if (bytes != newentry->length)
+			return CHDERR_WRITE_ERROR;
+	}
 
 	/* update the entry in memory */
-write_entry:
-	*entry = newentry;
+	*entry = *newentry;
 
 	/* update the map on file */
 	assemble_map_entry(&fileentry[0], &chd->map[hunknum]);
@@ -1981,12 +2528,10 @@ int chd_compress_ex(chd_exfile *chdex, const char *rawfile, UINT64 offset,
 		UINT32 inpsecsize, UINT32 srcperhunk, UINT32 hunks_to_read,
 		UINT32 hunksecsize, void (*progress)(const char *, ...))
 {
-	chd_interface_file *sourcefile = NULL;
-	chd_file *chd;
-	clock_t lastupdate;
+	compress_source source;
 	int err;
-	UINT64 sourcefileoffset = 0;
-	int hunk, blksread = 0;
+
+	source.file = NULL;
 
 	/* punt if no interface */
 	if (!cur_interface.open)
@@ -1996,85 +2541,28 @@ int chd_compress_ex(chd_exfile *chdex, const char *rawfile, UINT64 offset,
 	if (!chdex || !rawfile)
 		SET_ERROR_AND_CLEANUP(CHDERR_INVALID_PARAMETER);
 
-	chd = chdex->chd;
-
 	/* open the raw file */
-	sourcefile = multi_open(rawfile, "rb");
-	if (!sourcefile)
+	source.file = multi_open(rawfile, "rb");
+	if (!source.file)
 		SET_ERROR_AND_CLEANUP(CHDERR_FILE_NOT_FOUND);
 
-	/* loop over source hunks until we run out */
-	lastupdate = 0;
-	for (hunk = 0; hunk < hunks_to_read; hunk++)
-	{
-		clock_t curtime = clock();
-		UINT32 bytestochecksum;
-		UINT32 bytesread;
-		int i;
-
-		/* read the data.  first, zero the whole hunk */
-		memset(chd->cache, 0, chd->header.hunkbytes);
-
-		/* read each frame to a maximum framesize boundry, automatically padding them out */
-		for (i = 0; i < srcperhunk; i++)
-		{
-			bytesread = multi_read(sourcefile, sourcefileoffset + offset, inpsecsize, &chd->cache[i*hunksecsize]);
-			/*
-               NOTE: because we pad CD tracks to a hunk boundry, there is a possibility
-               that we will run off the end of the sourcefile and bytesread will be zero.
-               because we already zero out the hunk beforehand above, no special processing
-               need take place here.
-            */
-
-			blksread++;
-			sourcefileoffset += inpsecsize;
-		}
-
-		/* progress */
-		if (curtime - lastupdate > CLOCKS_PER_SEC / 2)
-		{
-			UINT64 sourcepos = (UINT64)hunk+chdex->hunknum * chd->header.hunkbytes;
-			if (progress && sourcepos)
-				(*progress)("Compressing hunk %d/%d... (ratio=%d%%)  \r", hunk+chdex->hunknum, chd->header.totalhunks, 100 - multi_length(chd->file) * 100 / sourcepos);
-			lastupdate = curtime;
-		}
-
-		/* update the MD5/SHA1 */
-		bytestochecksum = chd->header.hunkbytes;
-		if (chdex->sourceoffset + chd->header.hunkbytes > chd->header.logicalbytes)
-		{
-			if (chdex->sourceoffset >= chd->header.logicalbytes)
-				bytestochecksum = 0;
-			else
-				bytestochecksum = chd->header.logicalbytes - chdex->sourceoffset;
-		}
-		if (bytestochecksum)
-		{
-			MD5Update(&chdex->md5, chd->cache, bytestochecksum);
-			sha1_update(&chdex->sha, bytestochecksum, chd->cache);
-		}
-
-		/* write out the hunk */
-		err = write_hunk_from_memory(chd, hunk + chdex->hunknum, chd->cache);
-		if (err != CHDERR_NONE)
-			SET_ERROR_AND_CLEANUP(err);
-
-		/* update our CRC map */
-		if ((chd->map[hunk + chdex->hunknum].flags & MAP_ENTRY_FLAG_TYPE_MASK) != MAP_ENTRY_TYPE_SELF_HUNK &&
-			(chd->map[hunk + chdex->hunknum].flags & MAP_ENTRY_FLAG_TYPE_MASK) != MAP_ENTRY_TYPE_PARENT_HUNK)
-			add_to_crcmap(chd, hunk + chdex->hunknum);
+	/* read each frame to a maximum framesize boundry, automatically padding them out */
+	source.offset = offset;
+	source.secsize = inpsecsize;
+	source.secstride = hunksecsize;
+	source.secperhunk = srcperhunk;
 
-		/* prepare for the next hunk */
-		chdex->sourceoffset += chd->header.hunkbytes;
-	}
-
-	chdex->hunknum += hunks_to_read;
+	/* loop over source hunks until we run out */
+	err = compress_hunks(chdex, &source, hunks_to_read, progress);
+	if (err != CHDERR_NONE)
+		SET_ERROR_AND_CLEANUP(err);
 
+	multi_close(source.file);
 	return CHDERR_NONE;
 
 cleanup:
-	if (sourcefile)
-		multi_close(sourcefile);
+	if (source.file)
+		multi_close(source.file);
 	return last_error;
 }
 
@@ -2288,6 +2776,50 @@ static void free_codec(chd_file *chd)
 
 
 
+/*************************************
+ *
+ *  Thread compressor init/de-init
+ *
+ *************************************/
+
+static zlib_codec_data *init_compressor(void)
+{
+	zlib_codec_data *data;
+
+	data = malloc(sizeof(zlib_codec_data));
+	if (!data)
+		return NULL;
+	memset(data, 0, sizeof(zlib_codec_data));
+
+	/* only the compression stream is needed */
+	data->deflater.zalloc = fast_alloc;
+	data->deflater.zfree = fast_free;
+	data->deflater.opaque = data;
+	if (deflateInit2(&data->deflater, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		free_compressor(data);
+		return NULL;
+	}
+
+	return data;
+}
+
+
+static void free_compressor(zlib_codec_data *data)
+{
+	int i;
+
+	deflateEnd(&data->deflater);
+
+	/* free our fast memory */
+	for (i = 0; i < MAX_ZLIB_ALLOCS; i++)
+		if (data->allocptr[i])
+			free(data->allocptr[i]);
+	free(data);
+}
+
+
+
 /*************************************
  *
  *  Multifile routines
@@ -176,6 +176,8 @@ struct _chd_interface
 	UINT32 (*read)(chd_interface_file *file, UINT64 offset, UINT32 count, void *buffer);
 	UINT32 (*write)(chd_interface_file *file, UINT64 offset, UINT32 count, const void *buffer);
 	UINT64 (*length)(chd_interface_file *file);
+	void *(*map)(chd_interface_file *file, UINT64 offset, UINT32 count);			/* optional, read-only map */
+	void (*unmap)(chd_interface_file *file, void *buffer, UINT32 count);		/* optional, release a map */
 };
 typedef struct _chd_interface chd_interface;
 
@@ -189,6 +191,7 @@ typedef struct _chd_interface chd_interface;
 
 void chd_set_interface(chd_interface *new_interface);
 void chd_save_interface(chd_interface *interface_save);
+void chd_set_compress_threads(int threads);
 
 int chd_create(const char *filename, UINT64 logicalbytes, UINT32 hunkbytes, UINT32 compression, chd_file *parent);
 chd_file *chd_open(const char *filename, int writeable, chd_file *parent);
@@ -200,6 +203,7 @@ int chd_set_metadata(chd_file *chd, UINT32 metatag, UINT32 metaindex, const void
 
 UINT32 chd_read(chd_file *chd, UINT32 hunknum, UINT32 hunkcount, void *buffer);
 UINT32 chd_write(chd_file *chd, UINT32 hunknum, UINT32 hunkcount, const void *buffer);
+const void *chd_map_hunk(chd_file *chd, UINT32 hunknum);
 
 int chd_get_last_error(void);
 const chd_header *chd_get_header(chd_file *chd);
@@ -15,6 +15,9 @@
 #include <stdio.h>
 #include <time.h>
 #include <ctype.h>
+#ifdef USE_SMP
+#include <unistd.h>
+#endif
 
 
 /***************************************************************************
@@ -1963,6 +1966,11 @@ int main(int argc, char **argv)
 	/* set the interface for everyone */
 	chd_set_interface(&chdman_interface);
 
+#if defined(USE_SMP) && defined(_SC_NPROCESSORS_ONLN)
+	/* compress with all the available processors */
+	chd_set_compress_threads(sysconf(_SC_NPROCESSORS_ONLN));
+#endif
+
 	/* handle the appropriate command */
 	if (!strcmp(argv[1], "-createhd"))
 		do_createhd(argc, argv);
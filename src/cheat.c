@@ -666,6 +666,11 @@ enum
 	kSearchComparison_Max = kSearchComparison_NearTo
 };
 
+enum
+{
+	kSearchBlockSize = 64	// number of candidates compared at once by DoSearch
+};
+
 enum
 {
 	kEnergy_Equals = 0,
@@ -757,6 +762,7 @@ struct SearchRegion
 
 	UINT8	* first;
 	UINT8	* last;
+	UINT8	* current;
 
 	UINT8	* status;
 
@@ -1223,6 +1229,9 @@ static UINT32	ReadSearchOperand(UINT8 type, SearchInfo * search, SearchRegion *
 static UINT32	ReadSearchOperandBit(UINT8 type, SearchInfo * search, SearchRegion * region, UINT32 address);
 static UINT8	DoSearchComparison(SearchInfo * search, UINT32 lhs, UINT32 rhs);
 static UINT32	DoSearchComparisonBit(SearchInfo * search, UINT32 lhs, UINT32 rhs);
+static void		ReadSearchOperandBlock(UINT8 type, SearchInfo * search, SearchRegion * region, UINT32 offset, UINT32 count, UINT32 * out);
+static void		DoSearchComparisonBlock(SearchInfo * search, const UINT32 * lhs, const UINT32 * rhs, UINT32 count, UINT8 * out);
+static UINT8	IsRegionBlockEmpty(SearchRegion * region, UINT32 offset, UINT32 length);
 //static UINT8  IsRegionOffsetValid(SearchInfo * search, SearchRegion * region, UINT32 offset);
 
 #define IsRegionOffsetValid	IsRegionOffsetValidBit
@@ -7827,6 +7836,7 @@ static void DisposeSearchRegions(SearchInfo * info)
 
 			free(region->first);
 			free(region->last);
+			free(region->current);
 			free(region->status);
 			free(region->backupLast);
 			free(region->backupStatus);
@@ -7869,11 +7879,34 @@ static void FillBufferFromRegion(SearchRegion * region, UINT8 * buf)
 {
 	UINT32	offset;
 
-	// ### optimize if needed
-
-	for(offset = 0; offset < region->length; offset++)
+	switch(region->targetType)
 	{
-		buf[offset] = ReadRegionData(region, offset, 1, 0);
+		case kRegionType_CPU:
+			// same as ReadRegionData, but switching the cpu context only once
+			cpuintrf_push_context(region->targetIdx);
+
+			for(offset = 0; offset < region->length; offset++)
+			{
+				buf[offset] = program_read_byte(region->address + offset);
+			}
+
+			cpuintrf_pop_context();
+			break;
+
+		case kRegionType_Memory:
+			// raw memory has no byte swapping
+			if(region->cachedPointer)
+				memcpy(buf, region->cachedPointer + region->address, region->length);
+			else
+				memset(buf, 0, region->length);
+			break;
+
+		default:
+			for(offset = 0; offset < region->length; offset++)
+			{
+				buf[offset] = ReadRegionData(region, offset, 1, 0);
+			}
+			break;
 	}
 }
 
@@ -8101,6 +8134,7 @@ static void AllocateSearchRegions(SearchInfo * info)
 
 		free(region->first);
 		free(region->last);
+		free(region->current);
 		free(region->status);
 		free(region->backupLast);
 		free(region->backupStatus);
@@ -8109,24 +8143,28 @@ static void AllocateSearchRegions(SearchInfo * info)
 		{
 			region->first =			malloc(region->length);
 			region->last =			malloc(region->length);
+			region->current =		malloc(region->length);
 			region->status =		malloc(region->length);
 			region->backupLast =	malloc(region->length);
 			region->backupStatus =	malloc(region->length);
 
 			if(	!region->first ||
 				!region->last ||
+				!region->current ||
 				!region->status ||
 				!region->backupLast ||
 				!region->backupStatus)
 			{
 				free(region->first);
 				free(region->last);
+				free(region->current);
 				free(region->status);
 				free(region->backupLast);
 				free(region->backupStatus);
 
 				region->first =			NULL;
 				region->last =			NULL;
+				region->current =		NULL;
 				region->status =		NULL;
 				region->backupLast =	NULL;
 				region->backupStatus =	NULL;
@@ -8138,6 +8176,7 @@ static void AllocateSearchRegions(SearchInfo * info)
 		{
 			region->first =			NULL;
 			region->last =			NULL;
+			region->current =		NULL;
 			region->status =		NULL;
 			region->backupLast =	NULL;
 			region->backupStatus =	NULL;
@@ -8173,6 +8212,7 @@ static void BuildSearchRegions(SearchInfo * info)
 
 				region->first = NULL;
 				region->last = NULL;
+				region->current = NULL;
 				region->status = NULL;
 
 				region->backupLast = NULL;
@@ -8221,6 +8261,7 @@ static void BuildSearchRegions(SearchInfo * info)
 
 						traverse->first = NULL;
 						traverse->last = NULL;
+						traverse->current = NULL;
 						traverse->status = NULL;
 
 						traverse->backupLast = NULL;
@@ -9084,6 +9125,261 @@ static UINT32 DoSearchComparisonBit(SearchInfo * search, UINT32 lhs, UINT32 rhs)
 	return 0;
 }
 
+/*--------------------------------------------------------------------------------------------------
+  ReadSearchOperandBlock - reads the operand of count candidates starting at the region offset
+                           same result of ReadSearchOperand/ReadSearchOperandBit, but all the
+                           memory operands are read from the region buffers. the current memory
+                           must be already copied in region->current
+--------------------------------------------------------------------------------------------------*/
+
+static void ReadSearchOperandBlock(UINT8 type, SearchInfo * search, SearchRegion * region, UINT32 offset, UINT32 count, UINT32 * out)
+{
+	UINT32	bytes = kSearchByteIncrementTable[search->bytes];
+	UINT32	step = kSearchByteStep[search->bytes];
+	UINT8	* buf = NULL;
+	UINT8	littleEndian = 0;
+	UINT32	signBit = 0;
+	UINT32	signExtend = 0;
+	UINT32	i;
+
+	switch(type)
+	{
+		case kSearchOperand_Current:
+			// DoCPURead and DoMemoryRead with rawCPUInfo
+			buf = region->current;
+			if(region->targetType == kRegionType_CPU)
+				littleEndian = CPUNeedsSwap(region->targetIdx) ^ search->swap;
+			else
+				littleEndian = search->swap;
+			break;
+
+		case kSearchOperand_Previous:
+		case kSearchOperand_First:
+			// DoMemoryRead without CPUInfo reads 2 and 4 bytes in the host order
+			buf = (type == kSearchOperand_Previous) ? region->last : region->first;
+			if(bytes == 3)
+				littleEndian = search->swap;
+			else
+#ifdef LSB_FIRST
+				littleEndian = search->swap ^ 1;
+#else
+				littleEndian = search->swap;
+#endif
+			break;
+
+		case kSearchOperand_Value:
+			{
+				UINT32	value;
+
+				if(search->bytes == kSearchSize_1Bit)
+					value = search->value ? 0xFFFFFFFF : 0x00000000;
+				else
+					value = search->value;
+
+				value = SearchSignExtend(search, value);
+
+				for(i = 0; i < count; i++)
+					out[i] = value;
+			}
+			return;
+
+		default:
+			for(i = 0; i < count; i++)
+				out[i] = 0;
+			return;
+	}
+
+	buf += offset;
+
+	switch(bytes)
+	{
+		case 1:
+			for(i = 0; i < count; i++)
+				out[i] = buf[i * step];
+			break;
+
+		case 2:
+			if(littleEndian)
+			{
+				for(i = 0; i < count; i++)
+					out[i] = buf[i * step] | (buf[i * step + 1] << 8);
+			}
+			else
+			{
+				for(i = 0; i < count; i++)
+					out[i] = (buf[i * step] << 8) | buf[i * step + 1];
+			}
+			break;
+
+		case 3:
+			if(littleEndian)
+			{
+				for(i = 0; i < count; i++)
+					out[i] = buf[i * step] | (buf[i * step + 1] << 8) | (buf[i * step + 2] << 16);
+			}
+			else
+			{
+				for(i = 0; i < count; i++)
+					out[i] = (buf[i * step] << 16) | (buf[i * step + 1] << 8) | buf[i * step + 2];
+			}
+			break;
+
+		case 4:
+			if(littleEndian)
+			{
+				for(i = 0; i < count; i++)
+					out[i] = buf[i * step] | (buf[i * step + 1] << 8) | (buf[i * step + 2] << 16) | ((UINT32)buf[i * step + 3] << 24);
+			}
+			else
+			{
+				for(i = 0; i < count; i++)
+					out[i] = ((UINT32)buf[i * step] << 24) | (buf[i * step + 1] << 16) | (buf[i * step + 2] << 8) | buf[i * step + 3];
+			}
+			break;
+	}
+
+	// SearchSignExtend
+	if(search->sign)
+	{
+		signBit = kSearchByteSignBitTable[search->bytes];
+		signExtend = ~kSearchByteUnsignedMaskTable[search->bytes];
+	}
+
+	if(signBit)
+	{
+		for(i = 0; i < count; i++)
+			out[i] |= (out[i] & signBit) ? signExtend : 0;
+	}
+}
+
+/*--------------------------------------------------------------------------------------------------
+  DoSearchComparisonBlock - DoSearchComparison for count operands
+                            every comparison has its own loop, simple enough to be vectorized
+--------------------------------------------------------------------------------------------------*/
+
+#define SEARCH_COMPARISON_LOOP(type, expr)				\
+	{													\
+		const type	* l = (const type *)lhs;			\
+		const type	* r = (const type *)rhs;			\
+														\
+		for(i = 0; i < count; i++)						\
+			out[i] = (expr);							\
+	}
+
+static void DoSearchComparisonBlock(SearchInfo * search, const UINT32 * lhs, const UINT32 * rhs, UINT32 count, UINT8 * out)
+{
+	INT32	svalue;
+	UINT32	i;
+
+	svalue = search->value;
+	if(search->value & kSearchByteSignBitTable[search->bytes])
+		svalue |= ~kSearchByteUnsignedMaskTable[search->bytes];
+
+	if(search->sign)
+	{
+		switch(search->comparison)
+		{
+			case kSearchComparison_LessThan:
+				SEARCH_COMPARISON_LOOP(INT32, l[i] < r[i])
+				return;
+
+			case kSearchComparison_GreaterThan:
+				SEARCH_COMPARISON_LOOP(INT32, l[i] > r[i])
+				return;
+
+			case kSearchComparison_EqualTo:
+				SEARCH_COMPARISON_LOOP(INT32, l[i] == r[i])
+				return;
+
+			case kSearchComparison_LessThanOrEqualTo:
+				SEARCH_COMPARISON_LOOP(INT32, l[i] <= r[i])
+				return;
+
+			case kSearchComparison_GreaterThanOrEqualTo:
+				SEARCH_COMPARISON_LOOP(INT32, l[i] >= r[i])
+				return;
+
+			case kSearchComparison_NotEqual:
+				SEARCH_COMPARISON_LOOP(INT32, l[i] != r[i])
+				return;
+
+			case kSearchComparison_IncreasedBy:
+				// computed as unsigned like in DoSearchComparison, the wraparound is the same
+				SEARCH_COMPARISON_LOOP(UINT32, l[i] == r[i] + (UINT32)svalue)
+				return;
+
+			case kSearchComparison_NearTo:
+				SEARCH_COMPARISON_LOOP(UINT32, (l[i] == r[i]) | (l[i] + 1 == r[i]))
+				return;
+		}
+	}
+	else
+	{
+		switch(search->comparison)
+		{
+			case kSearchComparison_LessThan:
+				SEARCH_COMPARISON_LOOP(UINT32, l[i] < r[i])
+				return;
+
+			case kSearchComparison_GreaterThan:
+				SEARCH_COMPARISON_LOOP(UINT32, l[i] > r[i])
+				return;
+
+			case kSearchComparison_EqualTo:
+				SEARCH_COMPARISON_LOOP(UINT32, l[i] == r[i])
+				return;
+
+			case kSearchComparison_LessThanOrEqualTo:
+				SEARCH_COMPARISON_LOOP(UINT32, l[i] <= r[i])
+				return;
+
+			case kSearchComparison_GreaterThanOrEqualTo:
+				SEARCH_COMPARISON_LOOP(UINT32, l[i] >= r[i])
+				return;
+
+			case kSearchComparison_NotEqual:
+				SEARCH_COMPARISON_LOOP(UINT32, l[i] != r[i])
+				return;
+
+			case kSearchComparison_IncreasedBy:
+				SEARCH_COMPARISON_LOOP(UINT32, l[i] == r[i] + (UINT32)svalue)
+				return;
+
+			case kSearchComparison_NearTo:
+				SEARCH_COMPARISON_LOOP(UINT32, (l[i] == r[i]) | (l[i] + 1 == r[i]))
+				return;
+		}
+	}
+
+	memset(out, 0, count);
+}
+
+#undef SEARCH_COMPARISON_LOOP
+
+/*--------------------------------------------------------------------------------------------------
+  IsRegionBlockEmpty - returns 1 if no candidate is left in the status bytes of the block
+--------------------------------------------------------------------------------------------------*/
+
+static UINT8 IsRegionBlockEmpty(SearchRegion * region, UINT32 offset, UINT32 length)
+{
+	const UINT8	* status = region->status + offset;
+	UINT32		i = 0;
+
+	for(; i + 8 <= length; i += 8)
+	{
+		if(*((UINT32 *)&status[i]) | *((UINT32 *)&status[i + 4]))
+			return 0;
+	}
+
+	for(; i < length; i++)
+	{
+		if(status[i])
+			return 0;
+	}
+
+	return 1;
+}
+
 /*
 static UINT8 IsRegionOffsetValid(SearchInfo * search, SearchRegion * region, UINT32 offset)
 {
@@ -9224,89 +9520,89 @@ static void UpdateSearch(SearchInfo * search)
 
 static void DoSearch(SearchInfo * search)
 {
-	int	i, j;
+	UINT32	lhs[kSearchBlockSize];
+	UINT32	rhs[kSearchBlockSize];
+	UINT8	match[kSearchBlockSize];
+	int		i;
 
 	search->numResults = 0;
 
-	if(search->bytes == kSearchSize_1Bit)
+	for(i = 0; i < search->regionListLength; i++)
 	{
-		for(i = 0; i < search->regionListLength; i++)
-		{
-			SearchRegion	* region = &search->regionList[i];
-			UINT32			lastAddress = region->length - kSearchByteIncrementTable[search->bytes] + 1;
-			UINT32			increment = kSearchByteStep[search->bytes];
+		SearchRegion	* region = &search->regionList[i];
+		UINT32			lastAddress = region->length - kSearchByteIncrementTable[search->bytes] + 1;
+		UINT32			increment = kSearchByteStep[search->bytes];
+		UINT32			j;
 
-			region->numResults = 0;
+		region->numResults = 0;
 
-			if(	(region->length < kSearchByteIncrementTable[search->bytes]) ||
-				!region->flags & kRegionFlag_Enabled)
-			{
-				continue;
-			}
+		if(	(region->length < kSearchByteIncrementTable[search->bytes]) ||
+			!region->flags & kRegionFlag_Enabled)
+		{
+			continue;
+		}
 
-			for(j = 0; j < lastAddress; j += increment)
-			{
-				UINT32	address;
-				UINT32	lhs, rhs;
+		// read the current memory only once
+		if(	(search->lhs == kSearchOperand_Current) ||
+			(search->rhs == kSearchOperand_Current))
+		{
+			FillBufferFromRegion(region, region->current);
+		}
 
-				address = region->address + j;
+		for(j = 0; j < lastAddress; j += kSearchBlockSize * increment)
+		{
+			UINT32	count = (lastAddress - j + increment - 1) / increment;
+			UINT32	k;
 
-				if(IsRegionOffsetValidBit(search, region, j))
-				{
-					UINT32	validBits;
+			if(count > kSearchBlockSize)
+				count = kSearchBlockSize;
 
-					lhs = ReadSearchOperandBit(search->lhs, search, region, address);
-					rhs = ReadSearchOperandBit(search->rhs, search, region, address);
+			// skip quickly the blocks without candidates
+			if(IsRegionBlockEmpty(region, j, count * increment))
+				continue;
 
-					validBits = DoSearchComparisonBit(search, lhs, rhs);
+			ReadSearchOperandBlock(search->lhs, search, region, j, count, lhs);
+			ReadSearchOperandBlock(search->rhs, search, region, j, count, rhs);
 
-					InvalidateRegionOffsetBit(search, region, j, ~validBits);
+			if(search->bytes == kSearchSize_1Bit)
+			{
+				for(k = 0; k < count; k++)
+				{
+					UINT32	offset = j + k * increment;
 
-					if(IsRegionOffsetValidBit(search, region, j))
+					if(IsRegionOffsetValidBit(search, region, offset))
 					{
-						search->numResults++;
-						region->numResults++;
-					}
-				}
-			}
-		}
-	}
-	else
-	{
-		for(i = 0; i < search->regionListLength; i++)
-		{
-			SearchRegion	* region = &search->regionList[i];
-			UINT32			lastAddress = region->length - kSearchByteIncrementTable[search->bytes] + 1;
-			UINT32			increment = kSearchByteStep[search->bytes];
+						UINT32	validBits = DoSearchComparisonBit(search, lhs[k], rhs[k]);
 
-			region->numResults = 0;
+						InvalidateRegionOffsetBit(search, region, offset, ~validBits);
 
-			if(	(region->length < kSearchByteIncrementTable[search->bytes]) ||
-				!region->flags & kRegionFlag_Enabled)
-			{
-				continue;
+						if(IsRegionOffsetValidBit(search, region, offset))
+						{
+							search->numResults++;
+							region->numResults++;
+						}
+					}
+				}
 			}
-
-			for(j = 0; j < lastAddress; j += increment)
+			else
 			{
-				UINT32	address;
-				UINT32	lhs, rhs;
+				DoSearchComparisonBlock(search, lhs, rhs, count, match);
 
-				address = region->address + j;
-
-				if(IsRegionOffsetValid(search, region, j))
+				for(k = 0; k < count; k++)
 				{
-					lhs = ReadSearchOperand(search->lhs, search, region, address);
-					rhs = ReadSearchOperand(search->rhs, search, region, address);
+					UINT32	offset = j + k * increment;
 
-					if(!DoSearchComparison(search, lhs, rhs))
+					if(IsRegionOffsetValid(search, region, offset))
 					{
-						InvalidateRegionOffset(search, region, j);
-					}
-					else
-					{
-						search->numResults++;
-						region->numResults++;
+						if(!match[k])
+						{
+							InvalidateRegionOffset(search, region, offset);
+						}
+						else
+						{
+							search->numResults++;
+							region->numResults++;
+						}
 					}
 				}
 			}
@@ -23,6 +23,7 @@ COREOBJS = \
 	$(OBJ)/chd.o \
 	$(OBJ)/cheat.o \
 	$(OBJ)/config.o \
+	$(OBJ)/cpubench.o \
 	$(OBJ)/cpuexec.o \
 	$(OBJ)/cpuint.o \
 	$(OBJ)/cpuintrf.o \
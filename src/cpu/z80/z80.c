@@ -104,6 +104,16 @@
 #define BIG_SWITCH			1
 #endif
 
+/* dispatch main opcodes with computed gotos, each opcode jumping directly */
+/* to the next one, if the compiler supports taking the address of labels */
+#ifndef THREADED_CODE
+#if defined(__GNUC__) && BIG_SWITCH
+#define THREADED_CODE		1
+#else
+#define THREADED_CODE		0
+#endif
+#endif
+
 /* big flags array for ADD/ADC/SUB/SBC/CP results */
 #define BIG_FLAGS_ARRAY		1
 
@@ -559,6 +569,66 @@ INLINE void BURNODD(int cycles, int opcodes, int cyclesum)
 #endif
 
 
+#if THREADED_CODE
+/***************************************************************
+ * apply a macro to all the opcode numbers
+ ***************************************************************/
+#define ALL_OPCODES(M) \
+	M(00) M(01) M(02) M(03) M(04) M(05) M(06) M(07) \
+	M(08) M(09) M(0a) M(0b) M(0c) M(0d) M(0e) M(0f) \
+	M(10) M(11) M(12) M(13) M(14) M(15) M(16) M(17) \
+	M(18) M(19) M(1a) M(1b) M(1c) M(1d) M(1e) M(1f) \
+	M(20) M(21) M(22) M(23) M(24) M(25) M(26) M(27) \
+	M(28) M(29) M(2a) M(2b) M(2c) M(2d) M(2e) M(2f) \
+	M(30) M(31) M(32) M(33) M(34) M(35) M(36) M(37) \
+	M(38) M(39) M(3a) M(3b) M(3c) M(3d) M(3e) M(3f) \
+	M(40) M(41) M(42) M(43) M(44) M(45) M(46) M(47) \
+	M(48) M(49) M(4a) M(4b) M(4c) M(4d) M(4e) M(4f) \
+	M(50) M(51) M(52) M(53) M(54) M(55) M(56) M(57) \
+	M(58) M(59) M(5a) M(5b) M(5c) M(5d) M(5e) M(5f) \
+	M(60) M(61) M(62) M(63) M(64) M(65) M(66) M(67) \
+	M(68) M(69) M(6a) M(6b) M(6c) M(6d) M(6e) M(6f) \
+	M(70) M(71) M(72) M(73) M(74) M(75) M(76) M(77) \
+	M(78) M(79) M(7a) M(7b) M(7c) M(7d) M(7e) M(7f) \
+	M(80) M(81) M(82) M(83) M(84) M(85) M(86) M(87) \
+	M(88) M(89) M(8a) M(8b) M(8c) M(8d) M(8e) M(8f) \
+	M(90) M(91) M(92) M(93) M(94) M(95) M(96) M(97) \
+	M(98) M(99) M(9a) M(9b) M(9c) M(9d) M(9e) M(9f) \
+	M(a0) M(a1) M(a2) M(a3) M(a4) M(a5) M(a6) M(a7) \
+	M(a8) M(a9) M(aa) M(ab) M(ac) M(ad) M(ae) M(af) \
+	M(b0) M(b1) M(b2) M(b3) M(b4) M(b5) M(b6) M(b7) \
+	M(b8) M(b9) M(ba) M(bb) M(bc) M(bd) M(be) M(bf) \
+	M(c0) M(c1) M(c2) M(c3) M(c4) M(c5) M(c6) M(c7) \
+	M(c8) M(c9) M(ca) M(cb) M(cc) M(cd) M(ce) M(cf) \
+	M(d0) M(d1) M(d2) M(d3) M(d4) M(d5) M(d6) M(d7) \
+	M(d8) M(d9) M(da) M(db) M(dc) M(dd) M(de) M(df) \
+	M(e0) M(e1) M(e2) M(e3) M(e4) M(e5) M(e6) M(e7) \
+	M(e8) M(e9) M(ea) M(eb) M(ec) M(ed) M(ee) M(ef) \
+	M(f0) M(f1) M(f2) M(f3) M(f4) M(f5) M(f6) M(f7) \
+	M(f8) M(f9) M(fa) M(fb) M(fc) M(fd) M(fe) M(ff)
+
+
+/***************************************************************
+ * fetch and dispatch the next main opcode, if there are
+ * cycles left; this is replicated at the end of every opcode
+ * to give each one its own indirect jump
+ ***************************************************************/
+#define THREADED_DISPATCH										\
+{																\
+	if( z80_ICount <= 0 )										\
+		goto done;												\
+	PRVPC = PCD;												\
+	CALL_MAME_DEBUG;											\
+	R++;														\
+	op = ROP();													\
+	CC(op,op);													\
+	goto *op_labels[op];										\
+}
+
+#define THREADED_LABEL(opcode) &&label_##opcode,
+#define THREADED_OP(opcode) label_##opcode: op_##opcode(); THREADED_DISPATCH
+#endif
+
 /***************************************************************
  * Enter HALT state; write 1 to fake port on first execution
  ***************************************************************/
@@ -623,7 +693,7 @@ INLINE void WM16( UINT32 addr, PAIR *r )
  * reading opcodes. In case of system with memory mapped I/O,
  * this function can be used to greatly speed up emulation
  ***************************************************************/
-INLINE UINT8 ROP(void)
+INLINE UINT8 ATTR_FORCE_INLINE ROP(void)
 {
 	unsigned pc = PCD;
 	PC++;
@@ -636,14 +706,14 @@ INLINE UINT8 ROP(void)
  * support systems that use different encoding mechanisms for
  * opcodes and opcode arguments
  ***************************************************************/
-INLINE UINT8 ARG(void)
+INLINE UINT8 ATTR_FORCE_INLINE ARG(void)
 {
 	unsigned pc = PCD;
 	PC++;
 	return cpu_readop_arg(pc);
 }
 
-INLINE UINT32 ARG16(void)
+INLINE UINT32 ATTR_FORCE_INLINE ARG16(void)
 {
 	unsigned pc = PCD;
 	PC += 2;
@@ -3895,6 +3965,23 @@ static int z80_execute(int cycles)
 	z80_ICount = cycles - Z80.extra_cycles;
 	Z80.extra_cycles = 0;
 
+#if THREADED_CODE
+	{
+		static const void *const op_labels[0x100] = { ALL_OPCODES(THREADED_LABEL) };
+		unsigned op;
+
+		/* like the loop below, always execute at least one opcode */
+		PRVPC = PCD;
+		CALL_MAME_DEBUG;
+		R++;
+		op = ROP();
+		CC(op,op);
+		goto *op_labels[op];
+
+		ALL_OPCODES(THREADED_OP)
+	}
+done:
+#else
 	do
 	{
 		PRVPC = PCD;
@@ -3902,6 +3989,7 @@ static int z80_execute(int cycles)
 		R++;
 		EXEC_INLINE(op,ROP());
 	} while( z80_ICount > 0 );
+#endif
 
 	z80_ICount -= Z80.extra_cycles;
 	Z80.extra_cycles = 0;
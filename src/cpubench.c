@@ -0,0 +1,433 @@
+/***************************************************************************
+
+    cpubench.c
+
+    CPU core micro-benchmarks.
+
+    Every benchmarked CPU runs alone against a flat RAM address map with a
+    small window of counting handlers, executing short canned loops that
+    stress the ALU, the branches and the memory accesses.
+
+    Copyright (c) 1996-2006, Nicola Salmoria and the MAME Team.
+    Visit http://mamedev.org for licensing and usage restrictions.
+
+***************************************************************************/
+
+#include "driver.h"
+#include "cpubench.h"
+
+
+
+/***************************************************************************
+    CONSTANTS
+***************************************************************************/
+
+/* emulated cycles run for every instruction mix */
+#define BENCH_CYCLES			50000000
+
+/* cycles run by each cpunum_execute() call */
+#define BENCH_SLICE				10000
+
+#define BENCH_MAX_MIXES			3
+
+
+
+/***************************************************************************
+    TYPE DEFINITIONS
+***************************************************************************/
+
+typedef struct _bench_mix bench_mix;
+struct _bench_mix
+{
+	const char *		name;				/* name of the mix */
+	const UINT8 *		code;				/* program loaded at the CPU entry point */
+	int					length;				/* length of the program */
+	int					instructions;		/* instructions executed by one loop */
+	int					cycles;				/* nominal cycles of one loop */
+};
+
+
+typedef struct _bench_cpu bench_cpu;
+struct _bench_cpu
+{
+	int					type;				/* CPU type */
+	construct_map_t		map;				/* program address map */
+	offs_t				entry;				/* address of the program */
+	offs_t				vector_base;		/* address of the reset vectors */
+	const UINT8 *		vector;				/* reset vectors, NULL if none */
+	int					vector_length;
+	bench_mix			mix[BENCH_MAX_MIXES];
+};
+
+
+typedef struct _bench_run bench_run;
+struct _bench_run
+{
+	FILE *				out;				/* where to report */
+	const bench_cpu *	cpu;				/* CPU to run */
+	const bench_mix *	mix;				/* mix to run */
+};
+
+
+
+/***************************************************************************
+    GLOBALS
+***************************************************************************/
+
+static running_machine bench_machine;
+static machine_config bench_drv;
+
+static const game_driver bench_gamedrv =
+{
+	__FILE__,
+	NULL,
+	"cpubench",
+	NULL,
+	"CPU benchmark",
+	"2017",
+	"none",
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+#ifdef MESS
+	NULL,
+	NULL,
+#endif
+	NOT_A_DRIVER
+};
+
+/* handler calls done by the running mix */
+static UINT32 bench_reads;
+static UINT32 bench_writes;
+
+
+
+/***************************************************************************
+    ADDRESS MAPS
+***************************************************************************/
+
+static READ8_HANDLER( bench_r )
+{
+	bench_reads++;
+	return 0;
+}
+
+static WRITE8_HANDLER( bench_w )
+{
+	bench_writes++;
+}
+
+static READ16_HANDLER( bench16_r )
+{
+	bench_reads++;
+	return 0;
+}
+
+static WRITE16_HANDLER( bench16_w )
+{
+	bench_writes++;
+}
+
+static ADDRESS_MAP_START( bench8_map, ADDRESS_SPACE_PROGRAM, 8 )
+	AM_RANGE(0x0000, 0xefff) AM_RAM
+	AM_RANGE(0xf000, 0xf0ff) AM_READWRITE(bench_r, bench_w)
+	AM_RANGE(0xf100, 0xffff) AM_RAM
+ADDRESS_MAP_END
+
+static ADDRESS_MAP_START( bench16_map, ADDRESS_SPACE_PROGRAM, 16 )
+	AM_RANGE(0x000000, 0x00ffff) AM_RAM
+	AM_RANGE(0x010000, 0x0100ff) AM_READWRITE(bench16_r, bench16_w)
+ADDRESS_MAP_END
+
+
+
+/***************************************************************************
+    INSTRUCTION MIXES
+***************************************************************************/
+
+#if (HAS_Z80)
+static const UINT8 z80_alu[] =
+{
+	0x80,					/* loop: add a,b */
+	0xa9,					/* xor c */
+	0x14,					/* inc d */
+	0xa3,					/* and e */
+	0xb4,					/* or h */
+	0x95,					/* sub l */
+	0x2f,					/* cpl */
+	0x87,					/* add a,a */
+	0x1c,					/* inc e */
+	0x05,					/* dec b */
+	0xc3, 0x00, 0x00		/* jp loop */
+};
+
+static const UINT8 z80_branch[] =
+{
+	0x31, 0x00, 0xe0,		/* ld sp,$e000 */
+	0x06, 0x10,				/* loop: ld b,16 */
+	0x10, 0xfe,				/* djnz $ */
+	0xcd, 0x0d, 0x00,		/* call sub */
+	0xc3, 0x03, 0x00,		/* jp loop */
+	0xc9					/* sub: ret */
+};
+
+static const UINT8 z80_memory[] =
+{
+	0x31, 0x00, 0xe0,		/* ld sp,$e000 */
+	0x21, 0x00, 0x80,		/* ld hl,$8000 */
+	0x11, 0x00, 0x90,		/* ld de,$9000 */
+	0x7e,					/* loop: ld a,(hl) */
+	0x12,					/* ld (de),a */
+	0x2c,					/* inc l */
+	0x1c,					/* inc e */
+	0x3a, 0x00, 0xf0,		/* ld a,($f000) */
+	0x32, 0x01, 0xf0,		/* ld ($f001),a */
+	0xe5,					/* push hl */
+	0xe1,					/* pop hl */
+	0xc3, 0x09, 0x00		/* jp loop */
+};
+#endif
+
+#if (HAS_M6502)
+static const UINT8 m6502_vector[] = { 0x00, 0x02 };
+
+static const UINT8 m6502_alu[] =
+{
+	0x18,					/* loop: clc */
+	0x69, 0x01,				/* adc #$01 */
+	0x29, 0x7f,				/* and #$7f */
+	0x49, 0x55,				/* eor #$55 */
+	0x09, 0x01,				/* ora #$01 */
+	0xe8,					/* inx */
+	0xc8,					/* iny */
+	0x0a,					/* asl a */
+	0x4a,					/* lsr a */
+	0x4c, 0x00, 0x02		/* jmp loop */
+};
+
+static const UINT8 m6502_branch[] =
+{
+	0xa2, 0x10,				/* loop: ldx #16 */
+	0xca,					/* inner: dex */
+	0xd0, 0xfd,				/* bne inner */
+	0x20, 0x0b, 0x02,		/* jsr sub */
+	0x4c, 0x00, 0x02,		/* jmp loop */
+	0x60					/* sub: rts */
+};
+
+static const UINT8 m6502_memory[] =
+{
+	0xbd, 0x00, 0x10,		/* loop: lda $1000,x */
+	0x9d, 0x00, 0x20,		/* sta $2000,x */
+	0xad, 0x00, 0xf0,		/* lda $f000 */
+	0x8d, 0x01, 0xf0,		/* sta $f001 */
+	0xe6, 0x10,				/* inc $10 */
+	0xe8,					/* inx */
+	0x4c, 0x00, 0x02		/* jmp loop */
+};
+#endif
+
+#if (HAS_M68000)
+static const UINT8 m68000_vector[] = { 0x00, 0x00, 0xff, 0xf0, 0x00, 0x00, 0x04, 0x00 };
+
+static const UINT8 m68000_alu[] =
+{
+	0xd0, 0x81,				/* loop: add.l d1,d0 */
+	0xb3, 0x82,				/* eor.l d1,d2 */
+	0xc0, 0x83,				/* and.l d3,d0 */
+	0x52, 0x84,				/* addq.l #1,d4 */
+	0x44, 0x80,				/* neg.l d0 */
+	0xe3, 0x88,				/* lsl.l #1,d0 */
+	0x80, 0x81,				/* or.l d1,d0 */
+	0x4e, 0xf8, 0x04, 0x00	/* jmp loop.w */
+};
+
+static const UINT8 m68000_branch[] =
+{
+	0x7e, 0x0f,				/* loop: moveq #15,d7 */
+	0x51, 0xcf, 0xff, 0xfe,	/* dbf d7,$ */
+	0x61, 0x00, 0x00, 0x06,	/* bsr.w sub */
+	0x4e, 0xf8, 0x04, 0x00,	/* jmp loop.w */
+	0x4e, 0x75				/* sub: rts */
+};
+
+static const UINT8 m68000_memory[] =
+{
+	0x41, 0xf8, 0x20, 0x00,	/* loop: lea $2000.w,a0 */
+	0x43, 0xf8, 0x40, 0x00,	/* lea $4000.w,a1 */
+	0x22, 0xd8,				/* move.l (a0)+,(a1)+ */
+	0x22, 0xd8,				/* move.l (a0)+,(a1)+ */
+	0x30, 0x39, 0x00, 0x01, 0x00, 0x00,	/* move.w $10000.l,d0 */
+	0x33, 0xc0, 0x00, 0x01, 0x00, 0x02,	/* move.w d0,$10002.l */
+	0x4e, 0xf8, 0x04, 0x00	/* jmp loop.w */
+};
+#endif
+
+#define MIX(name, code, instructions, cycles) { name, code, sizeof(code), instructions, cycles }
+
+static const bench_cpu bench_cpus[] =
+{
+#if (HAS_Z80)
+	{ CPU_Z80, construct_map_bench8_map, 0x0000, 0, NULL, 0, {
+		MIX("alu", z80_alu, 11, 50),
+		MIX("branch", z80_branch, 20, 247),
+		MIX("memory", z80_memory, 9, 79) } },
+#endif
+#if (HAS_M6502)
+	{ CPU_M6502, construct_map_bench8_map, 0x0200, 0xfffc, m6502_vector, sizeof(m6502_vector), {
+		MIX("alu", m6502_alu, 10, 21),
+		MIX("branch", m6502_branch, 36, 96),
+		MIX("memory", m6502_memory, 7, 27) } },
+#endif
+#if (HAS_M68000)
+	{ CPU_M68000, construct_map_bench16_map, 0x0400, 0x0000, m68000_vector, sizeof(m68000_vector), {
+		MIX("alu", m68000_alu, 8, 66),
+		MIX("branch", m68000_branch, 20, 212),
+		MIX("memory", m68000_memory, 7, 98) } },
+#endif
+	{ CPU_DUMMY }
+};
+
+
+
+/***************************************************************************
+    BENCHMARK
+***************************************************************************/
+
+/*-------------------------------------------------
+    bench_irq_callback - no interrupt is ever
+    raised
+-------------------------------------------------*/
+
+static int bench_irq_callback(int irqline)
+{
+	return 0;
+}
+
+
+/*-------------------------------------------------
+    bench_load - copy a block in the program
+    space of the CPU
+-------------------------------------------------*/
+
+static void bench_load(offs_t address, const UINT8 *data, int length)
+{
+	int i;
+
+	cpuintrf_push_context(0);
+	for (i = 0; i < length; i++)
+		program_write_byte(address + i, data[i]);
+	cpuintrf_pop_context();
+}
+
+
+/*-------------------------------------------------
+    bench_run_mix - set up a machine with only
+    the given CPU and run one mix on it
+-------------------------------------------------*/
+
+static int bench_run_mix(void *param)
+{
+	const bench_run *run = param;
+	const bench_cpu *bench = run->cpu;
+	const bench_mix *mix = run->mix;
+	cycles_t start, stop;
+	double seconds;
+	INT64 total = 0;
+	INT64 instructions;
+
+	/* build a machine with only our CPU */
+	memset(&bench_drv, 0, sizeof(bench_drv));
+	bench_drv.cpu[0].cpu_type = bench->type;
+	bench_drv.cpu[0].cpu_clock = 1000000;
+	bench_drv.cpu[0].construct_map[ADDRESS_SPACE_PROGRAM][0] = bench->map;
+
+	memset(&bench_machine, 0, sizeof(bench_machine));
+	bench_machine.gamedrv = &bench_gamedrv;
+	bench_machine.drv = &bench_drv;
+	Machine = &bench_machine;
+
+	cpuintrf_init();
+	state_init();
+	state_save_allow_registration(TRUE);
+	if (memory_init() != 0)
+	{
+		fprintf(run->out, "%-10s %-8s memory_init failed\n", cputype_name(bench->type), mix->name);
+		Machine = NULL;
+		return 1;
+	}
+	cpuintrf_init_cpu(0, bench->type, bench_drv.cpu[0].cpu_clock, NULL, bench_irq_callback);
+
+	/* load the program and reset into it */
+	bench_load(bench->entry, mix->code, mix->length);
+	if (bench->vector)
+		bench_load(bench->vector_base, bench->vector, bench->vector_length);
+	cpunum_reset(0);
+
+	bench_reads = 0;
+	bench_writes = 0;
+
+	start = osd_cycles();
+	while (total < BENCH_CYCLES)
+		total += cpunum_execute(0, BENCH_SLICE);
+	stop = osd_cycles();
+
+	seconds = (double)(stop - start) / (double)osd_cycles_per_second();
+	if (seconds <= 0)
+		seconds = 1E-9;
+	instructions = total * mix->instructions / mix->cycles;
+
+	fprintf(run->out, "%-10s %-8s %10.2f %10.2f %10u %10u\n",
+		cputype_name(bench->type), mix->name,
+		(double)total / seconds / 1E6,
+		instructions ? seconds * 1E9 / (double)instructions : 0.0,
+		bench_reads, bench_writes);
+
+	cpuintrf_exit_cpu(0);
+	Machine = NULL;
+	return 0;
+}
+
+
+/*-------------------------------------------------
+    cpu_benchmark - run the instruction mixes on
+    all the benchmarked CPUs
+-------------------------------------------------*/
+
+int cpu_benchmark(FILE *out, const char *cpuname)
+{
+	const bench_cpu *bench;
+	bench_run run;
+	int found = 0;
+	int result = 0;
+	int i;
+
+	cpuintrf_init();
+
+	fprintf(out, "%-10s %-8s %10s %10s %10s %10s\n", "cpu", "mix", "MHz", "ns/instr", "reads", "writes");
+
+	for (bench = bench_cpus; bench->type != CPU_DUMMY; bench++)
+	{
+		if (cpuname && mame_stricmp(cpuname, cputype_name(bench->type)) != 0)
+			continue;
+		found = 1;
+
+		/* every mix runs on a fresh machine, torn down by the exit callbacks */
+		for (i = 0; i < BENCH_MAX_MIXES && bench->mix[i].name; i++)
+		{
+			run.out = out;
+			run.cpu = bench;
+			run.mix = &bench->mix[i];
+			result |= run_standalone(bench_run_mix, &run);
+		}
+	}
+
+	if (!found)
+	{
+		fprintf(out, "No benchmark for the CPU '%s'\n", cpuname);
+		return 1;
+	}
+
+	return result;
+}
@@ -0,0 +1,21 @@
+/***************************************************************************
+
+    cpubench.h
+
+    CPU core micro-benchmarks.
+
+    Copyright (c) 1996-2006, Nicola Salmoria and the MAME Team.
+    Visit http://mamedev.org for licensing and usage restrictions.
+
+***************************************************************************/
+
+#ifndef __CPUBENCH_H__
+#define __CPUBENCH_H__
+
+#include "mamecore.h"
+#include <stdio.h>
+
+/* run all the benchmarks, or only the ones of the named CPU if not NULL */
+int cpu_benchmark(FILE *out, const char *cpuname);
+
+#endif	/* __CPUBENCH_H__ */
@@ -14,6 +14,14 @@
 #include "driver.h"
 #include "profiler.h"
 
+#if defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_DRAWGFX_VECTOR
+#elif defined(__GNUC__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define USE_DRAWGFX_VECTOR
+#endif
+
 
 /***************************************************************************
     CONSTANTS
@@ -88,6 +96,156 @@ INLINE int readbit(const UINT8 *src, int bitnum)
 }
 
 
+#ifdef USE_DRAWGFX_VECTOR
+
+/*-------------------------------------------------
+    transpen_mask16 - return a mask with bit n
+    set if the pixel n of 16 is not transparent
+-------------------------------------------------*/
+
+INLINE UINT32 transpen_mask16(const UINT8 *src, int transpen)
+{
+#if defined(__SSE2__)
+	__m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)src), _mm_set1_epi8(transpen));
+
+	return ~_mm_movemask_epi8(eq) & 0xffff;
+#else
+	static const UINT8 bit[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+	uint8x16_t eq = vandq_u8(vceqq_u8(vld1q_u8(src), vdupq_n_u8(transpen)), vld1q_u8(bit));
+	uint8x8_t lo = vget_low_u8(eq);
+	uint8x8_t hi = vget_high_u8(eq);
+
+	lo = vpadd_u8(lo, lo);
+	lo = vpadd_u8(lo, lo);
+	lo = vpadd_u8(lo, lo);
+	hi = vpadd_u8(hi, hi);
+	hi = vpadd_u8(hi, hi);
+	hi = vpadd_u8(hi, hi);
+
+	return ~(vget_lane_u8(lo, 0) | (vget_lane_u8(hi, 0) << 8)) & 0xffff;
+#endif
+}
+
+
+/*-------------------------------------------------
+    transpen_copyN - copy the non transparent
+    pixels of a row 16 bytes at a time, and
+    return the number of pixels done; with flipx
+    the source is read backward from src
+-------------------------------------------------*/
+
+#if defined(__SSE2__)
+
+#define TRANSPEN_COPY(name, type, count_per_vec, set1, cmpeq, reverse)			\
+INLINE int name(type *dst, const type *src, int count, int transpen, int flipx)	\
+{																				\
+	__m128i trans = set1(transpen);												\
+	int done = 0;																\
+																				\
+	if (flipx)																	\
+		src -= count_per_vec - 1;												\
+																				\
+	for ( ; done + count_per_vec <= count; done += count_per_vec)				\
+	{																			\
+		__m128i s = _mm_loadu_si128((const __m128i *)src);						\
+		__m128i d = _mm_loadu_si128((const __m128i *)dst);						\
+		__m128i m;																\
+																				\
+		if (flipx)																\
+		{																		\
+			s = reverse(s);														\
+			src -= count_per_vec;												\
+		}																		\
+		else																	\
+			src += count_per_vec;												\
+																				\
+		m = cmpeq(s, trans);													\
+		_mm_storeu_si128((__m128i *)dst, _mm_or_si128(_mm_and_si128(m, d), _mm_andnot_si128(m, s)));	\
+		dst += count_per_vec;													\
+	}																			\
+																				\
+	return done;																\
+}
+
+INLINE __m128i reverse8(__m128i v)
+{
+	v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+	v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0x1b), 0x1b);
+	return _mm_shuffle_epi32(v, 0x4e);
+}
+
+INLINE __m128i reverse16(__m128i v)
+{
+	v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0x1b), 0x1b);
+	return _mm_shuffle_epi32(v, 0x4e);
+}
+
+INLINE __m128i reverse32(__m128i v)
+{
+	return _mm_shuffle_epi32(v, 0x1b);
+}
+
+TRANSPEN_COPY(transpen_copy8, UINT8, 16, _mm_set1_epi8, _mm_cmpeq_epi8, reverse8)
+TRANSPEN_COPY(transpen_copy16, UINT16, 8, _mm_set1_epi16, _mm_cmpeq_epi16, reverse16)
+TRANSPEN_COPY(transpen_copy32, UINT32, 4, _mm_set1_epi32, _mm_cmpeq_epi32, reverse32)
+
+#else
+
+#define TRANSPEN_COPY(name, type, count_per_vec, vtype, load, store, dup, ceq, bsl, reverse)	\
+INLINE int name(type *dst, const type *src, int count, int transpen, int flipx)	\
+{																				\
+	vtype trans = dup(transpen);												\
+	int done = 0;																\
+																				\
+	if (flipx)																	\
+		src -= count_per_vec - 1;												\
+																				\
+	for ( ; done + count_per_vec <= count; done += count_per_vec)				\
+	{																			\
+		vtype s = load(src);													\
+																				\
+		if (flipx)																\
+		{																		\
+			s = reverse(s);														\
+			src -= count_per_vec;												\
+		}																		\
+		else																	\
+			src += count_per_vec;												\
+																				\
+		store(dst, bsl(ceq(s, trans), load(dst), s));							\
+		dst += count_per_vec;													\
+	}																			\
+																				\
+	return done;																\
+}
+
+INLINE uint8x16_t reverse8(uint8x16_t v)
+{
+	v = vrev64q_u8(v);
+	return vextq_u8(v, v, 8);
+}
+
+INLINE uint16x8_t reverse16(uint16x8_t v)
+{
+	v = vrev64q_u16(v);
+	return vextq_u16(v, v, 4);
+}
+
+INLINE uint32x4_t reverse32(uint32x4_t v)
+{
+	v = vrev64q_u32(v);
+	return vextq_u32(v, v, 2);
+}
+
+TRANSPEN_COPY(transpen_copy8, UINT8, 16, uint8x16_t, vld1q_u8, vst1q_u8, vdupq_n_u8, vceqq_u8, vbslq_u8, reverse8)
+TRANSPEN_COPY(transpen_copy16, UINT16, 8, uint16x8_t, vld1q_u16, vst1q_u16, vdupq_n_u16, vceqq_u16, vbslq_u16, reverse16)
+TRANSPEN_COPY(transpen_copy32, UINT32, 4, uint32x4_t, vld1q_u32, vst1q_u32, vdupq_n_u32, vceqq_u32, vbslq_u32, reverse32)
+
+#endif
+
+#endif
+
+
 
 /***************************************************************************
 
@@ -382,6 +540,13 @@ INLINE void blockmove_NtoN_transpen_noremap8(
 	while (srcheight)
 	{
 		end = dstdata + srcwidth;
+#ifdef USE_DRAWGFX_VECTOR
+		{
+			int done = transpen_copy8(dstdata, srcdata, srcwidth, transpen, 0);
+			srcdata += done;
+			dstdata += done;
+		}
+#endif
 		while (((long)srcdata & 3) && dstdata < end)	/* longword align */
 		{
 			int col;
@@ -450,6 +615,13 @@ INLINE void blockmove_NtoN_transpen_noremap_flipx8(
 	while (srcheight)
 	{
 		end = dstdata + srcwidth;
+#ifdef USE_DRAWGFX_VECTOR
+		{
+			int done = transpen_copy8(dstdata, srcdata + 3, srcwidth, transpen, 1);
+			srcdata -= done;
+			dstdata += done;
+		}
+#endif
 		while (((long)srcdata & 3) && dstdata < end)	/* longword align */
 		{
 			int col;
@@ -507,6 +679,13 @@ INLINE void blockmove_NtoN_transpen_noremap16(
 	while (srcheight)
 	{
 		end = dstdata + srcwidth;
+#ifdef USE_DRAWGFX_VECTOR
+		{
+			int done = transpen_copy16(dstdata, srcdata, srcwidth, transpen, 0);
+			srcdata += done;
+			dstdata += done;
+		}
+#endif
 		while (dstdata < end)
 		{
 			int col;
@@ -536,6 +715,13 @@ INLINE void blockmove_NtoN_transpen_noremap_flipx16(
 	while (srcheight)
 	{
 		end = dstdata + srcwidth;
+#ifdef USE_DRAWGFX_VECTOR
+		{
+			int done = transpen_copy16(dstdata, srcdata, srcwidth, transpen, 1);
+			srcdata -= done;
+			dstdata += done;
+		}
+#endif
 		while (dstdata < end)
 		{
 			int col;
@@ -564,6 +750,13 @@ INLINE void blockmove_NtoN_transpen_noremap32(
 	while (srcheight)
 	{
 		end = dstdata + srcwidth;
+#ifdef USE_DRAWGFX_VECTOR
+		{
+			int done = transpen_copy32(dstdata, srcdata, srcwidth, transpen, 0);
+			srcdata += done;
+			dstdata += done;
+		}
+#endif
 		while (dstdata < end)
 		{
 			int col;
@@ -593,6 +786,13 @@ INLINE void blockmove_NtoN_transpen_noremap_flipx32(
 	while (srcheight)
 	{
 		end = dstdata + srcwidth;
+#ifdef USE_DRAWGFX_VECTOR
+		{
+			int done = transpen_copy32(dstdata, srcdata, srcwidth, transpen, 1);
+			srcdata -= done;
+			dstdata += done;
+		}
+#endif
 		while (dstdata < end)
 		{
 			int col;
@@ -3840,6 +4040,33 @@ DECLARE_SWAP_RAW_PRI(blockmove_8toN_transpen,(COMMON_ARGS,
 		while (dstheight)
 		{
 			end = dstdata - dstwidth*HMODULO;
+#ifdef USE_DRAWGFX_VECTOR
+			while (dstdata >= end + 16*HMODULO)
+			{
+				UINT32 mask = transpen_mask16(srcdata, transpen);
+
+				if (mask == 0xffff)
+				{
+					int i;
+
+					/* all opaque, no need to test the pixels */
+					for (i = 0; i < 16; i++)
+						SETPIXELCOLOR(-i*HMODULO,LOOKUP(srcdata[i]))
+				}
+				else
+				{
+					while (mask)
+					{
+						int i = __builtin_ctz(mask);
+
+						SETPIXELCOLOR(-i*HMODULO,LOOKUP(srcdata[i]))
+						mask &= mask - 1;
+					}
+				}
+				srcdata += 16;
+				INCREMENT_DST(-16*HMODULO)
+			}
+#endif
 			while (((long)srcdata & 3) && dstdata > end)	/* longword align */
 			{
 				int col;
@@ -3891,6 +4118,33 @@ DECLARE_SWAP_RAW_PRI(blockmove_8toN_transpen,(COMMON_ARGS,
 		while (dstheight)
 		{
 			end = dstdata + dstwidth*HMODULO;
+#ifdef USE_DRAWGFX_VECTOR
+			while (dstdata <= end - 16*HMODULO)
+			{
+				UINT32 mask = transpen_mask16(srcdata, transpen);
+
+				if (mask == 0xffff)
+				{
+					int i;
+
+					/* all opaque, no need to test the pixels */
+					for (i = 0; i < 16; i++)
+						SETPIXELCOLOR(i*HMODULO,LOOKUP(srcdata[i]))
+				}
+				else
+				{
+					while (mask)
+					{
+						int i = __builtin_ctz(mask);
+
+						SETPIXELCOLOR(i*HMODULO,LOOKUP(srcdata[i]))
+						mask &= mask - 1;
+					}
+				}
+				srcdata += 16;
+				INCREMENT_DST(16*HMODULO)
+			}
+#endif
 			while (((long)srcdata & 3) && dstdata < end)	/* longword align */
 			{
 				int col;
@@ -49,6 +49,7 @@
 
 #define FILEFLAG_OPENREAD		0x0001
 #define FILEFLAG_OPENWRITE		0x0002
+#define FILEFLAG_DEFER			0x0010
 #define FILEFLAG_HASH			0x0100
 #define FILEFLAG_REVERSE_SEARCH	0x0200
 #define FILEFLAG_VERIFY_ONLY	0x0400
@@ -66,6 +67,10 @@
 #define DEBUG_COOKIE			0xbaadf00d
 #endif
 
+#define HASHCACHE_NAME			"romhash"
+#define HASHCACHE_HEADER		"romhash 2"
+#define HASHCACHE_HASH_SIZE		4096
+
 
 
 /***************************************************************************
@@ -86,6 +91,28 @@ struct _mame_file
 	UINT8		type;
 	char		hash[HASH_BUF_SIZE];
 	int			back_char; /* Buffered char for unget. EOF for empty. */
+	UINT8		pending;	/* data not yet inflated and hashed */
+	UINT8		mapped;		/* data is mapped with osd_fmap */
+	UINT8 *		rawdata;	/* compressed data of a pending ZIPPED_FILE */
+	UINT32		rawlength;	/* length of the compressed data */
+	unsigned int hashfunctions;	/* hash functions to compute on completion */
+	UINT8		discard;	/* free the data after computing the hash */
+	char *		cachekey;	/* hash cache key of the file */
+	UINT32		cachesize;	/* hash cache stamp of the file */
+	UINT64		cachetime;
+};
+
+
+/* hash cache entry, the checksums of an unzipped ROM file indexed
+   by its full path and validated by its size and modification time */
+typedef struct _hashcache_entry hashcache_entry;
+struct _hashcache_entry
+{
+	hashcache_entry *next;
+	char *		key;
+	UINT32		size;
+	UINT64		time;
+	char		hash[HASH_BUF_SIZE];
 };
 
 
@@ -98,6 +125,10 @@ struct _mame_file
 int mess_ghost_images;
 #endif
 
+static hashcache_entry *hashcache_map[HASHCACHE_HASH_SIZE];
+static int hashcache_loaded;
+static int hashcache_dirty;
+
 
 
 /***************************************************************************
@@ -107,11 +138,16 @@ int mess_ghost_images;
 static mame_file *generic_fopen(int pathtype, const char *gamename, const char *filename, const char *hash, UINT32 flags, osd_file_error *error);
 static const char *get_extension_for_filetype(int filetype);
 static int checksum_file(int pathtype, int pathindex, const char *file, UINT8 **p, UINT64 *size, char* hash);
+static int checksum_file_cached(int pathtype, int pathindex, const char *file, mame_file *mfile, UINT32 flags);
+static void hashcache_store(const char *key, UINT32 size, UINT64 time, const char *hash);
+static void hashcache_save(void);
 static chd_interface_file *chd_open_cb(const char *filename, const char *mode);
 static void chd_close_cb(chd_interface_file *file);
 static UINT32 chd_read_cb(chd_interface_file *file, UINT64 offset, UINT32 count, void *buffer);
 static UINT32 chd_write_cb(chd_interface_file *file, UINT64 offset, UINT32 count, const void *buffer);
 static UINT64 chd_length_cb(chd_interface_file *file);
+static void *chd_map_cb(chd_interface_file *file, UINT64 offset, UINT32 count);
+static void chd_unmap_cb(chd_interface_file *file, void *buffer, UINT32 count);
 
 
 
@@ -125,7 +161,9 @@ static chd_interface mame_chd_interface =
 	chd_close_cb,
 	chd_read_cb,
 	chd_write_cb,
-	chd_length_cb
+	chd_length_cb,
+	chd_map_cb,
+	chd_unmap_cb
 };
 
 
@@ -149,6 +187,7 @@ void fileio_init(void)
 void fileio_exit(void)
 {
 	unzip_cache_clear();
+	hashcache_save();
 }
 
 
@@ -201,6 +240,7 @@ mame_file *mame_fopen_error(const char *gamename, const char *filename, int file
 		case FILETYPE_CTRLR:
 		case FILETYPE_LANGUAGE:
 		case FILETYPE_HIGHSCORE_DB:
+		case FILETYPE_HASHCACHE:
 			return generic_fopen(filetype, NULL, filename, 0, openforwrite ? FILEFLAG_OPENWRITE : FILEFLAG_OPENREAD, error);
 
 		/* game-specific files that live in a single directory */
@@ -326,6 +366,78 @@ mame_file *mame_fopen_rom(const char *gamename, const char *filename, const char
 }
 
 
+/*-------------------------------------------------
+    mame_fopen_rom_deferred - similar to
+    mame_fopen_rom, but only reads the raw data;
+    decompression and hashing are left to
+    mame_fcomplete
+-------------------------------------------------*/
+
+mame_file *mame_fopen_rom_deferred(const char *gamename, const char *filename, const char *exphash)
+{
+	return generic_fopen(FILETYPE_ROM, gamename, filename, exphash, FILEFLAG_OPENREAD | FILEFLAG_HASH | FILEFLAG_DEFER, NULL);
+}
+
+
+/*-------------------------------------------------
+    mame_fopen_checksum_deferred - similar to
+    mame_fchecksum, but it leaves the hashing of
+    the unzipped files to mame_fcomplete
+-------------------------------------------------*/
+
+mame_file *mame_fopen_checksum_deferred(const char *gamename, const char *filename, const char *exphash)
+{
+	return generic_fopen(FILETYPE_ROM, gamename, filename, exphash, FILEFLAG_OPENREAD | FILEFLAG_HASH | FILEFLAG_VERIFY_ONLY | FILEFLAG_DEFER, NULL);
+}
+
+
+/*-------------------------------------------------
+    mame_fcomplete - inflate and hash the data
+    of a file opened with mame_fopen_rom_deferred;
+    it touches only the file itself, so different
+    files can be completed concurrently
+-------------------------------------------------*/
+
+int mame_fcomplete(mame_file *file)
+{
+	if (!file->pending)
+		return 0;
+
+	file->pending = 0;
+
+	/* inflate the compressed data */
+	if (file->rawdata)
+	{
+		file->data = malloc(file->length ? file->length : 1);
+		if (file->data && inflate_zipped_data(file->rawdata, file->rawlength, file->data, file->length) != 0)
+		{
+			free(file->data);
+			file->data = NULL;
+		}
+
+		free(file->rawdata);
+		file->rawdata = NULL;
+
+		if (!file->data)
+		{
+			file->length = 0;
+			return -1;
+		}
+	}
+
+	hash_compute(file->hash, file->data, file->length, file->hashfunctions);
+
+	/* the data of a verify only file is not needed anymore */
+	if (file->discard)
+	{
+		free(file->data);
+		file->data = NULL;
+	}
+
+	return 0;
+}
+
+
 /*-------------------------------------------------
     mame_fclose - closes a file
 -------------------------------------------------*/
@@ -346,11 +458,23 @@ void mame_fclose(mame_file *file)
 
 		case ZIPPED_FILE:
 		case RAM_FILE:
-			if (file->data)
+			if (file->data && file->mapped)
+				osd_funmap(file->data, file->length);
+			else if (file->data)
 				free(file->data);
+			if (file->rawdata)
+				free(file->rawdata);
 			break;
 	}
 
+	/* remember the checksums of the file */
+	if (file->cachekey)
+	{
+		if (!file->pending && file->hash[0])
+			hashcache_store(file->cachekey, file->cachesize, file->cachetime, file->hash);
+		free(file->cachekey);
+	}
+
 	/* free the file data */
 	free(file);
 }
@@ -424,6 +548,10 @@ UINT32 mame_fread(mame_file *file, void *buffer, UINT32 length)
 	/* flush any buffered char */
 	file->back_char = EOF;
 
+	/* finish a deferred open */
+	if (file->pending)
+		mame_fcomplete(file);
+
 	/* switch off the file type */
 	switch (file->type)
 	{
@@ -568,6 +696,10 @@ UINT64 mame_fsize(mame_file *file)
 
 const char *mame_fhash(mame_file *file)
 {
+	/* finish a deferred open */
+	if (file->pending)
+		mame_fcomplete(file);
+
 	return file->hash;
 }
 
@@ -588,6 +720,10 @@ int mame_fgetc(mame_file *file)
 		return buffer;
 	}
 
+	/* finish a deferred open */
+	if (file->pending)
+		mame_fcomplete(file);
+
 	/* switch off the file type */
 	switch (file->type)
 	{
@@ -967,6 +1103,10 @@ static const char *get_extension_for_filetype(int filetype)
 			extension = "cmt";
 			break;
 
+		case FILETYPE_HASHCACHE:	/* ROM hash cache */
+			extension = "dat";
+			break;
+
 #ifdef MESS
 		case FILETYPE_HASH:
 			extension = "hsi";
@@ -1064,12 +1204,24 @@ static mame_file *generic_fopen(int pathtype, const char *gamename, const char *
 			/* now look for path/gamename/filename.ext */
 			compose_path(name, sizeof(name), gamename, filename, extension);
 
+			/* verify-only case, the checksums may come from the hash cache */
+			if ((flags & FILEFLAG_HASH) && (flags & FILEFLAG_VERIFY_ONLY))
+			{
+				if (checksum_file_cached(pathtype, pathindex, name, &file, flags) == 0)
+					break;
+			}
+
 			/* if we need checksums, load it into RAM and compute it along the way */
-			if (flags & FILEFLAG_HASH)
+			else if (flags & FILEFLAG_HASH)
 			{
-				if (checksum_file(pathtype, pathindex, name, &file.data, &file.length, file.hash) == 0)
+				if (checksum_file(pathtype, pathindex, name, &file.data, &file.length, (flags & FILEFLAG_DEFER) ? NULL : file.hash) == 0)
 				{
 					file.type = RAM_FILE;
+					if (flags & FILEFLAG_DEFER)
+					{
+						file.pending = 1;
+						file.hashfunctions = hash_data_used_functions(file.hash);
+					}
 					break;
 				}
 			}
@@ -1204,6 +1356,42 @@ static mame_file *generic_fopen(int pathtype, const char *gamename, const char *
 					}
 				}
 
+				/* deferred load case, read the raw data and leave the rest to mame_fcomplete() */
+				else if (flags & FILEFLAG_DEFER)
+				{
+					int err;
+					int mapped;
+
+					err = load_zipped_file_raw(pathtype, pathindex, name, tempname, &file.rawdata, &file.rawlength, &ziplength, &mapped);
+
+					/* load by CRC, as below */
+					if (err && hash)
+					{
+						char crcn[9];
+
+						if (hash_data_extract_printable_checksum(hash, HASH_CRC, crcn) != 0)
+							err = load_zipped_file_raw(pathtype, pathindex, name, crcn, &file.rawdata, &file.rawlength, &ziplength, &mapped);
+					}
+
+					if (err == 0)
+					{
+						VPRINTF(("Using (mame_fopen) zip file for %s\n", filename));
+						file.length = ziplength;
+						file.type = ZIPPED_FILE;
+						file.pending = 1;
+						file.hashfunctions = hash_data_used_functions(hash);
+
+						/* stored entries are already in their final form */
+						if (file.rawlength == 0)
+						{
+							file.data = file.rawdata;
+							file.rawdata = NULL;
+							file.mapped = mapped;
+						}
+						break;
+					}
+				}
+
 				/* full load case */
 				else
 				{
@@ -1324,9 +1512,13 @@ static int checksum_file(int pathtype, int pathindex, const char *file, UINT8 **
 
 	/* compute the checksums (only the functions for which we have an expected
        checksum). Take also care of crconly: if the user asked, we will calculate
-       only the CRC, but only if there is an expected CRC for this file. */
-	functions = hash_data_used_functions(hash);
-	hash_compute(hash, data, length, functions);
+       only the CRC, but only if there is an expected CRC for this file.
+       A NULL hash means that the caller computes them later. */
+	if (hash)
+	{
+		functions = hash_data_used_functions(hash);
+		hash_compute(hash, data, length, functions);
+	}
 
 	/* if the caller wants the data, give it away, otherwise free it */
 	if (p)
@@ -1340,6 +1532,214 @@ static int checksum_file(int pathtype, int pathindex, const char *file, UINT8 **
 }
 
 
+/*-------------------------------------------------
+    hashcache_bucket - hash of a cache key
+-------------------------------------------------*/
+
+static unsigned hashcache_bucket(const char *key)
+{
+	unsigned h = 0;
+
+	while (*key)
+		h = h * 33 + (UINT8)*key++;
+
+	return h % HASHCACHE_HASH_SIZE;
+}
+
+
+/*-------------------------------------------------
+    hashcache_insert - add or replace an entry
+    of the hash cache
+-------------------------------------------------*/
+
+static void hashcache_insert(const char *key, UINT32 size, UINT64 time, const char *hash)
+{
+	unsigned h = hashcache_bucket(key);
+	hashcache_entry *entry;
+
+	for (entry = hashcache_map[h]; entry; entry = entry->next)
+		if (strcmp(entry->key, key) == 0)
+			break;
+
+	if (!entry)
+	{
+		entry = malloc(sizeof(*entry));
+		if (!entry)
+			return;
+		entry->key = malloc(strlen(key) + 1);
+		if (!entry->key)
+		{
+			free(entry);
+			return;
+		}
+		strcpy(entry->key, key);
+		entry->next = hashcache_map[h];
+		hashcache_map[h] = entry;
+	}
+
+	entry->size = size;
+	entry->time = time;
+	hash_data_copy(entry->hash, hash);
+}
+
+
+/*-------------------------------------------------
+    hashcache_load - read the hash cache file,
+    one "size time hash path" line for each file
+    after the header; the time is written as 16
+    hex digits
+-------------------------------------------------*/
+
+static void hashcache_load(void)
+{
+	mame_file *f;
+	char line[1024 + HASH_BUF_SIZE];
+
+	hashcache_loaded = 1;
+
+	f = mame_fopen(NULL, HASHCACHE_NAME, FILETYPE_HASHCACHE, 0);
+	if (!f)
+		return;
+
+	/* ignore the files of a different format */
+	if (!mame_fgets(line, sizeof(line), f) || strncmp(line, HASHCACHE_HEADER, strlen(HASHCACHE_HEADER)) != 0)
+	{
+		mame_fclose(f);
+		return;
+	}
+
+	while (mame_fgets(line, sizeof(line), f))
+	{
+		char hash[HASH_BUF_SIZE];
+		unsigned size, time_hi, time_lo;
+		int pos;
+		char *key;
+
+		if (sscanf(line, "%u %8x%8x %255s %n", &size, &time_hi, &time_lo, hash, &pos) != 4)
+			continue;
+
+		key = line + pos;
+		key[strcspn(key, "\r\n")] = 0;
+		if (!*key || !hash_verify_string(hash))
+			continue;
+
+		hashcache_insert(key, size, ((UINT64)time_hi << 32) | time_lo, hash);
+	}
+
+	mame_fclose(f);
+}
+
+
+/*-------------------------------------------------
+    hashcache_save - write the hash cache file
+    if modified, and release it
+-------------------------------------------------*/
+
+static void hashcache_save(void)
+{
+	int i;
+
+	if (hashcache_dirty)
+	{
+		mame_file *f = mame_fopen(NULL, HASHCACHE_NAME, FILETYPE_HASHCACHE, 1);
+		if (f)
+		{
+			mame_fprintf(f, "%s\n", HASHCACHE_HEADER);
+			for (i = 0; i < HASHCACHE_HASH_SIZE; i++)
+			{
+				hashcache_entry *entry;
+				for (entry = hashcache_map[i]; entry; entry = entry->next)
+					mame_fprintf(f, "%u %08x%08x %s %s\n", entry->size, (UINT32)(entry->time >> 32), (UINT32)entry->time, entry->hash, entry->key);
+			}
+			mame_fclose(f);
+		}
+		hashcache_dirty = 0;
+	}
+
+	for (i = 0; i < HASHCACHE_HASH_SIZE; i++)
+		while (hashcache_map[i])
+		{
+			hashcache_entry *entry = hashcache_map[i];
+			hashcache_map[i] = entry->next;
+			free(entry->key);
+			free(entry);
+		}
+
+	hashcache_loaded = 0;
+}
+
+
+/*-------------------------------------------------
+    hashcache_store - remember the checksums of
+    a file
+-------------------------------------------------*/
+
+static void hashcache_store(const char *key, UINT32 size, UINT64 time, const char *hash)
+{
+	hashcache_insert(key, size, time, hash);
+	hashcache_dirty = 1;
+}
+
+
+/*-------------------------------------------------
+    checksum_file_cached - get the checksums of
+    a file, from the hash cache if the file is
+    unchanged; otherwise the file is loaded and
+    the checksums are stored at mame_fclose
+-------------------------------------------------*/
+
+static int checksum_file_cached(int pathtype, int pathindex, const char *file, mame_file *mfile, UINT32 flags)
+{
+	hashcache_entry *entry;
+	UINT64 size, time;
+	char key[1024];
+
+	/* the key is the full path, the same name may be a different file in another rompath */
+	if (osd_get_file_stamp(pathtype, pathindex, file, key, sizeof(key), &size, &time) != 0)
+		return -1;
+
+	if (!hashcache_loaded)
+		hashcache_load();
+
+	for (entry = hashcache_map[hashcache_bucket(key)]; entry; entry = entry->next)
+		if (strcmp(entry->key, key) == 0)
+			break;
+
+	/* unchanged file */
+	if (entry && entry->size == size && entry->time == time)
+	{
+		mfile->type = RAM_FILE;
+		mfile->length = size;
+		hash_data_copy(mfile->hash, entry->hash);
+		return 0;
+	}
+
+	/* load the file, computing all the checksums now or later */
+	if (checksum_file(pathtype, pathindex, file, &mfile->data, &mfile->length, (flags & FILEFLAG_DEFER) ? NULL : mfile->hash) != 0)
+		return -1;
+
+	mfile->type = RAM_FILE;
+	mfile->discard = 1;
+	if (flags & FILEFLAG_DEFER)
+	{
+		mfile->pending = 1;
+		mfile->hashfunctions = 0;
+	}
+	else
+	{
+		free(mfile->data);
+		mfile->data = NULL;
+	}
+
+	mfile->cachekey = malloc(strlen(key) + 1);
+	if (mfile->cachekey)
+		strcpy(mfile->cachekey, key);
+	mfile->cachesize = size;
+	mfile->cachetime = time;
+	return 0;
+}
+
+
 /*-------------------------------------------------
     chd_open_cb - interface for opening
     a hard disk image
@@ -1411,3 +1811,31 @@ UINT64 chd_length_cb(chd_interface_file *file)
 {
 	return mame_fsize((mame_file *)file);
 }
+
+
+/*-------------------------------------------------
+    chd_map_cb - interface for mapping in
+    memory a read-only hard disk image
+-------------------------------------------------*/
+
+void *chd_map_cb(chd_interface_file *file, UINT64 offset, UINT32 count)
+{
+	mame_file *mfile = (mame_file *)file;
+
+	/* only plain files can be mapped */
+	if (mfile->type != PLAIN_FILE)
+		return NULL;
+
+	return osd_fmap(mfile->file, offset, count);
+}
+
+
+/*-------------------------------------------------
+    chd_unmap_cb - interface for releasing a
+    mapped hard disk image
+-------------------------------------------------*/
+
+void chd_unmap_cb(chd_interface_file *file, void *buffer, UINT32 count)
+{
+	osd_funmap(buffer, count);
+}
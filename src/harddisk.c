@@ -153,6 +153,14 @@ UINT32 hard_disk_read(hard_disk_file *file, UINT32 lbasector, UINT32 numsectors,
 	/* if we haven't cached this hunk, read it now */
 	if (file->cachehunk != hunknum)
 	{
+		/* if the hunk is mapped in memory, copy the sector directly */
+		const UINT8 *data = chd_map_hunk(file->chd, hunknum);
+		if (data)
+		{
+			memcpy(buffer, &data[sectoroffs * file->info.sectorbytes], file->info.sectorbytes);
+			return 1;
+		}
+
 		if (!chd_read(file->chd, hunknum, 1, file->cache))
 			return 0;
 		file->cachehunk = hunknum;
@@ -257,6 +257,10 @@ static void hiscore_save (void)
 /* call hiscore_update periodically (i.e. once per frame) */
 static void hiscore_periodic (int param)
 {
+	/* the frames emulated ahead are discarded */
+	if (mame_is_running_ahead())
+		return;
+
 	if (state.mem_range)
 	{
 		if (!state.hiscores_have_been_loaded)
@@ -30,103 +30,102 @@ void print_game_device(FILE* out, const game_driver* game);
 void print_game_ramoptions(FILE* out, const game_driver* game);
 #endif /* MESS */
 
-/* Print a free format string */
-static const char *normalize_string(const char* s)
+/* Print a free format string, escaping the XML special chars */
+static void print_free_string(FILE *out, const char* s)
 {
-	static char buffer[1024];
-	char *d = &buffer[0];
+	const char* run;
+
+	if (!s)
+		return;
 
-	if (s)
+	/* the runs of plain chars are written at once */
+	run = s;
+	while (*s)
 	{
-		while (*s)
+		if (*s>=' ' && *s<='~' && *s!='\"' && *s!='&' && *s!='<' && *s!='>')
 		{
-			switch (*s)
-			{
-				case '\"' : d += sprintf(d, "&quot;"); break;
-				case '&'  : d += sprintf(d, "&amp;"); break;
-				case '<'  : d += sprintf(d, "&lt;"); break;
-				case '>'  : d += sprintf(d, "&gt;"); break;
-				default:
-					if (*s>=' ' && *s<='~')
-						*d++ = *s;
-					else
-						d += sprintf(d, "&#%d;", (unsigned)(unsigned char)*s);
-			}
 			++s;
+			continue;
 		}
-	}
-	*d++ = 0;
-	return buffer;
-}
 
-static void print_free_string(FILE *out, const char* s)
-{
-	if (s)
-	{
-		while (*s)
+		if (s != run)
+			fwrite(run, 1, s - run, out);
+
+		switch (*s)
 		{
-			switch (*s)
-			{
-				case '\"' : fprintf(out, "&quot;"); break;
-				case '&'  : fprintf(out, "&amp;"); break;
-				case '<'  : fprintf(out, "&lt;"); break;
-				case '>'  : fprintf(out, "&gt;"); break;
-				default:
-					if (*s>=' ' && *s<='~')
-						fprintf(out, "%c", *s);
-					else
-						fprintf(out, "&#%d;", (unsigned)(unsigned char)*s);
-			}
-			++s;
+			case '\"' : fputs("&quot;", out); break;
+			case '&'  : fputs("&amp;", out); break;
+			case '<'  : fputs("&lt;", out); break;
+			case '>'  : fputs("&gt;", out); break;
+			default:
+				fprintf(out, "&#%d;", (unsigned)(unsigned char)*s);
 		}
+
+		run = ++s;
 	}
+
+	if (s != run)
+		fwrite(run, 1, s - run, out);
 }
 
-static void print_game_switch(FILE* out, const game_driver* game)
+/* Print an attribute with a free format value */
+static void print_attribute(FILE *out, const char* name, const char* value)
 {
-	const input_port_entry* input;
-
-	begin_resource_tracking();
+	fputc(' ', out);
+	fputs(name, out);
+	fputs("=\"", out);
+	print_free_string(out, value);
+	fputc('\"', out);
+}
 
-	input = input_port_allocate(game->construct_ipt, NULL);
+/* Print an element with a free format content */
+static void print_element(FILE *out, const char* name, const char* value)
+{
+	fputs("\t\t<", out);
+	fputs(name, out);
+	fputc('>', out);
+	print_free_string(out, value);
+	fputs("</", out);
+	fputs(name, out);
+	fputs(">\n", out);
+}
 
+static void print_game_switch(FILE* out, const game_driver* game, const input_port_entry* input)
+{
 	while (input->type != IPT_END)
 	{
 		if (input->type==IPT_DIPSWITCH_NAME)
 		{
 			int def = input->default_value;
 
-			fprintf(out, "\t\t<dipswitch");
+			fputs("\t\t<dipswitch", out);
 
-			fprintf(out, " name=\"%s\"", normalize_string(input->name));
+			print_attribute(out, "name", input->name);
 			++input;
 
-			fprintf(out, ">\n");
+			fputs(">\n", out);
 
 			while (input->type==IPT_DIPSWITCH_SETTING)
 			{
-				fprintf(out, "\t\t\t<dipvalue");
-				fprintf(out, " name=\"%s\"", normalize_string(input->name));
+				fputs("\t\t\t<dipvalue", out);
+				print_attribute(out, "name", input->name);
 				if (def == input->default_value)
-					fprintf(out, " default=\"yes\"");
+					fputs(" default=\"yes\"", out);
 
-				fprintf(out, "/>\n");
+				fputs("/>\n", out);
 
 				++input;
 			}
 
-			fprintf(out, "\t\t</dipswitch>\n");
+			fputs("\t\t</dipswitch>\n", out);
 		}
 		else
 			++input;
 	}
-
-	end_resource_tracking();
 }
 
-static void print_game_input(FILE* out, const game_driver* game)
+static void print_game_input(FILE* out, const game_driver* game, const input_port_entry* input)
 {
-	const input_port_entry* input;
 	int nplayer = 0;
 	const char* control = 0;
 	int nbutton = 0;
@@ -134,10 +133,6 @@ static void print_game_input(FILE* out, const game_driver* game)
 	const char* service = 0;
 	const char* tilt = 0;
 
-	begin_resource_tracking();
-
-	input = input_port_allocate(game->construct_ipt, NULL);
-
 	while (input->type != IPT_END)
 	{
 		if (nplayer < input->player+1)
@@ -303,21 +298,19 @@ static void print_game_input(FILE* out, const game_driver* game)
 		++input;
 	}
 
-	fprintf(out, "\t\t<input");
+	fputs("\t\t<input", out);
 	fprintf(out, " players=\"%d\"", nplayer );
 	if (control)
-		fprintf(out, " control=\"%s\"", normalize_string(control) );
+		print_attribute(out, "control", control);
 	if (nbutton)
 		fprintf(out, " buttons=\"%d\"", nbutton );
 	if (ncoin)
 		fprintf(out, " coins=\"%d\"", ncoin );
 	if (service)
-		fprintf(out, " service=\"%s\"", normalize_string(service) );
+		print_attribute(out, "service", service);
 	if (tilt)
-		fprintf(out, " tilt=\"%s\"", normalize_string(tilt) );
-	fprintf(out, "/>\n");
-
-	end_resource_tracking();
+		print_attribute(out, "tilt", tilt);
+	fputs("/>\n", out);
 }
 
 static void print_game_bios(FILE* out, const game_driver* game)
@@ -332,16 +325,16 @@ static void print_game_bios(FILE* out, const game_driver* game)
 	/* Match against bios short names */
 	while(!BIOSENTRY_ISEND(thisbios))
 	{
-		fprintf(out, "\t\t<biosset");
+		fputs("\t\t<biosset", out);
 
 		if (thisbios->_name)
-			fprintf(out, " name=\"%s\"", normalize_string(thisbios->_name));
+			print_attribute(out, "name", thisbios->_name);
 		if (thisbios->_description)
-			fprintf(out, " description=\"%s\"", normalize_string(thisbios->_description));
+			print_attribute(out, "description", thisbios->_description);
 		if (thisbios->value == 0)
-			fprintf(out, " default=\"yes\"");
+			fputs(" default=\"yes\"", out);
 
-		fprintf(out, "/>\n");
+		fputs("/>\n", out);
 
 		thisbios++;
 	}
@@ -375,15 +368,27 @@ static void print_game_rom(FILE* out, const game_driver* game)
 
 			if (!ROM_NOGOODDUMP(rom) && clone_of)
 			{
+				const char* hash = ROM_GETHASHDATA(rom);
+				int crc = hash_data_has_checksum(hash, HASH_CRC);
+
 				fprom=NULL;
 				for (pregion = rom_first_region(clone_of); pregion; pregion = rom_next_region(pregion))
 					for (prom = rom_first_file(pregion); prom; prom = rom_next_file(prom))
-						if (hash_data_is_equal(ROM_GETHASHDATA(rom), ROM_GETHASHDATA(prom), 0))
+					{
+						const char* phash = ROM_GETHASHDATA(prom);
+						int pcrc = crc ? hash_data_has_checksum(phash, HASH_CRC) : 0;
+
+						/* a different crc is enough to reject the rom without the complete compare */
+						if (pcrc && mame_strnicmp(hash + crc, phash + pcrc, 8) != 0)
+							continue;
+
+						if (hash_data_is_equal(hash, phash, 0))
 						{
 							if (!fprom || !strcmp(ROM_GETNAME(prom), name))
 								fprom=prom;
 							in_parent = 1;
 						}
+					}
 			}
 
 			found_bios = 0;
@@ -406,16 +411,16 @@ static void print_game_rom(FILE* out, const game_driver* game)
 
 
 			if (!is_disk)
-				fprintf(out, "\t\t<rom");
+				fputs("\t\t<rom", out);
 			else
-				fprintf(out, "\t\t<disk");
+				fputs("\t\t<disk", out);
 
 			if (*name)
-				fprintf(out, " name=\"%s\"", normalize_string(name));
+				print_attribute(out, "name", name);
 			if (in_parent)
-				fprintf(out, " merge=\"%s\"", normalize_string(ROM_GETNAME(fprom)));
+				print_attribute(out, "merge", ROM_GETNAME(fprom));
 			if (!is_disk && found_bios)
-				fprintf(out, " bios=\"%s\"", normalize_string(bios_name));
+				print_attribute(out, "bios", bios_name);
 			if (!is_disk)
 				fprintf(out, " size=\"%d\"", length);
 
@@ -437,84 +442,81 @@ static void print_game_rom(FILE* out, const game_driver* game)
 
 			switch (ROMREGION_GETTYPE(region))
 			{
-				case REGION_CPU1: fprintf(out, " region=\"cpu1\""); break;
-				case REGION_CPU2: fprintf(out, " region=\"cpu2\""); break;
-				case REGION_CPU3: fprintf(out, " region=\"cpu3\""); break;
-				case REGION_CPU4: fprintf(out, " region=\"cpu4\""); break;
-				case REGION_CPU5: fprintf(out, " region=\"cpu5\""); break;
-				case REGION_CPU6: fprintf(out, " region=\"cpu6\""); break;
-				case REGION_CPU7: fprintf(out, " region=\"cpu7\""); break;
-				case REGION_CPU8: fprintf(out, " region=\"cpu8\""); break;
-				case REGION_GFX1: fprintf(out, " region=\"gfx1\""); break;
-				case REGION_GFX2: fprintf(out, " region=\"gfx2\""); break;
-				case REGION_GFX3: fprintf(out, " region=\"gfx3\""); break;
-				case REGION_GFX4: fprintf(out, " region=\"gfx4\""); break;
-				case REGION_GFX5: fprintf(out, " region=\"gfx5\""); break;
-				case REGION_GFX6: fprintf(out, " region=\"gfx6\""); break;
-				case REGION_GFX7: fprintf(out, " region=\"gfx7\""); break;
-				case REGION_GFX8: fprintf(out, " region=\"gfx8\""); break;
-				case REGION_PROMS: fprintf(out, " region=\"proms\""); break;
-				case REGION_SOUND1: fprintf(out, " region=\"sound1\""); break;
-				case REGION_SOUND2: fprintf(out, " region=\"sound2\""); break;
-				case REGION_SOUND3: fprintf(out, " region=\"sound3\""); break;
-				case REGION_SOUND4: fprintf(out, " region=\"sound4\""); break;
-				case REGION_SOUND5: fprintf(out, " region=\"sound5\""); break;
-				case REGION_SOUND6: fprintf(out, " region=\"sound6\""); break;
-				case REGION_SOUND7: fprintf(out, " region=\"sound7\""); break;
-				case REGION_SOUND8: fprintf(out, " region=\"sound8\""); break;
-				case REGION_USER1: fprintf(out, " region=\"user1\""); break;
-				case REGION_USER2: fprintf(out, " region=\"user2\""); break;
-				case REGION_USER3: fprintf(out, " region=\"user3\""); break;
-				case REGION_USER4: fprintf(out, " region=\"user4\""); break;
-				case REGION_USER5: fprintf(out, " region=\"user5\""); break;
-				case REGION_USER6: fprintf(out, " region=\"user6\""); break;
-				case REGION_USER7: fprintf(out, " region=\"user7\""); break;
-				case REGION_USER8: fprintf(out, " region=\"user8\""); break;
-				case REGION_DISKS: fprintf(out, " region=\"disks\""); break;
+				case REGION_CPU1: fputs(" region=\"cpu1\"", out); break;
+				case REGION_CPU2: fputs(" region=\"cpu2\"", out); break;
+				case REGION_CPU3: fputs(" region=\"cpu3\"", out); break;
+				case REGION_CPU4: fputs(" region=\"cpu4\"", out); break;
+				case REGION_CPU5: fputs(" region=\"cpu5\"", out); break;
+				case REGION_CPU6: fputs(" region=\"cpu6\"", out); break;
+				case REGION_CPU7: fputs(" region=\"cpu7\"", out); break;
+				case REGION_CPU8: fputs(" region=\"cpu8\"", out); break;
+				case REGION_GFX1: fputs(" region=\"gfx1\"", out); break;
+				case REGION_GFX2: fputs(" region=\"gfx2\"", out); break;
+				case REGION_GFX3: fputs(" region=\"gfx3\"", out); break;
+				case REGION_GFX4: fputs(" region=\"gfx4\"", out); break;
+				case REGION_GFX5: fputs(" region=\"gfx5\"", out); break;
+				case REGION_GFX6: fputs(" region=\"gfx6\"", out); break;
+				case REGION_GFX7: fputs(" region=\"gfx7\"", out); break;
+				case REGION_GFX8: fputs(" region=\"gfx8\"", out); break;
+				case REGION_PROMS: fputs(" region=\"proms\"", out); break;
+				case REGION_SOUND1: fputs(" region=\"sound1\"", out); break;
+				case REGION_SOUND2: fputs(" region=\"sound2\"", out); break;
+				case REGION_SOUND3: fputs(" region=\"sound3\"", out); break;
+				case REGION_SOUND4: fputs(" region=\"sound4\"", out); break;
+				case REGION_SOUND5: fputs(" region=\"sound5\"", out); break;
+				case REGION_SOUND6: fputs(" region=\"sound6\"", out); break;
+				case REGION_SOUND7: fputs(" region=\"sound7\"", out); break;
+				case REGION_SOUND8: fputs(" region=\"sound8\"", out); break;
+				case REGION_USER1: fputs(" region=\"user1\"", out); break;
+				case REGION_USER2: fputs(" region=\"user2\"", out); break;
+				case REGION_USER3: fputs(" region=\"user3\"", out); break;
+				case REGION_USER4: fputs(" region=\"user4\"", out); break;
+				case REGION_USER5: fputs(" region=\"user5\"", out); break;
+				case REGION_USER6: fputs(" region=\"user6\"", out); break;
+				case REGION_USER7: fputs(" region=\"user7\"", out); break;
+				case REGION_USER8: fputs(" region=\"user8\"", out); break;
+				case REGION_DISKS: fputs(" region=\"disks\"", out); break;
 				default: fprintf(out, " region=\"0x%x\"", ROMREGION_GETTYPE(region));
 		}
 
 		if (hash_data_has_info(ROM_GETHASHDATA(rom), HASH_INFO_NO_DUMP))
-			fprintf(out, " status=\"nodump\"");
+			fputs(" status=\"nodump\"", out);
 		if (hash_data_has_info(ROM_GETHASHDATA(rom), HASH_INFO_BAD_DUMP))
-			fprintf(out, " status=\"baddump\"");
+			fputs(" status=\"baddump\"", out);
 
 		if (!is_disk)
 		{
 			if (ROMREGION_GETFLAGS(region) & ROMREGION_DISPOSE)
-				fprintf(out, " dispose=\"yes\"");
+				fputs(" dispose=\"yes\"", out);
 
 			fprintf(out, " offset=\"%x\"", offset);
-			fprintf(out, "/>\n");
+			fputs("/>\n", out);
 		}
 		else
 		{
 			fprintf(out, " index=\"%x\"", DISK_GETINDEX(rom));
-			fprintf(out, "/>\n");
+			fputs("/>\n", out);
 		}
 	}
 }
 
-static void print_game_sampleof(FILE* out, const game_driver* game)
+static void print_game_sampleof(FILE* out, const game_driver* game, const machine_config* drv)
 {
 #if (HAS_SAMPLES)
-	machine_config drv;
 	int i;
 
-	expand_machine_driver(game->drv, &drv);
-
-	for( i = 0; drv.sound[i].sound_type && i < MAX_SOUND; i++ )
+	for( i = 0; drv->sound[i].sound_type && i < MAX_SOUND; i++ )
 	{
 		const char **samplenames = NULL;
-		if( drv.sound[i].sound_type == SOUND_SAMPLES )
-			samplenames = ((struct Samplesinterface *)drv.sound[i].config)->samplenames;
+		if( drv->sound[i].sound_type == SOUND_SAMPLES )
+			samplenames = ((struct Samplesinterface *)drv->sound[i].config)->samplenames;
 		if (samplenames != 0 && samplenames[0] != 0) {
 			int k = 0;
 			if (samplenames[k][0]=='*')
 			{
 				/* output sampleof only if different from game name */
 				if (strcmp(samplenames[k] + 1, game->name)!=0)
-					fprintf(out, " sampleof=\"%s\"", normalize_string(samplenames[k] + 1));
+					print_attribute(out, "sampleof", samplenames[k] + 1);
 				++k;
 			}
 		}
@@ -522,19 +524,16 @@ static void print_game_sampleof(FILE* out, const game_driver* game)
 #endif
 }
 
-static void print_game_sample(FILE* out, const game_driver* game)
+static void print_game_sample(FILE* out, const game_driver* game, const machine_config* drv)
 {
 #if (HAS_SAMPLES)
-	machine_config drv;
 	int i;
 
-	expand_machine_driver(game->drv, &drv);
-
-	for( i = 0; drv.sound[i].sound_type && i < MAX_SOUND; i++ )
+	for( i = 0; drv->sound[i].sound_type && i < MAX_SOUND; i++ )
 	{
 		const char **samplenames = NULL;
-		if( drv.sound[i].sound_type == SOUND_SAMPLES )
-			samplenames = ((struct Samplesinterface *)drv.sound[i].config)->samplenames;
+		if( drv->sound[i].sound_type == SOUND_SAMPLES )
+			samplenames = ((struct Samplesinterface *)drv->sound[i].config)->samplenames;
 		if (samplenames != 0 && samplenames[0] != 0) {
 			int k = 0;
 			if (samplenames[k][0]=='*')
@@ -548,8 +547,11 @@ static void print_game_sample(FILE* out, const game_driver* game)
 					int l = 0;
 					while (l<k && strcmp(samplenames[k],samplenames[l])!=0)
 						++l;
-					if (l==k)
-						fprintf(out, "\t\t<sample name=\"%s\"/>\n", normalize_string(samplenames[k]));
+					if (l==k) {
+						fputs("\t\t<sample", out);
+						print_attribute(out, "name", samplenames[k]);
+						fputs("/>\n", out);
+					}
 				}
 				++k;
 			}
@@ -558,28 +560,26 @@ static void print_game_sample(FILE* out, const game_driver* game)
 #endif
 }
 
-static void print_game_micro(FILE* out, const game_driver* game)
+static void print_game_micro(FILE* out, const game_driver* game, const machine_config* driver)
 {
-	machine_config driver;
 	const cpu_config* cpu;
 	const sound_config* sound;
 	int j;
 
-	expand_machine_driver(game->drv, &driver);
-	cpu = driver.cpu;
-	sound = driver.sound;
+	cpu = driver->cpu;
+	sound = driver->sound;
 
 	for(j=0;j<MAX_CPU;++j)
 	{
 		if (cpu[j].cpu_type!=0)
 		{
-			fprintf(out, "\t\t<chip");
-			fprintf(out, " type=\"cpu\"");
+			fputs("\t\t<chip", out);
+			fputs(" type=\"cpu\"", out);
 
-			fprintf(out, " name=\"%s\"", normalize_string(cputype_name(cpu[j].cpu_type)));
+			print_attribute(out, "name", cputype_name(cpu[j].cpu_type));
 
 			fprintf(out, " clock=\"%d\"", cpu[j].cpu_clock);
-			fprintf(out, "/>\n");
+			fputs("/>\n", out);
 		}
 	}
 
@@ -587,20 +587,18 @@ static void print_game_micro(FILE* out, const game_driver* game)
 	{
 		if (sound[j].sound_type)
 		{
-			fprintf(out, "\t\t<chip");
-			fprintf(out, " type=\"audio\"");
-			fprintf(out, " name=\"%s\"", normalize_string(sndtype_name(sound[j].sound_type)));
+			fputs("\t\t<chip", out);
+			fputs(" type=\"audio\"", out);
+			print_attribute(out, "name", sndtype_name(sound[j].sound_type));
 			if (sound[j].clock)
 				fprintf(out, " clock=\"%d\"", sound[j].clock);
-			fprintf(out, "/>\n");
+			fputs("/>\n", out);
 		}
 	}
 }
 
-static void print_game_video(FILE* out, const game_driver* game)
+static void print_game_video(FILE* out, const game_driver* game, const machine_config* driver)
 {
-	machine_config driver;
-
 	int dx;
 	int dy;
 	int ax;
@@ -608,42 +606,40 @@ static void print_game_video(FILE* out, const game_driver* game)
 	int showxy;
 	int orientation;
 
-	expand_machine_driver(game->drv, &driver);
-
-	fprintf(out, "\t\t<video");
-	if (driver.video_attributes & VIDEO_TYPE_VECTOR)
+	fputs("\t\t<video", out);
+	if (driver->video_attributes & VIDEO_TYPE_VECTOR)
 	{
-		fprintf(out, " screen=\"vector\"");
+		fputs(" screen=\"vector\"", out);
 		showxy = 0;
 	}
 	else
 	{
-		fprintf(out, " screen=\"raster\"");
+		fputs(" screen=\"raster\"", out);
 		showxy = 1;
 	}
 
 	if (game->flags & ORIENTATION_SWAP_XY)
 	{
-		ax = driver.aspect_y;
-		ay = driver.aspect_x;
+		ax = driver->aspect_y;
+		ay = driver->aspect_x;
 		if (ax == 0 && ay == 0) {
 			ax = 3;
 			ay = 4;
 		}
-		dx = driver.default_visible_area.max_y - driver.default_visible_area.min_y + 1;
-		dy = driver.default_visible_area.max_x - driver.default_visible_area.min_x + 1;
+		dx = driver->default_visible_area.max_y - driver->default_visible_area.min_y + 1;
+		dy = driver->default_visible_area.max_x - driver->default_visible_area.min_x + 1;
 		orientation = 1;
 	}
 	else
 	{
-		ax = driver.aspect_x;
-		ay = driver.aspect_y;
+		ax = driver->aspect_x;
+		ay = driver->aspect_y;
 		if (ax == 0 && ay == 0) {
 			ax = 4;
 			ay = 3;
 		}
-		dx = driver.default_visible_area.max_x - driver.default_visible_area.min_x + 1;
-		dy = driver.default_visible_area.max_y - driver.default_visible_area.min_y + 1;
+		dx = driver->default_visible_area.max_x - driver->default_visible_area.min_x + 1;
+		dy = driver->default_visible_area.max_y - driver->default_visible_area.min_y + 1;
 		orientation = 0;
 	}
 
@@ -657,23 +653,19 @@ static void print_game_video(FILE* out, const game_driver* game)
 	fprintf(out, " aspectx=\"%d\"", ax);
 	fprintf(out, " aspecty=\"%d\"", ay);
 
-	fprintf(out, " refresh=\"%f\"", driver.frames_per_second);
-	fprintf(out, "/>\n");
+	fprintf(out, " refresh=\"%f\"", driver->frames_per_second);
+	fputs("/>\n", out);
 }
 
-static void print_game_sound(FILE* out, const game_driver* game)
+static void print_game_sound(FILE* out, const game_driver* game, const machine_config* driver)
 {
-	machine_config driver;
-	const cpu_config* cpu;
 	const sound_config* sound;
 
 	/* check if the game have sound emulation */
 	int has_sound = 0;
 	int i;
 
-	expand_machine_driver(game->drv, &driver);
-	cpu = driver.cpu;
-	sound = driver.sound;
+	sound = driver->sound;
 
 	i = 0;
 	while (i < MAX_SOUND && !has_sound)
@@ -683,30 +675,26 @@ static void print_game_sound(FILE* out, const game_driver* game)
 		++i;
 	}
 
-	fprintf(out, "\t\t<sound");
+	fputs("\t\t<sound", out);
 
 	/* sound channel */
 	if (has_sound)
 	{
 		int speakers;
 		for (speakers = 0; speakers < MAX_SPEAKER; speakers++)
-			if (driver.speaker[speakers].tag == NULL)
+			if (driver->speaker[speakers].tag == NULL)
 				break;
 		fprintf(out, " channels=\"%d\"", speakers);
 	}
 	else
-		fprintf(out, " channels=\"0\"");
+		fputs(" channels=\"0\"", out);
 
-	fprintf(out, "/>\n");
+	fputs("/>\n", out);
 }
 
-static void print_game_driver(FILE* out, const game_driver* game)
+static void print_game_driver(FILE* out, const game_driver* game, const machine_config* driver)
 {
-	machine_config driver;
-
-	expand_machine_driver(game->drv, &driver);
-
-	fprintf(out, "\t\t<driver");
+	fputs("\t\t<driver", out);
 
 	/* The status entry is an hint for frontend authors */
 	/* to select working and not working games without */
@@ -717,109 +705,120 @@ static void print_game_driver(FILE* out, const game_driver* game)
 	/* don't work or have major emulation problems. */
 
 	if (game->flags & (GAME_NOT_WORKING | GAME_UNEMULATED_PROTECTION | GAME_NO_SOUND | GAME_WRONG_COLORS))
-		fprintf(out, " status=\"preliminary\"");
+		fputs(" status=\"preliminary\"", out);
 	else if (game->flags & (GAME_IMPERFECT_COLORS | GAME_IMPERFECT_SOUND | GAME_IMPERFECT_GRAPHICS))
-		fprintf(out, " status=\"imperfect\"");
+		fputs(" status=\"imperfect\"", out);
 	else
-		fprintf(out, " status=\"good\"");
+		fputs(" status=\"good\"", out);
 
 	if (game->flags & GAME_NOT_WORKING)
-		fprintf(out, " emulation=\"preliminary\"");
+		fputs(" emulation=\"preliminary\"", out);
 	else
-		fprintf(out, " emulation=\"good\"");
+		fputs(" emulation=\"good\"", out);
 
 	if (game->flags & GAME_WRONG_COLORS)
-		fprintf(out, " color=\"preliminary\"");
+		fputs(" color=\"preliminary\"", out);
 	else if (game->flags & GAME_IMPERFECT_COLORS)
-		fprintf(out, " color=\"imperfect\"");
+		fputs(" color=\"imperfect\"", out);
 	else
-		fprintf(out, " color=\"good\"");
+		fputs(" color=\"good\"", out);
 
 	if (game->flags & GAME_NO_SOUND)
-		fprintf(out, " sound=\"preliminary\"");
+		fputs(" sound=\"preliminary\"", out);
 	else if (game->flags & GAME_IMPERFECT_SOUND)
-		fprintf(out, " sound=\"imperfect\"");
+		fputs(" sound=\"imperfect\"", out);
 	else
-		fprintf(out, " sound=\"good\"");
+		fputs(" sound=\"good\"", out);
 
 	if (game->flags & GAME_IMPERFECT_GRAPHICS)
-		fprintf(out, " graphic=\"imperfect\"");
+		fputs(" graphic=\"imperfect\"", out);
 	else
-		fprintf(out, " graphic=\"good\"");
+		fputs(" graphic=\"good\"", out);
 
 	if (game->flags & GAME_NO_COCKTAIL)
-		fprintf(out, " cocktail=\"preliminary\"");
+		fputs(" cocktail=\"preliminary\"", out);
 
 	if (game->flags & GAME_UNEMULATED_PROTECTION)
-		fprintf(out, " protection=\"preliminary\"");
+		fputs(" protection=\"preliminary\"", out);
 
 	if (game->flags & GAME_SUPPORTS_SAVE)
-		fprintf(out, " savestate=\"supported\"");
+		fputs(" savestate=\"supported\"", out);
 	else
-		fprintf(out, " savestate=\"unsupported\"");
+		fputs(" savestate=\"unsupported\"", out);
 
-	fprintf(out, " palettesize=\"%d\"", driver.total_colors);
+	fprintf(out, " palettesize=\"%d\"", driver->total_colors);
 
-	fprintf(out, "/>\n");
+	fputs("/>\n", out);
 }
 
 /* Print the MAME info record for a game */
-static void print_game_info(FILE* out, const game_driver* game)
+static void print_game_info(FILE* out, const game_driver* game, input_port_entry* ports)
 {
 	const char *start;
 	const game_driver *clone_of;
+	machine_config driver;
+	const input_port_entry* input;
 
 	/* No action if not a game */
 	if (game->flags & NOT_A_DRIVER)
 		return;
 
-	fprintf(out, "\t<" XML_TOP);
+	/* expand the machine driver and the input ports only once */
+	expand_machine_driver(game->drv, &driver);
+
+	begin_resource_tracking();
+
+	input = input_port_allocate(game->construct_ipt, ports);
+
+	fputs("\t<" XML_TOP, out);
 
-	fprintf(out, " name=\"%s\"", normalize_string(game->name) );
+	print_attribute(out, "name", game->name);
 
 	start = strrchr(game->source_file, '/');
 	if (!start)
 		start = strrchr(game->source_file, '\\');
 	if (!start)
 		start = game->source_file - 1;
-	fprintf(out, " sourcefile=\"%s\"", normalize_string(start + 1));
+	print_attribute(out, "sourcefile", start + 1);
 
 	clone_of = driver_get_clone(game);
 	if (clone_of && !(clone_of->flags & NOT_A_DRIVER))
-		fprintf(out, " cloneof=\"%s\"", normalize_string(clone_of->name));
+		print_attribute(out, "cloneof", clone_of->name);
 
 	if (clone_of)
-		fprintf(out, " romof=\"%s\"", normalize_string(clone_of->name));
+		print_attribute(out, "romof", clone_of->name);
 
-	print_game_sampleof(out, game);
+	print_game_sampleof(out, game, &driver);
 
-	fprintf(out, ">\n");
+	fputs(">\n", out);
 
 	if (game->description)
-		fprintf(out, "\t\t<description>%s</description>\n", normalize_string(game->description));
+		print_element(out, "description", game->description);
 
 	/* print the year only if is a number */
 	if (game->year && strspn(game->year,"0123456789")==strlen(game->year))
-		fprintf(out, "\t\t<year>%s</year>\n", normalize_string(game->year) );
+		print_element(out, "year", game->year);
 
 	if (game->manufacturer)
-		fprintf(out, "\t\t<manufacturer>%s</manufacturer>\n", normalize_string(game->manufacturer));
+		print_element(out, "manufacturer", game->manufacturer);
 
 	print_game_bios(out, game);
 	print_game_rom(out, game);
-	print_game_sample(out, game);
-	print_game_micro(out, game);
-	print_game_video(out, game);
-	print_game_sound(out, game);
-	print_game_input(out, game);
-	print_game_switch(out, game);
-	print_game_driver(out, game);
+	print_game_sample(out, game, &driver);
+	print_game_micro(out, game, &driver);
+	print_game_video(out, game, &driver);
+	print_game_sound(out, game, &driver);
+	print_game_input(out, game, input);
+	print_game_switch(out, game, input);
+	print_game_driver(out, game, &driver);
 #ifdef MESS
 	print_game_device(out, game);
 	print_game_ramoptions(out, game);
 #endif
 
-	fprintf(out, "\t</" XML_TOP ">\n");
+	fputs("\t</" XML_TOP ">\n", out);
+
+	end_resource_tracking();
 }
 
 #if !defined(MESS)
@@ -827,6 +826,7 @@ static void print_game_info(FILE* out, const game_driver* game)
 static void print_resource_info(FILE* out, const game_driver* game)
 {
 	const char *start;
+	machine_config driver;
 
  	/* No action if not a resource */
  	if ((game->flags & NOT_A_DRIVER) == 0)
@@ -838,44 +838,54 @@ static void print_resource_info(FILE* out, const game_driver* game)
 	/* Games marked as runnable=yes can be started putting */
 	/* the game name as argument in the program command line, */
 	/* games marked as runnable=no cannot be started. */
-	fprintf(out, "\t<" XML_TOP " runnable=\"no\"");
+	fputs("\t<" XML_TOP " runnable=\"no\"", out);
 
-	fprintf(out, " name=\"%s\"", normalize_string(game->name) );
+	print_attribute(out, "name", game->name);
 
 	start = strrchr(game->source_file, '/');
 	if (!start)
 		start = strrchr(game->source_file, '\\');
 	if (!start)
 		start = game->source_file - 1;
-	fprintf(out, " sourcefile=\"%s\"", normalize_string(start + 1));
+	print_attribute(out, "sourcefile", start + 1);
 
-	fprintf(out, ">\n");
+	fputs(">\n", out);
 
 	if (game->description)
-		fprintf(out, "\t\t<description>%s</description>\n", normalize_string(game->description));
+		print_element(out, "description", game->description);
 
 	/* print the year only if it's a number */
 	if (game->year && strspn(game->year,"0123456789")==strlen(game->year))
-		fprintf(out, "\t\t<year>%s</year>\n", normalize_string(game->year) );
+		print_element(out, "year", game->year);
 
 	if (game->manufacturer)
-		fprintf(out, "\t\t<manufacturer>%s</manufacturer>\n", normalize_string(game->manufacturer));
+		print_element(out, "manufacturer", game->manufacturer);
 
 	print_game_bios(out, game);
 	print_game_rom(out, game);
-	print_game_sample(out, game);
 
-	fprintf(out, "\t</" XML_TOP ">\n");
+	expand_machine_driver(game->drv, &driver);
+	print_game_sample(out, game, &driver);
+
+	fputs("\t</" XML_TOP ">\n", out);
 }
 #endif
 
 static void print_mame_data(FILE* out, const game_driver* const games[])
 {
+	input_port_entry* ports;
 	int j;
 
+	/* the same input ports buffer is reused for all the games */
+	ports = malloc(MAX_INPUT_PORTS * MAX_BITS_PER_PORT * sizeof(*ports));
+	if (!ports)
+		return;
+
 	/* print games */
 	for(j=0;games[j];++j)
-		print_game_info(out, games[j]);
+		print_game_info(out, games[j], ports);
+
+	free(ports);
 
 #if !defined(MESS)
 	/* print resources */
@@ -887,7 +897,7 @@ static void print_mame_data(FILE* out, const game_driver* const games[])
 /* Print the MAME database in XML format */
 void print_mame_xml(FILE* out, const game_driver* const games[])
 {
-	fprintf(out,
+	fputs(
 		"<?xml version=\"1.0\"?>\n"
 		"<!DOCTYPE " XML_ROOT " [\n"
 		"<!ELEMENT " XML_ROOT " (" XML_TOP "+)>\n"
@@ -982,11 +992,12 @@ void print_mame_xml(FILE* out, const game_driver* const games[])
 		"\t\t<!ELEMENT ramoption (#PCDATA)>\n"
 #endif
 		"]>\n\n"
-		"<" XML_ROOT " build=\"%s\">\n",
-		normalize_string(build_version)
+		"<" XML_ROOT, out
 	);
+	print_attribute(out, "build", build_version);
+	fputs(">\n", out);
 
 	print_mame_data(out, games);
 
-	fprintf(out, "</" XML_ROOT ">\n");
+	fputs("</" XML_ROOT ">\n", out);
 }
@@ -210,6 +210,15 @@ struct _digital_joystick_info
 };
 
 
+typedef struct _input_frame_state input_frame_state;
+struct _input_frame_state
+{
+	input_port_info		port[MAX_INPUT_PORTS];	/* copy of the port state */
+	digital_joystick_info joystick[MAX_PLAYERS][DIGITAL_JOYSTICKS_PER_PLAYER]; /* copy of the joystick state */
+	UINT32				toggle[MAX_INPUT_PORTS][MAX_BITS_PER_PORT]; /* default values changed by the toggle controls */
+};
+
+
 struct _input_port_init_params
 {
 	input_port_entry *	ports;		/* base of the port array */
@@ -250,6 +259,12 @@ static digital_joystick_info joystick_info[MAX_PLAYERS][DIGITAL_JOYSTICKS_PER_PL
 /* memory for UI keys */
 static UINT8 ui_memory[__ipt_max];
 
+/* saved frame states, used to run ahead the emulation */
+static input_frame_state frame_state[INPUT_FRAME_STATES];
+
+/* when set, the digital values are not read at VBLANK */
+static UINT8 frame_frozen;
+
 /* XML attributes for the different types */
 static const char *seqtypestrings[] = { "standard", "decrement", "increment" };
 
@@ -1692,11 +1707,14 @@ input_port_entry *input_port_allocate(void (*construct_ipt)(input_port_init_para
  	iip.current_port = 0;
 
 	/* allocate memory for the input ports */
+	/* a reused buffer isn't cleared, every entry is cleared when initialized */
 	if (!memory)
+	{
 		iip.ports = (input_port_entry *)auto_malloc(iip.max_ports * sizeof(*iip.ports));
+		memset(iip.ports, 0, iip.max_ports * sizeof(*iip.ports));
+	}
 	else
 		iip.ports = memory;
-	memset(iip.ports, 0, iip.max_ports * sizeof(*iip.ports));
 
 	/* construct the ports */
  	construct_ipt(&iip);
@@ -2220,6 +2238,10 @@ profiler_mark(PROFILER_INPUT);
 					logerror("Warning: you are using IPT_VBLANK with vblank_duration = 0. You need to increase vblank_duration for IPT_VBLANK to work.\n");
 			}
 
+		/* keep the digital values of a frozen frame */
+		if (frame_frozen)
+			continue;
+
 		/* now loop back and modify based on the inputs */
 		portinfo->digital = 0;
 		for (bitnum = 0, info = &portinfo->bit[0]; bitnum < MAX_BITS_PER_PORT && info->port; bitnum++, info++)
@@ -2635,6 +2657,84 @@ profiler_mark(PROFILER_END);
 
 
 
+/*************************************
+ *
+ *  Frame state save/restore
+ *
+ *************************************/
+
+/*
+    The run-ahead emulates some frames more than once. The input
+    state updated at every VBLANK isn't part of the save states,
+    so it's saved and restored separately to process every edge
+    of the controls only once.
+*/
+
+int input_port_frame_supported(void)
+{
+	int portnum;
+
+	/* the analog ports read the deltas from the OSD at every frame */
+	for (portnum = 0; portnum < MAX_INPUT_PORTS; portnum++)
+		if (port_info[portnum].analoginfo)
+			return FALSE;
+
+	/* the recording and playback files must see every frame once */
+	if (Machine->record_file != NULL || Machine->playback_file != NULL)
+		return FALSE;
+
+	return TRUE;
+}
+
+
+void input_port_frame_save(int slot)
+{
+	input_frame_state *state = &frame_state[slot];
+	int portnum, bitnum;
+
+	memcpy(state->port, port_info, sizeof(port_info));
+	memcpy(state->joystick, joystick_info, sizeof(joystick_info));
+
+	for (portnum = 0; portnum < MAX_INPUT_PORTS; portnum++)
+		for (bitnum = 0; bitnum < MAX_BITS_PER_PORT && port_info[portnum].bit[bitnum].port; bitnum++)
+			state->toggle[portnum][bitnum] = port_info[portnum].bit[bitnum].port->default_value;
+}
+
+
+void input_port_frame_load(int slot)
+{
+	input_frame_state *state = &frame_state[slot];
+	int portnum, bitnum;
+
+	memcpy(port_info, state->port, sizeof(port_info));
+	memcpy(joystick_info, state->joystick, sizeof(joystick_info));
+
+	for (portnum = 0; portnum < MAX_INPUT_PORTS; portnum++)
+		for (bitnum = 0; bitnum < MAX_BITS_PER_PORT && port_info[portnum].bit[bitnum].port; bitnum++)
+			port_info[portnum].bit[bitnum].port->default_value = state->toggle[portnum][bitnum];
+}
+
+
+int input_port_frame_compare(int slot1, int slot2)
+{
+	int portnum;
+
+	/* compare only the digital values, the only ones used with the run-ahead */
+	for (portnum = 0; portnum < MAX_INPUT_PORTS; portnum++)
+		if (frame_state[slot1].port[portnum].digital != frame_state[slot2].port[portnum].digital)
+			return 1;
+
+	return 0;
+}
+
+
+void input_port_frame_freeze(int freeze)
+{
+	frame_frozen = freeze;
+}
+
+
+
 /*************************************
  *
  *  Input port reading
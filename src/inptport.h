@@ -30,6 +30,7 @@
 #define MAX_INPUT_PORTS		30
 #define MAX_PLAYERS			8
 #define MAX_BITS_PER_PORT	32
+#define INPUT_FRAME_STATES	3
 
 #define IP_ACTIVE_HIGH		0x00000000
 #define IP_ACTIVE_LOW		0xffffffff
@@ -717,6 +718,13 @@ void input_port_vblank_end(void);	/* called by cpuintrf.c - not for external use
 
 void input_port_set_digital_value(int port, UINT32 value, UINT32 mask);
 
+/* save and restore the per-frame input state, used by the run-ahead */
+int input_port_frame_supported(void);
+void input_port_frame_save(int slot);
+void input_port_frame_load(int slot);
+int input_port_frame_compare(int slot1, int slot2);
+void input_port_frame_freeze(int freeze);
+
 UINT32 readinputport(int port);
 UINT32 readinputportbytag(const char *tag);
 UINT32 readinputportbytag_safe(const char *tag, UINT32 defvalue);
@@ -187,6 +187,8 @@ static void counters_save(int config_type, xml_data_node *parentnode)
 void coin_counter_w(int num,int on)
 {
 	if (num >= COIN_COUNTERS) return;
+	/* the frames emulated ahead are discarded, don't count them */
+	if (mame_is_running_ahead()) return;
 	/* Count it only if the data has changed from 0 to non-zero */
 	if (on && (lastcoin[num] == 0))
 	{
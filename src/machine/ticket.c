@@ -177,7 +177,8 @@ static void ticket_dispenser_toggle(int which)
 	if (dispenser[which].status == ticketdispensed)
 	{
 		set_led_status(2,1);
-		dispensed_tickets++;
+		if (!mame_is_running_ahead())
+			dispensed_tickets++;
 
 #ifdef DEBUG_TICKET
 		logerror("Ticket Dispensed\n");
@@ -94,6 +94,17 @@
 
 #define MAX_MEMORY_REGIONS		32
 
+#define RUNAHEAD_MAX_FRAMES		4		/* maximum number of frames run ahead */
+#define RUNAHEAD_MEASURE_FRAMES	8		/* frames emulated to measure the lag */
+#define RUNAHEAD_MEASURE_SAMPLES	5		/* input changes measured before choosing the lag */
+
+enum
+{
+	RUNAHEAD_MODE_NONE,					/* emulating the real frames */
+	RUNAHEAD_MODE_RUN,					/* emulating ahead the frames to display */
+	RUNAHEAD_MODE_MEASURE				/* emulating ahead the frames to measure the lag */
+};
+
 
 
 /***************************************************************************
@@ -151,6 +162,24 @@ static mame_timer *soft_reset_timer;
 static void (*saveload_schedule_callback)(void);
 static mame_time saveload_schedule_time;
 
+/* run-ahead statics */
+static int runahead_enabled;
+static int runahead_frames;
+static int runahead_mode;
+static int runahead_hidden;
+static int runahead_pending;
+static int runahead_deferred;
+static UINT8 *runahead_buffer;
+static UINT32 runahead_size;
+static int runahead_slot;
+static int runahead_slot_valid;
+static int runahead_pass;
+static int runahead_index;
+static UINT32 runahead_crc[3][RUNAHEAD_MEASURE_FRAMES];
+static int runahead_sample[RUNAHEAD_MEASURE_SAMPLES];
+static int runahead_sample_count;
+static int runahead_eof;
+
 /* error recovery and exiting */
 static callback_item *reset_callback_list;
 static callback_item *pause_callback_list;
@@ -243,9 +272,14 @@ static void soft_reset(int param);
 static void free_callback_list(callback_item **cb);
 
 static void saveload_init(void);
+static void save_state_tags(void);
+static void load_state_tags(void);
 static void handle_save(void);
 static void handle_load(void);
 
+static void runahead_init(void);
+static void handle_runahead(void);
+
 
 static void logfile_callback(const char *buffer);
 
@@ -330,8 +364,14 @@ int run_game(int game)
 
 				/* execute CPUs if not paused */
 				if (!mame_paused)
+				{
 					cpuexec_timeslice();
 
+					/* run ahead after the end of a frame */
+					if (runahead_pending)
+						handle_runahead();
+				}
+
 				/* otherwise, just pump video updates through */
 				else
 				{
@@ -377,6 +417,41 @@ int run_game(int game)
 }
 
 
+/*-------------------------------------------------
+    run_standalone - run a function that needs
+    the init time services, like the memory
+    system, without a game
+-------------------------------------------------*/
+
+int run_standalone(int (*func)(void *), void *param)
+{
+	callback_item *cb;
+	int result;
+
+	current_phase = MAME_PHASE_INIT;
+	begin_resource_tracking();
+
+	result = (*func)(param);
+
+	/* call all exit callbacks registered */
+	current_phase = MAME_PHASE_EXIT;
+	for (cb = exit_callback_list; cb; cb = cb->next)
+		(*cb->func.exit)();
+
+	/* close all inner resource tracking */
+	while (resource_tracking_tag != 0)
+		end_resource_tracking();
+
+	/* free our callback lists */
+	free_callback_list(&exit_callback_list);
+	free_callback_list(&reset_callback_list);
+	free_callback_list(&pause_callback_list);
+
+	current_phase = MAME_PHASE_PREINIT;
+	return result;
+}
+
+
 /*-------------------------------------------------
     mame_get_phase - return the current program
     phase
@@ -1107,6 +1182,7 @@ static void init_machine(void)
 
 	/* start the save/load system */
 	saveload_init();
+	runahead_init();
 
 	/* call the game driver's init function */
 	/* this is where decryption is done and memory maps are altered */
@@ -1246,6 +1322,73 @@ static void saveload_init(void)
 }
 
 
+/*-------------------------------------------------
+    save_state_tags - save the default tag and
+    the data of all the CPUs
+-------------------------------------------------*/
+
+static void save_state_tags(void)
+{
+	int cpunum;
+
+	/* write the default tag */
+	state_save_push_tag(0);
+	state_save_save_continue();
+	state_save_pop_tag();
+
+	/* loop over CPUs */
+	for (cpunum = 0; cpunum < cpu_gettotalcpu(); cpunum++)
+	{
+		cpuintrf_push_context(cpunum);
+
+		/* make sure banking is set */
+		activecpu_reset_banking();
+
+		/* save the CPU data */
+		state_save_push_tag(cpunum + 1);
+		state_save_save_continue();
+		state_save_pop_tag();
+
+		cpuintrf_pop_context();
+	}
+}
+
+
+/*-------------------------------------------------
+    load_state_tags - load the default tag and
+    the data of all the CPUs
+-------------------------------------------------*/
+
+static void load_state_tags(void)
+{
+	int cpunum;
+
+	/* read tag 0 */
+	state_save_push_tag(0);
+	state_save_load_continue();
+	state_save_pop_tag();
+
+	/* loop over CPUs */
+	for (cpunum = 0; cpunum < cpu_gettotalcpu(); cpunum++)
+	{
+		cpuintrf_push_context(cpunum);
+
+		/* make sure banking is set */
+		activecpu_reset_banking();
+
+		/* load the CPU data */
+		state_save_push_tag(cpunum + 1);
+		state_save_load_continue();
+		state_save_pop_tag();
+
+		/* make sure banking is set */
+		activecpu_reset_banking();
+
+		cpuintrf_pop_context();
+	}
+}
+
+
 /*-------------------------------------------------
     handle_save - attempt to perform a save
 -------------------------------------------------*/
@@ -1277,8 +1420,6 @@ static void handle_save(void)
 	file = mame_fopen(Machine->gamedrv->name, saveload_pending_file, FILETYPE_STATE, 1);
 	if (file)
 	{
-		int cpunum;
-
 		/* write the save state */
 		if (state_save_save_begin(file) != 0)
 		{
@@ -1287,26 +1428,8 @@ static void handle_save(void)
 			goto cancel;
 		}
 
-		/* write the default tag */
-		state_save_push_tag(0);
-		state_save_save_continue();
-		state_save_pop_tag();
-
-		/* loop over CPUs */
-		for (cpunum = 0; cpunum < cpu_gettotalcpu(); cpunum++)
-		{
-			cpuintrf_push_context(cpunum);
-
-			/* make sure banking is set */
-			activecpu_reset_banking();
-
-			/* save the CPU data */
-			state_save_push_tag(cpunum + 1);
-			state_save_save_continue();
-			state_save_pop_tag();
-
-			cpuintrf_pop_context();
-		}
+		/* write all the tags */
+		save_state_tags();
 
 		/* finish and close */
 		state_save_save_finish();
@@ -1364,31 +1487,8 @@ static void handle_load(void)
 		/* start loading */
 		if (state_save_load_begin(file) == 0)
 		{
-			int cpunum;
-
-			/* read tag 0 */
-			state_save_push_tag(0);
-			state_save_load_continue();
-			state_save_pop_tag();
-
-			/* loop over CPUs */
-			for (cpunum = 0; cpunum < cpu_gettotalcpu(); cpunum++)
-			{
-				cpuintrf_push_context(cpunum);
-
-				/* make sure banking is set */
-				activecpu_reset_banking();
-
-				/* load the CPU data */
-				state_save_push_tag(cpunum + 1);
-				state_save_load_continue();
-				state_save_pop_tag();
-
-				/* make sure banking is set */
-				activecpu_reset_banking();
-
-				cpuintrf_pop_context();
-			}
+			/* read all the tags */
+			load_state_tags();
 
 			/* finish and close */
 			state_save_load_finish();
@@ -1407,3 +1507,370 @@ cancel:
 	saveload_pending_file = NULL;
 	saveload_schedule_callback = NULL;
 }
+
+
+
+/***************************************************************************
+
+    Run-ahead
+
+***************************************************************************/
+
+/*
+    The run-ahead hides the internal lag of the game. At the end of
+    a displayed frame the state is saved in memory, the following
+    frames are emulated ahead with the current input, and the last one
+    is displayed. Then the state is restored, and the emulation
+    continues from the real frame. Only the real frames produce sound.
+
+    When the number of frames is automatic, the lag is measured on the
+    input changes, comparing the frames emulated with the previous and
+    with the new input.
+*/
+
+/*-------------------------------------------------
+    runahead_exit - free the memory state
+-------------------------------------------------*/
+
+static void runahead_exit(void)
+{
+	free(runahead_buffer);
+	runahead_buffer = NULL;
+	runahead_size = 0;
+}
+
+
+/*-------------------------------------------------
+    runahead_init - initialize the run-ahead
+-------------------------------------------------*/
+
+static void runahead_init(void)
+{
+	runahead_mode = RUNAHEAD_MODE_NONE;
+	runahead_hidden = 0;
+	runahead_pending = FALSE;
+	runahead_deferred = FALSE;
+	runahead_slot = 0;
+	runahead_slot_valid = FALSE;
+	runahead_sample_count = 0;
+	runahead_eof = FALSE;
+	runahead_buffer = NULL;
+	runahead_size = 0;
+
+	/* the games without a working save state can't be restored */
+	runahead_enabled = options.runahead != 0
+		&& (Machine->gamedrv->flags & GAME_SUPPORTS_SAVE) != 0
+		&& !Machine->debug_mode;
+
+	/* the automatic mode starts without run-ahead, until the lag is measured */
+	if (options.runahead > 0)
+		runahead_frames = MIN(options.runahead, RUNAHEAD_MAX_FRAMES);
+	else
+		runahead_frames = 0;
+
+	if (options.runahead != 0 && !runahead_enabled)
+		logerror("Run-ahead disabled, save states not supported by the game\n");
+
+	set_runahead_performance(0, 0, -1);
+
+	add_exit_callback(runahead_exit);
+}
+
+
+/*-------------------------------------------------
+    runahead_save - save the state in memory
+-------------------------------------------------*/
+
+static int runahead_save(void)
+{
+	/* allocate the buffer the first time, when all the registrations are done */
+	if (runahead_buffer == NULL)
+	{
+		runahead_size = state_save_get_size();
+		runahead_buffer = malloc(runahead_size);
+		if (runahead_buffer == NULL)
+		{
+			logerror("Run-ahead disabled, unable to allocate %u bytes\n", runahead_size);
+			runahead_enabled = FALSE;
+			return 1;
+		}
+		logerror("Run-ahead state of %u bytes\n", runahead_size);
+	}
+
+	if (state_save_save_begin_memory(runahead_buffer, runahead_size) != 0)
+	{
+		logerror("Run-ahead disabled, illegal save state registrations\n");
+		runahead_enabled = FALSE;
+		return 1;
+	}
+
+	save_state_tags();
+	state_save_save_finish();
+
+	return 0;
+}
+
+
+/*-------------------------------------------------
+    runahead_load - load the state saved in
+    memory
+-------------------------------------------------*/
+
+static void runahead_load(void)
+{
+	if (state_save_load_begin_memory(runahead_buffer, runahead_size) != 0)
+		fatalerror("Run-ahead state changed size");
+
+	load_state_tags();
+	state_save_load_finish();
+}
+
+
+/*-------------------------------------------------
+    runahead_run - emulate ahead the specified
+    number of frames
+-------------------------------------------------*/
+
+static void runahead_run(int mode, int frames)
+{
+	runahead_mode = mode;
+	runahead_hidden = frames;
+	runahead_index = 0;
+
+	while (runahead_hidden > 0 && !hard_reset_pending && !exit_pending)
+		cpuexec_timeslice();
+
+	runahead_mode = RUNAHEAD_MODE_NONE;
+	runahead_hidden = 0;
+}
+
+
+/*-------------------------------------------------
+    runahead_restore - go back to the real frame,
+    also for the state not saved
+-------------------------------------------------*/
+
+static void runahead_restore(UINT32 seed)
+{
+	runahead_load();
+	input_port_frame_load(runahead_slot);
+	rand_seed = seed;
+
+	/* the state was saved before the end of the deferred frame */
+	if (runahead_eof)
+		update_video_eof();
+}
+
+
+/*-------------------------------------------------
+    runahead_measure - measure the lag of the
+    game after an input change
+-------------------------------------------------*/
+
+static void runahead_measure(UINT32 seed)
+{
+	int limit, lag, i, j;
+
+	/* the first pass uses the previous input, the others the new one */
+	for (runahead_pass = 0; runahead_pass < 3; runahead_pass++)
+	{
+		input_port_frame_load(runahead_pass == 0 ? runahead_slot ^ 1 : runahead_slot);
+		input_port_frame_freeze(TRUE);
+		runahead_run(RUNAHEAD_MODE_MEASURE, RUNAHEAD_MEASURE_FRAMES);
+		input_port_frame_freeze(FALSE);
+		runahead_restore(seed);
+	}
+
+	/* use only the frames equal with the same input */
+	for (limit = 0; limit < runahead_index; limit++)
+		if (runahead_crc[1][limit] != runahead_crc[2][limit])
+			break;
+
+	/* the first frame changed by the new input */
+	for (lag = 0; lag < limit; lag++)
+		if (runahead_crc[0][lag] != runahead_crc[1][lag])
+			break;
+
+	/* no visible effect */
+	if (lag == limit)
+		return;
+
+	logerror("Run-ahead: input change visible after %d frames\n", lag);
+
+	runahead_sample[runahead_sample_count++] = lag;
+
+	/* with enough samples use the median */
+	if (runahead_sample_count == RUNAHEAD_MEASURE_SAMPLES)
+	{
+		for (i = 1; i < RUNAHEAD_MEASURE_SAMPLES; i++)
+			for (j = i; j > 0 && runahead_sample[j - 1] > runahead_sample[j]; j--)
+			{
+				int temp = runahead_sample[j];
+				runahead_sample[j] = runahead_sample[j - 1];
+				runahead_sample[j - 1] = temp;
+			}
+
+		runahead_frames = MIN(runahead_sample[RUNAHEAD_MEASURE_SAMPLES / 2], RUNAHEAD_MAX_FRAMES);
+
+		logerror("Run-ahead: measured lag of %d frames\n", runahead_frames);
+	}
+}
+
+
+/*-------------------------------------------------
+    runahead_lag - return the lag of the game, or
+    -1 if not yet measured
+-------------------------------------------------*/
+
+static int runahead_lag(void)
+{
+	if (options.runahead > 0 || runahead_sample_count == RUNAHEAD_MEASURE_SAMPLES)
+		return runahead_frames;
+	else
+		return -1;
+}
+
+
+/*-------------------------------------------------
+    handle_runahead - run ahead after the end of
+    a real frame
+-------------------------------------------------*/
+
+static void handle_runahead(void)
+{
+	cycles_t start = osd_cycles();
+	cycles_t display = 0;
+	UINT32 seed = rand_seed;
+	int deferred = runahead_deferred;
+	int measure;
+	int frames = 0;
+
+	runahead_pending = FALSE;
+	runahead_deferred = FALSE;
+
+	/* keep the input of this frame and of the previous one */
+	runahead_slot ^= 1;
+	input_port_frame_save(runahead_slot);
+
+	/* measure the lag if the input changed */
+	measure = options.runahead < 0
+		&& runahead_sample_count < RUNAHEAD_MEASURE_SAMPLES
+		&& runahead_slot_valid
+		&& input_port_frame_compare(runahead_slot, runahead_slot ^ 1);
+
+	runahead_slot_valid = TRUE;
+
+	/* the anonymous timers aren't saved, so wait for the next frame */
+	if ((!measure && !deferred) || timer_has_anonymous() || runahead_save() != 0)
+	{
+		/* display the deferred frame as a normal one */
+		if (deferred)
+		{
+			update_deferred_screen(TRUE);
+			update_video_eof();
+		}
+		set_runahead_performance(0, 0, runahead_lag());
+		return;
+	}
+
+	/* the deferred frame ends after its state is saved, and again */
+	/* at every restore, so it's drawn always before its end */
+	runahead_eof = deferred;
+	if (runahead_eof)
+		update_video_eof();
+
+	if (measure)
+	{
+		runahead_measure(seed);
+		frames += 3 * RUNAHEAD_MEASURE_FRAMES;
+	}
+
+	/* emulate ahead until the frame to display, and display it */
+	/* before restoring the state to keep the palette of the frame */
+	if (deferred)
+	{
+		runahead_run(RUNAHEAD_MODE_RUN, runahead_frames);
+		frames += runahead_frames;
+
+		display = osd_cycles();
+		update_deferred_screen(FALSE);
+		display = osd_cycles() - display;
+
+		runahead_restore(seed);
+	}
+
+	/* report the time used, without the display */
+	set_runahead_performance(frames, (double)(osd_cycles() - start - display) / (double)osd_cycles_per_second(), runahead_lag());
+}
+
+
+/*-------------------------------------------------
+    mame_runahead_frame - return how the frame
+    just completed must be handled; called once
+    per frame by updatescreen
+-------------------------------------------------*/
+
+int mame_runahead_frame(void)
+{
+	/* frames emulated ahead */
+	if (runahead_mode == RUNAHEAD_MODE_MEASURE)
+	{
+		runahead_hidden--;
+		return RUNAHEAD_FRAME_MEASURE;
+	}
+
+	if (runahead_mode == RUNAHEAD_MODE_RUN)
+	{
+		runahead_hidden--;
+		return runahead_hidden == 0 ? RUNAHEAD_FRAME_DRAW : RUNAHEAD_FRAME_HIDDEN;
+	}
+
+	/* real frames */
+	if (!runahead_enabled || mame_paused || !input_port_frame_supported())
+		return RUNAHEAD_FRAME_NORMAL;
+
+	/* check the input at every frame for the lag measure */
+	runahead_pending = TRUE;
+
+	/* run ahead only for the frames to display */
+	if (runahead_frames == 0 || osd_skip_this_frame())
+		return RUNAHEAD_FRAME_NORMAL;
+
+	runahead_deferred = TRUE;
+
+	return RUNAHEAD_FRAME_DEFERRED;
+}
+
+
+/*-------------------------------------------------
+    mame_runahead_hash - store the CRC of a frame
+    emulated to measure the lag
+-------------------------------------------------*/
+
+void mame_runahead_hash(UINT32 crc)
+{
+	if (runahead_mode == RUNAHEAD_MODE_MEASURE && runahead_index < RUNAHEAD_MEASURE_FRAMES)
+		runahead_crc[runahead_pass][runahead_index++] = crc;
+}
+
+
+/*-------------------------------------------------
+    mame_is_running_ahead - return TRUE if the
+    frames emulated now are not the real ones
+-------------------------------------------------*/
+
+int mame_is_running_ahead(void)
+{
+	return runahead_mode != RUNAHEAD_MODE_NONE;
+}
+
+
+/*-------------------------------------------------
+    mame_runahead_skip_frame - return TRUE if the
+    frame emulated now is never displayed
+-------------------------------------------------*/
+
+int mame_runahead_skip_frame(void)
+{
+	return runahead_mode == RUNAHEAD_MODE_RUN && runahead_hidden > 1;
+}
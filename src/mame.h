@@ -222,6 +222,7 @@ struct _global_options
 
 	const char * savegame;	/* string representing a savegame to load; if one length then interpreted as a character */
 	int		auto_save;		/* 1 to automatically save/restore at startup/quitting time */
+	int		runahead;		/* number of frames to run ahead to hide the game lag; -1 to measure it */
 	char *	bios;			/* specify system bios (if used), 0 is default */
 
 	int		debug_width;	/* requested width of debugger bitmap */
@@ -267,6 +268,9 @@ extern char build_version[];
 /* execute a given game by index in the drivers[] array */
 int run_game(int game);
 
+/* execute a function using the init time services, without a game */
+int run_standalone(int (*func)(void *), void *param);
+
 /* return the current phase */
 int mame_get_phase(void);
 
@@ -309,6 +313,32 @@ int mame_is_paused(void);
 
 
 
+/* ----- run-ahead ----- */
+
+/* how the frame just completed is handled */
+enum
+{
+	RUNAHEAD_FRAME_NORMAL,				/* real frame, displayed as usual */
+	RUNAHEAD_FRAME_DEFERRED,			/* real frame, displayed after the run-ahead */
+	RUNAHEAD_FRAME_HIDDEN,				/* frame emulated ahead, not displayed */
+	RUNAHEAD_FRAME_DRAW,				/* last frame emulated ahead, drawn to be displayed */
+	RUNAHEAD_FRAME_MEASURE				/* frame emulated ahead to measure the lag, drawn and hashed */
+};
+
+/* return how the frame just completed must be handled; called once per frame */
+int mame_runahead_frame(void);
+
+/* store the CRC of a frame emulated to measure the lag */
+void mame_runahead_hash(UINT32 crc);
+
+/* are the frames emulated now not the real ones? */
+int mame_is_running_ahead(void);
+
+/* is the frame emulated now never displayed? */
+int mame_runahead_skip_frame(void);
+
+
+
 /* ----- memory region management ----- */
 
 /* allocate a new memory region */
@@ -375,6 +375,18 @@ int osd_handle_user_interface(mame_bitmap *bitmap, int is_menu_active);
 /* osd logging */
 void osd_log_va(const char* text, va_list arg);
 
+/* map in memory a read only part of a file. Return 0 if not supported. */
+/* The map remains valid also after closing the file. */
+void* osd_fmap(osd_file* file, UINT64 offset, UINT32 length);
+void osd_funmap(void* ptr, UINT32 length);
+
+/* get the full path, the size and the modification time of a regular file. Return 0 on success. */
+int osd_get_file_stamp(int pathtype, int pathindex, const char* filename, char* path, int path_size, UINT64* size, UINT64* mtime);
+
+/* run func(arg, num, max) for num = 0 ... max-1, possibly in parallel */
+/* on different threads. The calls must be independent. */
+void osd_parallelize(void (*func)(void* arg, int num, int max), void* arg, int max);
+
 #ifdef MESS
 /* this is here to follow the current mame file hierarchy style */
 #include "osd_mess.h"
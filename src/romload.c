@@ -24,6 +24,11 @@
 //#define LOG_LOAD
 
 
+/* limits of a single batch of ROM files read ahead */
+#define ROM_PREFETCH_MAX		64
+#define ROM_PREFETCH_SIZE		0x2000000
+
+
 
 /***************************************************************************
 
@@ -39,6 +44,15 @@ int system_bios;
 
 static int total_rom_load_warnings;
 
+/* ROM files read ahead and completed in parallel */
+static struct
+{
+	const rom_entry *romp[ROM_PREFETCH_MAX];
+	mame_file *file[ROM_PREFETCH_MAX];
+	int count;
+	int next;
+} prefetch;
+
 
 
 /***************************************************************************
@@ -461,26 +475,119 @@ static void region_post_process(rom_load_data *romdata, const rom_entry *regiond
 
 
 /*-------------------------------------------------
-    open_rom_file - open a ROM file, searching
-    up the parent and loading by checksum
+    prefetch_open_file - open a ROM file, searching
+    up the parent and loading by checksum; the data
+    is only read, not yet inflated or hashed
 -------------------------------------------------*/
 
-static int open_rom_file(rom_load_data *romdata, const rom_entry *romp)
+static mame_file *prefetch_open_file(rom_load_data *romdata, const rom_entry *romp)
 {
 	const game_driver *drv;
+	mame_file *file;
 
 	++romdata->romsloaded;
 
 	/* update status display */
 	if (osd_display_loading_rom_message(ROM_GETNAME(romp), romdata))
-       return 0;
+		return NULL;
 
 	/* Attempt reading up the chain through the parents. It automatically also
        attempts any kind of load by checksum supported by the archives. */
-	romdata->file = NULL;
-	for (drv = Machine->gamedrv; !romdata->file && drv; drv = driver_get_clone(drv))
+	file = NULL;
+	for (drv = Machine->gamedrv; !file && drv; drv = driver_get_clone(drv))
 		if (drv->name && *drv->name)
-			romdata->file = mame_fopen_rom(drv->name, ROM_GETNAME(romp), ROM_GETHASHDATA(romp));
+			file = mame_fopen_rom_deferred(drv->name, ROM_GETNAME(romp), ROM_GETHASHDATA(romp));
+
+	return file;
+}
+
+
+/*-------------------------------------------------
+    prefetch_complete_task - inflate and hash a
+    share of the prefetched files
+-------------------------------------------------*/
+
+static void prefetch_complete_task(void *param, int task_num, int task_count)
+{
+	int i;
+
+	(void)param;
+
+	for (i = task_num; i < prefetch.count; i += task_count)
+		if (prefetch.file[i] && mame_fcomplete(prefetch.file[i]) != 0)
+		{
+			/* a corrupted archive entry is reported as missing */
+			mame_fclose(prefetch.file[i]);
+			prefetch.file[i] = NULL;
+		}
+}
+
+
+/*-------------------------------------------------
+    prefetch_flush - close any prefetched file not
+    yet used
+-------------------------------------------------*/
+
+static void prefetch_flush(void)
+{
+	for ( ; prefetch.next < prefetch.count; prefetch.next++)
+		if (prefetch.file[prefetch.next])
+			mame_fclose(prefetch.file[prefetch.next]);
+
+	prefetch.count = 0;
+	prefetch.next = 0;
+}
+
+
+/*-------------------------------------------------
+    prefetch_rom_files - read ahead the files of
+    the region starting at the given entry; the
+    I/O is sequential, the decompression and the
+    hashing are spread over the available CPUs
+-------------------------------------------------*/
+
+static void prefetch_rom_files(rom_load_data *romdata, const rom_entry *romp)
+{
+	UINT64 size = 0;
+
+	prefetch_flush();
+
+	for ( ; !ROMENTRY_ISREGIONEND(romp) && prefetch.count < ROM_PREFETCH_MAX && size < ROM_PREFETCH_SIZE; romp++)
+	{
+		mame_file *file;
+
+		/* same selection done by process_rom_entries */
+		if (!ROMENTRY_ISFILE(romp))
+			continue;
+		if (ROM_GETBIOSFLAGS(romp) && ROM_GETBIOSFLAGS(romp) != (system_bios+1))
+			continue;
+
+		debugload("Opening ROM file: %s\n", ROM_GETNAME(romp));
+		file = prefetch_open_file(romdata, romp);
+		if (file)
+			size += mame_fsize(file);
+
+		prefetch.romp[prefetch.count] = romp;
+		prefetch.file[prefetch.count] = file;
+		prefetch.count++;
+	}
+
+	osd_parallelize(prefetch_complete_task, NULL, prefetch.count);
+}
+
+
+/*-------------------------------------------------
+    open_rom_file - get a ROM file from the
+    prefetched ones, reading ahead the next batch
+    when needed
+-------------------------------------------------*/
+
+static int open_rom_file(rom_load_data *romdata, const rom_entry *romp)
+{
+	if (prefetch.next == prefetch.count || prefetch.romp[prefetch.next] != romp)
+		prefetch_rom_files(romdata, romp);
+
+	romdata->file = prefetch.file[prefetch.next++];
 
 	/* return the result */
 	return (romdata->file != NULL);
@@ -750,7 +857,6 @@ static int process_rom_entries(rom_load_data *romdata, const rom_entry *romp)
 				int explength = 0;
 
 				/* open the file */
-				debugload("Opening ROM file: %s\n", ROM_GETNAME(romp));
 				if (!open_rom_file(romdata, romp))
 					handle_missing_file(romdata, romp);
 
@@ -819,6 +925,7 @@ fatalerror:
 	if (romdata->file)
 		mame_fclose(romdata->file);
 	romdata->file = NULL;
+	prefetch_flush();
 	return 0;
 }
 
@@ -950,6 +1057,9 @@ int rom_init(const rom_entry *romp)
 	/* reset the disk list */
 	memset(disk_handle, 0, sizeof(disk_handle));
 
+	/* reset the prefetched files */
+	memset(&prefetch, 0, sizeof(prefetch));
+
 	/* determine the correct biosset to load based on options.bios string */
 	system_bios = determine_bios_rom(Machine->gamedrv->bios);
 
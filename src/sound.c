@@ -687,8 +687,8 @@ void sound_frame_update(void)
 				}
 #endif
 
-				/* mix if sound is enabled */
-				if (global_sound_enabled && !nosound_mode)
+				/* mix if sound is enabled, the frames emulated ahead are silent */
+				if (global_sound_enabled && !nosound_mode && !mame_is_running_ahead())
 				{
 					/* if the speaker is centered, send to both left and right */
 					if (spk->speaker->x == 0)
@@ -712,33 +712,37 @@ void sound_frame_update(void)
 		}
 	}
 
-	/* now downmix the final result */
-	for (sample = 0; sample < samples_this_frame; sample++)
+	/* the frames emulated ahead only consume the streams, the real frame plays the sound */
+	if (!mame_is_running_ahead())
 	{
-		INT32 samp;
-
-		/* clamp the left side */
-		samp = leftmix[sample];
-		if (samp < -32768)
-			samp = -32768;
-		else if (samp > 32767)
-			samp = 32767;
-		finalmix[sample*2+0] = samp;
-
-		/* clamp the right side */
-		samp = rightmix[sample];
-		if (samp < -32768)
-			samp = -32768;
-		else if (samp > 32767)
-			samp = 32767;
-		finalmix[sample*2+1] = samp;
-	}
+		/* now downmix the final result */
+		for (sample = 0; sample < samples_this_frame; sample++)
+		{
+			INT32 samp;
+
+			/* clamp the left side */
+			samp = leftmix[sample];
+			if (samp < -32768)
+				samp = -32768;
+			else if (samp > 32767)
+				samp = 32767;
+			finalmix[sample*2+0] = samp;
+
+			/* clamp the right side */
+			samp = rightmix[sample];
+			if (samp < -32768)
+				samp = -32768;
+			else if (samp > 32767)
+				samp = 32767;
+			finalmix[sample*2+1] = samp;
+		}
 
-	if (wavfile && !mame_is_paused())
-		wav_add_data_16(wavfile, finalmix, samples_this_frame * 2);
+		if (wavfile && !mame_is_paused())
+			wav_add_data_16(wavfile, finalmix, samples_this_frame * 2);
 
-	/* play the result */
-	samples_this_frame = osd_update_audio_stream(finalmix);
+		/* play the result */
+		samples_this_frame = osd_update_audio_stream(finalmix);
+	}
 
 	/* update the streamer */
 	streams_frame_update();
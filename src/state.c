@@ -119,6 +119,7 @@ static UINT8 ss_registration_allowed;
 static UINT8 *ss_dump_array;
 static mame_file *ss_dump_file;
 static UINT32 ss_dump_size;
+static UINT8 ss_dump_memory;
 
 #ifdef MESS
 static const char ss_magic_num[8] = { 'M', 'E', 'S', 'S', 'S', 'A', 'V', 'E' };
@@ -795,6 +796,44 @@ int state_save_save_begin(mame_file *file)
 }
 
 
+/*-------------------------------------------------
+    state_save_get_size - return the size of the
+    buffer required to save the state in memory
+-------------------------------------------------*/
+
+UINT32 state_save_get_size(void)
+{
+	return compute_size_and_offsets();
+}
+
+
+/*-------------------------------------------------
+    state_save_save_begin_memory - begin the
+    process of saving in a preallocated memory
+    buffer, without any file I/O or allocation
+-------------------------------------------------*/
+
+int state_save_save_begin_memory(UINT8 *buffer, UINT32 size)
+{
+	/* if we have illegal registrations, return an error */
+	if (ss_illegal_regs > 0)
+		return 1;
+
+	/* the buffer must contain the whole state */
+	ss_dump_size = compute_size_and_offsets();
+	if (size < ss_dump_size)
+	{
+		ss_dump_size = 0;
+		return 1;
+	}
+
+	ss_dump_array = buffer;
+	ss_dump_file = NULL;
+	ss_dump_memory = 1;
+	return 0;
+}
+
+
 /*-------------------------------------------------
     state_save_save_continue - save within the
     current tag
@@ -805,22 +844,22 @@ void state_save_save_continue(void)
 	ss_entry *entry;
 	int count;
 
-	TRACE(logerror("Saving tag %d\n", ss_current_tag));
+	/* memory states are saved at every frame, don't trace them */
+	if (!ss_dump_memory)
+		TRACE(logerror("Saving tag %d\n", ss_current_tag));
 
 	/* call the pre-save functions */
-	TRACE(logerror("  calling pre-save functions\n"));
 	count = call_hook_functions(ss_prefunc_reg);
-	TRACE(logerror("    %d functions called\n", count));
-
-	/* then copy in all the data */
-	TRACE(logerror("  copying data\n"));
+	if (!ss_dump_memory)
+		TRACE(logerror("  %d pre-save functions called\n", count));
 
 	/* iterate over entries with matching tags */
 	for (entry = ss_registry; entry; entry = entry->next)
 		if (entry->tag == ss_current_tag)
 		{
 			memcpy(ss_dump_array + entry->offset, entry->data, entry->typesize * entry->typecount);
-			TRACE(logerror("    %s: %x..%x\n", entry->name, entry->offset, entry->offset + entry->typesize * entry->typecount - 1));
+			if (!ss_dump_memory)
+				TRACE(logerror("    %s: %x..%x\n", entry->name, entry->offset, entry->offset + entry->typesize * entry->typecount - 1));
 		}
 }
 
@@ -835,6 +874,15 @@ void state_save_save_finish(void)
 	UINT32 signature;
 	UINT8 flags = 0;
 
+	/* a memory state is only used in the same session, so no header is required */
+	if (ss_dump_memory)
+	{
+		ss_dump_array = NULL;
+		ss_dump_size = 0;
+		ss_dump_memory = 0;
+		return;
+	}
+
 	TRACE(logerror("Finishing save\n"));
 
 	/* compute the flags */
@@ -899,6 +947,29 @@ int state_save_load_begin(mame_file *file)
 }
 
 
+/*-------------------------------------------------
+    state_save_load_begin_memory - begin the
+    process of loading the state from a memory
+    buffer filled by state_save_save_begin_memory
+-------------------------------------------------*/
+
+int state_save_load_begin_memory(UINT8 *buffer, UINT32 size)
+{
+	/* the buffer must contain the whole state */
+	ss_dump_size = compute_size_and_offsets();
+	if (size < ss_dump_size)
+	{
+		ss_dump_size = 0;
+		return 1;
+	}
+
+	ss_dump_array = buffer;
+	ss_dump_file = NULL;
+	ss_dump_memory = 1;
+	return 0;
+}
+
+
 /*-------------------------------------------------
     state_save_load_continue - load all state in
     the current tag
@@ -911,14 +982,18 @@ void state_save_load_continue(void)
 	int count;
 
 	/* first determine whether or not we need to convert the endianness of the data */
+	/* a memory state has no header, and it's always in the native format */
+	if (ss_dump_memory)
+		need_convert = 0;
+	else
 #ifdef LSB_FIRST
-	need_convert = (ss_dump_array[9] & SS_MSB_FIRST) != 0;
+		need_convert = (ss_dump_array[9] & SS_MSB_FIRST) != 0;
 #else
-	need_convert = (ss_dump_array[9] & SS_MSB_FIRST) == 0;
+		need_convert = (ss_dump_array[9] & SS_MSB_FIRST) == 0;
 #endif
 
-	TRACE(logerror("Loading tag %d\n", ss_current_tag));
-	TRACE(logerror("  copying data\n"));
+	if (!ss_dump_memory)
+		TRACE(logerror("Loading tag %d\n", ss_current_tag));
 
 	/* iterate over entries with matching tags */
 	for (entry = ss_registry; entry; entry = entry->next)
@@ -927,13 +1002,14 @@ void state_save_load_continue(void)
 			memcpy(entry->data, ss_dump_array + entry->offset, entry->typesize * entry->typecount);
 			if (need_convert && ss_conv[entry->typesize])
 				(*ss_conv[entry->typesize])(entry->data, entry->typecount);
-			TRACE(logerror("    %s: %x..%x\n", entry->name, entry->offset, entry->offset + entry->typesize * entry->typecount - 1));
+			if (!ss_dump_memory)
+				TRACE(logerror("    %s: %x..%x\n", entry->name, entry->offset, entry->offset + entry->typesize * entry->typecount - 1));
 		}
 
 	/* call the post-load functions */
-	TRACE(logerror("  calling post-load functions\n"));
 	count = call_hook_functions(ss_postfunc_reg);
-	TRACE(logerror("    %d functions called\n", count));
+	if (!ss_dump_memory)
+		TRACE(logerror("  %d post-load functions called\n", count));
 }
 
 
@@ -944,6 +1020,15 @@ void state_save_load_continue(void)
 
 void state_save_load_finish(void)
 {
+	/* the memory buffer is owned by the caller */
+	if (ss_dump_memory)
+	{
+		ss_dump_array = NULL;
+		ss_dump_size = 0;
+		ss_dump_memory = 0;
+		return;
+	}
+
 	TRACE(logerror("Finishing load\n"));
 
 	/* free memory and reset the global states */
@@ -97,6 +97,11 @@ void state_save_register_func_postload_ptr(void (*func)(void *), void *param);
 int  state_save_save_begin(mame_file *file);
 int  state_save_load_begin(mame_file *file);
 
+/* Save and load in a preallocated memory buffer, without file I/O or allocation */
+UINT32 state_save_get_size(void);
+int  state_save_save_begin_memory(UINT8 *buffer, UINT32 size);
+int  state_save_load_begin_memory(UINT8 *buffer, UINT32 size);
+
 void state_save_push_tag(int tag);
 void state_save_pop_tag(void);
 
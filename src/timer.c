@@ -499,6 +499,24 @@ int timer_count_anonymous(void)
 }
 
 
+/*-------------------------------------------------
+    timer_has_anonymous - return TRUE if there are
+    anonymous (non-saveable) timers, without
+    logging them
+-------------------------------------------------*/
+
+int timer_has_anonymous(void)
+{
+	mame_timer *t;
+
+	for (t = timer_head; t; t = t->next)
+		if (t->temporary && t != callback_timer)
+			return TRUE;
+
+	return FALSE;
+}
+
+
 
 /***************************************************************************
 
@@ -413,14 +413,15 @@ void rewindzip(zip_file* zip) {
 	zip->cd_pos = 0;
 }
 
-/* Seek zip->fp to compressed data
+/* Get the offset of the compressed data
+   out:
+    *offset position of the data in zip->fp
    return:
     ==0 success
     <0 error
 */
-int seekcompresszip(zip_file* zip, zip_entry* ent) {
+static int offsetcompresszip(zip_file* zip, zip_entry* ent, long* offset) {
 	char buf[ZIPNAME];
-	long offset;
 
 	if (!zip->fp) {
 		if (!revivezip(zip))
@@ -441,14 +442,27 @@ int seekcompresszip(zip_file* zip, zip_entry* ent) {
 		UINT16 filename_length = read_word (buf+ZIPFNLN);
 		UINT16 extra_field_length = read_word (buf+ZIPXTRALN);
 
-		/* calculate offset to data and osd_fseek() there */
-		offset = ent->offset_lcl_hdr_frm_frst_disk + ZIPNAME + filename_length + extra_field_length;
+		/* calculate offset to data */
+		*offset = ent->offset_lcl_hdr_frm_frst_disk + ZIPNAME + filename_length + extra_field_length;
+	}
 
-		if (osd_fseek(zip->fp, offset, SEEK_SET) != 0) {
-			errormsg ("Seeking to compressed data", ERROR_CORRUPT, zip->zip);
-			return -1;
-		}
+	return 0;
+}
 
+/* Seek zip->fp to compressed data
+   return:
+    ==0 success
+    <0 error
+*/
+int seekcompresszip(zip_file* zip, zip_entry* ent) {
+	long offset;
+
+	if (offsetcompresszip(zip, ent, &offset) != 0)
+		return -1;
+
+	if (osd_fseek(zip->fp, offset, SEEK_SET) != 0) {
+		errormsg ("Seeking to compressed data", ERROR_CORRUPT, zip->zip);
+		return -1;
 	}
 
 	return 0;
@@ -541,6 +555,52 @@ static int inflate_file(osd_file* in_file, unsigned in_size, unsigned char* out_
 	return 0;
 }
 
+/* Inflate a memory buffer
+   in:
+   in_data compressed data, with one extra dummy byte allocated after the end
+   in_size size of the compressed data
+   out_size size of decompressed data
+   out:
+   out_data buffer for decompressed data
+   return:
+   ==0 ok
+   note:
+   It doesn't access any shared state, so it can be called concurrently
+   from different threads on different buffers.
+*/
+int inflate_zipped_data(const unsigned char* in_data, unsigned in_size, unsigned char* out_data, unsigned out_size)
+{
+	int err;
+	z_stream d_stream; /* decompression stream */
+
+	d_stream.zalloc = 0;
+	d_stream.zfree = 0;
+	d_stream.opaque = 0;
+
+	d_stream.next_in = (unsigned char*)in_data;
+	d_stream.avail_in = in_size + 1; /* add dummy byte at end of compressed data */
+	d_stream.next_out = out_data;
+	d_stream.avail_out = out_size;
+
+	err = inflateInit2(&d_stream, -MAX_WBITS);
+	if (err != Z_OK)
+		return -1;
+
+	err = inflate(&d_stream, Z_FINISH);
+	if (err != Z_STREAM_END) {
+		inflateEnd(&d_stream);
+		return -1;
+	}
+
+	if (inflateEnd(&d_stream) != Z_OK)
+		return -1;
+
+	if (d_stream.avail_out > 0)
+		return -1;
+
+	return 0;
+}
+
 /* Read compressed data
    out:
     data compressed data read
@@ -561,6 +621,30 @@ int readcompresszip(zip_file* zip, zip_entry* ent, char* data) {
 	return 0;
 }
 
+/* Check if a "Deflate" entry is supported
+   return:
+    ==0 success
+    <0 error
+*/
+static int checkdeflatezip(zip_file* zip, zip_entry* ent) {
+	if (ent->version_needed_to_extract > 0x14) {
+		errormsg("Version too new", ERROR_UNSUPPORTED,zip->zip);
+		return -2;
+	}
+
+	if (ent->os_needed_to_extract != 0x00) {
+		errormsg("OS not supported", ERROR_UNSUPPORTED,zip->zip);
+		return -2;
+	}
+
+	if (ent->disk_number_start != zip->number_of_this_disk) {
+		errormsg("Cannot span disks", ERROR_UNSUPPORTED,zip->zip);
+		return -2;
+	}
+
+	return 0;
+}
+
 /* Read UNcompressed data
    out:
     data UNcompressed data
@@ -581,20 +665,8 @@ int readuncompresszip(zip_file* zip, zip_entry* ent, char* data) {
 		return readcompresszip(zip,ent,data);
 	} else if (ent->compression_method == 0x0008) {
 		/* file is compressed using "Deflate" method */
-		if (ent->version_needed_to_extract > 0x14) {
-			errormsg("Version too new", ERROR_UNSUPPORTED,zip->zip);
-			return -2;
-		}
-
-		if (ent->os_needed_to_extract != 0x00) {
-			errormsg("OS not supported", ERROR_UNSUPPORTED,zip->zip);
-			return -2;
-		}
-
-		if (ent->disk_number_start != zip->number_of_this_disk) {
-			errormsg("Cannot span disks", ERROR_UNSUPPORTED,zip->zip);
+		if (checkdeflatezip(zip, ent) != 0)
 			return -2;
-		}
 
 		/* read compressed data */
 		if (seekcompresszip(zip,ent)!=0) {
@@ -616,101 +688,168 @@ int readuncompresszip(zip_file* zip, zip_entry* ent, char* data) {
 }
 
 /* -------------------------------------------------------------------------
-   Zip cache support
+   Zip index support
  ------------------------------------------------------------------------- */
 
-/* Use the zip cache */
-#define ZIP_CACHE
+/* The central directory of every zip used is parsed only once, and kept in
+   a process wide index until unzip_cache_clear(). All the lookups are done
+   in the index. Only the zip used last is kept open, all the others are
+   suspended.
+*/
 
-#ifdef ZIP_CACHE
+/* Size of the zip hash table */
+#define ZIP_INDEX_HASH_SIZE 1024
 
-/* ZIP cache entries */
-#define ZIP_CACHE_MAX 5
+/* Index entry of a zipped file */
+typedef struct _zip_index_entry zip_index_entry;
+struct _zip_index_entry
+{
+	const char* name; /* 0 terminated, without the directory part */
+	UINT32	crc32;
+	UINT32	compressed_size;
+	UINT32	uncompressed_size;
+	UINT32	offset_lcl_hdr_frm_frst_disk;
+	UINT16	compression_method;
+	UINT16	disk_number_start;
+	UINT8	version_needed_to_extract;
+	UINT8	os_needed_to_extract;
+};
+
+/* Index of a zip */
+typedef struct _zip_index zip_index;
+struct _zip_index
+{
+	zip_index* next; /* next zip in the same hash bucket */
+	zip_file* zip; /* zip stream, without the central directory data */
+	unsigned count; /* number of entries */
+	zip_index_entry* entry; /* entries */
+	char* name_map; /* storage for the entry names */
+};
 
-/* ZIP cache buffer LRU ( Last Recently Used )
-     zip_cache_map[0] is the newer
-     zip_cache_map[ZIP_CACHE_MAX-1] is the older
-*/
-static zip_file* zip_cache_map[ZIP_CACHE_MAX];
+static zip_index* zip_index_map[ZIP_INDEX_HASH_SIZE];
 
-static zip_file* cache_openzip(int pathtype, int pathindex, const char* zipfile) {
-	zip_file* zip;
-	unsigned i;
+/* zip kept open */
+static zip_file* zip_index_active;
 
-	/* search in the cache buffer */
-	for(i=0;i<ZIP_CACHE_MAX;++i) {
-		if (zip_cache_map[i] && zip_cache_map[i]->pathtype == pathtype && zip_cache_map[i]->pathindex == pathindex && strcmp(zip_cache_map[i]->zip,zipfile)==0) {
-			/* found */
-			unsigned j;
+static unsigned zip_index_hash(int pathtype, int pathindex, const char* zipfile) {
+	unsigned h = pathtype * 31 + pathindex;
 
-/*
-            logerror("Zip cache HIT  for %s\n", zipfile);
-*/
+	while (*zipfile)
+		h = h * 33 + (unsigned char)*zipfile++;
 
-			/* reset the zip directory */
-			rewindzip( zip_cache_map[i] );
+	return h % ZIP_INDEX_HASH_SIZE;
+}
 
-			/* store */
-			zip = zip_cache_map[i];
+static void zip_index_free(zip_index* idx) {
+	if (zip_index_active == idx->zip)
+		zip_index_active = 0;
+	closezip(idx->zip);
+	free(idx->entry);
+	free(idx->name_map);
+	free(idx);
+}
 
-			/* shift */
-			for(j=i;j>0;--j)
-				zip_cache_map[j] = zip_cache_map[j-1];
+/* Parse the central directory of a zip */
+static zip_index* zip_index_build(int pathtype, int pathindex, const char* zipfile) {
+	zip_index* idx;
+	zip_entry* ent;
+	char* name;
 
-			/* set the first entry */
-			zip_cache_map[0] = zip;
+	idx = (zip_index*)malloc(sizeof(zip_index));
+	if (!idx)
+		return 0;
 
-			return zip_cache_map[0];
-		}
+	idx->zip = openzip(pathtype, pathindex, zipfile);
+	if (!idx->zip) {
+		free(idx);
+		return 0;
 	}
-	/* not found */
-
-/*
-    logerror("Zip cache FAIL for %s\n", zipfile);
-*/
 
-	/* open the zip */
-	zip = openzip( pathtype, pathindex, zipfile );
-	if (!zip)
+	/* every directory record is larger than its name plus the terminator */
+	idx->count = 0;
+	idx->entry = (zip_index_entry*)malloc(idx->zip->total_entries_cent_dir * sizeof(zip_index_entry));
+	idx->name_map = (char*)malloc(idx->zip->size_of_cent_dir);
+	if (!idx->entry || !idx->name_map) {
+		zip_index_free(idx);
 		return 0;
-
-	/* close the oldest entry */
-	if (zip_cache_map[ZIP_CACHE_MAX-1]) {
-		/* close last zip */
-		closezip(zip_cache_map[ZIP_CACHE_MAX-1]);
-		/* reset the entry */
-		zip_cache_map[ZIP_CACHE_MAX-1] = 0;
 	}
 
-	/* shift */
-	for(i=ZIP_CACHE_MAX-1;i>0;--i)
-		zip_cache_map[i] = zip_cache_map[i-1];
+	name = idx->name_map;
+	while (idx->count < idx->zip->total_entries_cent_dir && (ent = readzip(idx->zip)) != 0) {
+		zip_index_entry* e = &idx->entry[idx->count++];
+		const char* base;
+
+		/* only the name without directory is compared */
+		base = strrchr(ent->name, '/');
+		if (base)
+			++base;
+		else
+			base = ent->name;
+
+		strcpy(name, base);
+		e->name = name;
+		name += strlen(base) + 1;
+
+		e->crc32 = ent->crc32;
+		e->compressed_size = ent->compressed_size;
+		e->uncompressed_size = ent->uncompressed_size;
+		e->offset_lcl_hdr_frm_frst_disk = ent->offset_lcl_hdr_frm_frst_disk;
+		e->compression_method = ent->compression_method;
+		e->disk_number_start = ent->disk_number_start;
+		e->version_needed_to_extract = ent->version_needed_to_extract;
+		e->os_needed_to_extract = ent->os_needed_to_extract;
+	}
 
-	/* set the first entry */
-	zip_cache_map[0] = zip;
+	/* the directory data is not needed anymore */
+	free(idx->zip->ent.name);
+	idx->zip->ent.name = 0;
+	free(idx->zip->cd);
+	idx->zip->cd = 0;
+	free(idx->zip->ecd);
+	idx->zip->ecd = 0;
+	idx->zip->zipfile_comment = 0;
 
-	return zip_cache_map[0];
+	return idx;
 }
 
-static void cache_closezip(zip_file* zip) {
-	unsigned i;
+/* Get the index of a zip, parsing it if required */
+static zip_index* zip_index_open(int pathtype, int pathindex, const char* zipfile) {
+	unsigned h = zip_index_hash(pathtype, pathindex, zipfile);
+	zip_index* idx;
 
-	/* search in the cache buffer */
-	for(i=0;i<ZIP_CACHE_MAX;++i) {
-		if (zip_cache_map[i]==zip) {
-			/* close zip */
-			closezip(zip);
+	for(idx=zip_index_map[h];idx;idx=idx->next)
+		if (idx->zip->pathtype == pathtype && idx->zip->pathindex == pathindex && strcmp(idx->zip->zip,zipfile)==0)
+			break;
 
-			/* reset cache entry */
-			zip_cache_map[i] = 0;
-			return;
+	if (!idx) {
+		idx = zip_index_build(pathtype, pathindex, zipfile);
+		if (!idx)
+			return 0;
 
-		}
+		idx->next = zip_index_map[h];
+		zip_index_map[h] = idx;
 	}
-	/* not found */
 
-	/* close zip */
-	closezip(zip);
+	/* keep open only the last zip used */
+	if (zip_index_active && zip_index_active != idx->zip)
+		suspendzip(zip_index_active);
+	zip_index_active = idx->zip;
+
+	return idx;
+}
+
+/* Convert an index entry to a zip entry usable for reading */
+static void zip_index_get(zip_index_entry* e, zip_entry* ent) {
+	memset(ent, 0, sizeof(zip_entry));
+	ent->name = (char*)e->name;
+	ent->crc32 = e->crc32;
+	ent->compressed_size = e->compressed_size;
+	ent->uncompressed_size = e->uncompressed_size;
+	ent->offset_lcl_hdr_frm_frst_disk = e->offset_lcl_hdr_frm_frst_disk;
+	ent->compression_method = e->compression_method;
+	ent->disk_number_start = e->disk_number_start;
+	ent->version_needed_to_extract = e->version_needed_to_extract;
+	ent->os_needed_to_extract = e->os_needed_to_extract;
 }
 
 /* CK980415 added to allow osd code to clear zip cache for auditing--each time
@@ -719,48 +858,26 @@ void unzip_cache_clear()
 {
 	unsigned i;
 
-	/* search in the cache buffer for any zip info and clear it */
-	for(i=0;i<ZIP_CACHE_MAX;++i) {
-		if (zip_cache_map[i] != NULL) {
-			/* close zip */
-			closezip(zip_cache_map[i]);
-
-			/* reset cache entry */
-			zip_cache_map[i] = 0;
-/*          return; */
-
+	for(i=0;i<ZIP_INDEX_HASH_SIZE;++i) {
+		while (zip_index_map[i]) {
+			zip_index* idx = zip_index_map[i];
+			zip_index_map[i] = idx->next;
+			zip_index_free(idx);
 		}
 	}
 }
 
-#define cache_suspendzip(a) suspendzip(a)
-
-#else
-
-#define cache_openzip(a,b,c) openzip(a,b,c)
-#define cache_closezip(a) closezip(a)
-#define cache_suspendzip(a) closezip(a)
-
-#define unzip_cache_clear()
-
-#endif
-
 /* -------------------------------------------------------------------------
    Backward MAME compatibility
  ------------------------------------------------------------------------- */
 
-/* Compare two filename
+/* Compare a filename in the index with the requested one
    note:
-     don't check directory in zip and ignore case
+     ignore case
 */
 static int equal_filename(const char* zipfile, const char* file) {
 	const char* s1 = file;
-	/* start comparison after last / */
-	const char* s2 = strrchr(zipfile,'/');
-	if (s2)
-		++s2;
-	else
-		s2 = zipfile;
+	const char* s2 = zipfile;
 	while (*s1 && toupper(*s1)==toupper(*s2)) {
 		++s1;
 		++s2;
@@ -768,93 +885,218 @@ static int equal_filename(const char* zipfile, const char* file) {
 	return !*s1 && !*s2;
 }
 
+/* Decode a "load by CRC" filename, the CRC printed as 8 lowercase hex digits
+   return:
+    ==0 not a CRC
+*/
+static UINT32 crc_filename(const char* file) {
+	UINT32 crc = 0;
+	unsigned i;
+
+	for(i=0;i<8;++i) {
+		if (file[i] >= '0' && file[i] <= '9')
+			crc = (crc << 4) | (file[i] - '0');
+		else if (file[i] >= 'a' && file[i] <= 'f')
+			crc = (crc << 4) | (file[i] - 'a' + 10);
+		else
+			return 0;
+	}
+
+	if (file[8] != 0)
+		return 0;
+
+	return crc;
+}
+
+/* Search an entry by name, or by CRC if the name is a CRC */
+static zip_index_entry* zip_index_find(zip_index* idx, const char* filename) {
+	/* NS981003: support for "load by CRC" */
+	UINT32 crc = crc_filename(filename);
+	unsigned i;
+
+	for(i=0;i<idx->count;++i) {
+		zip_index_entry* e = &idx->entry[i];
+		if (equal_filename(e->name, filename) || (crc && e->crc32 == crc))
+			return e;
+	}
+
+	return 0;
+}
+
+/* Search a file in a zip using the zip index, without reading it.
+   The entry name remains valid until unzip_cache_clear().
+   return:
+     ==0 found, ent filled
+     >0 file missing in the zip
+     <0 error opening the zip
+*/
+int /* error */ find_zipped_file (int pathtype, int pathindex, const char* zipfile, const char* filename, zip_entry* ent) {
+	zip_index* idx;
+	zip_index_entry* e;
+
+	idx = zip_index_open(pathtype, pathindex, zipfile);
+	if (!idx)
+		return -1;
+
+	e = zip_index_find(idx, filename);
+	if (!e)
+		return 1;
+
+	zip_index_get(e, ent);
+
+	return 0;
+}
+
 /* Pass the path to the zipfile and the name of the file within the zipfile.
    buf will be set to point to the uncompressed image of that zipped file.
    length will be set to the length of the uncompressed data. */
 int /* error */ load_zipped_file (int pathtype, int pathindex, const char* zipfile, const char* filename, unsigned char** buf, unsigned int* length) {
-	zip_file* zip;
-	zip_entry* ent;
+	zip_index* idx;
+	zip_index_entry* e;
+	zip_entry ent;
 
-	zip = cache_openzip(pathtype, pathindex, zipfile);
-	if (!zip)
+	idx = zip_index_open(pathtype, pathindex, zipfile);
+	if (!idx)
 		return -1;
 
-	while (readzip(zip)) {
-		/* NS981003: support for "load by CRC" */
-		char crc[9];
+	e = zip_index_find(idx, filename);
+	if (!e)
+		return -1;
 
-		ent = &(zip->ent);
+	zip_index_get(e, &ent);
 
-		sprintf(crc,"%08x",ent->crc32);
-		if (equal_filename(ent->name, filename) ||
-				(ent->crc32 && !strcmp(crc, filename)))
-		{
-			*length = ent->uncompressed_size;
-			*buf = (unsigned char*)malloc( *length );
-			if (!*buf) {
-				if (!gUnzipQuiet)
-					printf("load_zipped_file(): Unable to allocate %d bytes of RAM\n",*length);
-				cache_closezip(zip);
-				return -1;
-			}
+	*length = ent.uncompressed_size;
+	*buf = (unsigned char*)malloc( *length );
+	if (!*buf) {
+		if (!gUnzipQuiet)
+			printf("load_zipped_file(): Unable to allocate %d bytes of RAM\n",*length);
+		return -1;
+	}
 
-			if (readuncompresszip(zip, ent, (char*)*buf)!=0) {
-				free(*buf);
-				cache_closezip(zip);
-				return -1;
-			}
+	if (readuncompresszip(idx->zip, &ent, (char*)*buf)!=0) {
+		free(*buf);
+		suspendzip(idx->zip);
+		return -1;
+	}
 
-			cache_suspendzip(zip);
-			return 0;
+	return 0;
+}
+
+/* Like load_zipped_file(), but it doesn't decompress the data.
+   For a "Deflate" entry buf is set to the raw compressed stream (with one
+   spare byte at the end as required by inflate_zipped_data()) and
+   compressed_length to its size. For a stored entry buf already contains
+   the final data and compressed_length is set to 0. If possible the
+   stored data is mapped in memory instead of read, and mapped is set;
+   such buffer must be released with osd_funmap() and not free().
+   This allows to do all the file I/O sequentially, and to inflate the data
+   later, possibly in parallel. */
+int /* error */ load_zipped_file_raw (int pathtype, int pathindex, const char* zipfile, const char* filename, unsigned char** buf, unsigned int* compressed_length, unsigned int* length, int* mapped) {
+	zip_index* idx;
+	zip_index_entry* e;
+	zip_entry ent;
+
+	idx = zip_index_open(pathtype, pathindex, zipfile);
+	if (!idx)
+		return -1;
+
+	e = zip_index_find(idx, filename);
+	if (!e)
+		return -1;
+
+	zip_index_get(e, &ent);
+
+	*mapped = 0;
+	*length = ent.uncompressed_size;
+
+	if (ent.compression_method == 0x0008) {
+		if (checkdeflatezip(idx->zip, &ent) != 0)
+			return -1;
+
+		*compressed_length = ent.compressed_size;
+		*buf = (unsigned char*)malloc( *compressed_length + 1 );
+		if (!*buf) {
+			if (!gUnzipQuiet)
+				printf("load_zipped_file_raw(): Unable to allocate %d bytes of RAM\n",*compressed_length + 1);
+			return -1;
+		}
+
+		if (readcompresszip(idx->zip, &ent, (char*)*buf)!=0) {
+			free(*buf);
+			suspendzip(idx->zip);
+			return -1;
 		}
+
+		/* the dummy byte */
+		(*buf)[*compressed_length] = 0;
+
+		return 0;
 	}
 
-	cache_suspendzip(zip);
-	return -1;
+	*compressed_length = 0;
+
+	/* map the stored data */
+	if (ent.compression_method == 0x0000 && ent.compressed_size == ent.uncompressed_size) {
+		long offset;
+
+		if (offsetcompresszip(idx->zip, &ent, &offset) == 0) {
+			*buf = (unsigned char*)osd_fmap(idx->zip->fp, offset, *length);
+			if (*buf) {
+				*mapped = 1;
+				return 0;
+			}
+		}
+	}
+
+	*buf = (unsigned char*)malloc( *length );
+	if (!*buf) {
+		if (!gUnzipQuiet)
+			printf("load_zipped_file_raw(): Unable to allocate %d bytes of RAM\n",*length);
+		return -1;
+	}
+
+	if (readuncompresszip(idx->zip, &ent, (char*)*buf)!=0) {
+		free(*buf);
+		suspendzip(idx->zip);
+		return -1;
+	}
+
+	return 0;
 }
 
 /*  Pass the path to the zipfile and the name of the file within the zipfile.
     sum will be set to the CRC-32 of that zipped file. */
 /*  The caller can preset sum to the expected checksum to enable "load by CRC" */
 int /* error */ checksum_zipped_file (int pathtype, int pathindex, const char *zipfile, const char *filename, unsigned int *length, unsigned int *sum) {
-	zip_file* zip;
-	zip_entry* ent;
+	zip_index* idx;
+	unsigned i;
 
-	zip = cache_openzip(pathtype, pathindex, zipfile);
-	if (!zip)
+	idx = zip_index_open(pathtype, pathindex, zipfile);
+	if (!idx)
 		return -1;
 
-	while (readzip(zip)) {
-		ent = &(zip->ent);
+	for(i=0;i<idx->count;++i) {
+		zip_index_entry* e = &idx->entry[i];
 
-		if (equal_filename(ent->name, filename))
+		if (equal_filename(e->name, filename))
 		{
-			*length = ent->uncompressed_size;
-			*sum = ent->crc32;
-			cache_suspendzip(zip);
+			*length = e->uncompressed_size;
+			*sum = e->crc32;
 			return 0;
 		}
 	}
 
-	cache_suspendzip(zip);
-
 	/* NS981003: support for "load by CRC" */
-	zip = cache_openzip(pathtype, pathindex, zipfile);
-	if (!zip)
-		return -1;
-
-	while (readzip(zip)) {
-		ent = &(zip->ent);
+	for(i=0;i<idx->count;++i) {
+		zip_index_entry* e = &idx->entry[i];
 
-		if (*sum && ent->crc32 == *sum)
+		if (*sum && e->crc32 == *sum)
 		{
-			*length = ent->uncompressed_size;
-			*sum = ent->crc32;
-			cache_suspendzip(zip);
+			*length = e->uncompressed_size;
+			*sum = e->crc32;
 			return 0;
 		}
 	}
 
-	cache_suspendzip(zip);
 	return -1;
 }
@@ -15,6 +15,7 @@
 #include "profiler.h"
 #include "png.h"
 #include "vidhrdw/vector.h"
+#include <zlib.h>
 
 #if defined(MAME_DEBUG) && !defined(NEW_DEBUGGER)
 #include "mamedbg.h"
@@ -33,6 +34,10 @@
    routines don't clip at boundaries of the bitmap. */
 #define BITMAP_SAFETY				16
 
+/* tiles decoded at once, and number of independent decoding tasks */
+#define DECODE_BLOCK_SIZE			256
+#define DECODE_TASK_COUNT			8
+
 
 
 /***************************************************************************
@@ -393,45 +398,69 @@ static int allocate_graphics(const gfx_decode *gfxdecodeinfo)
 }
 
 
+/*-------------------------------------------------
+    decode_graphics_task - decode a share of the
+    tile blocks of all the graphics elements
+-------------------------------------------------*/
+
+static void decode_graphics_task(void *param, int task_num, int task_count)
+{
+	const gfx_decode *gfxdecodeinfo = param;
+	int block = 0;
+	int i, j;
+
+	/* blocks are dealt round-robin, so every task gets a share of each element */
+	for (i = 0; i < MAX_GFX_ELEMENTS; i++)
+		if (Machine->gfx[i] && gfxdecodeinfo[i].memory_region > REGION_INVALID)
+		{
+			UINT8 *region_base = memory_region(gfxdecodeinfo[i].memory_region);
+			gfx_element *gfx = Machine->gfx[i];
+
+			/* the first block of raw graphics is done upfront because it sets the data pointer */
+			j = (gfx->flags & GFX_DONT_FREE_GFXDATA) ? DECODE_BLOCK_SIZE : 0;
+
+			for ( ; j < gfx->total_elements; j += DECODE_BLOCK_SIZE, block++)
+				if (block % task_count == task_num)
+				{
+					int num_to_decode = (j + DECODE_BLOCK_SIZE < gfx->total_elements) ? DECODE_BLOCK_SIZE : (gfx->total_elements - j);
+					decodegfx(gfx, region_base + gfxdecodeinfo[i].start, j, num_to_decode);
+				}
+		}
+}
+
+
 /*-------------------------------------------------
     decode_graphics - decode the graphics
 -------------------------------------------------*/
 
 static void decode_graphics(const gfx_decode *gfxdecodeinfo)
 {
-	int totalgfx = 0, curgfx = 0;
 	int i;
 
-	/* count total graphics elements */
-	for (i = 0; i < MAX_GFX_ELEMENTS; i++)
-		if (Machine->gfx[i])
-			totalgfx += Machine->gfx[i]->total_elements;
-
-	/* loop over all elements */
+	/* set up the raw graphics and clear the elements without a region */
 	for (i = 0; i < MAX_GFX_ELEMENTS; i++)
 		if (Machine->gfx[i])
 		{
-			/* if we have a valid region, decode it now */
+			gfx_element *gfx = Machine->gfx[i];
+
+			/* raw graphics point to the region, so the first block must be done before the others */
 			if (gfxdecodeinfo[i].memory_region > REGION_INVALID)
 			{
-				UINT8 *region_base = memory_region(gfxdecodeinfo[i].memory_region);
-				gfx_element *gfx = Machine->gfx[i];
-				int j;
-
-				/* now decode the actual graphics */
-				for (j = 0; j < gfx->total_elements; j += 1024)
+				if (gfx->flags & GFX_DONT_FREE_GFXDATA)
 				{
-					int num_to_decode = (j + 1024 < gfx->total_elements) ? 1024 : (gfx->total_elements - j);
-					decodegfx(gfx, region_base + gfxdecodeinfo[i].start, j, num_to_decode);
-					curgfx += num_to_decode;
-		/*          ui_display_decoding(artwork_get_ui_bitmap(), curgfx * 100 / totalgfx);*/
+					UINT8 *region_base = memory_region(gfxdecodeinfo[i].memory_region);
+					int num_to_decode = (DECODE_BLOCK_SIZE < gfx->total_elements) ? DECODE_BLOCK_SIZE : gfx->total_elements;
+					decodegfx(gfx, region_base + gfxdecodeinfo[i].start, 0, num_to_decode);
 				}
 			}
 
 			/* otherwise, clear the target region */
 			else
-				memset(Machine->gfx[i]->gfxdata, 0, Machine->gfx[i]->char_modulo * Machine->gfx[i]->total_elements);
+				memset(gfx->gfxdata, 0, gfx->char_modulo * gfx->total_elements);
 		}
+
+	/* each tile is decoded independently, so the blocks can be spread over the threads */
+	osd_parallelize(decode_graphics_task, (void *)gfxdecodeinfo, DECODE_TASK_COUNT);
 }
 
 
@@ -618,7 +647,7 @@ void force_partial_update(int scanline)
 	rectangle clip = Machine->visible_area;
 
 	/* if skipping this frame, bail */
-	if (osd_skip_this_frame())
+	if (skip_this_frame())
 		return;
 
 	/* skip if less than the lowest so far */
@@ -790,27 +819,43 @@ static void recompute_fps(int skipped_it)
 
 
 /*-------------------------------------------------
-    updatescreen - handle frameskipping and UI,
-    plus updating the screen during normal
-    operations
+    screen_crc - compute the CRC of the visible
+    area of the screen bitmap
 -------------------------------------------------*/
 
-void updatescreen(void)
+static UINT32 screen_crc(void)
 {
-	/* update sound */
-	sound_frame_update();
+	mame_bitmap *bitmap = scrbitmap[0];
+	int bytes = (bitmap->depth + 7) / 8;
+	int min_x = Machine->absolute_visible_area.min_x;
+	int width = Machine->absolute_visible_area.max_x - min_x + 1;
+	UINT32 crc = 0;
+	int y;
 
-	/* if we're not skipping this frame, draw the screen */
-	if (!osd_skip_this_frame())
+	for (y = Machine->absolute_visible_area.min_y; y <= Machine->absolute_visible_area.max_y; y++)
+		crc = crc32(crc, (UINT8 *)bitmap->line[y] + min_x * bytes, width * bytes);
+
+	return crc;
+}
+
+
+/*-------------------------------------------------
+    update_deferred_screen - display a frame
+    whose update was deferred by the run-ahead;
+    the end-of-frame callback is left to the
+    caller
+-------------------------------------------------*/
+
+void update_deferred_screen(int draw)
+{
+	/* draw the screen if not already done */
+	if (draw)
 	{
 		profiler_mark(PROFILER_VIDEO);
 		draw_screen();
 		profiler_mark(PROFILER_END);
 	}
 
-	/* the user interface must be called between vh_update() and osd_update_video_and_audio(), */
-	/* to allow it to overlay things on the game display. We must call it even */
-	/* if the frame is skipped, to keep a consistent timing. */
 	ui_update_and_render(artwork_get_ui_bitmap());
 
 	/* update our movie recording state */
@@ -819,8 +864,70 @@ void updatescreen(void)
 
 	/* blit to the screen */
 	update_video_and_audio();
+}
+
+
+/*-------------------------------------------------
+    updatescreen - handle frameskipping and UI,
+    plus updating the screen during normal
+    operations
+-------------------------------------------------*/
+
+void updatescreen(void)
+{
+	int frame = mame_runahead_frame();
+
+	/* update sound */
+	sound_frame_update();
+
+	if (frame == RUNAHEAD_FRAME_NORMAL)
+	{
+		/* if we're not skipping this frame, draw the screen */
+		if (!osd_skip_this_frame())
+		{
+			profiler_mark(PROFILER_VIDEO);
+			draw_screen();
+			profiler_mark(PROFILER_END);
+		}
 
-	/* call the end-of-frame callback */
+		/* the user interface must be called between vh_update() and osd_update_video_and_audio(), */
+		/* to allow it to overlay things on the game display. We must call it even */
+		/* if the frame is skipped, to keep a consistent timing. */
+		ui_update_and_render(artwork_get_ui_bitmap());
+
+		/* update our movie recording state */
+		if (!mame_is_paused())
+			record_movie_frame(scrbitmap[0]);
+
+		/* blit to the screen */
+		update_video_and_audio();
+	}
+
+	/* the frames emulated ahead are drawn only if used */
+	/* and the deferred frames are displayed after the run-ahead */
+	else if (frame == RUNAHEAD_FRAME_DRAW || frame == RUNAHEAD_FRAME_MEASURE)
+	{
+		profiler_mark(PROFILER_VIDEO);
+		draw_screen();
+		profiler_mark(PROFILER_END);
+
+		if (frame == RUNAHEAD_FRAME_MEASURE)
+			mame_runahead_hash(screen_crc());
+	}
+
+	/* call the end-of-frame callback, the deferred frames call it after the display */
+	if (frame != RUNAHEAD_FRAME_DEFERRED)
+		update_video_eof();
+}
+
+
+/*-------------------------------------------------
+    update_video_eof - call the end-of-frame
+    callback of the driver
+-------------------------------------------------*/
+
+void update_video_eof(void)
+{
 	if (Machine->drv->video_eof && !mame_is_paused())
 	{
 		profiler_mark(PROFILER_VIDEO);
@@ -836,7 +943,21 @@ void updatescreen(void)
 
 int skip_this_frame(void)
 {
-	return osd_skip_this_frame();
+	/* the frames emulated ahead and never displayed are skipped */
+	return osd_skip_this_frame() || mame_runahead_skip_frame();
+}
+
+
+/*-------------------------------------------------
+    set_runahead_performance - store the time used
+    by the run-ahead in the latest frame
+-------------------------------------------------*/
+
+void set_runahead_performance(int frames, double seconds, int lag)
+{
+	performance.runahead_frames = frames;
+	performance.runahead_time = seconds;
+	performance.runahead_lag = lag;
 }
 
 
@@ -1287,6 +1408,10 @@ void bitmap_free(mame_bitmap *bitmap)
 
 void set_led_status(int num, int on)
 {
+	/* the frames emulated ahead are discarded */
+	if (mame_is_running_ahead())
+		return;
+
 	if (on)
 		leds_status |=	(1 << num);
 	else
@@ -1299,6 +1424,10 @@ void set_led_status(int num, int on)
 
 void set_knocker_status(int on)
 {
+	/* the frames emulated ahead are discarded */
+	if (mame_is_running_ahead())
+		return;
+
 	if (on)
 		knocker_status = 1;
 	else
@@ -79,6 +79,9 @@ struct _performance_info
 	double			frames_per_second;			/* actual rendered fps */
 	int				vector_updates_last_second; /* # of vector updates last second */
 	int				partial_updates_this_frame; /* # of partial updates last frame */
+	int				runahead_frames;			/* # of frames run ahead last frame */
+	double			runahead_time;				/* seconds used by the run-ahead last frame */
+	int				runahead_lag;				/* frames of lag hidden by the run-ahead, -1 if not measured */
 };
 /* In mamecore.h: typedef struct _performance_info performance_info; */
 
@@ -123,6 +126,15 @@ void update_video_and_audio(void);
 /* (this calls draw_screen and update_video_and_audio) */
 void updatescreen(void);
 
+/* display a frame deferred by the run-ahead */
+void update_deferred_screen(int draw);
+
+/* call the end-of-frame callback of the driver */
+void update_video_eof(void);
+
+/* store the time used by the run-ahead */
+void set_runahead_performance(int frames, double seconds, int lag);
+
 /* can we skip this frame? */
 int skip_this_frame(void);
 
@@ -210,6 +210,7 @@ mame_file *mame_fopen_error(const char *gamename, const char *filename, int file
 		case FILETYPE_COMMENT:
 		case FILETYPE_INI:
 		case FILETYPE_HASH:		/* MESS-specific */
+		case FILETYPE_HASHINDEX:	/* MESS-specific */
 			return generic_fopen(filetype, NULL, gamename, 0, openforwrite ? FILEFLAG_OPENWRITE : FILEFLAG_OPENREAD, error);
 
 		/* generic multi-directory files */
@@ -971,6 +972,10 @@ static const char *get_extension_for_filetype(int filetype)
 		case FILETYPE_HASH:
 			extension = "hsi";
 			break;
+
+		case FILETYPE_HASHINDEX:
+			extension = "hsx";
+			break;
 #endif
 	}
 	return extension;
@@ -41,6 +41,7 @@ enum
 	FILETYPE_COMMENT,
 	FILETYPE_DEBUGLOG,
 	FILETYPE_HASH,	/* MESS-specific */
+	FILETYPE_HASHINDEX,	/* MESS-specific */
 	FILETYPE_end 	/* dummy last entry */
 };
 
@@ -375,6 +375,11 @@ int osd_handle_user_interface(mame_bitmap *bitmap, int is_menu_active);
 /* osd logging */
 void osd_log_va(const char* text, va_list arg);
 
+/* map in memory a read only part of a file. Return 0 if not supported. */
+/* The map remains valid also after closing the file. */
+void* osd_fmap(osd_file* file, UINT64 offset, UINT32 length);
+void osd_funmap(void* ptr, UINT32 length);
+
 #ifdef MESS
 /* this is here to follow the current mame file hierarchy style */
 #include "osd_mess.h"
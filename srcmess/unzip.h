@@ -135,7 +135,11 @@ int readuncompresszip(zip_file* zip, zip_entry* ent, char* data);
 /* public functions */
 int /* error */ load_zipped_file (int pathtype, int pathindex, const char *zipfile, const char *filename,
 	unsigned char **buf, unsigned int *length);
+int /* error */ load_zipped_file_raw (int pathtype, int pathindex, const char *zipfile, const char *filename,
+	unsigned char **buf, unsigned int *compressed_length, unsigned int *length, int *mapped);
+int /* error */ inflate_zipped_data (const unsigned char *in_data, unsigned int in_size, unsigned char *out_data, unsigned int out_size);
 int /* error */ checksum_zipped_file (int pathtype, int pathindex, const char *zipfile, const char *filename, unsigned int *length, unsigned int *sum);
+int /* error */ find_zipped_file (int pathtype, int pathindex, const char *zipfile, const char *filename, zip_entry *ent);
 
 void unzip_cache_clear(void);
 